@@ -11,7 +11,8 @@ project, then, looks like:
           ext_modules=mypycify(['foo.py']),
     )
 
-See the mypycify docs for additional arguments.
+See the mypycify docs for additional arguments. To compile the C files
+in parallel, also pass cmdclass={'build_ext': get_build_ext()}.
 
 mypycify can integrate with either distutils or setuptools, but needs
 to know at import-time whether it is using distutils or setuputils. We
@@ -21,6 +22,8 @@ hackily decide based on whether setuptools has been imported already.
 import sys
 import os.path
 import hashlib
+import json
+import shutil
 import time
 import re
 
@@ -75,6 +78,128 @@ def setup_mypycify_vars() -> None:
         vars['CFLAGS'] = vars['CFLAGS'].replace('-arch i386', '')
 
 
+# Paths of the C files whose object files can be cached, mapped to all the
+# headers that they can include
+cacheable_sources = {}  # type: Dict[str, Tuple[str, ...]]
+
+
+def register_cacheable_sources(cfiles: List[str], headers: List[str]) -> None:
+    for cfile in cfiles:
+        cacheable_sources[os.path.abspath(cfile)] = tuple(sorted(headers))
+
+
+def object_cache_key(compiler: Any, src: str, args: List[str],
+                     digests: Dict[Tuple[str, ...], bytes]) -> Optional[str]:
+    """Compute the hash of everything that affects the object file of a C file.
+
+    Return None if the object file of the source can't be cached. The digests
+    of the headers are memoized in digests.
+    """
+    headers = cacheable_sources.get(os.path.abspath(src))
+    if headers is None:
+        return None
+    if headers not in digests:
+        h = hashlib.sha256()
+        for path in headers:
+            with open(path, 'rb') as f:
+                h.update(path.encode('utf-8') + b'\0' + hashlib.sha256(f.read()).digest())
+        digests[headers] = h.digest()
+    h = hashlib.sha256(json.dumps([compiler.compiler_so, args, src]).encode('utf-8'))
+    h.update(digests[headers])
+    with open(src, 'rb') as f:
+        h.update(f.read())
+    return h.hexdigest()
+
+
+def setup_parallel_compile(compiler: Any, jobs: int, cache_dir: str) -> None:
+    """Make a distutils compiler compile the C files of mypyc extensions in parallel.
+
+    The object files of registered sources (see register_cacheable_sources)
+    are also stored in cache_dir by the hash of their inputs, and unchanged
+    files are copied from there instead of being compiled again.
+
+    This replaces the compile method of the given compiler object only, and
+    only calls that compile registered sources with a unix compiler are
+    affected. Use teardown_parallel_compile to restore it.
+    """
+    original = compiler.compile
+
+    def compile(sources: List[str], output_dir: Optional[str] = None,
+                macros: Any = None, include_dirs: Optional[List[str]] = None, debug: int = 0,
+                extra_preargs: Optional[List[str]] = None,
+                extra_postargs: Optional[List[str]] = None,
+                depends: Optional[List[str]] = None) -> List[str]:
+        if (compiler.compiler_type != 'unix'
+                or not any(os.path.abspath(src) in cacheable_sources for src in sources)):
+            return original(sources, output_dir, macros, include_dirs, debug,
+                            extra_preargs, extra_postargs, depends)
+        macros, objects, extra_postargs, pp_opts, build = compiler._setup_compile(
+            output_dir, macros, include_dirs, sources, depends, extra_postargs)
+        cc_args = compiler._get_cc_args(pp_opts, debug, extra_preargs)
+        to_compile = [obj for obj in objects if obj in build]
+        digests = {}  # type: Dict[Tuple[str, ...], bytes]
+        keys = {obj: object_cache_key(compiler, build[obj][0], cc_args + extra_postargs, digests)
+                for obj in to_compile}
+
+        def compile_object(obj: str) -> None:
+            src, ext = build[obj]
+            key = keys[obj]
+            if key is None:
+                compiler._compile(obj, src, ext, cc_args, extra_postargs, pp_opts)
+                return
+            cached = os.path.join(cache_dir, key + '.o')
+            if os.path.exists(cached):
+                shutil.copyfile(cached, obj)
+                return
+            compiler._compile(obj, src, ext, cc_args, extra_postargs, pp_opts)
+            # Copy through a temporary file so that concurrent builds
+            # never see a partially written object file
+            os.makedirs(cache_dir, exist_ok=True)
+            tmp = '{}.{}.tmp'.format(cached, os.getpid())
+            shutil.copyfile(obj, tmp)
+            os.replace(tmp, cached)
+
+        from multiprocessing.pool import ThreadPool
+        with ThreadPool(max(jobs, 1)) as pool:
+            pool.map(compile_object, to_compile)
+        return objects
+
+    compiler.compile = compile
+
+
+def teardown_parallel_compile(compiler: Any) -> None:
+    """Undo setup_parallel_compile."""
+    vars(compiler).pop('compile', None)
+
+
+def get_build_ext() -> Type[Any]:
+    """Return a build_ext command that compiles mypyc extensions in parallel.
+
+    Pass it to setup as cmdclass={'build_ext': get_build_ext()}. The options
+    given to mypycify are stored in the extensions, and other extensions are
+    built as usual.
+    """
+    # Like in get_extension, pick setuptools if it has been imported.
+    if 'setuptools' not in sys.modules:
+        from distutils.command.build_ext import build_ext  # type: ignore
+    else:
+        from setuptools.command.build_ext import build_ext  # type: ignore  # noqa
+
+    class mypyc_build_ext(build_ext):  # type: ignore
+        def build_extension(self, ext: Any) -> None:
+            options = getattr(ext, 'mypyc_parallel_compile', None)
+            if options is None:
+                super().build_extension(ext)
+                return
+            setup_parallel_compile(self.compiler, *options)
+            try:
+                super().build_extension(ext)
+            finally:
+                teardown_parallel_compile(self.compiler)
+
+    return mypyc_build_ext
+
+
 def fail(message: str) -> NoReturn:
     # TODO: Is there something else we should do to fail?
     sys.exit(message)
@@ -122,7 +247,8 @@ def get_mypy_config(mypy_options: List[str],
 
 
 def generate_c_extension_shim(
-        full_module_name: str, module_name: str, dir_name: str, group_name: str) -> str:
+        full_module_name: str, module_name: str, dir_name: str, group_name: str,
+        index: int = 0) -> str:
     """Create a C extension shim with a passthrough PyInit function.
 
     Arguments:
@@ -130,6 +256,7 @@ def generate_c_extension_shim(
         module_name: the final component of the module name
         dir_name: the directory to place source code
         group_name: the name of the group
+        index: the position of the module in the group's table of init functions
     """
     cname = '%s.c' % full_module_name.replace('.', os.sep)
     cpath = os.path.join(dir_name, cname)
@@ -143,7 +270,8 @@ def generate_c_extension_shim(
         cpath,
         shim_template.format(modname=module_name,
                              libname=shared_lib_name(group_name),
-                             full_modname=exported_name(full_module_name)))
+                             full_modname=exported_name(full_module_name),
+                             index=index))
 
     return cpath
 
@@ -238,8 +366,8 @@ def build_using_shared_lib(sources: List[BuildSource],
     in the shared library.
 
     The shared library (which lib_name is the name of) is a python
-    extension module that exports the real initialization functions in
-    Capsules stored in module attributes.
+    extension module that exports a table of the real initialization
+    functions in a Capsule stored in a module attribute.
     """
     extensions = [get_extension()(
         shared_lib_name(group_name),
@@ -249,9 +377,10 @@ def build_using_shared_lib(sources: List[BuildSource],
         extra_compile_args=extra_compile_args,
     )]
 
-    for source in sources:
+    for index, source in enumerate(sources):
         module_name = source.module.split('.')[-1]
-        shim_file = generate_c_extension_shim(source.module, module_name, build_dir, group_name)
+        shim_file = generate_c_extension_shim(source.module, module_name, build_dir, group_name,
+                                              index)
 
         # We include the __init__ in the "module name" we stick in the Extension,
         # since this seems to be needed for it to end up in the right place.
@@ -432,7 +561,10 @@ def mypycify(
     separate: Union[bool, List[Tuple[List[str], Optional[str]]]] = False,
     skip_cgen_input: Optional[Any] = None,
     target_dir: Optional[str] = None,
-    include_runtime_files: Optional[bool] = None
+    include_runtime_files: Optional[bool] = None,
+    profile_dispatch: bool = False,
+    dispatch_profile: Optional[str] = None,
+    jobs: Optional[int] = None
 ) -> List['Extension']:
     """Main entry point to building using mypyc.
 
@@ -471,6 +603,16 @@ def mypycify(
                                should be directly #include'd instead of linked
                                separately in order to reduce compiler invocations.
                                Defaults to False in multi_file mode, True otherwise.
+        profile_dispatch: Should the receiver types at method calls through vtables
+                          be counted. The counts are written to the file named by the
+                          MYPYC_DISPATCH_PROFILE environment variable on exit.
+        dispatch_profile: A file written by a profile_dispatch build. Calls that
+                          almost always saw the same class get a guarded direct call.
+        jobs: The number of C files to compile in parallel with unix compilers.
+              Defaults to the number of CPUs. Object files of generated C files are
+              also cached in the objcache subdirectory of target_dir, so unchanged
+              files aren't compiled again (use multi_file to make this effective).
+              This requires the build_ext command from get_build_ext.
     """
 
     # Figure out our configuration
@@ -481,6 +623,8 @@ def mypycify(
         separate=separate is not False,
         target_dir=target_dir,
         include_runtime_files=include_runtime_files,
+        profile_dispatch=profile_dispatch,
+        dispatch_profile=dispatch_profile,
     )
 
     # Generate all the actual important C code
@@ -542,6 +686,16 @@ def mypycify(
                 write_file(rt_file, f.read())
             shared_cfilenames.append(rt_file)
 
+    # Generated C files can include the generated headers of any group and
+    # the runtime library (including its C files if they are #included)
+    headers = [os.path.join(include_dir(), name)
+               for name in os.listdir(include_dir()) if name.endswith(('.h', '.c'))]
+    for _, deps in group_cfilenames:
+        # Includes of runtime library files aren't found in the target directory
+        headers.extend(dep for dep in deps if os.path.exists(dep))
+    for cfilenames, _ in group_cfilenames:
+        register_cacheable_sources(cfilenames + shared_cfilenames, list(set(headers)))
+
     extensions = []
     for (group_sources, lib_name), (cfilenames, deps) in zip(groups, group_cfilenames):
         if lib_name:
@@ -551,4 +705,9 @@ def mypycify(
             extensions.extend(build_single_module(
                 group_sources, cfilenames + shared_cfilenames, cflags))
 
+    # Used by the build_ext command from get_build_ext
+    parallel_compile = (jobs or os.cpu_count() or 1, os.path.join(build_dir, 'objcache'))
+    for extension in extensions:
+        setattr(extension, 'mypyc_parallel_compile', parallel_compile)
+
     return extensions
@@ -0,0 +1,64 @@
+"""Receiver type profiles of native method call sites.
+
+A build compiled with the profile_dispatch option counts the receiver
+types seen at each method call that goes through a vtable. If the
+MYPYC_DISPATCH_PROFILE environment variable is set, the counts are
+appended to the file it names when the interpreter exits (see
+CPyDispatchProfile_Register in lib-rt/misc_ops.c). Each line has the
+form "<site>\t<type fullname>\t<count>", where the type "*" stands for
+all the types that didn't fit in the table of a site.
+
+Passing such a file back through the dispatch_profile option makes mypyc
+emit a guarded direct call at each site that (almost) always saw the
+same native class.
+"""
+
+from typing import Dict, List
+
+from typing_extensions import Final
+
+
+# The fraction of the calls at a site that a single class must account for
+MONOMORPHIC_THRESHOLD = 0.95  # type: Final
+
+# Sites with fewer calls than this don't matter enough to specialize
+MIN_CALLS = 100  # type: Final
+
+
+def dispatch_site_name(module_name: str, line: int, method: str) -> str:
+    """Return the name that identifies a call site across builds.
+
+    Sites of the same method on the same line share a name, and their counts are merged.
+    """
+    return '{}:{}:{}'.format(module_name, line, method)
+
+
+def read_dispatch_profile(lines: List[str]) -> Dict[str, str]:
+    """Find the monomorphic sites in profile lines.
+
+    Return a map from site names to the full name of the receiver class.
+    Counts for the same site are added up, since a profile may have been
+    appended to by several processes or compilation groups.
+    """
+    counts = {}  # type: Dict[str, Dict[str, int]]
+    for line in lines:
+        fields = line.rstrip('\n').split('\t')
+        if len(fields) != 3:
+            continue
+        site, type_name, count = fields
+        site_counts = counts.setdefault(site, {})
+        site_counts[type_name] = site_counts.get(type_name, 0) + int(count)
+
+    result = {}  # type: Dict[str, str]
+    for site, site_counts in counts.items():
+        total = sum(site_counts.values())
+        type_name = max(site_counts, key=lambda name: site_counts[name])
+        if (type_name != '*' and total >= MIN_CALLS
+                and site_counts[type_name] >= MONOMORPHIC_THRESHOLD * total):
+            result[site] = type_name
+    return result
+
+
+def load_dispatch_profile(path: str) -> Dict[str, str]:
+    with open(path) as f:
+        return read_dispatch_profile(f.readlines())
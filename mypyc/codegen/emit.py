@@ -8,14 +8,14 @@ from mypyc.common import (
     REG_PREFIX, ATTR_PREFIX, STATIC_PREFIX, TYPE_PREFIX, NATIVE_PREFIX,
     FAST_ISINSTANCE_MAX_SUBCLASSES, use_vectorcall
 )
-from mypyc.ir.ops import BasicBlock, Value
+from mypyc.ir.ops import BasicBlock, Value, LoadInlineCache
 from mypyc.ir.rtypes import (
     RType, RTuple, RInstance, RUnion, RPrimitive,
     is_float_rprimitive, is_bool_rprimitive, is_int_rprimitive, is_short_int_rprimitive,
     is_list_rprimitive, is_dict_rprimitive, is_set_rprimitive, is_tuple_rprimitive,
     is_none_rprimitive, is_object_rprimitive, object_rprimitive, is_str_rprimitive,
     int_rprimitive, is_optional_type, optional_value_type, is_int32_rprimitive,
-    is_int64_rprimitive, is_bit_rprimitive
+    is_int64_rprimitive, is_bit_rprimitive, is_bytes_rprimitive
 )
 from mypyc.ir.func_ir import FuncDecl
 from mypyc.ir.class_ir import ClassIR, all_concrete_classes
@@ -55,6 +55,35 @@ class HeaderDeclaration:
         self.needs_export = needs_export
 
 
+class StaticTables:
+    """Literals and per-site caches that generated code refers to by index.
+
+    A compilation group normally has a single set of tables. In multi-file
+    mode each module has its own set, with names that have a per-module
+    suffix, so that the C file of a module doesn't depend on the contents
+    of other modules (see GroupGenerator.generate_c_for_modules).
+    """
+
+    def __init__(self, suffix: str = '') -> None:
+        # Suffix of the names of the C arrays
+        self.suffix = suffix
+
+        self.literals = Literals()
+
+        # Map from LoadInlineCache ops to indexes in the inline cache array
+        self.inline_caches = {}  # type: Dict[LoadInlineCache, int]
+        # Names ("module:line") of the sites of the inline caches, by index
+        self.inline_cache_sites = []  # type: List[str]
+
+        # Map from (source path, function name, line) of traceback entries to
+        # indexes in the array of cached code objects
+        self.traceback_codes = {}  # type: Dict[Tuple[str, str, int], int]
+
+        # Number of trait lookup sites, each of which has a slot in the
+        # array of trait caches
+        self.num_trait_caches = 0
+
+
 class EmitterContext:
     """Shared emitter state for a compilation group."""
 
@@ -86,7 +115,15 @@ class EmitterContext:
         # The declaration contains the body of the struct.
         self.declarations = OrderedDict()  # type: Dict[str, HeaderDeclaration]
 
-        self.literals = Literals()
+        # Tables of literals and per-site caches used by the code being generated
+        self.tables = StaticTables()
+
+        # Names of the method call sites that count receiver types, if
+        # profiling (the index of a name is the index of its site)
+        self.dispatch_sites = None  # type: Optional[List[str]]
+        # Map from names of monomorphic call sites to the class they
+        # dispatch to, from a dispatch profile
+        self.dispatch_targets = {}  # type: Dict[str, ClassIR]
 
 
 class Emitter:
@@ -205,6 +242,42 @@ class Emitter:
         suffix = self.names.private_name(module or '', id)
         return '{}{}{}{}'.format(star_maybe, lib_prefix, prefix, suffix)
 
+    def traceback_call(self, source_path: str, module_name: str, func_name: str,
+                       line: int) -> str:
+        """Return a C statement that adds a traceback entry for the current exception.
+
+        Each distinct entry gets a slot for a cached code object.
+        """
+        key = (source_path, func_name, line)
+        codes = self.context.tables.traceback_codes
+        if key not in codes:
+            codes[key] = len(codes)
+        globals_static = self.static_name('globals', module_name)
+        return 'CPy_AddTracebackCached(&CPyTracebackCodes[%d], "%s", "%s", %d, %s);' % (
+            codes[key],
+            source_path.replace("\\", "\\\\"),
+            func_name,
+            line,
+            globals_static)
+
+    def trait_cache(self) -> str:
+        """Return a C expression for a pointer to a fresh trait lookup cache."""
+        tables = self.context.tables
+        index = tables.num_trait_caches
+        tables.num_trait_caches += 1
+        return '&CPyTraitCaches[%d]' % index
+
+    def dispatch_site(self, name: str) -> Optional[str]:
+        """Return a C expression for a pointer to a new dispatch profile site.
+
+        Return None if we aren't profiling.
+        """
+        sites = self.context.dispatch_sites
+        if sites is None:
+            return None
+        sites.append(name)
+        return '&CPyDispatchSites[%d]' % (len(sites) - 1)
+
     def type_struct_name(self, cl: ClassIR) -> str:
         return self.static_name(cl.name, cl.module_name, prefix=TYPE_PREFIX)
 
@@ -411,7 +484,7 @@ class Emitter:
         # TODO: Verify refcount handling.
         if (is_list_rprimitive(typ) or is_dict_rprimitive(typ) or is_set_rprimitive(typ)
                 or is_float_rprimitive(typ) or is_str_rprimitive(typ) or is_int_rprimitive(typ)
-                or is_bool_rprimitive(typ)):
+                or is_bool_rprimitive(typ) or is_bytes_rprimitive(typ)):
             if declare_dest:
                 self.emit_line('PyObject *{};'.format(dest))
             if is_list_rprimitive(typ):
@@ -424,6 +497,8 @@ class Emitter:
                 prefix = 'CPyFloat'
             elif is_str_rprimitive(typ):
                 prefix = 'PyUnicode'
+            elif is_bytes_rprimitive(typ):
+                prefix = 'CPyBytes'
             elif is_int_rprimitive(typ):
                 prefix = 'PyLong'
             elif is_bool_rprimitive(typ) or is_bit_rprimitive(typ):
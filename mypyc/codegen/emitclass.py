@@ -4,12 +4,14 @@ from typing import Optional, List, Tuple, Dict, Callable, Mapping, Set
 
 from mypy.ordered_dict import OrderedDict
 
-from mypyc.common import PREFIX, NATIVE_PREFIX, REG_PREFIX, use_fastcall
+from mypyc.common import (
+    PREFIX, NATIVE_PREFIX, REG_PREFIX, GENERATOR_HELPER_NAME, use_fastcall
+)
 from mypyc.codegen.emit import Emitter, HeaderDeclaration
 from mypyc.codegen.emitfunc import native_function_header
 from mypyc.codegen.emitwrapper import (
     generate_dunder_wrapper, generate_hash_wrapper, generate_richcompare_wrapper,
-    generate_bool_wrapper, generate_get_wrapper,
+    generate_bool_wrapper, generate_get_wrapper, generate_len_wrapper,
 )
 from mypyc.ir.rtypes import RType, RTuple, object_rprimitive
 from mypyc.ir.func_ir import FuncIR, FuncDecl, FUNC_STATICMETHOD, FUNC_CLASSMETHOD
@@ -46,6 +48,7 @@ SLOT_DEFS = {
 
 AS_MAPPING_SLOT_DEFS = {
     '__getitem__': ('mp_subscript', generate_dunder_wrapper),
+    '__len__': ('mp_length', generate_len_wrapper),
 }  # type: SlotTable
 
 AS_NUMBER_SLOT_DEFS = {
@@ -167,7 +170,11 @@ def generate_class(cl: ClassIR, module: str, emitter: Emitter) -> None:
     # Fill out dunder methods that live in tables hanging off the side.
     for table_name, type, slot_defs in SIDE_TABLES:
         slots = generate_slots(cl, slot_defs, emitter)
-        if slots:
+        if table_name == 'as_async' and is_generator_class(cl):
+            fields['tp_iternext'] = 'CPyGen_IterNext'
+            fields['tp_as_async'] = '&{}.base'.format(
+                generate_generator_methods_for_class(cl, slots, emitter))
+        elif slots:
             table_struct_name = generate_side_table_for_class(cl, table_name, type, slots, emitter)
             fields['tp_{}'.format(table_name)] = '&{}'.format(table_struct_name)
 
@@ -244,6 +251,10 @@ def generate_class(cl: ClassIR, module: str, emitter: Emitter) -> None:
     if cl.is_trait:
         generate_new_for_trait(cl, new_name, emitter)
 
+    if has_native_pickle_methods(cl):
+        generate_pickle_methods(cl, emitter)
+        emit_line()
+
     generate_methods_table(cl, methods_name, emitter)
     emit_line()
 
@@ -452,8 +463,9 @@ def generate_setup_for_class(cl: ClassIR,
     emitter.emit_line('{}(PyTypeObject *type)'.format(func_name))
     emitter.emit_line('{')
     emitter.emit_line('{} *self;'.format(cl.struct_name(emitter.names)))
-    emitter.emit_line('self = ({struct} *)type->tp_alloc(type, 0);'.format(
-        struct=cl.struct_name(emitter.names)))
+    alloc = 'CPyFreeList_Alloc(type)' if cl.use_free_list else 'type->tp_alloc(type, 0)'
+    emitter.emit_line('self = ({struct} *){alloc};'.format(
+        struct=cl.struct_name(emitter.names), alloc=alloc))
     emitter.emit_line('if (self == NULL)')
     emitter.emit_line('    return NULL;')
 
@@ -649,7 +661,10 @@ def generate_dealloc_for_class(cl: ClassIR,
     # The trashcan is needed to handle deep recursive deallocations
     emitter.emit_line('CPy_TRASHCAN_BEGIN(self, {})'.format(dealloc_func_name))
     emitter.emit_line('{}(self);'.format(clear_func_name))
-    emitter.emit_line('Py_TYPE(self)->tp_free((PyObject *)self);')
+    if cl.use_free_list:
+        emitter.emit_line('CPyFreeList_Free((PyObject *)self);')
+    else:
+        emitter.emit_line('Py_TYPE(self)->tp_free((PyObject *)self);')
     emitter.emit_line('CPy_TRASHCAN_END(self)')
     emitter.emit_line('}')
 
@@ -659,7 +674,7 @@ def generate_methods_table(cl: ClassIR,
                            emitter: Emitter) -> None:
     emitter.emit_line('static PyMethodDef {}[] = {{'.format(name))
     for fn in cl.methods.values():
-        if fn.decl.is_prop_setter or fn.decl.is_prop_getter:
+        if fn.decl.is_prop_setter or fn.decl.is_prop_getter or fn.name == GENERATOR_HELPER_NAME:
             continue
         emitter.emit_line('{{"{}",'.format(fn.name))
         emitter.emit_line(' (PyCFunction){}{},'.format(PREFIX, fn.cname(emitter.names)))
@@ -676,7 +691,14 @@ def generate_methods_table(cl: ClassIR,
         emitter.emit_line(' {}, NULL}},'.format(' | '.join(flags)))
 
     # Provide a default __getstate__ and __setstate__
-    if not cl.has_method('__setstate__') and not cl.has_method('__getstate__'):
+    if has_native_pickle_methods(cl):
+        name_prefix = cl.name_prefix(emitter.names)
+        emitter.emit_lines(
+            '{{"__setstate__", (PyCFunction){}_setstate, METH_O, NULL}},'.format(name_prefix),
+            '{{"__getstate__", (PyCFunction){}_getstate, METH_NOARGS, NULL}},'.format(
+                name_prefix),
+        )
+    elif not cl.has_method('__setstate__') and not cl.has_method('__getstate__'):
         emitter.emit_lines(
             '{"__setstate__", (PyCFunction)CPyPickle_SetState, METH_O, NULL},',
             '{"__getstate__", (PyCFunction)CPyPickle_GetState, METH_NOARGS, NULL},',
@@ -686,6 +708,170 @@ def generate_methods_table(cl: ClassIR,
     emitter.emit_line('};')
 
 
+def has_native_pickle_methods(cl: ClassIR) -> bool:
+    """Do we generate the default __getstate__ and __setstate__ of cl?
+
+    Otherwise the generic ones in the runtime library are used, which
+    go through __mypyc_attrs__ and normal attribute access.
+    """
+    return (not cl.is_trait and not cl.builtin_base and not cl.is_generated and not cl.has_dict
+            and not cl.has_method('__setstate__') and not cl.has_method('__getstate__'))
+
+
+def generate_pickle_methods(cl: ClassIR, emitter: Emitter) -> None:
+    """Generate __getstate__ and __setstate__ that access the struct directly.
+
+    The state is a dict that maps the names of the defined attributes to
+    their values (like the generic CPyPickle_GetState), or a tuple of the
+    values of all attributes if the class has compact_pickle set. Only
+    instances of exactly cl use the fast paths, since an interpreted
+    subclass may override attributes.
+    """
+    name_prefix = cl.name_prefix(emitter.names)
+    struct_name = cl.struct_name(emitter.names)
+    type_name = emitter.type_struct_name(cl)
+    # Same order as in __mypyc_attrs__
+    attrs = [(name, rtype) for ancestor in cl.mro for name, rtype in ancestor.attributes.items()]
+    keys_name = '{}_state_keys'.format(name_prefix)
+    if attrs and not cl.compact_pickle:
+        emitter.emit_line('static PyObject *{}[{}];'.format(keys_name, len(attrs)))
+        emitter.emit_line('static const char * const {}_state_names[] = {{{}}};'.format(
+            name_prefix, ', '.join('"{}"'.format(name) for name, _ in attrs)))
+        emitter.emit_line()
+
+    emitter.emit_line('static PyObject *')
+    emitter.emit_line('{}_getstate({} *self, PyObject *Py_UNUSED(ignored))'.format(
+        name_prefix, struct_name))
+    emitter.emit_line('{')
+    emitter.emit_lines('if (Py_TYPE(self) != {}) {{'.format(type_name),
+                       'return CPyPickle_GetState((PyObject *)self);',
+                       '}')
+    if cl.compact_pickle:
+        emitter.emit_lines('PyObject *state = PyTuple_New({});'.format(len(attrs)),
+                           'if (state == NULL) {',
+                           'return NULL;',
+                           '}')
+    else:
+        if attrs:
+            emitter.emit_lines(
+                'if (CPyPickle_InitKeys({}, {}_state_names, {}) < 0) {{'.format(
+                    keys_name, name_prefix, len(attrs)),
+                'return NULL;',
+                '}')
+        emitter.emit_lines('PyObject *state = PyDict_New();',
+                           'if (state == NULL) {',
+                           'return NULL;',
+                           '}')
+    for i, (name, rtype) in enumerate(attrs):
+        attr_expr = 'self->{}'.format(emitter.attr(name))
+        if cl.compact_pickle:
+            # All attributes must be defined, since the tuple has no way to leave them out
+            emitter.emit_undefined_attr_check(rtype, attr_expr, '==', unlikely=True)
+            emitter.emit_lines('PyErr_SetString(PyExc_AttributeError,',
+                               '    "attribute {} of {} undefined");'.format(
+                                   repr(name), repr(cl.name)),
+                               'Py_DECREF(state);',
+                               'return NULL;',
+                               '}')
+            emitter.emit_line('{')
+            emitter.emit_inc_ref(attr_expr, rtype)
+            emitter.emit_box(attr_expr, 'value', rtype, declare_dest=True)
+            emitter.emit_line('PyTuple_SET_ITEM(state, {}, value);'.format(i))
+            emitter.emit_line('}')
+        else:
+            # Undefined attributes are left out
+            emitter.emit_undefined_attr_check(rtype, attr_expr, '!=')
+            emitter.emit_inc_ref(attr_expr, rtype)
+            emitter.emit_box(attr_expr, 'value', rtype, declare_dest=True)
+            emitter.emit_lines(
+                'int res = PyDict_SetItem(state, {}[{}], value);'.format(keys_name, i),
+                'Py_DECREF(value);',
+                'if (res < 0) {',
+                'Py_DECREF(state);',
+                'return NULL;',
+                '}',
+                '}')
+    emitter.emit_line('return state;')
+    emitter.emit_line('}')
+    emitter.emit_line()
+
+    emitter.emit_line('static PyObject *')
+    emitter.emit_line('{}_setstate({} *self, PyObject *state)'.format(name_prefix, struct_name))
+    emitter.emit_line('{')
+    # Other kinds of state (such as a dict in compact mode, to support pickles
+    # from before the class was changed to compact_pickle) are handled generically
+    check = 'PyTuple_Check(state)' if cl.compact_pickle else 'PyDict_CheckExact(state)'
+    emitter.emit_lines('if (Py_TYPE(self) != {} || !{}) {{'.format(type_name, check),
+                       'return CPyPickle_SetState((PyObject *)self, state);',
+                       '}')
+    if cl.compact_pickle:
+        emitter.emit_lines(
+            'if (PyTuple_GET_SIZE(state) != {}) {{'.format(len(attrs)),
+            'PyErr_SetString(PyExc_TypeError,',
+            '    "state of {} must be a tuple of {} items");'.format(repr(cl.name), len(attrs)),
+            'return NULL;',
+            '}')
+    elif attrs:
+        emitter.emit_lines('if (CPyPickle_InitKeys({}, {}_state_names, {}) < 0) {{'.format(
+                               keys_name, name_prefix, len(attrs)),
+                           'return NULL;',
+                           '}',
+                           'Py_ssize_t found = 0;')
+    for i, (name, rtype) in enumerate(attrs):
+        emitter.emit_line('{')
+        if cl.compact_pickle:
+            emitter.emit_line('PyObject *value = PyTuple_GET_ITEM(state, {});'.format(i))
+        else:
+            emitter.emit_lines(
+                'PyObject *value = PyDict_GetItemWithError(state, {}[{}]);'.format(keys_name, i),
+                'if (value == NULL && PyErr_Occurred()) {',
+                'return NULL;',
+                '}',
+                'if (value != NULL) {',
+                'found++;')
+        generate_set_attr_from_object(cl, name, rtype, 'value', 'return NULL;', emitter)
+        if not cl.compact_pickle:
+            emitter.emit_line('}')
+        emitter.emit_line('}')
+    if not cl.compact_pickle:
+        # Keys that aren't attributes of the class (for example, from a
+        # pickle of a different version of the class) are set normally
+        emitter.emit_lines(
+            'if ({} < PyDict_GET_SIZE(state)) {{'.format('found' if attrs else '0'),
+            'return CPyPickle_SetState((PyObject *)self, state);',
+            '}')
+    emitter.emit_line('Py_RETURN_NONE;')
+    emitter.emit_line('}')
+
+
+def generate_set_attr_from_object(cl: ClassIR,
+                                  attr: str,
+                                  rtype: RType,
+                                  value: str,
+                                  failure: str,
+                                  emitter: Emitter) -> None:
+    """Set an attribute of self to a borrowed object, checking its type."""
+    attr_field = emitter.attr(attr)
+    if rtype.is_unboxed:
+        emitter.emit_unbox(value, 'tmp', rtype, custom_failure=failure, declare_dest=True)
+    elif is_same_type(rtype, object_rprimitive):
+        emitter.emit_line('PyObject *tmp = {};'.format(value))
+    else:
+        emitter.emit_cast(value, 'tmp', rtype, declare_dest=True)
+        emitter.emit_lines('if (!tmp)',
+                           '    {}'.format(failure))
+    emitter.emit_inc_ref('tmp', rtype)
+    if rtype.is_refcounted:
+        # Release the old value last, since that can run arbitrary code
+        emitter.emit_line('{}old = self->{};'.format(emitter.ctype_spaced(rtype), attr_field))
+        emitter.emit_line('self->{} = tmp;'.format(attr_field))
+        emitter.emit_undefined_attr_check(rtype, 'old', '!=')
+        emitter.emit_dec_ref('old', rtype)
+        emitter.emit_line('}')
+    else:
+        emitter.emit_line('self->{} = tmp;'.format(attr_field))
+
+
 def generate_side_table_for_class(cl: ClassIR,
                                   name: str,
                                   type: str,
@@ -699,6 +885,54 @@ def generate_side_table_for_class(cl: ClassIR,
     return name
 
 
+def is_generator_class(cl: ClassIR) -> bool:
+    return cl.is_generated and GENERATOR_HELPER_NAME in cl.methods
+
+
+def generate_generator_methods_for_class(cl: ClassIR,
+                                         slots: Dict[str, str],
+                                         emitter: Emitter) -> str:
+    """Generate the CPyAsyncMethods table of a generator class.
+
+    This lets native code resume the generator by calling the helper method
+    directly, without raising StopIteration when the generator returns.
+    """
+    prefix = cl.name_prefix(emitter.names)
+    helper = emitter.native_function_name(cl.methods[GENERATOR_HELPER_NAME].decl)
+    send_name = '{}_send'.format(prefix)
+    throw_name = '{}_throw'.format(prefix)
+    emitter.emit_lines(
+        'static int {}(PyObject *self, PyObject *arg, PyObject **result) {{'.format(send_name),
+        'PyObject *retval = NULL;',
+        'PyObject *res = {}(self, Py_None, Py_None, Py_None, arg, &retval);'.format(helper),
+        'return CPyGen_SendResult(res, retval, result);',
+        '}',
+        '',
+        'static int {}(PyObject *self, PyObject *type, PyObject *value, '
+        'PyObject *traceback, PyObject **result) {{'.format(throw_name),
+        'PyObject *retval = NULL;',
+        'PyObject *res = {}(self, type, value, traceback, Py_None, &retval);'.format(helper),
+        'return CPyGen_SendResult(res, retval, result);',
+        '}',
+        '',
+    )
+    name = '{}_as_async'.format(prefix)
+    emitter.emit_line('static CPyAsyncMethods {} = {{'.format(name))
+    emitter.emit_line('.base = {')
+    for field, value in slots.items():
+        emitter.emit_line('.{} = {},'.format(field, value))
+    emitter.emit_lines(
+        '#if PY_VERSION_HEX >= 0x030A0000',
+        '.am_send = (sendfunc){},'.format(send_name),
+        '#endif',
+        '},',
+        '.send = {},'.format(send_name),
+        '.throw_ = {},'.format(throw_name),
+        '};',
+    )
+    return name
+
+
 def generate_getseter_declarations(cl: ClassIR, emitter: Emitter) -> None:
     if not cl.is_trait:
         for attr in cl.attributes:
@@ -1,18 +1,20 @@
 """Code generation for native function bodies."""
 
-from typing import Union, Optional
+from typing import Union, Optional, Tuple
 from typing_extensions import Final
 
 from mypyc.common import (
     REG_PREFIX, NATIVE_PREFIX, STATIC_PREFIX, TYPE_PREFIX, MODULE_PREFIX,
 )
 from mypyc.codegen.emit import Emitter
+from mypyc.codegen.dispatchprofile import dispatch_site_name
 from mypyc.ir.ops import (
     OpVisitor, Goto, Branch, Return, Assign, Integer, LoadErrorValue, GetAttr, SetAttr,
     LoadStatic, InitStatic, TupleGet, TupleSet, Call, IncRef, DecRef, Box, Cast, Unbox,
     BasicBlock, Value, MethodCall, Unreachable, NAMESPACE_STATIC, NAMESPACE_TYPE, NAMESPACE_MODULE,
     RaiseStandardError, CallC, LoadGlobal, Truncate, IntOp, LoadMem, GetElementPtr,
-    LoadAddress, ComparisonOp, SetMem, Register, LoadLiteral, AssignMulti, KeepAlive
+    LoadAddress, ComparisonOp, SetMem, Register, LoadLiteral, AssignMulti, KeepAlive,
+    LoadInlineCache
 )
 from mypyc.ir.rtypes import (
     RType, RTuple, RArray, is_tagged, is_int32_rprimitive, is_int64_rprimitive, RStruct,
@@ -20,7 +22,7 @@ from mypyc.ir.rtypes import (
 )
 from mypyc.ir.func_ir import FuncIR, FuncDecl, FUNC_STATICMETHOD, FUNC_CLASSMETHOD, all_values
 from mypyc.ir.class_ir import ClassIR
-from mypyc.ir.pprint import generate_names_for_ir
+from mypyc.ir.pprint import generate_names_for_ir, literal_repr
 
 # Whether to insert debug asserts for all error handling, to quickly
 # catch errors propagating without exceptions set.
@@ -56,11 +58,22 @@ def generate_native_function(fn: FuncIR,
     declarations.emit_line('{} {{'.format(native_function_header(fn.decl, emitter)))
     body.indent()
 
+    # Arrays initialized with AssignMulti are declared on first assignment.
+    # Arrays that are only filled through their address are declared here.
+    array_inits = {op.dest for block in fn.blocks for op in block.ops
+                   if isinstance(op, AssignMulti)}
+
     for r in all_values(fn.arg_regs, fn.blocks):
         if isinstance(r.type, RTuple):
             emitter.declare_tuple_struct(r.type)
         if isinstance(r.type, RArray):
-            continue  # Special: declared on first assignment
+            if r not in array_inits:
+                declarations.emit_line('{ctype}{prefix}{name}[{length}];'.format(
+                    ctype=emitter.ctype_spaced(r.type.item_type),
+                    prefix=REG_PREFIX,
+                    name=names[r],
+                    length=r.type.length))
+            continue
 
         if r in fn.arg_regs:
             continue  # Skip the arguments
@@ -104,7 +117,7 @@ class FunctionEmitterVisitor(OpVisitor[None]):
         self.declarations = declarations
         self.source_path = source_path
         self.module_name = module_name
-        self.literals = emitter.context.literals
+        self.literals = emitter.context.tables.literals
         self.next_block = None  # type: Optional[BasicBlock]
 
     def temp_name(self) -> str:
@@ -213,15 +226,15 @@ class FunctionEmitterVisitor(OpVisitor[None]):
 
     def visit_load_literal(self, op: LoadLiteral) -> None:
         index = self.literals.literal_index(op.value)
-        s = repr(op.value)
+        s = literal_repr(op.value)
         if not any(x in s for x in ('/*', '*/', '\0')):
             ann = ' /* %s */' % s
         else:
             ann = ''
         if not is_int_rprimitive(op.type):
-            self.emit_line('%s = CPyStatics[%d];%s' % (self.reg(op), index, ann))
+            self.emit_line('%s = CPyStatic(%d);%s' % (self.reg(op), index, ann))
         else:
-            self.emit_line('%s = (CPyTagged)CPyStatics[%d] | 1;%s' % (
+            self.emit_line('%s = (CPyTagged)CPyStatic(%d) | 1;%s' % (
                 self.reg(op), index, ann))
 
     def get_attr_expr(self, obj: str, op: Union[GetAttr, SetAttr], decl_cl: ClassIR) -> str:
@@ -235,17 +248,17 @@ class FunctionEmitterVisitor(OpVisitor[None]):
         if decl_cl.is_trait and op.class_type.class_ir.is_trait:
             # For pure trait access find the offset first, offsets
             # are ordered by attribute position in the cl.attributes dict.
-            # TODO: pre-calculate the mapping to make this faster.
             trait_attr_index = list(decl_cl.attributes).index(op.attr)
             # TODO: reuse these names somehow?
             offset = self.emitter.temp_name()
             self.declarations.emit_line('size_t {};'.format(offset))
             self.emitter.emit_line('{} = {};'.format(
                 offset,
-                'CPy_FindAttrOffset({}, {}, {})'.format(
+                'CPy_FindAttrOffsetCached({}, {}, {}, {})'.format(
                     self.emitter.type_struct_name(decl_cl),
                     '({}{})->vtable'.format(cast, obj),
                     trait_attr_index,
+                    self.emitter.trait_cache(),
                 )
             ))
             attr_cast = '({} *)'.format(self.ctype(op.class_type.attr_type(op.attr)))
@@ -268,8 +281,8 @@ class FunctionEmitterVisitor(OpVisitor[None]):
         attr_rtype, decl_cl = cl.attr_details(op.attr)
         if cl.get_method(op.attr):
             # Properties are essentially methods, so use vtable access for them.
-            version = '_TRAIT' if cl.is_trait else ''
-            self.emit_line('%s = CPY_GET_ATTR%s(%s, %s, %d, %s, %s); /* %s */' % (
+            version, cache = self.trait_cache_args(cl)
+            self.emit_line('%s = CPY_GET_ATTR%s(%s, %s, %d, %s, %s%s); /* %s */' % (
                 dest,
                 version,
                 obj,
@@ -277,12 +290,13 @@ class FunctionEmitterVisitor(OpVisitor[None]):
                 rtype.getter_index(op.attr),
                 rtype.struct_name(self.names),
                 self.ctype(rtype.attr_type(op.attr)),
+                cache,
                 op.attr))
         else:
             # Otherwise, use direct or offset struct access.
             attr_expr = self.get_attr_expr(obj, op, decl_cl)
             self.emitter.emit_line('{} = {};'.format(dest, attr_expr))
-            if attr_rtype.is_refcounted:
+            if attr_rtype.is_refcounted and not op.is_borrowed:
                 self.emitter.emit_undefined_attr_check(
                     attr_rtype, attr_expr, '==', unlikely=True
                 )
@@ -303,8 +317,8 @@ class FunctionEmitterVisitor(OpVisitor[None]):
         attr_rtype, decl_cl = cl.attr_details(op.attr)
         if cl.get_method(op.attr):
             # Again, use vtable access for properties...
-            version = '_TRAIT' if cl.is_trait else ''
-            self.emit_line('%s = CPY_SET_ATTR%s(%s, %s, %d, %s, %s, %s); /* %s */' % (
+            version, cache = self.trait_cache_args(cl)
+            self.emit_line('%s = CPY_SET_ATTR%s(%s, %s, %d, %s, %s, %s%s); /* %s */' % (
                 dest,
                 version,
                 obj,
@@ -313,6 +327,7 @@ class FunctionEmitterVisitor(OpVisitor[None]):
                 src,
                 rtype.struct_name(self.names),
                 self.ctype(rtype.attr_type(op.attr)),
+                cache,
                 op.attr))
         else:
             # ...and struct access for normal attributes.
@@ -397,7 +412,6 @@ class FunctionEmitterVisitor(OpVisitor[None]):
             [obj])
         args = ', '.join(obj_args + [self.reg(arg) for arg in op.args])
         mtype = native_function_type(method, self.emitter)
-        version = '_TRAIT' if rtype.class_ir.is_trait else ''
         if is_direct:
             # Directly call method, without going through the vtable.
             lib = self.emitter.get_group_prefix(method.decl)
@@ -406,13 +420,37 @@ class FunctionEmitterVisitor(OpVisitor[None]):
         else:
             # Call using vtable.
             method_idx = rtype.method_index(name)
-            self.emit_line('{}CPY_GET_METHOD{}({}, {}, {}, {}, {})({}); /* {} */'.format(
+            site_name = dispatch_site_name(self.module_name, op.line, name)
+            site = self.emitter.dispatch_site(site_name)
+            if site is not None:
+                self.emit_line('CPyDispatchProfile_Record({}, {});'.format(site, obj))
+            target = self.find_dispatch_target(site_name, rtype.class_ir, name, method_idx)
+            if target is not None:
+                # The profile says that the receiver is almost always of one
+                # class, so check for it and call its implementation directly.
+                target_cl, target_fn = target
+                lib = self.emitter.get_group_prefix(target_fn.decl)
+                self.emit_line('if (Py_TYPE({}) == {}) {{'.format(
+                    obj, self.emitter.type_struct_name(target_cl)))
+                self.emit_line('{}(({}){}{}{})({});'.format(
+                    dest, mtype, lib, NATIVE_PREFIX, target_fn.cname(self.names), args))
+                self.emit_line('} else {')
+            version, cache = self.trait_cache_args(rtype.class_ir)
+            self.emit_line('{}CPY_GET_METHOD{}({}, {}, {}, {}, {}{})({}); /* {} */'.format(
                 dest, version, obj, self.emitter.type_struct_name(rtype.class_ir),
-                method_idx, rtype.struct_name(self.names), mtype, args, op.method))
+                method_idx, rtype.struct_name(self.names), mtype, cache, args, op.method))
+            if target is not None:
+                self.emit_line('}')
 
     def visit_inc_ref(self, op: IncRef) -> None:
         src = self.reg(op.src)
-        self.emit_inc_ref(src, op.src.type)
+        if isinstance(op.src, LoadLiteral):
+            # Literals can be immortal, and then they don't need to be counted
+            self.emit_line('#ifndef CPY_IMMORTAL_STATICS')
+            self.emit_inc_ref(src, op.src.type)
+            self.emit_line('#endif')
+        else:
+            self.emit_inc_ref(src, op.src.type)
 
     def visit_dec_ref(self, op: DecRef) -> None:
         src = self.reg(op.src)
@@ -525,6 +563,10 @@ class FunctionEmitterVisitor(OpVisitor[None]):
         src = self.reg(op.src) if isinstance(op.src, Register) else op.src
         self.emit_line('%s = (%s)&%s;' % (dest, typ._ctype, src))
 
+    def visit_load_inline_cache(self, op: LoadInlineCache) -> None:
+        index = self.emitter.context.tables.inline_caches[op]
+        self.emit_line('%s = &CPyInlineCaches[%d];' % (self.reg(op), index))
+
     def visit_keep_alive(self, op: KeepAlive) -> None:
         # This is a no-op.
         pass
@@ -534,6 +576,36 @@ class FunctionEmitterVisitor(OpVisitor[None]):
     def label(self, label: BasicBlock) -> str:
         return self.emitter.label(label)
 
+    def find_dispatch_target(self, site_name: str, cl: ClassIR, name: str,
+                             method_idx: int) -> Optional[Tuple[ClassIR, FuncIR]]:
+        """Find the profiled receiver class of a vtable call and the function it calls.
+
+        This is the function stored in the vtable (or trait vtable) of the
+        class, which might be a glue method.
+        """
+        target = self.emitter.context.dispatch_targets.get(site_name)
+        if target is None or target.is_trait or cl not in target.mro:
+            return None
+        if cl.is_trait:
+            entries = target.trait_vtables.get(cl)
+        else:
+            entries = target.vtable_entries
+        if entries is None or method_idx >= len(entries):
+            return None
+        entry = entries[method_idx]
+        if entry.name != name:
+            return None
+        return target, entry.method
+
+    def trait_cache_args(self, cl: ClassIR) -> Tuple[str, str]:
+        """Return the vtable access macro suffix and extra arguments for a class.
+
+        Lookups through a trait go via a per-site cache of the last receiver's vtable.
+        """
+        if cl.is_trait:
+            return '_TRAIT_CACHED', ', ' + self.emitter.trait_cache()
+        return '', ''
+
     def reg(self, reg: Value) -> str:
         if isinstance(reg, Integer):
             val = reg.value
@@ -573,12 +645,9 @@ class FunctionEmitterVisitor(OpVisitor[None]):
 
     def emit_traceback(self, op: Branch) -> None:
         if op.traceback_entry is not None:
-            globals_static = self.emitter.static_name('globals', self.module_name)
-            self.emit_line('CPy_AddTraceback("%s", "%s", %d, %s);' % (
-                self.source_path.replace("\\", "\\\\"),
-                op.traceback_entry[0],
-                op.traceback_entry[1],
-                globals_static))
+            self.emit_line(self.emitter.traceback_call(self.source_path, self.module_name,
+                                                       op.traceback_entry[0],
+                                                       op.traceback_entry[1]))
             if DEBUG_ERRORS:
                 self.emit_line('assert(PyErr_Occurred() != NULL && "failure w/o err!");')
 
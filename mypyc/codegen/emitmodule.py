@@ -7,6 +7,7 @@ import os
 import json
 from mypy.ordered_dict import OrderedDict
 from typing import List, Tuple, Dict, Iterable, Set, TypeVar, Optional
+from typing_extensions import Final
 
 from mypy.nodes import MypyFile
 from mypy.build import (
@@ -23,19 +24,20 @@ from mypyc.irbuild.main import build_ir
 from mypyc.irbuild.prepare import load_type_map
 from mypyc.irbuild.mapper import Mapper
 from mypyc.common import (
-    PREFIX, TOP_LEVEL_NAME, MODULE_PREFIX, RUNTIME_C_FILES, use_fastcall,
+    PREFIX, TOP_LEVEL_NAME, GENERATOR_HELPER_NAME, MODULE_PREFIX, RUNTIME_C_FILES, use_fastcall,
     use_vectorcall, shared_lib_name,
 )
 from mypyc.codegen.cstring import c_string_initializer
+from mypyc.codegen.dispatchprofile import load_dispatch_profile
 from mypyc.codegen.literals import Literals
-from mypyc.codegen.emit import EmitterContext, Emitter, HeaderDeclaration
+from mypyc.codegen.emit import EmitterContext, Emitter, HeaderDeclaration, StaticTables
 from mypyc.codegen.emitfunc import generate_native_function, native_function_header
 from mypyc.codegen.emitclass import generate_class_type_decl, generate_class
 from mypyc.codegen.emitwrapper import (
     generate_wrapper_function, wrapper_function_header,
     generate_legacy_wrapper_function, legacy_wrapper_function_header,
 )
-from mypyc.ir.ops import DeserMaps, LoadLiteral
+from mypyc.ir.ops import DeserMaps, LoadLiteral, LoadInlineCache
 from mypyc.ir.rtypes import RType, RTuple
 from mypyc.ir.func_ir import FuncIR
 from mypyc.ir.class_ir import ClassIR
@@ -44,10 +46,19 @@ from mypyc.options import CompilerOptions
 from mypyc.transform.uninit import insert_uninit_checks
 from mypyc.transform.refcount import insert_ref_count_opcodes
 from mypyc.transform.exceptions import insert_exception_handling
+from mypyc.transform.nogil import check_nogil_regions
 from mypyc.namegen import NameGenerator, exported_name
 from mypyc.errors import Errors
 
 
+# Names of the static tables that generated code refers to. In multi-file
+# mode these are defined as macros that expand to the suffixed names of
+# the tables of the module in each C file.
+TABLE_NAMES = [
+    'CPyStatics', 'CPyStatics_Lazy', 'CPyInlineCaches', 'CPyTracebackCodes', 'CPyTraitCaches',
+]  # type: Final
+
+
 # All of the modules being compiled are divided into "groups". A group
 # is a set of modules that are placed into the same shared library.
 # Two common configurations are that every module is placed in a group
@@ -224,6 +235,12 @@ def compile_scc_to_ir(
     for module in modules.values():
         for fn in module.functions:
             insert_ref_count_opcodes(fn)
+    # Check nogil functions.
+    paths = {tree.fullname: tree.path for tree in scc}
+    for module_name, module in modules.items():
+        for fn in module.functions:
+            for line, message in check_nogil_regions(fn):
+                errors.error(message, paths[module_name], line)
 
     return modules
 
@@ -416,11 +433,16 @@ def compile_modules_to_c(
     return modules, [ctext[name] for _, name in groups]
 
 
+def has_wrapper_function(fn: FuncIR) -> bool:
+    # Generator helpers take a C pointer argument, so they can't be called from Python
+    return fn.name not in (TOP_LEVEL_NAME, GENERATOR_HELPER_NAME)
+
+
 def generate_function_declaration(fn: FuncIR, emitter: Emitter) -> None:
     emitter.context.declarations[emitter.native_function_name(fn.decl)] = HeaderDeclaration(
         '{};'.format(native_function_header(fn.decl, emitter)),
         needs_export=True)
-    if fn.name != TOP_LEVEL_NAME:
+    if has_wrapper_function(fn):
         if is_fastcall_supported(fn, emitter.capi_version):
             emitter.context.declarations[PREFIX + fn.cname(emitter.names)] = HeaderDeclaration(
                 '{};'.format(wrapper_function_header(fn, emitter.names)))
@@ -479,6 +501,18 @@ class GroupGenerator:
         self.use_shared_lib = group_name is not None
         self.compiler_options = compiler_options
         self.multi_file = compiler_options.multi_file
+        # Static tables used by each module (see generate_c_for_modules)
+        self.module_tables = {}  # type: Dict[str, StaticTables]
+        if compiler_options.profile_dispatch:
+            self.context.dispatch_sites = []
+        if compiler_options.dispatch_profile:
+            self.context.dispatch_targets = self.find_dispatch_targets(
+                load_dispatch_profile(compiler_options.dispatch_profile))
+
+    def find_dispatch_targets(self, profile: Dict[str, str]) -> Dict[str, ClassIR]:
+        """Resolve the receiver classes of monomorphic call sites in this group."""
+        classes = {cl.fullname: cl for _, module in self.modules for cl in module.classes}
+        return {site: classes[name] for site, name in profile.items() if name in classes}
 
     @property
     def group_suffix(self) -> str:
@@ -492,10 +526,25 @@ class GroupGenerator:
         file_contents = []
         multi_file = self.use_shared_lib and self.multi_file
 
-        # Collect all literal refs in IR.
-        for _, module in self.modules:
+        # In multi-file mode each module gets its own tables of literals and
+        # caches, so that changes to one module don't affect the C files of
+        # the other modules. The array sizes aren't part of the declarations
+        # in the headers for the same reason.
+        if multi_file:
+            self.module_tables = {
+                module_name: StaticTables('_' + exported_name(module_name))
+                for module_name, _ in self.modules
+            }
+        else:
+            self.module_tables = {module_name: self.context.tables
+                                  for module_name, _ in self.modules}
+
+        # Collect all literal refs and inline caches in IR.
+        for module_name, module in self.modules:
+            tables = self.module_tables[module_name]
             for fn in module.functions:
-                collect_literals(fn, self.context.literals)
+                collect_literals(fn, tables.literals)
+                collect_inline_caches(fn, tables.inline_caches, tables.inline_cache_sites)
 
         base_emitter = Emitter(self.context)
         # Optionally just include the runtime library c files to
@@ -507,14 +556,18 @@ class GroupGenerator:
         base_emitter.emit_line('#include "__native_internal{}.h"'.format(self.short_group_suffix))
         emitter = base_emitter
 
-        self.generate_literal_tables()
+        for tables in self.all_tables():
+            self.generate_literal_tables(tables)
+            self.generate_inline_cache_table(tables)
 
         for module_name, module in self.modules:
+            self.context.tables = self.module_tables[module_name]
             if multi_file:
                 emitter = Emitter(self.context)
                 emitter.emit_line('#include "__native{}.h"'.format(self.short_group_suffix))
                 emitter.emit_line(
                     '#include "__native_internal{}.h"'.format(self.short_group_suffix))
+                self.define_table_names(self.context.tables, emitter)
 
             self.declare_module(module_name, emitter)
             self.declare_internal_globals(module_name, emitter)
@@ -530,7 +583,7 @@ class GroupGenerator:
             for fn in module.functions:
                 emitter.emit_line()
                 generate_native_function(fn, emitter, self.source_paths[module_name], module_name)
-                if fn.name != TOP_LEVEL_NAME:
+                if has_wrapper_function(fn):
                     emitter.emit_line()
                     if is_fastcall_supported(fn, emitter.capi_version):
                         generate_wrapper_function(
@@ -542,6 +595,11 @@ class GroupGenerator:
                 name = ('__native_{}.c'.format(emitter.names.private_name(module_name)))
                 file_contents.append((name, ''.join(emitter.fragments)))
 
+        for tables in self.all_tables():
+            self.generate_traceback_code_table(tables)
+            self.generate_trait_cache_table(tables)
+        self.generate_dispatch_site_table()
+
         # The external header file contains type declarations while
         # the internal contains declarations of functions and objects
         # (which are shared between shared libraries via dynamic
@@ -618,34 +676,109 @@ class GroupGenerator:
              ''.join(ext_declarations.fragments)),
         ]
 
-    def generate_literal_tables(self) -> None:
+    def all_tables(self) -> List[StaticTables]:
+        """Return the distinct static tables of the group, in module order."""
+        result = []  # type: List[StaticTables]
+        for module_name, _ in self.modules:
+            tables = self.module_tables[module_name]
+            if tables not in result:
+                result.append(tables)
+        return result
+
+    def define_table_names(self, tables: StaticTables, emitter: Emitter) -> None:
+        """Make the unsuffixed table names used by generated code refer to a module's tables."""
+        for name in TABLE_NAMES:
+            emitter.emit_line('#define {} {}{}'.format(name, name, tables.suffix))
+
+    def generate_literal_tables(self, tables: StaticTables) -> None:
         """Generate tables containing descriptions of Python literals to construct.
 
         We will store the constructed literals in a single array that contains
         literals of all types. This way we can refer to an arbitrary literal by
         its index.
         """
-        literals = self.context.literals
+        literals = tables.literals
+        suffix = tables.suffix
+        unsized = bool(suffix)
         # During module initialization we store all the constructed objects here
-        self.declare_global('PyObject *[%d]' % literals.num_literals(), 'CPyStatics')
+        # (or only on first use, if compiled with MYPYC_LAZY_STATICS)
+        self.declare_global('PyObject *[%d]' % literals.num_literals(), 'CPyStatics' + suffix,
+                            unsized=unsized)
+        # Used to create literals on first use if compiled with MYPYC_LAZY_STATICS
+        self.declare_global('CPyStatics_Table ', 'CPyStatics_Lazy' + suffix)
         # Descriptions of str literals
         init_str = c_string_array_initializer(literals.encoded_str_values())
-        self.declare_global('const char * const []', 'CPyLit_Str', initializer=init_str)
+        self.declare_global('const char * const []', 'CPyLit_Str' + suffix,
+                            initializer=init_str)
         # Descriptions of bytes literals
         init_bytes = c_string_array_initializer(literals.encoded_bytes_values())
-        self.declare_global('const char * const []', 'CPyLit_Bytes', initializer=init_bytes)
+        self.declare_global('const char * const []', 'CPyLit_Bytes' + suffix,
+                            initializer=init_bytes)
         # Descriptions of int literals
         init_int = c_string_array_initializer(literals.encoded_int_values())
-        self.declare_global('const char * const []', 'CPyLit_Int', initializer=init_int)
+        self.declare_global('const char * const []', 'CPyLit_Int' + suffix,
+                            initializer=init_int)
         # Descriptions of float literals
         init_floats = c_array_initializer(literals.encoded_float_values())
-        self.declare_global('const double []', 'CPyLit_Float', initializer=init_floats)
+        self.declare_global('const double []', 'CPyLit_Float' + suffix,
+                            initializer=init_floats)
         # Descriptions of complex literals
         init_complex = c_array_initializer(literals.encoded_complex_values())
-        self.declare_global('const double []', 'CPyLit_Complex', initializer=init_complex)
+        self.declare_global('const double []', 'CPyLit_Complex' + suffix,
+                            initializer=init_complex)
         # Descriptions of tuple literals
         init_tuple = c_array_initializer(literals.encoded_tuple_values())
-        self.declare_global('const int []', 'CPyLit_Tuple', initializer=init_tuple)
+        self.declare_global('const int []', 'CPyLit_Tuple' + suffix, initializer=init_tuple)
+        # Descriptions of frozenset literals
+        init_frozenset = c_array_initializer(literals.encoded_frozenset_values())
+        self.declare_global('const int []', 'CPyLit_FrozenSet' + suffix,
+                            initializer=init_frozenset)
+
+    def generate_inline_cache_table(self, tables: StaticTables) -> None:
+        """Generate the array of inline caches used by LoadInlineCache ops."""
+        suffix = tables.suffix
+        num_caches = max(len(tables.inline_caches), 1)
+        self.declare_global('CPyInlineCache [%d]' % num_caches, 'CPyInlineCaches' + suffix,
+                            unsized=bool(suffix))
+        # Site names for the attribute profiler, only used if MYPYC_PROFILE_ATTRS is defined
+        names = ['"{}"'.format(name) for name in tables.inline_cache_sites] or ['NULL']
+        self.declare_global('const char * const [%d]' % num_caches,
+                            'CPyInlineCacheSites' + suffix,
+                            initializer=c_array_initializer(names), unsized=bool(suffix))
+
+    def generate_traceback_code_table(self, tables: StaticTables) -> None:
+        """Generate the array of cached code objects used for traceback entries.
+
+        This must be called after all functions have been generated.
+        """
+        # The slots are zero-initialized (and the array can't be empty in C)
+        num_codes = max(len(tables.traceback_codes), 1)
+        self.declare_global('PyCodeObject *[%d]' % num_codes, 'CPyTracebackCodes' + tables.suffix,
+                            unsized=bool(tables.suffix))
+
+    def generate_trait_cache_table(self, tables: StaticTables) -> None:
+        """Generate the array of caches used by trait vtable lookups.
+
+        This must be called after all functions have been generated.
+        """
+        # The caches are zero-initialized (and the array can't be empty in C)
+        num_caches = max(tables.num_trait_caches, 1)
+        self.declare_global('CPyTraitCache [%d]' % num_caches, 'CPyTraitCaches' + tables.suffix,
+                            unsized=bool(tables.suffix))
+
+    def generate_dispatch_site_table(self) -> None:
+        """Generate the array of call sites that count receiver types, if profiling.
+
+        This must be called after all functions have been generated.
+        """
+        sites = self.context.dispatch_sites
+        if sites is None:
+            return
+        num_sites = max(len(sites), 1)
+        self.declare_global('CPyDispatchSite [%d]' % num_sites, 'CPyDispatchSites')
+        names = ['"{}"'.format(name) for name in sites] or ['NULL']
+        self.declare_global('const char * const [%d]' % num_sites, 'CPyDispatchSiteNames',
+                            initializer=c_array_initializer(names))
 
     def generate_export_table(self, decl_emitter: Emitter, code_emitter: Emitter) -> None:
         """Generate the declaration and definition of the group's export struct.
@@ -720,12 +853,14 @@ class GroupGenerator:
         compilation group.
 
         The init function is responsible for creating Capsules that
-        wrap pointers to the initialization function of all the real
-        init functions for modules in this shared library as well as
-        the export table containing all of the exported functions and
-        values from all the modules.
+        wrap a table of the real init functions for modules in this
+        shared library (indexed by module, in the order of the group)
+        as well as the export table containing all of the exported
+        functions and values from all the modules.
 
         These capsules are stored in attributes of the shared library.
+        Creating the shared library doesn't initialize any of the
+        modules; each one is initialized when its shim is imported.
         """
         assert self.group_name is not None
 
@@ -744,6 +879,7 @@ class GroupGenerator:
             'Py_INCREF(module);',
             'return module;',
             '}',
+            'CPyImportProfile_START(profile_init);',
             'module = PyModule_Create(&def);',
             'if (!module) {',
             'goto fail;',
@@ -765,30 +901,52 @@ class GroupGenerator:
             '',
         )
 
+        # All of the module init functions go into a single table, so
+        # that a shim finds its init function with one attribute lookup
+        # and an index instead of a capsule import per module.
+        for mod, _ in self.modules:
+            emitter.emit_line('extern PyObject *CPyInit_{}(void);'.format(exported_name(mod)))
+        emitter.emit_line('static const CPyModule_InitEntry init_table[] = {')
         for mod, _ in self.modules:
             name = exported_name(mod)
+            emitter.emit_line('{{"{}", CPyInit_{}}},'.format(name, name))
+        emitter.emit_lines(
+            '{NULL, NULL},',
+            '};',
+            'capsule = PyCapsule_New((void *)init_table, "{}.init_table", NULL);'.format(
+                shared_lib_name(self.group_name)),
+            'if (!capsule) {',
+            'goto fail;',
+            '}',
+            'res = PyCapsule_SetContext(capsule, (void *)(Py_ssize_t){});'.format(
+                len(self.modules)),
+            'if (res < 0) {',
+            'Py_DECREF(capsule);',
+            'goto fail;',
+            '}',
+            'res = PyObject_SetAttrString(module, "init_table", capsule);',
+            'Py_DECREF(capsule);',
+            'if (res < 0) {',
+            'goto fail;',
+            '}',
+            '',
+        )
+
+        for group in sorted(self.context.group_deps):
+            egroup = exported_name(group)
             emitter.emit_lines(
-                'extern PyObject *CPyInit_{}(void);'.format(name),
-                'capsule = PyCapsule_New((void *)CPyInit_{}, "{}.init_{}", NULL);'.format(
-                    name, shared_lib_name(self.group_name), name),
-                'if (!capsule) {',
+                'tmp = PyImport_ImportModule("{}");'.format(shared_lib_name(group)),
+                'if (!tmp) {',
                 'goto fail;',
                 '}',
-                'res = PyObject_SetAttrString(module, "init_{}", capsule);'.format(name),
-                'Py_DECREF(capsule);',
-                'if (res < 0) {',
+                'capsule = PyObject_GetAttrString(tmp, "exports");',
+                'Py_DECREF(tmp);',
+                'if (!capsule) {',
                 'goto fail;',
                 '}',
-                '',
-            )
-
-        for group in sorted(self.context.group_deps):
-            egroup = exported_name(group)
-            emitter.emit_lines(
-                'tmp = PyImport_ImportModule("{}"); if (!tmp) goto fail; Py_DECREF(tmp);'.format(
-                    shared_lib_name(group)),
-                'struct export_table_{} *pexports_{} = PyCapsule_Import("{}.exports", 0);'.format(
-                    egroup, egroup, shared_lib_name(group)),
+                'struct export_table_{} *pexports_{} ='.format(egroup, egroup),
+                '    PyCapsule_GetPointer(capsule, "{}.exports");'.format(shared_lib_name(group)),
+                'Py_DECREF(capsule);',
                 'if (!pexports_{}) {{'.format(egroup),
                 'goto fail;',
                 '}',
@@ -798,6 +956,8 @@ class GroupGenerator:
             )
 
         emitter.emit_lines(
+            'CPyImportProfile_END(profile_init, "shared library init", "{}");'.format(
+                shared_lib_name(self.group_name)),
             'return module;',
             'fail:',
             'Py_XDECREF(module);',
@@ -819,10 +979,36 @@ class GroupGenerator:
         for symbol, fixup in self.simple_inits:
             emitter.emit_line('{} = {};'.format(symbol, fixup))
 
-        values = 'CPyLit_Str, CPyLit_Bytes, CPyLit_Int, CPyLit_Float, CPyLit_Complex, CPyLit_Tuple'
-        emitter.emit_lines('if (CPyStatics_Initialize(CPyStatics, {}) < 0) {{'.format(values),
-                           'return -1;',
-                           '}')
+        emitter.emit_line('int res;')
+        for tables in self.all_tables():
+            suffix = tables.suffix
+            values = ', '.join('CPyLit_{}{}'.format(kind, suffix) for kind in [
+                'Str', 'Bytes', 'Int', 'Float', 'Complex', 'Tuple', 'FrozenSet'])
+            emitter.emit_lines(
+                '#ifdef MYPYC_LAZY_STATICS',
+                'res = CPyStatics_InitializeLazy(&CPyStatics_Lazy{}, CPyStatics{}, {}, {});'
+                .format(suffix, suffix, tables.literals.num_literals(), values),
+                '#else',
+                'res = CPyStatics_Initialize(CPyStatics{}, {});'.format(suffix, values),
+                '#endif',
+                'if (res < 0) {',
+                'return -1;',
+                '}')
+
+            emitter.emit_lines(
+                '#ifdef MYPYC_PROFILE_ATTRS',
+                'if (CPyAttrProfile_Register(CPyInlineCaches{}, CPyInlineCacheSites{}, {}) < 0) {{'
+                .format(suffix, suffix, len(tables.inline_caches)),
+                'return -1;',
+                '}',
+                '#endif')
+
+        if self.context.dispatch_sites is not None:
+            emitter.emit_lines(
+                'if (CPyDispatchProfile_Register(CPyDispatchSites, CPyDispatchSiteNames, '
+                '{}) < 0) {{'.format(len(self.context.dispatch_sites)),
+                'return -1;',
+                '}')
 
         emitter.emit_lines(
             'is_initialized = 1;',
@@ -885,6 +1071,8 @@ class GroupGenerator:
                            'Py_INCREF({});'.format(module_static),
                            'return {};'.format(module_static),
                            '}')
+        # Phases of module initialization are timed if compiled with MYPYC_PROFILE_IMPORT
+        emitter.emit_line('CPyImportProfile_START(profile_init);')
 
         emitter.emit_lines('{} = PyModule_Create(&{}module);'.format(module_static, module_prefix),
                            'if (unlikely({} == NULL))'.format(module_static),
@@ -898,24 +1086,34 @@ class GroupGenerator:
                            'if (unlikely({} == NULL))'.format(module_globals),
                            '    return NULL;')
 
-        # HACK: Manually instantiate generated classes here
-        for cl in module.classes:
-            if cl.is_generated:
-                type_struct = emitter.type_struct_name(cl)
-                emitter.emit_lines(
-                    '{t} = (PyTypeObject *)CPyType_FromTemplate('
-                    '(PyObject *){t}_template, NULL, modname);'
-                    .format(t=type_struct))
-                emitter.emit_lines('if (unlikely(!{}))'.format(type_struct),
-                                   '    return NULL;')
+        # HACK: Manually instantiate generated classes here. They have no
+        # bases, so they can all be created with a single call.
+        generated = [emitter.type_struct_name(cl) for cl in module.classes if cl.is_generated]
+        if generated:
+            emitter.emit_line('static const CPyType_Template generated_types[] = {')
+            for type_struct in generated:
+                emitter.emit_line('{{&{t}, &{t}_template_}},'.format(t=type_struct))
+            emitter.emit_line('};')
+            emitter.emit_lines(
+                'if (unlikely(CPyType_FromTemplates(generated_types, {}, modname) < 0))'.format(
+                    len(generated)),
+                '    return NULL;')
 
-        emitter.emit_lines('if (CPyGlobalsInit() < 0)',
-                           '    return NULL;')
+        emitter.emit_lines('CPyImportProfile_START(profile_globals);',
+                           'if (CPyGlobalsInit() < 0)',
+                           '    return NULL;',
+                           'CPyImportProfile_END(profile_globals, "CPyGlobalsInit", "{}");'.format(
+                               module_name))
 
+        emitter.emit_line('CPyImportProfile_START(profile_top_level);')
         self.generate_top_level_call(module, emitter)
+        emitter.emit_line('CPyImportProfile_END(profile_top_level, "top level", "{}");'.format(
+            module_name))
 
         emitter.emit_lines('Py_DECREF(modname);')
 
+        emitter.emit_line('CPyImportProfile_END(profile_init, "module init", "{}");'.format(
+            module_name))
         emitter.emit_line('return {};'.format(module_static))
         emitter.emit_line('}')
 
@@ -963,20 +1161,29 @@ class GroupGenerator:
 
     def declare_global(self, type_spaced: str, name: str,
                        *,
-                       initializer: Optional[str] = None) -> None:
+                       initializer: Optional[str] = None,
+                       unsized: bool = False) -> None:
+        """Declare a global in the header and define it in the main C file.
+
+        If unsized is true, the array size in type_spaced is only used in the
+        definition, so that the header doesn't change when the size changes.
+        """
+        decl = None
         if '[' not in type_spaced:
             base = '{}{}'.format(type_spaced, name)
         else:
             a, b = type_spaced.split('[', 1)
             base = '{}{}[{}'.format(a, name, b)
+            if unsized:
+                decl = '{}{}[]'.format(a, name)
 
         if not initializer:
-            defn = None
+            defn = None if decl is None else ['{};'.format(base)]
         else:
             defn = ['{} = {};'.format(base, initializer)]
         if name not in self.context.declarations:
             self.context.declarations[name] = HeaderDeclaration(
-                '{};'.format(base),
+                '{};'.format(decl or base),
                 defn=defn,
             )
 
@@ -1090,6 +1297,19 @@ def collect_literals(fn: FuncIR, literals: Literals) -> None:
                 literals.record_literal(op.value)
 
 
+def collect_inline_caches(fn: FuncIR, inline_caches: Dict[LoadInlineCache, int],
+                          sites: List[str]) -> None:
+    """Assign an index in the inline cache array to each LoadInlineCache op in fn.
+
+    Also append the name of the site of each cache to sites.
+    """
+    for block in fn.blocks:
+        for op in block.ops:
+            if isinstance(op, LoadInlineCache):
+                inline_caches[op] = len(inline_caches)
+                sites.append('{}:{}'.format(fn.decl.module_name, op.line))
+
+
 def c_array_initializer(components: List[str]) -> str:
     """Construct an initializer for a C array variable.
 
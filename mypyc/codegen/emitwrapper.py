@@ -10,14 +10,16 @@ The wrappers aren't used for most calls between two native functions
 or methods in a single compilation unit.
 """
 
-from typing import List, Optional
+from typing import List, Optional, Set, Tuple
 
 from mypy.nodes import ARG_POS, ARG_OPT, ARG_NAMED_OPT, ARG_NAMED, ARG_STAR, ARG_STAR2
 
 from mypyc.common import PREFIX, NATIVE_PREFIX, DUNDER_PREFIX, use_vectorcall
 from mypyc.codegen.emit import Emitter
 from mypyc.ir.rtypes import (
-    RType, is_object_rprimitive, is_int_rprimitive, is_bool_rprimitive, object_rprimitive
+    RType, RInstance, is_object_rprimitive, is_int_rprimitive, is_bool_rprimitive,
+    is_str_rprimitive, is_list_rprimitive, is_dict_rprimitive, object_rprimitive,
+    is_c_py_ssize_t_rprimitive
 )
 from mypyc.ir.func_ir import FuncIR, RuntimeArg, FUNC_STATICMETHOD
 from mypyc.ir.class_ir import ClassIR
@@ -64,13 +66,8 @@ def generate_traceback_code(fn: FuncIR,
     # Unlike traceback frames added for exceptions seen in IR, we do this
     # even if there is no `traceback_name`. This is because the error will
     # have originated here and so we need it in the traceback.
-    globals_static = emitter.static_name('globals', module_name)
-    traceback_code = 'CPy_AddTraceback("%s", "%s", %d, %s);' % (
-        source_path.replace("\\", "\\\\"),
-        fn.traceback_name or fn.name,
-        fn.line,
-        globals_static)
-    return traceback_code
+    return emitter.traceback_call(source_path, module_name, fn.traceback_name or fn.name,
+                                  fn.line)
 
 
 def make_arg_groups(args: List[RuntimeArg]) -> List[List[RuntimeArg]]:
@@ -118,6 +115,68 @@ def make_format_string(func_name: Optional[str], groups: List[List[RuntimeArg]])
     return format
 
 
+def arg_type_kind(typ: RType, emitter: Emitter) -> Tuple[str, str]:
+    """Return the CPyArg_Type kind and type pointer for checking an argument type.
+
+    These let the descriptor based argument parser type check and unbox
+    arguments, instead of generating a separate check for each argument.
+    Unsupported types are CPYARG_OBJECT and are checked by the wrapper.
+    """
+    if is_int_rprimitive(typ):
+        return 'CPYARG_INT', 'NULL'
+    elif is_bool_rprimitive(typ):
+        return 'CPYARG_BOOL', 'NULL'
+    elif is_str_rprimitive(typ):
+        return 'CPYARG_STR', 'NULL'
+    elif is_list_rprimitive(typ):
+        return 'CPYARG_LIST', 'NULL'
+    elif is_dict_rprimitive(typ):
+        return 'CPYARG_DICT', 'NULL'
+    elif (isinstance(typ, RInstance) and not typ.class_ir.is_trait
+            and not emitter.get_group_prefix(typ.class_ir)):
+        # Types in other groups are only reachable through the export table,
+        # so their addresses aren't constants.
+        return 'CPYARG_INSTANCE', '&{}'.format(emitter.type_struct_name(typ.class_ir))
+    return 'CPYARG_OBJECT', 'NULL'
+
+
+def make_arg_types(args: List[RuntimeArg], emitter: Emitter) -> Optional[str]:
+    """Return a static CPyArg_Type array for arguments, or None if all are objects."""
+    kinds = [arg_type_kind(arg.type, emitter) for arg in args]
+    if all(kind == 'CPYARG_OBJECT' for kind, _ in kinds):
+        return None
+    items = ''.join('{{{}, {}, "{}"}}, '.format(kind, type_ptr, emitter.pretty_name(arg.type))
+                    for arg, (kind, type_ptr) in zip(args, kinds))
+    return 'static const CPyArg_Type argtypes[] = {{{}}};'.format(items.rstrip(', '))
+
+
+def make_arg_descriptor(func_name: str, groups: List[List[RuntimeArg]],
+                        types: Optional[str] = None) -> str:
+    """Return an initializer for a CPyArg_Descriptor for the accepted arguments.
+
+    This has the same information as a format string from make_format_string(),
+    but precomputed so that nothing needs to be interpreted at call time. The
+    keyword list must be ordered by reorder_arg_groups(). If types is given,
+    it's the name of a CPyArg_Type array for the named arguments.
+    """
+    num_pos = len(groups[ARG_POS])
+    num_max = num_pos + len(groups[ARG_OPT])
+    num_named = num_max + len(groups[ARG_NAMED_OPT])
+    if groups[ARG_NAMED]:
+        required_kwonly_start = str(num_named)
+    else:
+        required_kwonly_start = 'INT_MAX'
+    return '{{kwlist, "{}", {}, {}, {}, {}, {}, {}, {}}}'.format(
+        func_name,
+        num_named + len(groups[ARG_NAMED]),
+        num_pos,
+        num_max,
+        required_kwonly_start,
+        int(bool(groups[ARG_STAR])),
+        int(bool(groups[ARG_STAR2])),
+        types or 'NULL')
+
+
 def generate_wrapper_function(fn: FuncIR,
                               emitter: Emitter,
                               source_path: str,
@@ -142,47 +201,66 @@ def generate_wrapper_function(fn: FuncIR,
     reordered_args = reorder_arg_groups(groups)
 
     emitter.emit_line(make_static_kwlist(reordered_args))
-    fmt = make_format_string(fn.name, groups)
-    # Define the arguments the function accepts (but no types yet)
-    emitter.emit_line('static CPyArg_Parser parser = {{"{}", kwlist, 0}};'.format(fmt))
-
-    for arg in real_args:
-        emitter.emit_line('PyObject *obj_{}{};'.format(
-                          arg.name, ' = NULL' if arg.optional else ''))
+    # Define the arguments the function accepts, and the types that the parser
+    # can check and unbox without help from the wrapper
+    arg_types = make_arg_types(reordered_args, emitter)
+    if arg_types:
+        emitter.emit_line(arg_types)
+    emitter.emit_line('static CPyArg_Descriptor parser = {};'.format(
+        make_arg_descriptor(fn.name, groups, 'argtypes' if arg_types else None)))
+
+    # Arguments are stored in slots in keyword list order, followed by *args and **kwargs
+    slot_args = reordered_args + groups[ARG_STAR] + groups[ARG_STAR2]
+    if slot_args:
+        emitter.emit_line('CPyArg_Slot slots[{}];'.format(len(slot_args)))
+        slots = 'slots'
+    else:
+        slots = 'NULL'
 
     cleanups = ['CPy_DECREF(obj_{});'.format(arg.name)
                 for arg in groups[ARG_STAR] + groups[ARG_STAR2]]
 
-    arg_ptrs = []  # type: List[str]
-    if groups[ARG_STAR] or groups[ARG_STAR2]:
-        arg_ptrs += ['&obj_{}'.format(groups[ARG_STAR][0].name) if groups[ARG_STAR] else 'NULL']
-        arg_ptrs += ['&obj_{}'.format(groups[ARG_STAR2][0].name) if groups[ARG_STAR2] else 'NULL']
-    arg_ptrs += ['&obj_{}'.format(arg.name) for arg in reordered_args]
-
     if fn.name == '__call__' and use_vectorcall(emitter.capi_version):
         nargs = 'PyVectorcall_NARGS(nargs)'
     else:
         nargs = 'nargs'
-    parse_fn = 'CPyArg_ParseStackAndKeywords'
-    # Special case some common signatures
-    if len(real_args) == 0:
-        # No args
-        parse_fn = 'CPyArg_ParseStackAndKeywordsNoArgs'
-    elif len(real_args) == 1 and len(groups[ARG_POS]) == 1:
-        # Single positional arg
-        parse_fn = 'CPyArg_ParseStackAndKeywordsOneArg'
-    elif len(real_args) == len(groups[ARG_POS]) + len(groups[ARG_OPT]):
-        # No keyword-only args, *args or **kwargs
-        parse_fn = 'CPyArg_ParseStackAndKeywordsSimple'
-    emitter.emit_lines(
-        'if (!{}(args, {}, kwnames, &parser{})) {{'.format(
-            parse_fn, nargs, ''.join(', ' + n for n in arg_ptrs)),
-        'return NULL;',
-        '}')
     traceback_code = generate_traceback_code(fn, emitter, source_path, module_name)
+    parse_call = 'CPyArg_ParseStackAndKeywordsSlots(args, {}, kwnames, &parser, {})'.format(
+        nargs, slots)
+    if arg_types:
+        # The parser returns -1 if it failed to type check an argument
+        emitter.emit_lines(
+            'int parsed = {};'.format(parse_call),
+            'if (unlikely(parsed <= 0)) {',
+            'if (parsed < 0) {',
+            traceback_code,
+            '}',
+            'return NULL;',
+            '}')
+    else:
+        emitter.emit_lines(
+            'if (!{}) {{'.format(parse_call),
+            'return NULL;',
+            '}')
+    checked_args = set()  # type: Set[str]
+    for i, arg in enumerate(slot_args):
+        kind = 'CPYARG_OBJECT'
+        if arg.kind not in (ARG_STAR, ARG_STAR2):
+            kind, _ = arg_type_kind(arg.type, emitter)
+        if kind == 'CPYARG_INT':
+            emitter.emit_line('CPyTagged arg_{} = slots[{}].tagged;'.format(arg.name, i))
+        elif kind == 'CPYARG_BOOL':
+            emitter.emit_line('char arg_{} = slots[{}].boolean;'.format(arg.name, i))
+        elif kind != 'CPYARG_OBJECT':
+            emitter.emit_line('PyObject *arg_{} = slots[{}].obj;'.format(arg.name, i))
+        else:
+            emitter.emit_line('PyObject *obj_{} = slots[{}].obj;'.format(arg.name, i))
+            continue
+        checked_args.add(arg.name)
     generate_wrapper_core(fn, emitter, groups[ARG_OPT] + groups[ARG_NAMED_OPT],
                           cleanups=cleanups,
-                          traceback_code=traceback_code)
+                          traceback_code=traceback_code,
+                          checked_args=checked_args)
 
     emitter.emit_line('}')
 
@@ -331,6 +409,13 @@ def generate_hash_wrapper(cl: ClassIR, fn: FuncIR, emitter: Emitter) -> str:
     emitter.emit_line('static Py_ssize_t {name}(PyObject *self) {{'.format(
         name=name
     ))
+    if is_c_py_ssize_t_rprimitive(fn.ret_type):
+        # The native method already returns a tp_hash result (or -1 on error)
+        emitter.emit_line('return {}{}{}(self);'.format(emitter.get_group_prefix(fn.decl),
+                                                        NATIVE_PREFIX,
+                                                        fn.cname(emitter.names)))
+        emitter.emit_line('}')
+        return name
     emitter.emit_line('{}retval = {}{}{}(self);'.format(emitter.ctype_spaced(fn.ret_type),
                                                         emitter.get_group_prefix(fn.decl),
                                                         NATIVE_PREFIX,
@@ -350,6 +435,42 @@ def generate_hash_wrapper(cl: ClassIR, fn: FuncIR, emitter: Emitter) -> str:
     return name
 
 
+def generate_len_wrapper(cl: ClassIR, fn: FuncIR, emitter: Emitter) -> str:
+    """Generates a wrapper for native __len__ methods."""
+    name = '{}{}{}'.format(DUNDER_PREFIX, fn.name, cl.name_prefix(emitter.names))
+    emitter.emit_line('static Py_ssize_t {name}(PyObject *self) {{'.format(
+        name=name
+    ))
+    if is_c_py_ssize_t_rprimitive(fn.ret_type):
+        # The native method already returns an mp_length result (or -1 on error)
+        emitter.emit_line('return {}{}{}(self);'.format(emitter.get_group_prefix(fn.decl),
+                                                        NATIVE_PREFIX,
+                                                        fn.cname(emitter.names)))
+        emitter.emit_line('}')
+        return name
+    emitter.emit_line('{}retval = {}{}{}(self);'.format(emitter.ctype_spaced(fn.ret_type),
+                                                        emitter.get_group_prefix(fn.decl),
+                                                        NATIVE_PREFIX,
+                                                        fn.cname(emitter.names)))
+    emitter.emit_error_check('retval', fn.ret_type, 'return -1;')
+    if is_bool_rprimitive(fn.ret_type):
+        emitter.emit_line('return retval;')
+        emitter.emit_line('}')
+        return name
+    assert not fn.ret_type.is_unboxed, "Unsupported __len__ return type"
+    emitter.emit_line('Py_ssize_t val = PyNumber_AsSsize_t(retval, PyExc_OverflowError);')
+    emitter.emit_dec_ref('retval', fn.ret_type)
+    emitter.emit_line('if (val == -1 && PyErr_Occurred()) return -1;')
+    emitter.emit_line('if (val < 0) {')
+    emitter.emit_line('PyErr_SetString(PyExc_ValueError, "__len__() should return >= 0");')
+    emitter.emit_line('return -1;')
+    emitter.emit_line('}')
+    emitter.emit_line('return val;')
+    emitter.emit_line('}')
+
+    return name
+
+
 def generate_bool_wrapper(cl: ClassIR, fn: FuncIR, emitter: Emitter) -> str:
     """Generates a wrapper for native __bool__ methods."""
     name = '{}{}{}'.format(DUNDER_PREFIX, fn.name, cl.name_prefix(emitter.names))
@@ -377,21 +498,27 @@ def generate_wrapper_core(fn: FuncIR, emitter: Emitter,
                           optional_args: Optional[List[RuntimeArg]] = None,
                           arg_names: Optional[List[str]] = None,
                           cleanups: Optional[List[str]] = None,
-                          traceback_code: Optional[str] = None) -> None:
+                          traceback_code: Optional[str] = None,
+                          checked_args: Optional[Set[str]] = None) -> None:
     """Generates the core part of a wrapper function for a native function.
 
-    This expects each argument as a PyObject * named obj_{arg} as a precondition.
+    This expects each argument as a PyObject * named obj_{arg} as a precondition,
+    except for arguments in checked_args, which have already been checked and
+    unboxed into arg_{arg}.
     It converts the PyObject *s to the necessary types, checking and unboxing if necessary,
     makes the call, then boxes the result if necessary and returns it.
     """
 
     optional_args = optional_args or []
     cleanups = cleanups or []
+    checked_args = checked_args or set()
     use_goto = bool(cleanups or traceback_code)
     error_code = 'return NULL;' if not use_goto else 'goto fail;'
 
     arg_names = arg_names or [arg.name for arg in fn.args]
     for arg_name, arg in zip(arg_names, fn.args):
+        if arg_name in checked_args:
+            continue
         # Suppress the argument check for *args/**kwargs, since we know it must be right.
         typ = arg.type if arg.kind not in (ARG_STAR, ARG_STAR2) else object_rprimitive
         generate_arg_check(arg_name, typ, emitter, error_code, arg in optional_args)
@@ -1,11 +1,12 @@
-from typing import Dict, List, Union, Tuple, Any, cast
+from typing import Dict, List, Union, Tuple, FrozenSet, Any, cast
 
 from typing_extensions import Final
 
 
-# Supported Python literal types. All tuple items must have supported
-# literal types as well, but we can't represent the type precisely.
-LiteralValue = Union[str, bytes, int, bool, float, complex, Tuple[object, ...], None]
+# Supported Python literal types. All tuple and frozenset items must have
+# supported literal types as well, but we can't represent the type precisely.
+LiteralValue = Union[str, bytes, int, bool, float, complex, Tuple[object, ...],
+                     FrozenSet[object], None]
 
 
 # Some literals are singletons and handled specially (None, False and True)
@@ -23,6 +24,7 @@ class Literals:
         self.float_literals = {}  # type: Dict[float, int]
         self.complex_literals = {}  # type: Dict[complex, int]
         self.tuple_literals = {}  # type: Dict[Tuple[object, ...], int]
+        self.frozenset_literals = {}  # type: Dict[FrozenSet[object], int]
 
     def record_literal(self, value: LiteralValue) -> None:
         """Ensure that the literal value is available in generated code."""
@@ -55,6 +57,12 @@ class Literals:
                 for item in value:
                     self.record_literal(cast(Any, item))
                 tuple_literals[value] = len(tuple_literals)
+        elif isinstance(value, frozenset):
+            frozenset_literals = self.frozenset_literals
+            if value not in frozenset_literals:
+                for item in sorted_frozenset_items(value):
+                    self.record_literal(cast(Any, item))
+                frozenset_literals[value] = len(frozenset_literals)
         else:
             assert False, 'invalid literal: %r' % value
 
@@ -86,13 +94,16 @@ class Literals:
         n += len(self.complex_literals)
         if isinstance(value, tuple):
             return n + self.tuple_literals[value]
+        n += len(self.tuple_literals)
+        if isinstance(value, frozenset):
+            return n + self.frozenset_literals[value]
         assert False, 'invalid literal: %r' % value
 
     def num_literals(self) -> int:
         # The first three are for None, True and False
         return (NUM_SINGLETONS + len(self.str_literals) + len(self.bytes_literals) +
                 len(self.int_literals) + len(self.float_literals) + len(self.complex_literals) +
-                len(self.tuple_literals))
+                len(self.tuple_literals) + len(self.frozenset_literals))
 
     # The following methods return the C encodings of literal values
     # of different types
@@ -140,6 +151,35 @@ class Literals:
                 result.append(str(index))
         return result
 
+    def encoded_frozenset_values(self) -> List[str]:
+        """Encode frozenset values into a C array.
+
+        The format is the same as for tuples (see encoded_tuple_values).
+        """
+        values = self.frozenset_literals
+        value_by_index = {}
+        for value, index in values.items():
+            value_by_index[index] = value
+        result = []
+        num = len(values)
+        result.append(str(num))
+        for i in range(num):
+            value = value_by_index[i]
+            result.append(str(len(value)))
+            for item in sorted_frozenset_items(value):
+                index = self.literal_index(cast(Any, item))
+                result.append(str(index))
+        return result
+
+
+def sorted_frozenset_items(value: FrozenSet[object]) -> List[object]:
+    """Return frozenset items in a deterministic order.
+
+    Iteration order of str items depends on hash randomization, but generated
+    code shouldn't vary between runs.
+    """
+    return sorted(value, key=repr)
+
 
 def _encode_str_values(values: Dict[str, int]) -> List[bytes]:
     value_by_index = {}
@@ -203,8 +243,15 @@ def format_int(n: int) -> bytes:
 
 
 def format_str_literal(s: str) -> bytes:
+    """Format a str literal as a header followed by UTF-8 data.
+
+    The header is the length of the UTF-8 data shifted left by one, with the
+    low bit set if the value is ASCII. ASCII values can be constructed at
+    runtime without decoding.
+    """
     utf8 = s.encode('utf-8')
-    return format_int(len(utf8)) + utf8
+    is_ascii = len(utf8) == len(s)
+    return format_int((len(utf8) << 1) | is_ascii) + utf8
 
 
 def _encode_int_values(values: Dict[int, int]) -> List[bytes]:
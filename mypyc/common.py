@@ -19,6 +19,7 @@ TEMP_ATTR_NAME = '__mypyc_temp__'  # type: Final
 LAMBDA_NAME = '__mypyc_lambda__'  # type: Final
 PROPSET_PREFIX = '__mypyc_setter__'  # type: Final
 SELF_NAME = '__mypyc_self__'  # type: Final
+GENERATOR_HELPER_NAME = '__mypyc_generator_helper__'  # type: Final
 
 # Max short int we accept as a literal is based on 32-bit platforms,
 # so that we can just always emit the same code.
@@ -55,9 +56,11 @@ RUNTIME_C_FILES = [
     'getargs.c',
     'getargsfast.c',
     'int_ops.c',
+    'float_ops.c',
     'list_ops.c',
     'dict_ops.c',
     'str_ops.c',
+    'bytes_ops.c',
     'set_ops.c',
     'tuple_ops.c',
     'exc_ops.c',
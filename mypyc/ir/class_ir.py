@@ -102,6 +102,11 @@ class ClassIR:
         self.has_dict = False
         # Do we allow interpreted subclasses? Derived from a mypyc_attr.
         self.allow_interpreted_subclasses = False
+        # Do we recycle the memory of instances through free lists? Derived from a mypyc_attr.
+        self.use_free_list = False
+        # Is the pickled state a tuple of the attribute values instead of a dict?
+        # Derived from a mypyc_attr.
+        self.compact_pickle = False
         # If this a subclass of some built-in python class, the name
         # of the object for that class. We currently only support this
         # in a few ad-hoc cases.
@@ -271,6 +276,8 @@ class ClassIR:
             'inherits_python': self.inherits_python,
             'has_dict': self.has_dict,
             'allow_interpreted_subclasses': self.allow_interpreted_subclasses,
+            'use_free_list': self.use_free_list,
+            'compact_pickle': self.compact_pickle,
             'builtin_base': self.builtin_base,
             'ctor': self.ctor.serialize(),
             # We serialize dicts as lists to ensure order is preserved
@@ -321,6 +328,8 @@ class ClassIR:
         ir.inherits_python = data['inherits_python']
         ir.has_dict = data['has_dict']
         ir.allow_interpreted_subclasses = data['allow_interpreted_subclasses']
+        ir.use_free_list = data['use_free_list']
+        ir.compact_pickle = data['compact_pickle']
         ir.builtin_base = data['builtin_base']
         ir.ctor = FuncDecl.deserialize(data['ctor'], ctx)
         ir.attributes = OrderedDict(
@@ -11,7 +11,7 @@ value has a type (RType). A value can hold various things, such as:
 
 from abc import abstractmethod
 from typing import (
-    List, Sequence, Dict, Generic, TypeVar, Optional, NamedTuple, Tuple, Union
+    List, Sequence, Dict, Generic, TypeVar, Optional, NamedTuple, Tuple, Union, FrozenSet
 )
 
 from typing_extensions import Final, TYPE_CHECKING
@@ -21,7 +21,7 @@ from mypyc.ir.rtypes import (
     RType, RInstance, RTuple, RArray, RVoid, is_bool_rprimitive, is_int_rprimitive,
     is_short_int_rprimitive, is_none_rprimitive, object_rprimitive, bool_rprimitive,
     short_int_rprimitive, int_rprimitive, void_rtype, pointer_rprimitive, is_pointer_rprimitive,
-    bit_rprimitive, is_bit_rprimitive
+    bit_rprimitive, is_bit_rprimitive, inline_cache_rprimitive
 )
 
 if TYPE_CHECKING:
@@ -533,7 +533,7 @@ class LoadLiteral(RegisterOp):
     This is used to load a static PyObject * value corresponding to
     a literal of one of the supported types.
 
-    Tuple literals must contain only valid literal values as items.
+    Tuple and frozenset literals must contain only valid literal values as items.
 
     NOTE: You can use this to load boxed (Python) int objects. Use
           Integer to load unboxed, tagged integers or fixed-width,
@@ -549,7 +549,8 @@ class LoadLiteral(RegisterOp):
     is_borrowed = True
 
     def __init__(self,
-                 value: Union[None, str, bytes, bool, int, float, complex, Tuple[object, ...]],
+                 value: Union[None, str, bytes, bool, int, float, complex, Tuple[object, ...],
+                              FrozenSet[object]],
                  rtype: RType) -> None:
         self.value = value
         self.type = rtype
@@ -566,13 +567,19 @@ class GetAttr(RegisterOp):
 
     error_kind = ERR_MAGIC
 
-    def __init__(self, obj: Value, attr: str, line: int) -> None:
+    def __init__(self, obj: Value, attr: str, line: int, *, borrow: bool = False) -> None:
         super().__init__(line)
         self.obj = obj
         self.attr = attr
         assert isinstance(obj.type, RInstance), 'Attribute access not supported: %s' % obj.type
         self.class_type = obj.type
         self.type = obj.type.attr_type(attr)
+        # If borrow is True, the result is borrowed from obj, which must be kept
+        # alive. The attribute isn't checked for being undefined, so the caller
+        # must check the result if the attribute could be undefined.
+        self.is_borrowed = borrow
+        if borrow:
+            self.error_kind = ERR_NEVER
 
     def sources(self) -> List[Value]:
         return [self.obj]
@@ -733,15 +740,20 @@ class Cast(RegisterOp):
 
     error_kind = ERR_MAGIC
 
-    def __init__(self, src: Value, typ: RType, line: int) -> None:
+    def __init__(self, src: Value, typ: RType, line: int, *, borrow: bool = False) -> None:
         super().__init__(line)
         self.src = src
         self.type = typ
+        # If borrow is True, the result is borrowed from src, which must
+        # be kept alive (and must itself be borrowed or otherwise live)
+        self.is_borrowed = borrow
 
     def sources(self) -> List[Value]:
         return [self.src]
 
     def stolen(self) -> List[Value]:
+        if self.is_borrowed:
+            return []
         return [self.src]
 
     def accept(self, visitor: 'OpVisitor[T]') -> T:
@@ -1153,6 +1165,29 @@ class LoadAddress(RegisterOp):
         return visitor.visit_load_address(self)
 
 
+class LoadInlineCache(RegisterOp):
+    """Get the address of a per-call-site inline cache: result = &CPyInlineCaches[N]
+
+    Each op refers to a separate zero-initialized CPyInlineCache struct
+    that is shared by all executions of the op. Primitives such as
+    CPyObject_GetAttrCached use it to remember the result of a lookup
+    so that repeated lookups on the same type or dict are faster.
+    """
+
+    error_kind = ERR_NEVER
+    is_borrowed = True
+
+    def __init__(self, line: int = -1) -> None:
+        super().__init__(line)
+        self.type = inline_cache_rprimitive
+
+    def sources(self) -> List[Value]:
+        return []
+
+    def accept(self, visitor: 'OpVisitor[T]') -> T:
+        return visitor.visit_load_inline_cache(self)
+
+
 class KeepAlive(RegisterOp):
     """A no-op operation that ensures source values aren't freed.
 
@@ -1310,6 +1345,10 @@ class OpVisitor(Generic[T]):
     def visit_load_address(self, op: LoadAddress) -> T:
         raise NotImplementedError
 
+    @abstractmethod
+    def visit_load_inline_cache(self, op: LoadInlineCache) -> T:
+        raise NotImplementedError
+
     @abstractmethod
     def visit_keep_alive(self, op: KeepAlive) -> T:
         raise NotImplementedError
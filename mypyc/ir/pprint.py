@@ -10,7 +10,7 @@ from mypyc.ir.ops import (
     LoadStatic, InitStatic, TupleGet, TupleSet, IncRef, DecRef, Call, MethodCall, Cast, Box, Unbox,
     RaiseStandardError, CallC, Truncate, LoadGlobal, IntOp, ComparisonOp, LoadMem, SetMem,
     GetElementPtr, LoadAddress, Register, Value, OpVisitor, BasicBlock, ControlOp, LoadLiteral,
-    AssignMulti, KeepAlive
+    AssignMulti, KeepAlive, LoadInlineCache
 )
 from mypyc.ir.func_ir import FuncIR, all_values_full
 from mypyc.ir.module_ir import ModuleIRs
@@ -71,10 +71,14 @@ class IRPrettyPrintVisitor(OpVisitor[str]):
         # it explicit that this is a Python object.
         if isinstance(op.value, int):
             prefix = 'object '
-        return self.format('%r = %s%s', op, prefix, repr(op.value))
+        return self.format('%r = %s%s', op, prefix, literal_repr(op.value))
 
     def visit_get_attr(self, op: GetAttr) -> str:
-        return self.format('%r = %r.%s', op, op.obj, op.attr)
+        if op.is_borrowed:
+            prefix = 'borrow '
+        else:
+            prefix = ''
+        return self.format('%r = %s%r.%s', op, prefix, op.obj, op.attr)
 
     def visit_set_attr(self, op: SetAttr) -> str:
         return self.format('%r.%s = %r; %r = is_error', op.obj, op.attr, op.src, op)
@@ -130,7 +134,11 @@ class IRPrettyPrintVisitor(OpVisitor[str]):
         return s
 
     def visit_cast(self, op: Cast) -> str:
-        return self.format('%r = cast(%s, %r)', op, op.type, op.src)
+        if op.is_borrowed:
+            prefix = 'borrow '
+        else:
+            prefix = ''
+        return self.format('%r = %scast(%s, %r)', op, prefix, op.type, op.src)
 
     def visit_box(self, op: Box) -> str:
         return self.format('%r = box(%s, %r)', op, op.src.type, op.src)
@@ -191,6 +199,9 @@ class IRPrettyPrintVisitor(OpVisitor[str]):
         else:
             return self.format("%r = load_address %s", op, op.src)
 
+    def visit_load_inline_cache(self, op: LoadInlineCache) -> str:
+        return self.format("%r = load_inline_cache", op)
+
     def visit_keep_alive(self, op: KeepAlive) -> str:
         return self.format('keep_alive %s' % ', '.join(self.format('%r', v)
                                                        for v in op.src))
@@ -382,3 +393,13 @@ def generate_names_for_ir(args: List[Register], blocks: List[BasicBlock]) -> Dic
                 used_names.add(name)
 
     return names
+
+
+def literal_repr(value: object) -> str:
+    """Return repr of a literal value, with frozenset items in a stable order."""
+    if isinstance(value, frozenset):
+        if not value:
+            return 'frozenset()'
+        # Hash randomization affects the iteration order of str items
+        return 'frozenset({%s})' % ', '.join(sorted(repr(item) for item in value))
+    return repr(value)
@@ -188,14 +188,18 @@ class RPrimitive(RType):
         #       we need to figure out some way to represent here.
         if ctype == 'CPyTagged':
             self.c_undefined = 'CPY_INT_TAG'
-        elif ctype in ('int32_t', 'int64_t', 'CPyPtr', 'uint32_t', 'uint64_t'):
+        elif ctype in ('int32_t', 'int64_t'):
+            # Signed C integers are only returned by native __hash__ and __len__
+            # methods, and like the corresponding slots they use -1 for errors.
+            self.c_undefined = '-1'
+        elif ctype in ('CPyPtr', 'uint32_t', 'uint64_t'):
             self.c_undefined = '0'
         elif ctype == 'PyObject *':
             # Boxed types use the null pointer as the error value.
             self.c_undefined = 'NULL'
         elif ctype == 'char':
             self.c_undefined = '2'
-        elif ctype == 'PyObject **':
+        elif ctype in ('PyObject **', 'CPyInlineCache *', 'PyThreadState *', 'int *'):
             self.c_undefined = 'NULL'
         else:
             assert False, 'Unrecognized ctype: %r' % ctype
@@ -239,6 +243,20 @@ object_rprimitive = RPrimitive('builtins.object', is_unboxed=False,
 object_pointer_rprimitive = RPrimitive('object_ptr', is_unboxed=False,
                                is_refcounted=False, ctype='PyObject **')  # type: Final
 
+# Pointer to a per-call-site inline cache (see LoadInlineCache)
+inline_cache_rprimitive = RPrimitive('inline_cache_ptr', is_unboxed=False,
+                                     is_refcounted=False,
+                                     ctype='CPyInlineCache *')  # type: Final
+
+# Thread state saved while a nogil function runs without the GIL
+thread_state_rprimitive = RPrimitive('thread_state_ptr', is_unboxed=False,
+                                     is_refcounted=False,
+                                     ctype='PyThreadState *')  # type: Final
+
+# Pointer to the pending error code of a nogil function (see CPy_NoGIL_Raise)
+nogil_error_rprimitive = RPrimitive('nogil_error_ptr', is_unboxed=False,
+                                    is_refcounted=False, ctype='int *')  # type: Final
+
 # Arbitrary-precision integer (corresponds to Python 'int'). Small
 # enough values are stored unboxed, while large integers are
 # represented as a tagged pointer to a Python 'int' PyObject. The
@@ -319,6 +337,11 @@ set_rprimitive = RPrimitive('builtins.set', is_unboxed=False, is_refcounted=True
 # (PyUnicode).
 str_rprimitive = RPrimitive('builtins.str', is_unboxed=False, is_refcounted=True)  # type: Final
 
+# Python bytes object. Note that mypy promotes bytearray and memoryview
+# to bytes, so a value of this type can also be one of those.
+bytes_rprimitive = RPrimitive('builtins.bytes', is_unboxed=False,
+                              is_refcounted=True)  # type: Final
+
 # Tuple of an arbitrary length (corresponds to Tuple[t, ...], with
 # explicit '...').
 tuple_rprimitive = RPrimitive('builtins.tuple', is_unboxed=False,
@@ -397,6 +420,10 @@ def is_str_rprimitive(rtype: RType) -> bool:
     return isinstance(rtype, RPrimitive) and rtype.name == 'builtins.str'
 
 
+def is_bytes_rprimitive(rtype: RType) -> bool:
+    return isinstance(rtype, RPrimitive) and rtype.name == 'builtins.bytes'
+
+
 def is_tuple_rprimitive(rtype: RType) -> bool:
     return isinstance(rtype, RPrimitive) and rtype.name == 'builtins.tuple'
 
@@ -505,6 +532,9 @@ dict_next_rtuple_single = RTuple(
     [bool_rprimitive, int_rprimitive, object_rprimitive]
 )
 
+# Number of objects in a batch and the new offset for batched dict iteration.
+dict_next_batch_rtuple = RTuple([short_int_rprimitive, int_rprimitive])
+
 
 def compute_rtype_alignment(typ: RType) -> int:
     """Compute alignment of a given type based on platform alignment rule"""
@@ -32,19 +32,23 @@ from mypyc.common import TEMP_ATTR_NAME, SELF_NAME
 from mypyc.irbuild.prebuildvisitor import PreBuildVisitor
 from mypyc.ir.ops import (
     BasicBlock, Integer, Value, Register, Op, Assign, Branch, Unreachable, TupleGet, GetAttr,
-    SetAttr, LoadStatic, InitStatic, NAMESPACE_MODULE, RaiseStandardError
+    SetAttr, LoadStatic, InitStatic, NAMESPACE_MODULE, RaiseStandardError, LoadInlineCache,
+    Cast, KeepAlive
 )
 from mypyc.ir.rtypes import (
     RType, RTuple, RInstance, int_rprimitive, dict_rprimitive,
     none_rprimitive, is_none_rprimitive, object_rprimitive, is_object_rprimitive,
-    str_rprimitive, is_tagged, is_list_rprimitive, is_tuple_rprimitive, c_pyssize_t_rprimitive
+    str_rprimitive, is_tagged, is_list_rprimitive, is_tuple_rprimitive, c_pyssize_t_rprimitive,
+    tuple_rprimitive, is_c_py_ssize_t_rprimitive
 )
 from mypyc.ir.func_ir import FuncIR, INVALID_FUNC_DEF, RuntimeArg, FuncSignature, FuncDecl
 from mypyc.ir.class_ir import ClassIR, NonExtClassInfo
 from mypyc.primitives.registry import CFunctionDescription, function_ops
-from mypyc.primitives.list_ops import to_list, list_pop_last, list_get_item_unsafe_op
-from mypyc.primitives.dict_ops import dict_get_item_op, dict_set_item_op
+from mypyc.primitives.list_ops import to_list, list_pop_last, list_get_item_unsafe_borrow_op
+from mypyc.primitives.tuple_ops import tuple_get_item_unsafe_borrow_op
+from mypyc.primitives.dict_ops import dict_get_item_cached_op, dict_set_item_op
 from mypyc.primitives.generic_ops import py_setattr_op, iter_op, next_op
+from mypyc.primitives.int_ops import int_to_hash_value_op, int_to_len_value_op
 from mypyc.primitives.misc_ops import import_op, check_unpack_count_op, get_module_dict_op
 from mypyc.crash import catch_errors
 from mypyc.options import CompilerOptions
@@ -113,6 +117,7 @@ class IRBuilder:
         self.encapsulating_funcs = pbv.encapsulating_funcs
         self.nested_fitems = pbv.nested_funcs.keys()
         self.fdefs_to_decorators = pbv.funcs_to_decorators
+        self.nogil_funcs = pbv.nogil_funcs
 
         self.visitor = visitor
 
@@ -206,6 +211,20 @@ class IRBuilder:
     def coerce(self, src: Value, target_type: RType, line: int, force: bool = False) -> Value:
         return self.builder.coerce(src, target_type, line, force)
 
+    def coerce_ret_value(self, src: Value, fn_name: str, line: int) -> Value:
+        """Coerce a value returned from function fn_name to the current return type.
+
+        Native __hash__ and __len__ methods return a C integer (see
+        Mapper.fdef_to_sig), so int results are converted the way CPython
+        converts the results of Python __hash__ and __len__ methods.
+        """
+        ret_type = self.ret_types[-1]
+        if is_c_py_ssize_t_rprimitive(ret_type) and not is_c_py_ssize_t_rprimitive(src.type):
+            src = self.coerce(src, int_rprimitive, line)
+            op = int_to_hash_value_op if fn_name == '__hash__' else int_to_len_value_op
+            return self.call_c(op, [src], line)
+        return self.coerce(src, ret_type, line)
+
     def none_object(self) -> Value:
         return self.builder.none_object()
 
@@ -303,8 +322,9 @@ class IRBuilder:
         # Python 3.7 has a nice 'PyImport_GetModule' function that we can't use :(
         mod_dict = self.call_c(get_module_dict_op, [], line)
         # Get module object from modules dict.
-        return self.call_c(dict_get_item_op,
-                           [mod_dict, self.load_str(module)], line)
+        cache = self.add(LoadInlineCache(line))
+        return self.call_c(dict_get_item_cached_op,
+                           [mod_dict, self.load_str(module), cache], line)
 
     def get_module_attr(self, module: str, attr: str, line: int) -> Value:
         """Look up an attribute of a module without storing it in the local namespace.
@@ -337,7 +357,7 @@ class IRBuilder:
     def add_implicit_return(self) -> None:
         block = self.builder.blocks[-1]
         if not block.terminated:
-            retval = self.coerce(self.builder.none(), self.ret_types[-1], -1)
+            retval = self.coerce_ret_value(self.builder.none(), self.fn_info.name, -1)
             self.nonlocal_control[-1].gen_return(self, retval, self.fn_info.fitem.line)
 
     def add_implicit_unreachable(self) -> None:
@@ -533,23 +553,41 @@ class IRBuilder:
     def process_sequence_assignment(self,
                                     target: AssignmentTargetTuple,
                                     rvalue: Value,
-                                    line: int) -> None:
-        """Process assignment like 'x, y = s', where s is a variable-length list or tuple."""
+                                    line: int,
+                                    item_types: Optional[Sequence[RType]] = None) -> None:
+        """Process assignment like 'x, y = s', where s is a variable-length list or tuple.
+
+        If item_types is given, rvalue is a boxed fixed-length tuple with these
+        item types. The items are then read directly from the tuple object,
+        instead of unboxing the whole tuple first.
+        """
+        seq = rvalue
+        if not (is_list_rprimitive(rvalue.type) or is_tuple_rprimitive(rvalue.type)):
+            seq = self.add(Cast(rvalue, tuple_rprimitive, line, borrow=True))
+
         # Check the length of sequence.
         expected_len = Integer(len(target.items), c_pyssize_t_rprimitive)
-        self.builder.call_c(check_unpack_count_op, [rvalue, expected_len], line)
+        self.builder.call_c(check_unpack_count_op, [seq, expected_len], line)
 
-        # Read sequence items.
+        # Read sequence items. Nothing can modify the sequence before all the
+        # items have been read, so we can borrow them. Borrowed items are copied
+        # to registers, since assigning to a target could run arbitrary code.
         values = []
         for i in range(len(target.items)):
-            item = target.items[i]
             index = self.builder.load_int(i)
-            if is_list_rprimitive(rvalue.type):
-                item_value = self.call_c(list_get_item_unsafe_op, [rvalue, index], line)
+            if is_list_rprimitive(seq.type):
+                item_value = self.call_c(list_get_item_unsafe_borrow_op, [seq, index], line)
             else:
-                item_value = self.builder.gen_method_call(
-                    rvalue, '__getitem__', [index], item.type, line)
+                item_value = self.call_c(tuple_get_item_unsafe_borrow_op, [seq, index], line)
+            item_type = item_types[i] if item_types is not None else target.items[i].type
+            item_value = self.coerce(item_value, item_type, line)
+            if item_value.is_borrowed:
+                reg = Register(item_value.type)
+                self.add(Assign(reg, item_value))
+                item_value = reg
             values.append(item_value)
+        if not rvalue.is_borrowed:
+            self.add(KeepAlive([rvalue]))
 
         # Assign sequence items to the target lvalues.
         for lvalue, value in zip(target.items, values):
@@ -1099,7 +1137,8 @@ class IRBuilder:
     def load_global_str(self, name: str, line: int) -> Value:
         _globals = self.load_globals_dict()
         reg = self.load_str(name)
-        return self.call_c(dict_get_item_op, [_globals, reg], line)
+        cache = self.add(LoadInlineCache(line))
+        return self.call_c(dict_get_item_cached_op, [_globals, reg, cache], line)
 
     def load_globals_dict(self) -> Value:
         return self.add(LoadStatic(dict_rprimitive, 'globals', self.module_name))
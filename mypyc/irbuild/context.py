@@ -156,6 +156,10 @@ class GeneratorClass(ImplicitClass):
         # Holds the arg passed to send
         self.send_arg_reg = None  # type: Optional[Value]
 
+        # Holds the pointer where a return statement stores the return value instead
+        # of raising StopIteration (NULL if StopIteration should be raised)
+        self.stop_iter_value_reg = None  # type: Optional[Value]
+
         # The switch block is used to decide which instruction to go using the value held in the
         # next-label register.
         self.switch_block = BasicBlock()
@@ -4,7 +4,7 @@ The top-level AST transformation logic is implemented in mypyc.irbuild.visitor
 and mypyc.irbuild.builder.
 """
 
-from typing import List, Optional, Union, Callable, cast
+from typing import List, Optional, Tuple, Union, Callable, FrozenSet, cast
 
 from mypy.nodes import (
     Expression, NameExpr, MemberExpr, SuperExpr, CallExpr, UnaryExpr, OpExpr, IndexExpr,
@@ -18,26 +18,42 @@ from mypy.types import TupleType, get_proper_type, Instance
 
 from mypyc.common import MAX_SHORT_INT
 from mypyc.ir.ops import (
-    Value, Register, TupleGet, TupleSet, BasicBlock, Assign, LoadAddress, RaiseStandardError
+    Value, Register, TupleGet, TupleSet, BasicBlock, Assign, LoadAddress, RaiseStandardError,
+    Integer, LoadLiteral, Cast, KeepAlive
 )
 from mypyc.ir.rtypes import (
-    RTuple, object_rprimitive, is_none_rprimitive, int_rprimitive, is_int_rprimitive
+    RTuple, RInstance, object_rprimitive, is_none_rprimitive, int_rprimitive, is_int_rprimitive,
+    is_short_int_rprimitive, is_str_rprimitive, is_list_rprimitive, is_tuple_rprimitive,
+    c_int_rprimitive, is_tagged
 )
 from mypyc.ir.func_ir import FUNC_CLASSMETHOD, FUNC_STATICMETHOD
 from mypyc.primitives.registry import CFunctionDescription, builtin_names
 from mypyc.primitives.generic_ops import iter_op
-from mypyc.primitives.misc_ops import new_slice_op, ellipsis_op, type_op, get_module_dict_op
-from mypyc.primitives.list_ops import list_append_op, list_extend_op, list_slice_op
-from mypyc.primitives.tuple_ops import list_tuple_op, tuple_slice_op
-from mypyc.primitives.dict_ops import dict_new_op, dict_set_item_op, dict_get_item_op
-from mypyc.primitives.set_ops import set_add_op, set_update_op
-from mypyc.primitives.str_ops import str_slice_op
+from mypyc.primitives.misc_ops import new_slice_op, ellipsis_op, type_op
+from mypyc.primitives.list_ops import (
+    list_append_op, list_extend_op, list_slice_op, list_slice_step_op, list_get_item_borrow_op,
+    list_get_item_short_borrow_op
+)
+from mypyc.primitives.tuple_ops import (
+    list_tuple_op, tuple_slice_op, tuple_slice_step_op, tuple_get_item_borrow_op
+)
+from mypyc.primitives.dict_ops import (
+    dict_new_op, dict_set_item_op, dict_view_contains_ops
+)
+from mypyc.primitives.set_ops import (
+    set_add_op, set_update_op, set_from_iterable_op, frozenset_contains_op,
+    frozenset_contains_int_op
+)
+from mypyc.primitives.bytes_ops import bytes_slice_op
+from mypyc.primitives.str_ops import (
+    str_slice_op, str_slice_step_op, str_index_equals_char_op
+)
 from mypyc.primitives.int_ops import int_comparison_op_mapping
 from mypyc.irbuild.specialize import specializers
 from mypyc.irbuild.builder import IRBuilder
 from mypyc.irbuild.for_helpers import (
     translate_list_comprehension, translate_set_comprehension,
-    comprehension_helper
+    comprehension_helper, is_plain_value_type, dict_view_call
 )
 
 
@@ -100,11 +116,7 @@ def transform_name_expr(builder: IRBuilder, expr: NameExpr) -> Value:
             # via local variables, but this is tricky since the mypy
             # AST doesn't include a Var node for the module. We
             # instead load the module separately on each access.
-            mod_dict = builder.call_c(get_module_dict_op, [], expr.line)
-            obj = builder.call_c(dict_get_item_op,
-                                 [mod_dict, builder.load_str(expr.node.fullname)],
-                                 expr.line)
-            return obj
+            return builder.get_module(expr.node.fullname, expr.line)
         else:
             return builder.read(builder.get_assignment_target(expr), expr.line)
 
@@ -124,6 +136,10 @@ def transform_member_expr(builder: IRBuilder, expr: MemberExpr) -> Value:
     if isinstance(expr.node, MypyFile) and expr.node.fullname in builder.imports:
         return builder.load_module(expr.node.fullname)
 
+    borrowed = try_gen_borrowed_item_attr(builder, expr)
+    if borrowed is not None:
+        return borrowed
+
     obj = builder.accept(expr.expr)
     rtype = builder.node_type(expr)
     # Special case: for named tuples transform attribute access to faster index access.
@@ -136,6 +152,49 @@ def transform_member_expr(builder: IRBuilder, expr: MemberExpr) -> Value:
     return builder.builder.get_attr(obj, expr.name, rtype, expr.line)
 
 
+def is_native_attr_ref(builder: IRBuilder, expr: MemberExpr) -> bool:
+    """Is expr a direct reference to a native attribute (not a property)?"""
+    obj_rtype = builder.node_type(expr.expr)
+    return (isinstance(obj_rtype, RInstance)
+            and obj_rtype.class_ir.is_ext_class
+            and obj_rtype.class_ir.has_attr(expr.name)
+            and not obj_rtype.class_ir.get_method(expr.name))
+
+
+def try_gen_borrowed_item_attr(builder: IRBuilder, expr: MemberExpr) -> Optional[Value]:
+    """Generate a[i].x, where a is a list or tuple, without owning a[i].
+
+    Reading a native attribute can't run arbitrary code, so nothing can
+    modify the sequence between the item read and the attribute read. This
+    lets us borrow the item, as long as the sequence is kept alive until
+    the attribute has been read.
+
+    Return None if the expression can't be generated this way.
+    """
+    index_expr = expr.expr
+    if (not isinstance(index_expr, IndexExpr)
+            or isinstance(index_expr.index, SliceExpr)
+            or not is_native_attr_ref(builder, expr)):
+        return None
+    base_type = builder.node_type(index_expr.base)
+    if (not (is_list_rprimitive(base_type) or is_tuple_rprimitive(base_type))
+            or not is_tagged(builder.node_type(index_expr.index))):
+        return None
+    base = builder.accept(index_expr.base)
+    index = builder.accept(index_expr.index)
+    if is_tuple_rprimitive(base_type):
+        op = tuple_get_item_borrow_op
+    elif is_short_int_rprimitive(index.type):
+        op = list_get_item_short_borrow_op
+    else:
+        op = list_get_item_borrow_op
+    item = builder.call_c(op, [base, index], index_expr.line)
+    obj = builder.add(Cast(item, builder.node_type(index_expr), expr.line, borrow=True))
+    result = builder.builder.get_attr(obj, expr.name, builder.node_type(expr), expr.line)
+    builder.add(KeepAlive([base]))
+    return result
+
+
 def transform_super_expr(builder: IRBuilder, o: SuperExpr) -> Value:
     # warning(builder, 'can not optimize super() expression', o.line)
     sup_val = builder.load_module_attr_by_fullname('builtins.super', o.line)
@@ -374,12 +433,9 @@ def try_gen_slice_op(builder: IRBuilder, base: Value, index: SliceExpr) -> Optio
 
     Return None if a specialized op isn't available.
 
-    This supports obj[x:y], obj[:x], and obj[x:] for a few types.
+    This supports obj[x:y], obj[:x], and obj[x:] for a few types, optionally
+    with a stride. The bounds are passed unboxed, even if there's a stride.
     """
-    if index.stride:
-        # We can only handle the default stride of 1.
-        return None
-
     if index.begin_index:
         begin_type = builder.node_type(index.begin_index)
     else:
@@ -388,21 +444,48 @@ def try_gen_slice_op(builder: IRBuilder, base: Value, index: SliceExpr) -> Optio
         end_type = builder.node_type(index.end_index)
     else:
         end_type = int_rprimitive
+    # The defaults for missing bounds depend on the sign of the stride,
+    # so a stride that isn't a literal is only supported with both bounds.
+    step = 1  # type: Optional[int]
+    if index.stride:
+        step = builder.extract_int(index.stride)
+        if step is None:
+            if (not is_int_rprimitive(builder.node_type(index.stride))
+                    or not index.begin_index or not index.end_index):
+                return None
+        elif step == 0:
+            # Let the generic path raise ValueError.
+            return None
 
     # Both begin and end index must be int (or missing).
     if is_int_rprimitive(begin_type) and is_int_rprimitive(end_type):
         if index.begin_index:
             begin = builder.accept(index.begin_index)
+        elif step is not None and step < 0:
+            begin = builder.load_int(MAX_SHORT_INT)
         else:
             begin = builder.load_int(0)
         if index.end_index:
             end = builder.accept(index.end_index)
+        elif step is not None and step < 0:
+            # Replace missing end index with a bound below the start of any
+            # sequence.
+            end = builder.load_int(-MAX_SHORT_INT)
         else:
             # Replace missing end index with the largest short integer
             # (a sequence can't be longer).
             end = builder.load_int(MAX_SHORT_INT)
-        candidates = [list_slice_op, tuple_slice_op, str_slice_op]
-        return builder.builder.matching_call_c(candidates, [base, begin, end], index.line)
+        if step == 1:
+            candidates = [list_slice_op, tuple_slice_op, str_slice_op, bytes_slice_op]
+            return builder.builder.matching_call_c(candidates, [base, begin, end], index.line)
+        if step is not None:
+            stride = builder.load_int(step)
+        else:
+            assert index.stride is not None
+            stride = builder.accept(index.stride)
+        candidates = [list_slice_step_op, tuple_slice_step_op, str_slice_step_op]
+        return builder.builder.matching_call_c(candidates, [base, begin, end, stride],
+                                               index.line)
 
     return None
 
@@ -482,6 +565,53 @@ def transform_comparison_expr(builder: IRBuilder, e: ComparisonExpr) -> Value:
             else:
                 return builder.true()
 
+    # x in {...}
+    # x not in {...}
+    if (e.operators[0] in ['in', 'not in']
+            and len(e.operators) == 1
+            and isinstance(e.operands[1], SetExpr)):
+        values = set_literal_values(builder, e.operands[1].items)
+        if values is not None:
+            # Look up the item in a precomputed frozenset instead of building a set.
+            left = builder.accept(e.operands[0])
+            literal = builder.add(LoadLiteral(values, object_rprimitive))
+            if is_tagged(left.type):
+                target = builder.call_c(frozenset_contains_int_op, [literal, left], e.line)
+            else:
+                target = builder.call_c(frozenset_contains_op, [literal, left], e.line)
+            if e.operators[0] == 'not in':
+                target = builder.unary_op(target, 'not', e.line)
+            return target
+
+    # x in <dict>.keys()/values()/items()
+    # x not in <dict>.keys()/values()/items()
+    if e.operators[0] in ['in', 'not in'] and len(e.operators) == 1:
+        view = dict_view_call(builder, e.operands[1])
+        if view is not None:
+            left = builder.accept(e.operands[0])
+            dict_reg = builder.accept(view[0])
+            target = builder.call_c(dict_view_contains_ops[view[1]], [dict_reg, left], e.line)
+            if e.operators[0] == 'not in':
+                target = builder.unary_op(target, 'not', e.line)
+            return target
+
+    # <str>[i] == 'x'
+    # <str>[i] != 'x'
+    if e.operators[0] in ['==', '!='] and len(e.operators) == 1:
+        char_index = str_char_comparison(builder, e.operands[0], e.operands[1])
+        if char_index is None:
+            char_index = str_char_comparison(builder, e.operands[1], e.operands[0])
+        if char_index is not None:
+            index_expr, char = char_index
+            base = builder.accept(index_expr.base)
+            index = builder.accept(index_expr.index)
+            target = builder.call_c(str_index_equals_char_op,
+                                    [base, index, Integer(ord(char), c_int_rprimitive)],
+                                    e.line)
+            if e.operators[0] == '!=':
+                target = builder.unary_op(target, 'not', e.line)
+            return target
+
     # TODO: Don't produce an expression when used in conditional context
     # All of the trickiness here is due to support for chained conditionals
     # (`e1 < e2 > e3`, etc). `e1 < e2 > e3` is approximately equivalent to
@@ -506,6 +636,23 @@ def transform_comparison_expr(builder: IRBuilder, e: ComparisonExpr) -> Value:
     return go(0, builder.accept(e.operands[0]))
 
 
+def str_char_comparison(builder: IRBuilder,
+                        left: Expression,
+                        right: Expression) -> Optional[Tuple[IndexExpr, str]]:
+    """Match "<str>[<int>] == <single character literal>".
+
+    Return the index expression and the character, or None if there is no match.
+    Evaluating the literal has no side effects, so the operands may be swapped.
+    """
+    if (isinstance(left, IndexExpr)
+            and isinstance(right, StrExpr)
+            and len(right.value) == 1
+            and is_str_rprimitive(builder.node_type(left.base))
+            and is_int_rprimitive(builder.node_type(left.index))):
+        return left, right.value
+    return None
+
+
 def transform_basic_comparison(builder: IRBuilder,
                                op: str,
                                left: Value,
@@ -547,8 +694,11 @@ def transform_str_expr(builder: IRBuilder, expr: StrExpr) -> Value:
 
 
 def transform_bytes_expr(builder: IRBuilder, expr: BytesExpr) -> Value:
-    value = bytes(expr.value, 'utf8').decode('unicode-escape').encode('raw-unicode-escape')
-    return builder.builder.load_bytes(value)
+    return builder.builder.load_bytes(bytes_expr_value(expr))
+
+
+def bytes_expr_value(expr: BytesExpr) -> bytes:
+    return bytes(expr.value, 'utf8').decode('unicode-escape').encode('raw-unicode-escape')
 
 
 def transform_ellipsis(builder: IRBuilder, o: EllipsisExpr) -> Value:
@@ -611,6 +761,11 @@ def transform_dict_expr(builder: IRBuilder, expr: DictExpr) -> Value:
 
 
 def transform_set_expr(builder: IRBuilder, expr: SetExpr) -> Value:
+    values = set_literal_values(builder, expr.items)
+    if values is not None:
+        # Copy a frozenset that is constructed once during module initialization.
+        literal = builder.add(LoadLiteral(values, object_rprimitive))
+        return builder.call_c(set_from_iterable_op, [literal], expr.line)
     return _visit_display(
         builder,
         expr.items,
@@ -622,6 +777,30 @@ def transform_set_expr(builder: IRBuilder, expr: SetExpr) -> Value:
     )
 
 
+def set_literal_values(builder: IRBuilder,
+                       items: List[Expression]) -> Optional[FrozenSet[object]]:
+    """Return the value of a set display with only literal items, if possible.
+
+    Items of different types that compare equal (such as 1 and 1.0) aren't
+    supported, since the result depends on which one is added first.
+    """
+    values = []  # type: List[object]
+    for item in items:
+        value = None  # type: object
+        if isinstance(item, (StrExpr, FloatExpr)):
+            value = item.value
+        elif isinstance(item, BytesExpr):
+            value = bytes_expr_value(item)
+        else:
+            value = builder.extract_int(item)
+        if value is None:
+            return None
+        values.append(value)
+    if len(set(values)) != len(set((type(value), value) for value in values)):
+        return None
+    return frozenset(values)
+
+
 def _visit_display(builder: IRBuilder,
                    items: List[Expression],
                    constructor_op: Callable[[List[Value], int], Value],
@@ -675,7 +854,12 @@ def transform_dictionary_comprehension(builder: IRBuilder, o: DictionaryComprehe
         v = builder.accept(o.value)
         builder.call_c(dict_set_item_op, [d, k, v], o.line)
 
-    comprehension_helper(builder, loop_params, gen_inner_stmts, o.line)
+    # Adding arbitrary keys to the new dict could call __hash__ or __eq__
+    body_exprs = None  # type: Optional[List[Expression]]
+    if is_plain_value_type(builder.node_type(o.key)):
+        body_exprs = [o.key, o.value]
+    comprehension_helper(builder, loop_params, gen_inner_stmts, o.line,
+                         body_exprs=body_exprs)
     return d
 
 
@@ -5,28 +5,45 @@ for better efficiency.  Each for loop generator class below deals one
 such special case.
 """
 
-from typing import Union, List, Optional, Tuple, Callable
+from typing import Union, List, Optional, Tuple, Callable, Sequence
 from typing_extensions import Type, ClassVar
 
 from mypy.nodes import (
-    Lvalue, Expression, TupleExpr, CallExpr, RefExpr, GeneratorExpr, ARG_POS, MemberExpr, TypeAlias
+    Lvalue, Expression, TupleExpr, CallExpr, RefExpr, GeneratorExpr, ARG_POS, MemberExpr,
+    TypeAlias, NameExpr, IntExpr, IndexExpr, SliceExpr, Node, Statement, Block, StrExpr,
+    FloatExpr, OpExpr, UnaryExpr, ComparisonExpr, ConditionalExpr, ExpressionStmt, ReturnStmt,
+    AssignmentStmt, OperatorAssignmentStmt, IfStmt, WhileStmt, PassStmt, BreakStmt,
+    ContinueStmt, LDEF, ListExpr, StarExpr
 )
+from mypyc.common import MAX_LITERAL_SHORT_INT
 from mypyc.ir.ops import (
-    Value, BasicBlock, Integer, Branch, Register, TupleGet, TupleSet, IntOp
+    Value, BasicBlock, Integer, Branch, Register, TupleGet, TupleSet, IntOp, LoadAddress, Cast,
+    KeepAlive, ComparisonOp
 )
 from mypyc.ir.rtypes import (
-    RType, is_short_int_rprimitive, is_list_rprimitive, is_sequence_rprimitive,
-    is_tuple_rprimitive, is_dict_rprimitive,
-    RTuple, short_int_rprimitive, int_rprimitive
+    RType, is_short_int_rprimitive, is_int_rprimitive, is_list_rprimitive, is_sequence_rprimitive,
+    is_tuple_rprimitive, is_dict_rprimitive, is_set_rprimitive, is_str_rprimitive,
+    is_bool_rprimitive, is_float_rprimitive, RTuple, RArray, short_int_rprimitive,
+    int_rprimitive, object_rprimitive, object_pointer_rprimitive, c_int_rprimitive,
+    c_pyssize_t_rprimitive, uint64_rprimitive
 )
 from mypyc.primitives.registry import CFunctionDescription
 from mypyc.primitives.dict_ops import (
     dict_next_key_op, dict_next_value_op, dict_next_item_op, dict_check_size_op,
-    dict_key_iter_op, dict_value_iter_op, dict_item_iter_op
+    dict_key_iter_op, dict_value_iter_op, dict_item_iter_op, dict_batch_iter_op,
+    dict_next_batch_op, dict_batch_item_op, dict_version_op, dict_check_batch_op,
+    dict_batch_offset_op, dict_items_flat_op, DICT_BATCH_KEYS, DICT_BATCH_VALUES,
+    DICT_BATCH_ITEMS, DICT_BATCH_BORROWED, DICT_BATCH_SIZE
 )
-from mypyc.primitives.list_ops import list_append_op, list_get_item_unsafe_op, new_list_set_item_op
-from mypyc.primitives.set_ops import set_add_op
-from mypyc.primitives.generic_ops import iter_op, next_op
+from mypyc.primitives.list_ops import (
+    list_append_op, list_get_item_unsafe_op, list_get_item_unsafe_borrow_op,
+    new_list_set_item_op, new_presized_list_op, list_append_steal_op, list_shrink_to_fit_op,
+    range_length_hint_op
+)
+from mypyc.primitives.tuple_ops import tuple_get_item_borrow_op
+from mypyc.primitives.set_ops import set_add_op, set_iter_op, set_next_op, set_check_size_op
+from mypyc.primitives.str_ops import str_get_item_unsafe_op
+from mypyc.primitives.generic_ops import iter_op, next_op, sequence_slice_index_op
 from mypyc.primitives.exc_ops import no_err_occurred_op
 from mypyc.irbuild.builder import IRBuilder
 from mypyc.irbuild.targets import AssignmentTarget, AssignmentTargetTuple
@@ -36,7 +53,7 @@ GenFunc = Callable[[], None]
 
 def for_loop_helper(builder: IRBuilder, index: Lvalue, expr: Expression,
                     body_insts: GenFunc, else_insts: Optional[GenFunc],
-                    line: int) -> None:
+                    line: int, body: Optional[Sequence[Node]] = None) -> None:
     """Generate IR for a loop.
 
     Args:
@@ -44,6 +61,7 @@ def for_loop_helper(builder: IRBuilder, index: Lvalue, expr: Expression,
         expr: the expression to iterate over
         body_insts: a function that generates the body of the loop
         else_insts: a function that generates the else block instructions
+        body: the statements and expressions generated by body_insts, if known
     """
     # Body of the loop
     body_block = BasicBlock()
@@ -57,7 +75,8 @@ def for_loop_helper(builder: IRBuilder, index: Lvalue, expr: Expression,
     # Determine where we want to exit, if our condition check fails.
     normal_loop_exit = else_block if else_insts is not None else exit_block
 
-    for_gen = make_for_loop_generator(builder, index, expr, body_block, normal_loop_exit, line)
+    for_gen = make_for_loop_generator(builder, index, expr, body_block, normal_loop_exit, line,
+                                      body=body)
 
     builder.push_loop_stack(step_block, exit_block)
     condition_block = BasicBlock()
@@ -188,17 +207,62 @@ def translate_list_comprehension(builder: IRBuilder, gen: GeneratorExpr) -> Valu
     if val is not None:
         return val
 
-    list_ops = builder.new_list_op([], gen.line)
+    # If the length of the source is cheap to get, allocate space for all
+    # items up front and release what's left over at the end (in case an
+    # exception or a change in the length stops the loop early)
+    capacity = list_comprehension_capacity_hint(builder, gen)
+    if capacity is not None:
+        list_ops = builder.call_c(new_presized_list_op, [capacity], gen.line)
+        append_op = list_append_steal_op
+    else:
+        list_ops = builder.new_list_op([], gen.line)
+        append_op = list_append_op
     loop_params = list(zip(gen.indices, gen.sequences, gen.condlists))
 
     def gen_inner_stmts() -> None:
         e = builder.accept(gen.left_expr)
-        builder.call_c(list_append_op, [list_ops, e], gen.line)
+        builder.call_c(append_op, [list_ops, e], gen.line)
 
-    comprehension_helper(builder, loop_params, gen_inner_stmts, gen.line)
+    comprehension_helper(builder, loop_params, gen_inner_stmts, gen.line,
+                         body_exprs=[gen.left_expr])
+    if capacity is not None:
+        builder.call_c(list_shrink_to_fit_op, [list_ops], gen.line)
     return list_ops
 
 
+def list_comprehension_capacity_hint(builder: IRBuilder, gen: GeneratorExpr) -> Optional[Value]:
+    """Return the expected length of a list comprehension, if it's cheap.
+
+    This handles a single loop without conditions over a list, tuple, dict or set
+    variable, or over range(...) with literal or variable arguments. The source
+    expressions are evaluated again by the loop, so they must not have side effects.
+    With a condition, the length of the source could be far more than needed.
+    """
+    if len(gen.sequences) != 1 or gen.condlists[0]:
+        return None
+    expr = gen.sequences[0]
+    if isinstance(expr, NameExpr):
+        rtype = builder.node_type(expr)
+        if (is_list_rprimitive(rtype) or is_tuple_rprimitive(rtype)
+                or is_dict_rprimitive(rtype) or is_set_rprimitive(rtype)):
+            return builder.builder.builtin_len(builder.accept(expr), gen.line,
+                                               use_pyssize_t=True)
+    elif (isinstance(expr, CallExpr)
+            and isinstance(expr.callee, RefExpr)
+            and is_range_ref(expr.callee)
+            and 1 <= len(expr.args) <= 2
+            and set(expr.arg_kinds) == {ARG_POS}
+            and all(isinstance(arg, (NameExpr, IntExpr)) for arg in expr.args)
+            and all(is_int_rprimitive(builder.node_type(arg)) for arg in expr.args)):
+        if len(expr.args) == 1:
+            start = Integer(0)  # type: Value
+        else:
+            start = builder.accept(expr.args[0])
+        end = builder.accept(expr.args[-1])
+        return builder.call_c(range_length_hint_op, [start, end], gen.line)
+    return None
+
+
 def translate_set_comprehension(builder: IRBuilder, gen: GeneratorExpr) -> Value:
     set_ops = builder.new_set_op([], gen.line)
     loop_params = list(zip(gen.indices, gen.sequences, gen.condlists))
@@ -207,14 +271,20 @@ def translate_set_comprehension(builder: IRBuilder, gen: GeneratorExpr) -> Value
         e = builder.accept(gen.left_expr)
         builder.call_c(set_add_op, [set_ops, e], gen.line)
 
-    comprehension_helper(builder, loop_params, gen_inner_stmts, gen.line)
+    # Adding arbitrary objects to a set could call __hash__ or __eq__
+    body_exprs = None  # type: Optional[List[Expression]]
+    if is_plain_value_type(builder.node_type(gen.left_expr)):
+        body_exprs = [gen.left_expr]
+    comprehension_helper(builder, loop_params, gen_inner_stmts, gen.line,
+                         body_exprs=body_exprs)
     return set_ops
 
 
 def comprehension_helper(builder: IRBuilder,
                          loop_params: List[Tuple[Lvalue, Expression, List[Expression]]],
                          gen_inner_stmts: Callable[[], None],
-                         line: int) -> None:
+                         line: int,
+                         body_exprs: Optional[List[Expression]] = None) -> None:
     """Helper function for list comprehensions.
 
     Args:
@@ -224,7 +294,15 @@ def comprehension_helper(builder: IRBuilder,
             - "conditions" is a list of conditions, evaluated in order with short-circuiting,
                 that must all be true for the loop body to be executed
         gen_inner_stmts: function to generate the IR for the body of the innermost loop
+        body_exprs: the expressions evaluated by gen_inner_stmts, if known (only used
+            for a single loop)
     """
+    body = None  # type: Optional[List[Expression]]
+    if body_exprs is not None and len(loop_params) == 1:
+        conds = loop_params[0][2]
+        if all(is_pure_plain_expr(builder, cond) for cond in conds):
+            body = conds + body_exprs
+
     def handle_loop(loop_params: List[Tuple[Lvalue, Expression, List[Expression]]]) -> None:
         """Generate IR for a loop.
 
@@ -234,7 +312,7 @@ def comprehension_helper(builder: IRBuilder,
         index, expr, conds = loop_params[0]
         for_loop_helper(builder, index, expr,
                         lambda: loop_contents(conds, loop_params[1:]),
-                        None, line)
+                        None, line, body=body)
 
     def loop_contents(
             conds: List[Expression],
@@ -274,19 +352,220 @@ def is_range_ref(expr: RefExpr) -> bool:
             or isinstance(expr.node, TypeAlias) and expr.fullname == 'six.moves.xrange')
 
 
+def slice_view_step(builder: IRBuilder, base: Expression, index: SliceExpr) -> Optional[int]:
+    """Return the step if "for x in base[index]" can iterate without creating the slice.
+
+    The base must be a tuple or str, the bounds must be ints and the stride (if any)
+    must be a non-zero int literal, so that we know the direction of the loop.
+    """
+    base_type = builder.node_type(base)
+    if not (is_tuple_rprimitive(base_type) or is_str_rprimitive(base_type)):
+        return None
+    for bound in index.begin_index, index.end_index:
+        if bound is not None and not is_int_rprimitive(builder.node_type(bound)):
+            return None
+    if index.stride is None:
+        return 1
+    step = extract_short_int_step(builder, index.stride)
+    if step == 0:
+        return None
+    return step
+
+
+def extract_short_int_step(builder: IRBuilder, e: Expression) -> Optional[int]:
+    """Return the value of a loop step if it's an int literal that fits in a short int.
+
+    Loops with such a step can add it to the index as a C integer constant.
+    """
+    step = builder.extract_int(e)
+    if step is None or abs(step) > MAX_LITERAL_SHORT_INT:
+        return None
+    return step
+
+
+def is_plain_value_type(rtype: RType) -> bool:
+    """Do operations on values of this type never run arbitrary code?"""
+    return (is_int_rprimitive(rtype) or is_short_int_rprimitive(rtype)
+            or is_bool_rprimitive(rtype) or is_float_rprimitive(rtype)
+            or is_str_rprimitive(rtype))
+
+
+def is_local_name(lvalue: Lvalue) -> bool:
+    return isinstance(lvalue, NameExpr) and lvalue.kind == LDEF
+
+
+def is_pure_expr(builder: IRBuilder, expr: Expression) -> bool:
+    """Can evaluating expr clearly not modify any dict (conservatively)?"""
+    if isinstance(expr, (IntExpr, StrExpr, FloatExpr, NameExpr)):
+        return True
+    if isinstance(expr, TupleExpr):
+        return all(is_pure_expr(builder, item) for item in expr.items)
+    if isinstance(expr, OpExpr):
+        return (is_pure_plain_expr(builder, expr.left)
+                and is_pure_plain_expr(builder, expr.right))
+    if isinstance(expr, UnaryExpr):
+        return is_pure_plain_expr(builder, expr.expr)
+    if isinstance(expr, ComparisonExpr):
+        if all(op in ('is', 'is not') for op in expr.operators):
+            return all(is_pure_expr(builder, operand) for operand in expr.operands)
+        return all(is_pure_plain_expr(builder, operand) for operand in expr.operands)
+    if isinstance(expr, ConditionalExpr):
+        return (is_pure_plain_expr(builder, expr.cond)
+                and is_pure_expr(builder, expr.if_expr)
+                and is_pure_expr(builder, expr.else_expr))
+    if isinstance(expr, IndexExpr):
+        # Lookups that don't call __hash__ or __eq__ of arbitrary objects
+        base_type = builder.node_type(expr.base)
+        if is_sequence_rprimitive(base_type):
+            return (is_int_rprimitive(builder.node_type(expr.index))
+                    and is_pure_expr(builder, expr.base)
+                    and is_pure_expr(builder, expr.index))
+        # Dict lookups are excluded, since a defaultdict, Counter or other
+        # subclass can insert keys in __missing__ or __getitem__.
+        return False
+    if isinstance(expr, CallExpr) and set(expr.arg_kinds) <= {ARG_POS}:
+        if not all(is_pure_expr(builder, arg) for arg in expr.args):
+            return False
+        callee = expr.callee
+        if isinstance(callee, NameExpr) and callee.fullname == 'builtins.len':
+            arg_type = builder.node_type(expr.args[0])
+            return len(expr.args) == 1 and (is_sequence_rprimitive(arg_type)
+                                            or is_dict_rprimitive(arg_type)
+                                            or is_set_rprimitive(arg_type))
+        if isinstance(callee, MemberExpr) and callee.name == 'append':
+            return (len(expr.args) == 1 and is_list_rprimitive(builder.node_type(callee.expr))
+                    and is_pure_expr(builder, callee.expr))
+    return False
+
+
+def is_pure_plain_expr(builder: IRBuilder, expr: Expression) -> bool:
+    return is_pure_expr(builder, expr) and is_plain_value_type(builder.node_type(expr))
+
+
+def is_pure_stmt(builder: IRBuilder, stmt: Statement) -> bool:
+    """Can executing stmt clearly not modify any dict (conservatively)?
+
+    Only local variables may be assigned, since assigning a global writes to
+    the module dict.
+    """
+    if isinstance(stmt, (PassStmt, BreakStmt, ContinueStmt)):
+        return True
+    if isinstance(stmt, Block):
+        return all(is_pure_stmt(builder, s) for s in stmt.body)
+    if isinstance(stmt, ExpressionStmt):
+        return is_pure_expr(builder, stmt.expr)
+    if isinstance(stmt, ReturnStmt):
+        return stmt.expr is None or is_pure_expr(builder, stmt.expr)
+    if isinstance(stmt, AssignmentStmt):
+        return (all(is_local_name(lvalue) for lvalue in stmt.lvalues)
+                and is_pure_expr(builder, stmt.rvalue))
+    if isinstance(stmt, OperatorAssignmentStmt):
+        return (is_local_name(stmt.lvalue)
+                and is_plain_value_type(builder.node_type(stmt.lvalue))
+                and is_pure_plain_expr(builder, stmt.rvalue))
+    if isinstance(stmt, IfStmt):
+        return (all(is_pure_plain_expr(builder, e) for e in stmt.expr)
+                and all(is_pure_stmt(builder, b) for b in stmt.body)
+                and (stmt.else_body is None or is_pure_stmt(builder, stmt.else_body)))
+    if isinstance(stmt, WhileStmt):
+        return (is_pure_plain_expr(builder, stmt.expr)
+                and is_pure_stmt(builder, stmt.body)
+                and stmt.else_body is None)
+    return False
+
+
+def can_borrow_dict_items(builder: IRBuilder,
+                          index: Lvalue,
+                          body: Optional[Sequence[Node]]) -> bool:
+    """Can a for loop over a dict use keys and values borrowed from the dict?
+
+    This requires that the loop body can't modify the dict. We only accept
+    bodies that bind local variables and use simple operations on primitive
+    values. This still can't rule out things like __del__ methods that modify
+    the dict, so the generated code also checks the dict version before reading
+    the next item, and fetches the remaining items again if it has changed.
+
+    Args:
+        body: statements and expressions evaluated for each item (None if unknown)
+    """
+    if body is None or builder.fn_info.is_generator:
+        return False
+    if isinstance(index, TupleExpr):
+        if not all(is_local_name(item) for item in index.items):
+            return False
+    elif not is_local_name(index):
+        return False
+    for node in body:
+        if isinstance(node, Statement):
+            if not is_pure_stmt(builder, node):
+                return False
+        elif not (isinstance(node, Expression) and is_pure_expr(builder, node)):
+            return False
+    return True
+
+
+def dict_view_call(builder: IRBuilder, expr: Expression) -> Optional[Tuple[Expression, str]]:
+    """If expr is "<dict>.keys()", "<dict>.values()" or "<dict>.items()", return (dict, name)."""
+    if (isinstance(expr, CallExpr)
+            and isinstance(expr.callee, MemberExpr)
+            and not expr.args
+            and expr.callee.name in ('keys', 'values', 'items')
+            and is_dict_rprimitive(builder.node_type(expr.callee.expr))):
+        return expr.callee.expr, expr.callee.name
+    return None
+
+
 def make_for_loop_generator(builder: IRBuilder,
                             index: Lvalue,
                             expr: Expression,
                             body_block: BasicBlock,
                             loop_exit: BasicBlock,
                             line: int,
-                            nested: bool = False) -> 'ForGenerator':
+                            nested: bool = False,
+                            body: Optional[Sequence[Node]] = None) -> 'ForGenerator':
     """Return helper object for generating a for loop over an iterable.
 
     If "nested" is True, this is a nested iterator such as "e" in "enumerate(e)".
+    If "body" is given, it contains the statements and expressions evaluated for
+    each item, which can enable faster iteration over dicts.
     """
 
     rtyp = builder.node_type(expr)
+    if isinstance(expr, IndexExpr) and isinstance(expr.index, SliceExpr):
+        step = slice_view_step(builder, expr.base, expr.index)
+        if step is not None:
+            # Special case "for x in <tuple or str>[a:b:c]".
+            expr_reg = builder.accept(expr.base)
+            begin_reg = None  # type: Optional[Value]
+            stop_reg = None  # type: Optional[Value]
+            if expr.index.begin_index:
+                begin_reg = builder.accept(expr.index.begin_index)
+            if expr.index.end_index:
+                stop_reg = builder.accept(expr.index.end_index)
+            target_type = builder.get_sequence_type(expr)
+
+            for_slice = ForSequenceSlice(builder, index, body_block, loop_exit, line, nested)
+            for_slice.init_slice(expr_reg, begin_reg, stop_reg, step, target_type)
+            return for_slice
+
+    if (isinstance(expr, CallExpr)
+            and isinstance(expr.callee, RefExpr)
+            and expr.callee.fullname == 'builtins.list'
+            and len(expr.args) == 1
+            and expr.arg_kinds == [ARG_POS]):
+        view = dict_view_call(builder, expr.args[0])
+        if view is not None and view[1] == 'items':
+            # Special case "for k, v in list(<dict>.items())": copy the keys
+            # and values to a flat list without creating the item tuples. We
+            # always need the snapshot, since even a defaultdict lookup or a
+            # __del__ method in the body can modify the dict.
+            expr_reg = builder.call_c(dict_items_flat_op, [builder.accept(view[0])], line)
+            target_type = builder.get_dict_item_type(view[0])
+            for_items = ForDictionaryItemsSnapshot(builder, index, body_block, loop_exit,
+                                                   line, nested)
+            for_items.init(expr_reg, target_type, reverse=False)
+            return for_items
+
     if is_sequence_rprimitive(rtyp):
         # Special case "for x in <list>".
         expr_reg = builder.accept(expr)
@@ -302,18 +581,28 @@ def make_for_loop_generator(builder: IRBuilder,
         target_type = builder.get_dict_key_type(expr)
 
         for_dict = ForDictionaryKeys(builder, index, body_block, loop_exit, line, nested)
-        for_dict.init(expr_reg, target_type)
+        for_dict.init(expr_reg, target_type,
+                      batch=not nested and can_borrow_dict_items(builder, index, body))
         return for_dict
 
+    if is_set_rprimitive(rtyp):
+        # Special case "for x in <set>".
+        expr_reg = builder.accept(expr)
+        target_type = builder.get_sequence_type(expr)
+
+        for_set = ForSet(builder, index, body_block, loop_exit, line, nested)
+        for_set.init(expr_reg, target_type)
+        return for_set
+
     if (isinstance(expr, CallExpr)
             and isinstance(expr.callee, RefExpr)):
         if (is_range_ref(expr.callee)
                 and (len(expr.args) <= 2
                      or (len(expr.args) == 3
-                         and builder.extract_int(expr.args[2]) is not None))
+                         and extract_short_int_step(builder, expr.args[2]) is not None))
                 and set(expr.arg_kinds) == {ARG_POS}):
             # Special case "for x in range(...)".
-            # We support the 3 arg form but only for int literals, since it doesn't
+            # We support the 3 arg form but only for short int literals, since it doesn't
             # seem worth the hassle of supporting dynamically determining which
             # direction of comparison to do.
             if len(expr.args) == 1:
@@ -323,7 +612,7 @@ def make_for_loop_generator(builder: IRBuilder,
                 start_reg = builder.accept(expr.args[0])
                 end_reg = builder.accept(expr.args[1])
             if len(expr.args) == 3:
-                step = builder.extract_int(expr.args[2])
+                step = extract_short_int_step(builder, expr.args[2])
                 assert step is not None
                 if step == 0:
                     builder.error("range() step can't be zero", expr.args[2].line)
@@ -376,7 +665,7 @@ def make_for_loop_generator(builder: IRBuilder,
         if (is_dict_rprimitive(rtype)
                 and expr.callee.name in ('keys', 'values', 'items')):
             expr_reg = builder.accept(expr.callee.expr)
-            for_dict_type = None  # type: Optional[Type[ForGenerator]]
+            for_dict_type = None  # type: Optional[Type[ForDictionaryCommon]]
             if expr.callee.name == 'keys':
                 target_type = builder.get_dict_key_type(expr.callee.expr)
                 for_dict_type = ForDictionaryKeys
@@ -387,7 +676,8 @@ def make_for_loop_generator(builder: IRBuilder,
                 target_type = builder.get_dict_item_type(expr.callee.expr)
                 for_dict_type = ForDictionaryItems
             for_dict_gen = for_dict_type(builder, index, body_block, loop_exit, line, nested)
-            for_dict_gen.init(expr_reg, target_type)
+            for_dict_gen.init(expr_reg, target_type,
+                              batch=not nested and can_borrow_dict_items(builder, index, body))
             return for_dict_gen
 
     # Default to a generic for loop.
@@ -487,8 +777,7 @@ class ForIterable(ForGenerator):
         line = self.line
         # We unbox here so that iterating with tuple unpacking generates a tuple based
         # unpack instead of an iterator based one.
-        next_reg = builder.coerce(self.next_reg, self.target_type, line)
-        builder.assign(builder.get_assignment_target(self.index), next_reg, line)
+        assign_loop_item(builder, self.index, self.next_reg, self.target_type, line)
 
     def gen_step(self) -> None:
         # Nothing to do here, since we get the next item as part of gen_condition().
@@ -503,14 +792,25 @@ class ForIterable(ForGenerator):
 
 
 def unsafe_index(
-    builder: IRBuilder, target: Value, index: Value, line: int
+    builder: IRBuilder, target: Value, index: Value, line: int, *, borrow: bool = False
 ) -> Value:
-    """Emit a potentially unsafe index into a target."""
+    """Emit a potentially unsafe index into a target.
+
+    If borrow is True, the result may be a borrowed reference. The caller
+    must keep target alive and ensure that no arbitrary code can run before
+    the last use of the result.
+    """
     # This doesn't really fit nicely into any of our data-driven frameworks
     # since we want to use __getitem__ if we don't have an unsafe version,
     # so we just check manually.
     if is_list_rprimitive(target.type):
+        if borrow:
+            return builder.call_c(list_get_item_unsafe_borrow_op, [target, index], line)
         return builder.call_c(list_get_item_unsafe_op, [target, index], line)
+    elif borrow and is_tuple_rprimitive(target.type):
+        return builder.call_c(tuple_get_item_borrow_op, [target, index], line)
+    elif is_str_rprimitive(target.type):
+        return builder.call_c(str_get_item_unsafe_op, [target, index], line)
     else:
         return builder.gen_method_call(target, '__getitem__', [index], None, line)
 
@@ -559,19 +859,21 @@ class ForSequence(ForGenerator):
     def begin_body(self) -> None:
         builder = self.builder
         line = self.line
-        # Read the next list item.
+        # Read the next list item. If the item is unboxed or unpacked right
+        # away, the result doesn't share the reference, and nothing can modify
+        # the sequence before that, so the item can be borrowed.
         value_box = unsafe_index(
             builder,
             builder.read(self.expr_target, line),
             builder.read(self.index_target, line),
-            line
+            line,
+            borrow=self.target_type.is_unboxed or unpacks_item(self.index, self.target_type)
         )
         assert value_box
         # We coerce to the type of list elements here so that
         # iterating with tuple unpacking generates a tuple based
         # unpack instead of an iterator based one.
-        builder.assign(builder.get_assignment_target(self.index),
-                       builder.coerce(value_box, self.target_type, line), line)
+        assign_loop_item(builder, self.index, value_box, self.target_type, line)
 
     def gen_step(self) -> None:
         # Step to the next item.
@@ -584,6 +886,62 @@ class ForSequence(ForGenerator):
         builder.assign(self.index_target, add, line)
 
 
+class ForSequenceSlice(ForSequence):
+    """Generate optimized IR for a for loop over a slice of an immutable sequence.
+
+    This iterates over the original tuple or str instead of creating the
+    slice, so only the items are allocated (if at all). Lists aren't
+    supported, since the loop body could modify the list, and a slice would
+    have to preserve the original items.
+    """
+
+    def init_slice(self, expr_reg: Value, start_reg: Optional[Value], end_reg: Optional[Value],
+                   step: int, target_type: RType) -> None:
+        builder = self.builder
+        self.reverse = step < 0
+        self.step = step
+        self.expr_target = builder.maybe_spill(expr_reg)
+        expr = builder.read(self.expr_target, self.line)
+        # Clamp the bounds like slicing would. This only needs to be done once,
+        # since the length of the sequence can't change.
+        if start_reg is not None:
+            index_reg = self.slice_index(expr, start_reg)
+        elif not self.reverse:
+            index_reg = Integer(0)
+        else:
+            index_reg = builder.binary_op(self.load_len(self.expr_target),
+                                          Integer(1), '-', self.line)
+        if end_reg is not None:
+            end_index_reg = self.slice_index(expr, end_reg)
+        elif not self.reverse:
+            end_index_reg = self.load_len(self.expr_target)
+        else:
+            end_index_reg = Integer(-1)
+        self.index_target = builder.maybe_spill_assignable(index_reg)
+        self.end_target = builder.maybe_spill(end_index_reg)
+        self.target_type = target_type
+
+    def slice_index(self, expr: Value, index: Value) -> Value:
+        return self.builder.call_c(sequence_slice_index_op, [expr, index, Integer(self.step)],
+                                   self.line)
+
+    def gen_condition(self) -> None:
+        builder = self.builder
+        line = self.line
+        cmp = '<' if self.step > 0 else '>'
+        comparison = builder.binary_op(builder.read(self.index_target, line),
+                                       builder.read(self.end_target, line), cmp, line)
+        builder.add_bool_branch(comparison, self.body_block, self.loop_exit)
+
+    def gen_step(self) -> None:
+        builder = self.builder
+        line = self.line
+        add = builder.int_op(short_int_rprimitive,
+                             builder.read(self.index_target, line),
+                             Integer(self.step), IntOp.ADD, line)
+        builder.assign(self.index_target, add, line)
+
+
 class ForDictionaryCommon(ForGenerator):
     """Generate optimized IR for a for loop over dictionary keys/values.
 
@@ -595,21 +953,29 @@ class ForDictionaryCommon(ForGenerator):
       * f3: next value (object)
     For more info see https://docs.python.org/3/c-api/dict.html#c.PyDict_Next.
 
+    If the loop body can't modify the dict (see can_borrow_dict_items), we
+    instead fetch up to DICT_BATCH_SIZE borrowed keys/values at a time into a
+    C array, and read the next item directly from the array.
+
     Note that for subclasses we fall back to generic PyObject_GetIter() logic,
     since they may override some iteration methods in subtly incompatible manner.
     The fallback logic is implemented in CPy.h via dynamic type check.
     """
     dict_next_op = None  # type: ClassVar[CFunctionDescription]
     dict_iter_op = None  # type: ClassVar[CFunctionDescription]
+    # Number of objects per item and kind of batched iteration
+    batch_width = 1  # type: ClassVar[int]
+    batch_kind = 0  # type: ClassVar[int]
 
     def need_cleanup(self) -> bool:
         # Technically, a dict subclass can raise an unrelated exception
         # in __next__(), so we need this.
         return True
 
-    def init(self, expr_reg: Value, target_type: RType) -> None:
+    def init(self, expr_reg: Value, target_type: RType, batch: bool = False) -> None:
         builder = self.builder
         self.target_type = target_type
+        self.batch = batch
 
         # We add some variables to environment class, so they can be read across yield.
         self.expr_target = builder.maybe_spill(expr_reg)
@@ -617,14 +983,40 @@ class ForDictionaryCommon(ForGenerator):
         self.offset_target = builder.maybe_spill_assignable(offset)
         self.size = builder.maybe_spill(self.load_len(self.expr_target))
 
+        if batch:
+            self.init_batch(expr_reg)
+            return
+
         # For dict class (not a subclass) this is the dictionary itself.
         iter_reg = builder.call_c(self.dict_iter_op, [expr_reg], self.line)
         self.iter_target = builder.maybe_spill(iter_reg)
 
+    def init_batch(self, expr_reg: Value) -> None:
+        # Batched iteration isn't used in generators, so nothing needs to be spilled.
+        builder = self.builder
+        line = self.line
+        self.kind = Integer(self.batch_kind | DICT_BATCH_BORROWED, c_int_rprimitive)
+        self.iter_target = builder.call_c(dict_batch_iter_op, [expr_reg, self.kind], line)
+        self.version = Register(uint64_rprimitive)
+        builder.assign(self.version, builder.call_c(dict_version_op, [expr_reg], line), line)
+        self.batch_buf = Register(RArray(object_rprimitive,
+                                         DICT_BATCH_SIZE * self.batch_width))
+        self.batch_ptr = builder.add(LoadAddress(object_pointer_rprimitive, self.batch_buf,
+                                                 line))
+        self.batch_start = Register(int_rprimitive)
+        self.batch_pos = Register(short_int_rprimitive)
+        self.batch_count = Register(short_int_rprimitive)
+        builder.assign(self.batch_start, Integer(0), line)
+        builder.assign(self.batch_pos, Integer(0), line)
+        builder.assign(self.batch_count, Integer(0), line)
+
     def gen_condition(self) -> None:
         """Get next key/value pair, set new offset, and check if we should continue."""
         builder = self.builder
         line = self.line
+        if self.batch:
+            self.gen_batch_condition()
+            return
         self.next_tuple = self.builder.call_c(
             self.dict_next_op, [builder.read(self.iter_target, line),
                                 builder.read(self.offset_target, line)], line)
@@ -638,6 +1030,54 @@ class ForDictionaryCommon(ForGenerator):
             Branch(should_continue, self.body_block, self.loop_exit, Branch.BOOL)
         )
 
+    def gen_batch_condition(self) -> None:
+        """Fetch the next batch if the current one is used up."""
+        builder = self.builder
+        line = self.line
+        fetch = BasicBlock()
+        more_items = builder.binary_op(self.batch_pos, self.batch_count, '<', line)
+        builder.add_bool_branch(more_items, self.body_block, fetch)
+
+        builder.activate_block(fetch)
+        builder.assign(self.batch_start, builder.read(self.offset_target, line), line)
+        batch = builder.call_c(
+            dict_next_batch_op,
+            [builder.read(self.iter_target, line), builder.read(self.offset_target, line),
+             self.batch_ptr,
+             Integer(DICT_BATCH_SIZE, c_pyssize_t_rprimitive), self.kind], line)
+        builder.assign(self.offset_target, builder.add(TupleGet(batch, 1, line)), line)
+        builder.assign(self.batch_count, builder.add(TupleGet(batch, 0, line)), line)
+        builder.assign(self.batch_pos, Integer(0), line)
+        not_empty = builder.binary_op(self.batch_count, Integer(0), '!=', line)
+        builder.add_bool_branch(not_empty, self.body_block, self.loop_exit)
+
+    def next_batch_items(self) -> List[Value]:
+        """Read the next key and/or value from the current batch.
+
+        The items are borrowed, so we copy them to fresh registers before
+        assigning to the loop variables: replacing the old value of a variable
+        could run arbitrary code.
+        """
+        builder = self.builder
+        line = self.line
+        items = []
+        for i in range(self.batch_width):
+            if i == 0:
+                pos = self.batch_pos  # type: Value
+            else:
+                pos = builder.int_op(short_int_rprimitive, self.batch_pos, Integer(i),
+                                     IntOp.ADD, line)
+            item = builder.call_c(dict_batch_item_op, [self.batch_ptr, pos], line)
+            if self.batch_width > 1:
+                reg = Register(object_rprimitive)
+                builder.assign(reg, item, line)
+                item = reg
+            items.append(item)
+        new_pos = builder.int_op(short_int_rprimitive, self.batch_pos,
+                                 Integer(self.batch_width), IntOp.ADD, line)
+        builder.assign(self.batch_pos, new_pos, line)
+        return items
+
     def gen_step(self) -> None:
         """Check that dictionary didn't change size during iteration.
 
@@ -645,11 +1085,39 @@ class ForDictionaryCommon(ForGenerator):
         """
         builder = self.builder
         line = self.line
+        if self.batch:
+            self.gen_batch_step()
+            return
         # Technically, we don't need a new primitive for this, but it is simpler.
         builder.call_c(dict_check_size_op,
                        [builder.read(self.expr_target, line),
                         builder.read(self.size, line)], line)
 
+    def gen_batch_step(self) -> None:
+        """Refetch the rest of the batch if the loop body replaced some values.
+
+        The borrowed items are then potentially stale (or freed), but as long
+        as the size didn't change we can continue from the same position.
+        """
+        builder = self.builder
+        line = self.line
+        dict_reg = builder.read(self.expr_target, line)
+        stale = builder.call_c(dict_check_batch_op,
+                               [dict_reg, builder.read(self.size, line), self.version], line)
+        refetch, done = BasicBlock(), BasicBlock()
+        is_stale = builder.add(ComparisonOp(stale, Integer(0, c_int_rprimitive),
+                                            ComparisonOp.NEQ, line))
+        builder.add(Branch(is_stale, refetch, done, Branch.BOOL))
+
+        builder.activate_block(refetch)
+        offset = builder.call_c(dict_batch_offset_op,
+                                [builder.read(self.iter_target, line), self.batch_start,
+                                 self.batch_pos, self.kind], line)
+        builder.assign(self.offset_target, offset, line)
+        builder.assign(self.batch_count, Integer(0), line)
+        builder.assign(self.version, builder.call_c(dict_version_op, [dict_reg], line), line)
+        builder.goto_and_activate(done)
+
     def gen_cleanup(self) -> None:
         # Same as for generic ForIterable.
         self.builder.call_c(no_err_occurred_op, [], self.line)
@@ -659,59 +1127,162 @@ class ForDictionaryKeys(ForDictionaryCommon):
     """Generate optimized IR for a for loop over dictionary keys."""
     dict_next_op = dict_next_key_op
     dict_iter_op = dict_key_iter_op
+    batch_kind = DICT_BATCH_KEYS
 
     def begin_body(self) -> None:
         builder = self.builder
         line = self.line
 
-        # Key is stored at the third place in the tuple.
-        key = builder.add(TupleGet(self.next_tuple, 2, line))
-        builder.assign(builder.get_assignment_target(self.index),
-                       builder.coerce(key, self.target_type, line), line)
+        if self.batch:
+            key = self.next_batch_items()[0]
+        else:
+            # Key is stored at the third place in the tuple.
+            key = builder.add(TupleGet(self.next_tuple, 2, line))
+        assign_loop_item(builder, self.index, key, self.target_type, line)
 
 
 class ForDictionaryValues(ForDictionaryCommon):
     """Generate optimized IR for a for loop over dictionary values."""
     dict_next_op = dict_next_value_op
     dict_iter_op = dict_value_iter_op
+    batch_kind = DICT_BATCH_VALUES
 
     def begin_body(self) -> None:
         builder = self.builder
         line = self.line
 
-        # Value is stored at the third place in the tuple.
-        value = builder.add(TupleGet(self.next_tuple, 2, line))
-        builder.assign(builder.get_assignment_target(self.index),
-                       builder.coerce(value, self.target_type, line), line)
+        if self.batch:
+            value = self.next_batch_items()[0]
+        else:
+            # Value is stored at the third place in the tuple.
+            value = builder.add(TupleGet(self.next_tuple, 2, line))
+        assign_loop_item(builder, self.index, value, self.target_type, line)
 
 
 class ForDictionaryItems(ForDictionaryCommon):
     """Generate optimized IR for a for loop over dictionary items."""
     dict_next_op = dict_next_item_op
     dict_iter_op = dict_item_iter_op
+    batch_width = 2
+    batch_kind = DICT_BATCH_ITEMS
+
+    def begin_body(self) -> None:
+        builder = self.builder
+        line = self.line
+
+        if self.batch:
+            key, value = self.next_batch_items()
+        else:
+            key = builder.add(TupleGet(self.next_tuple, 2, line))
+            value = builder.add(TupleGet(self.next_tuple, 3, line))
+
+        assign_dict_item(builder, self.index, self.target_type, key, value, line)
+
+
+class ForDictionaryItemsSnapshot(ForSequence):
+    """Generate optimized IR for a for loop over list(<dict>.items()).
+
+    The keys and values are copied to a flat list (key1, value1, key2, ...),
+    so that no item tuples need to be allocated.
+    """
 
     def begin_body(self) -> None:
         builder = self.builder
         line = self.line
+        # The list isn't visible to the loop body, so it always contains a
+        # value after each key.
+        index = builder.read(self.index_target, line)
+        items = builder.read(self.expr_target, line)
+        key = unsafe_index(builder, items, index, line)
+        value = unsafe_index(builder, items, builder.int_op(short_int_rprimitive, index,
+                                                            Integer(1), IntOp.ADD, line), line)
+        assign_dict_item(builder, self.index, self.target_type, key, value, line)
+
+    def gen_step(self) -> None:
+        builder = self.builder
+        line = self.line
+        add = builder.int_op(short_int_rprimitive,
+                             builder.read(self.index_target, line),
+                             Integer(2), IntOp.ADD, line)
+        builder.assign(self.index_target, add, line)
+
+
+def unpacks_item(index: Lvalue, target_type: RType) -> bool:
+    """Would assign_loop_item() unpack an item without unboxing or copying it?"""
+    return (isinstance(index, (TupleExpr, ListExpr))
+            and not any(isinstance(item, StarExpr) for item in index.items)
+            and (isinstance(target_type, RTuple)
+                 or is_tuple_rprimitive(target_type)
+                 or is_list_rprimitive(target_type)))
+
+
+def assign_loop_item(builder: IRBuilder, index: Lvalue, item: Value, target_type: RType,
+                     line: int) -> None:
+    """Assign an item of an iterable to the index of a for loop.
 
-        key = builder.add(TupleGet(self.next_tuple, 2, line))
-        value = builder.add(TupleGet(self.next_tuple, 3, line))
-
-        # Coerce just in case e.g. key is itself a tuple to be unpacked.
-        assert isinstance(self.target_type, RTuple)
-        key = builder.coerce(key, self.target_type.types[0], line)
-        value = builder.coerce(value, self.target_type.types[1], line)
-
-        target = builder.get_assignment_target(self.index)
-        if isinstance(target, AssignmentTargetTuple):
-            # Simpler code for common case: for k, v in d.items().
-            if len(target.items) != 2:
-                builder.error("Expected a pair for dict item iteration", line)
-            builder.assign(target.items[0], key, line)
-            builder.assign(target.items[1], value, line)
+    If the index is a tuple of lvalues, such as in "for x, y in <list of
+    tuples>", the components are read directly from the item and written to
+    the lvalues. The item is never unboxed to an RTuple, which would need to
+    check and copy each component an extra time.
+    """
+    if unpacks_item(index, target_type) and not item.type.is_unboxed:
+        target = builder.get_assignment_target(index)
+        assert isinstance(target, AssignmentTargetTuple)
+        if isinstance(target_type, RTuple):
+            if len(target_type.types) == len(target.items):
+                builder.process_sequence_assignment(target, item, line, target_type.types)
+                return
         else:
-            rvalue = builder.add(TupleSet([key, value], line))
-            builder.assign(target, rvalue, line)
+            seq = builder.add(Cast(item, target_type, line, borrow=True))
+            builder.process_sequence_assignment(target, seq, line)
+            builder.add(KeepAlive([item]))
+            return
+    builder.assign(builder.get_assignment_target(index),
+                   builder.coerce(item, target_type, line), line)
+
+
+def assign_dict_item(builder: IRBuilder, index: Lvalue, target_type: RType,
+                     key: Value, value: Value, line: int) -> None:
+    """Assign a dict key and value to the index of a for loop over dict items."""
+    # Coerce just in case e.g. key is itself a tuple to be unpacked.
+    assert isinstance(target_type, RTuple)
+    key = builder.coerce(key, target_type.types[0], line)
+    value = builder.coerce(value, target_type.types[1], line)
+
+    target = builder.get_assignment_target(index)
+    if isinstance(target, AssignmentTargetTuple):
+        # Simpler code for common case: for k, v in d.items().
+        if len(target.items) != 2:
+            builder.error("Expected a pair for dict item iteration", line)
+        builder.assign(target.items[0], key, line)
+        builder.assign(target.items[1], value, line)
+    else:
+        rvalue = builder.add(TupleSet([key, value], line))
+        builder.assign(target, rvalue, line)
+
+
+class ForSet(ForDictionaryCommon):
+    """Generate optimized IR for a for loop over a set.
+
+    This works like a loop over dict keys, but uses _PySet_NextEntry().
+    """
+    dict_next_op = set_next_op
+    dict_iter_op = set_iter_op
+
+    def gen_step(self) -> None:
+        """Check that the set didn't change size during iteration."""
+        builder = self.builder
+        line = self.line
+        builder.call_c(set_check_size_op,
+                       [builder.read(self.expr_target, line),
+                        builder.read(self.size, line)], line)
+
+    def begin_body(self) -> None:
+        builder = self.builder
+        line = self.line
+        # Item is stored at the third place in the tuple.
+        item = builder.add(TupleGet(self.next_tuple, 2, line))
+        assign_loop_item(builder, self.index, item, self.target_type, line)
 
 
 class ForRange(ForGenerator):
@@ -27,8 +27,8 @@ from mypyc.ir.func_ir import (
     FuncIR, FuncSignature, RuntimeArg, FuncDecl, FUNC_CLASSMETHOD, FUNC_STATICMETHOD, FUNC_NORMAL
 )
 from mypyc.ir.class_ir import ClassIR, NonExtClassInfo
-from mypyc.primitives.generic_ops import py_setattr_op, next_raw_op, iter_op
-from mypyc.primitives.misc_ops import check_stop_op, yield_from_except_op, coro_op, send_op
+from mypyc.primitives.generic_ops import py_setattr_op, iter_op
+from mypyc.primitives.misc_ops import yield_from_except_op, coro_op, send_status_op
 from mypyc.primitives.dict_ops import dict_set_item_op
 from mypyc.common import SELF_NAME, LAMBDA_NAME, decorator_helper_name
 from mypyc.sametype import is_same_method_signature
@@ -50,6 +50,7 @@ from mypyc.irbuild.env_class import (
     setup_env_class, load_outer_envs, load_env_registers, finalize_env_class,
     setup_func_for_recursive_call
 )
+from mypyc.irbuild.nogil import is_nogil_func, gen_nogil_entry, gen_nogil_exit
 
 
 # Top-level transform functions
@@ -72,6 +73,11 @@ def transform_overloaded_func_def(builder: IRBuilder, o: OverloadedFuncDef) -> N
 
 
 def transform_decorator(builder: IRBuilder, dec: Decorator) -> None:
+    if not is_decorated(builder, dec.func):
+        # Only compile-time decorators such as mypyc_attr
+        transform_func_def(builder, dec.func)
+        return
+
     func_ir, func_reg = gen_func_item(
         builder,
         dec.func,
@@ -203,6 +209,7 @@ def gen_func_item(builder: IRBuilder,
     is_nested = fitem in builder.nested_fitems or isinstance(fitem, LambdaExpr)
     contains_nested = fitem in builder.encapsulating_funcs.keys()
     is_decorated = fitem in builder.fdefs_to_decorators
+    nogil = is_nogil_func(builder, fitem, sig, cdef)
     in_non_ext = False
     class_name = None
     if cdef:
@@ -278,8 +285,12 @@ def gen_func_item(builder: IRBuilder,
                     nested_fn, object_rprimitive, env_for_func, reassign=False
                 )
 
+    if nogil:
+        nogil_region = gen_nogil_entry(builder, fitem.line)
     builder.accept(fitem.body)
     builder.maybe_add_implicit_return()
+    if nogil:
+        gen_nogil_exit(builder, nogil_region, fitem.line)
 
     if builder.fn_info.is_generator:
         populate_switch_for_generator_class(builder)
@@ -505,18 +516,25 @@ def handle_yield_from_and_await(builder: IRBuilder, o: Union[YieldFromExpr, Awai
 
     iter_reg = builder.maybe_spill_assignable(iter_val)
 
+    # Native generators and coroutines (and anything supporting am_send on
+    # Python 3.10+) pass both yielded and returned values through the pointer
+    # argument, so that returning doesn't raise StopIteration.
     stop_block, main_block, done_block = BasicBlock(), BasicBlock(), BasicBlock()
-    _y_init = builder.call_c(next_raw_op, [builder.read(iter_reg)], o.line)
-    builder.add(Branch(_y_init, stop_block, main_block, Branch.IS_ERROR))
-
-    # Try extracting a return value from a StopIteration and return it.
-    # If it wasn't, this reraises the exception.
+    init_val = Register(object_rprimitive)
+    yielded = builder.call_c(
+        send_status_op,
+        [builder.read(iter_reg), builder.none_object(),
+         builder.add(LoadAddress(object_pointer_rprimitive, init_val))],
+        o.line)
+    builder.add(Branch(yielded, main_block, stop_block, Branch.BOOL))
+
+    # The iterator returned a value (or raised StopIteration). Return it.
     builder.activate_block(stop_block)
-    builder.assign(result, builder.call_c(check_stop_op, [], o.line), o.line)
+    builder.assign(result, init_val, o.line)
     builder.goto(done_block)
 
     builder.activate_block(main_block)
-    builder.assign(to_yield_reg, _y_init, o.line)
+    builder.assign(to_yield_reg, init_val, o.line)
 
     # OK Now the main loop!
     loop_block = BasicBlock()
@@ -550,23 +568,24 @@ def handle_yield_from_and_await(builder: IRBuilder, o: Union[YieldFromExpr, Awai
         builder.nonlocal_control[-1].gen_break(builder, o.line)
 
     def else_body() -> None:
-        # Do a next() or a .send(). It will return NULL on exception
-        # but it won't automatically propagate.
-        _y = builder.call_c(
-            send_op, [builder.read(iter_reg), builder.read(received_reg)], o.line
+        # Do a next() or a .send(). Errors other than StopIteration propagate.
+        val = Register(object_rprimitive)
+        val_address = builder.add(LoadAddress(object_pointer_rprimitive, val))
+        yielded = builder.call_c(
+            send_status_op, [builder.read(iter_reg), builder.read(received_reg), val_address],
+            o.line
         )
         ok, stop = BasicBlock(), BasicBlock()
-        builder.add(Branch(_y, stop, ok, Branch.IS_ERROR))
+        builder.add(Branch(yielded, ok, stop, Branch.BOOL))
 
         # Everything's fine. Yield it.
         builder.activate_block(ok)
-        builder.assign(to_yield_reg, _y, o.line)
+        builder.assign(to_yield_reg, val, o.line)
         builder.nonlocal_control[-1].gen_continue(builder, o.line)
 
-        # Try extracting a return value from a StopIteration and return it.
-        # If it wasn't, this rereaises the exception.
+        # The iterator returned a value. Stop iterating.
         builder.activate_block(stop)
-        builder.assign(result, builder.call_c(check_stop_op, [], o.line), o.line)
+        builder.assign(result, val, o.line)
         builder.nonlocal_control[-1].gen_break(builder, o.line)
 
     builder.push_loop_stack(loop_block, done_block)
@@ -674,7 +693,7 @@ def gen_glue_method(builder: IRBuilder, sig: FuncSignature, target: FuncIR,
             args[0], target.name, args[1:], line, arg_kinds[1:], arg_names[1:])
     else:
         retval = builder.builder.call(target.decl, args, arg_kinds, arg_names, line)
-    retval = builder.coerce(retval, sig.ret_type, line)
+    retval = builder.coerce_ret_value(retval, target.name, line)
     builder.add(Return(retval))
 
     arg_regs, _, blocks, ret_type, _ = builder.leave()
@@ -12,12 +12,14 @@ from typing import List
 
 from mypy.nodes import Var, ARG_OPT
 
-from mypyc.common import SELF_NAME, NEXT_LABEL_ATTR_NAME, ENV_ATTR_NAME
+from mypyc.common import SELF_NAME, NEXT_LABEL_ATTR_NAME, ENV_ATTR_NAME, GENERATOR_HELPER_NAME
 from mypyc.ir.ops import (
     BasicBlock, Call, Return, Goto, Integer, SetAttr, Unreachable, RaiseStandardError,
     Value, Register
 )
-from mypyc.ir.rtypes import RInstance, int_rprimitive, object_rprimitive
+from mypyc.ir.rtypes import (
+    RInstance, int_rprimitive, object_rprimitive, object_pointer_rprimitive
+)
 from mypyc.ir.func_ir import FuncIR, FuncDecl, FuncSignature, RuntimeArg
 from mypyc.ir.class_ir import ClassIR
 from mypyc.primitives.exc_ops import raise_exception_with_tb_op
@@ -139,18 +141,24 @@ def add_helper_to_generator_class(builder: IRBuilder,
                                   blocks: List[BasicBlock],
                                   sig: FuncSignature,
                                   fn_info: FuncInfo) -> FuncDecl:
-    """Generates a helper method for a generator class, called by '__next__' and 'throw'."""
+    """Generates a helper method for a generator class, called by '__next__' and 'throw'.
+
+    If the final 'stop_iter_ptr' argument is not NULL, a return statement stores
+    the return value there instead of raising StopIteration. Native code that
+    resumes the generator uses this (see CPyAsyncMethods in CPy.h).
+    """
     sig = FuncSignature((RuntimeArg(SELF_NAME, object_rprimitive),
                          RuntimeArg('type', object_rprimitive),
                          RuntimeArg('value', object_rprimitive),
                          RuntimeArg('traceback', object_rprimitive),
-                         RuntimeArg('arg', object_rprimitive)
+                         RuntimeArg('arg', object_rprimitive),
+                         RuntimeArg('stop_iter_ptr', object_pointer_rprimitive)
                          ), sig.ret_type)
-    helper_fn_decl = FuncDecl('__mypyc_generator_helper__', fn_info.generator_class.ir.name,
+    helper_fn_decl = FuncDecl(GENERATOR_HELPER_NAME, fn_info.generator_class.ir.name,
                               builder.module_name, sig)
     helper_fn_ir = FuncIR(helper_fn_decl, arg_regs, blocks,
                           fn_info.fitem.line, traceback_name=fn_info.fitem.name)
-    fn_info.generator_class.ir.methods['__mypyc_generator_helper__'] = helper_fn_ir
+    fn_info.generator_class.ir.methods[GENERATOR_HELPER_NAME] = helper_fn_ir
     builder.functions.append(helper_fn_ir)
     return helper_fn_decl
 
@@ -171,7 +179,8 @@ def add_next_to_generator_class(builder: IRBuilder,
     none_reg = builder.none_object()
     # Call the helper function with error flags set to Py_None, and return that result.
     result = builder.add(Call(fn_decl,
-                              [builder.self(), none_reg, none_reg, none_reg, none_reg],
+                              [builder.self(), none_reg, none_reg, none_reg, none_reg,
+                               Integer(0, object_pointer_rprimitive)],
                               fn_info.fitem.line))
     builder.add(Return(result))
     builder.leave_method()
@@ -187,7 +196,8 @@ def add_send_to_generator_class(builder: IRBuilder,
     none_reg = builder.none_object()
     # Call the helper function with error flags set to Py_None, and return that result.
     result = builder.add(Call(fn_decl,
-                              [builder.self(), none_reg, none_reg, none_reg, builder.read(arg)],
+                              [builder.self(), none_reg, none_reg, none_reg, builder.read(arg),
+                               Integer(0, object_pointer_rprimitive)],
                               fn_info.fitem.line))
     builder.add(Return(result))
     builder.leave_method()
@@ -214,7 +224,8 @@ def add_throw_to_generator_class(builder: IRBuilder,
     result = builder.add(
         Call(
             fn_decl,
-            [builder.self(), builder.read(typ), builder.read(val), builder.read(tb), none_reg],
+            [builder.self(), builder.read(typ), builder.read(val), builder.read(tb), none_reg,
+             Integer(0, object_pointer_rprimitive)],
             fn_info.fitem.line
         )
     )
@@ -253,9 +264,12 @@ def setup_env_for_generator_class(builder: IRBuilder) -> None:
     exc_tb = builder.add_local(Var('traceback'), object_rprimitive, is_arg=True)
     # TODO: Use the right type here instead of object?
     exc_arg = builder.add_local(Var('arg'), object_rprimitive, is_arg=True)
+    stop_iter_ptr = builder.add_local(Var('stop_iter_ptr'), object_pointer_rprimitive,
+                                      is_arg=True)
 
     cls.exc_regs = (exc_type, exc_val, exc_tb)
     cls.send_arg_reg = exc_arg
+    cls.stop_iter_value_reg = stop_iter_ptr
 
     cls.self_reg = builder.read(self_target, fitem.line)
     cls.curr_env_reg = load_outer_env(builder, cls.self_reg, builder.symtables[-1])
@@ -23,7 +23,8 @@ from mypyc.ir.ops import (
     GetAttr, LoadStatic, MethodCall, CallC, Truncate, LoadLiteral, AssignMulti,
     RaiseStandardError, Unreachable, LoadErrorValue,
     NAMESPACE_TYPE, NAMESPACE_MODULE, NAMESPACE_STATIC, IntOp, GetElementPtr,
-    LoadMem, ComparisonOp, LoadAddress, TupleGet, SetMem, KeepAlive, ERR_NEVER, ERR_FALSE
+    LoadMem, ComparisonOp, LoadAddress, TupleGet, SetMem, KeepAlive, LoadInlineCache,
+    ERR_NEVER, ERR_FALSE
 )
 from mypyc.ir.rtypes import (
     RType, RUnion, RInstance, RArray, optional_value_type, int_rprimitive, float_rprimitive,
@@ -32,7 +33,8 @@ from mypyc.ir.rtypes import (
     is_list_rprimitive, is_tuple_rprimitive, is_dict_rprimitive, is_set_rprimitive, PySetObject,
     none_rprimitive, RTuple, is_bool_rprimitive, is_str_rprimitive, c_int_rprimitive,
     pointer_rprimitive, PyObject, PyListObject, bit_rprimitive, is_bit_rprimitive,
-    object_pointer_rprimitive, c_size_t_rprimitive, dict_rprimitive
+    object_pointer_rprimitive, c_size_t_rprimitive, dict_rprimitive, uint32_rprimitive,
+    is_int_rprimitive, bytes_rprimitive, is_bytes_rprimitive, is_c_py_ssize_t_rprimitive
 )
 from mypyc.ir.func_ir import FuncDecl, FuncSignature
 from mypyc.ir.class_ir import ClassIR, all_concrete_classes
@@ -42,7 +44,7 @@ from mypyc.common import (
 )
 from mypyc.primitives.registry import (
     method_call_ops, CFunctionDescription, function_ops,
-    binary_ops, unary_ops, ERR_NEG_INT
+    binary_ops, unary_ops, str_literal_ops, ERR_NEG_INT, ERR_NEG_ONE
 )
 from mypyc.primitives.list_ops import (
     list_extend_op, new_list_op
@@ -51,20 +53,27 @@ from mypyc.primitives.tuple_ops import (
     list_tuple_op, new_tuple_op, new_tuple_with_length_op
 )
 from mypyc.primitives.dict_ops import (
-    dict_update_in_display_op, dict_new_op, dict_build_op, dict_size_op
+    dict_update_in_display_op, dict_new_op, dict_build_op, dict_size_op,
+    dict_from_template_op
 )
 from mypyc.primitives.generic_ops import (
-    py_getattr_op, py_call_op, py_call_with_kwargs_op, py_method_call_op,
-    py_vectorcall_op, py_vectorcall_method_op,
-    generic_len_op, generic_ssize_t_len_op
+    py_getattr_cached_op, py_call_op, py_call_with_kwargs_op, py_method_call_cached_op,
+    py_vectorcall_op, py_vectorcall_method_cached_op,
+    generic_len_op, generic_ssize_t_len_op, generic_hash_op, generic_ssize_t_hash_op
 )
 from mypyc.primitives.misc_ops import (
     none_object_op, fast_isinstance_op, bool_op
 )
-from mypyc.primitives.int_ops import int_comparison_op_mapping
+from mypyc.primitives.int_ops import (
+    int_comparison_op_mapping, int_nogil_binary_ops, int_nogil_neg_op, int_nogil_invert_op,
+    int_nogil_check_attr_op, bool_nogil_check_attr_op, ssize_t_to_int_op
+)
 from mypyc.primitives.exc_ops import err_occurred_op, keep_propagating_op
-from mypyc.primitives.str_ops import unicode_compare, str_check_if_true
+from mypyc.primitives.str_ops import (
+    unicode_compare, str_check_if_true, str_build_op, STR_BUILD_MAX_PIECES
+)
 from mypyc.primitives.set_ops import new_set_op
+from mypyc.primitives.bytes_ops import bytes_len_op
 from mypyc.rt_subtype import is_runtime_subtype
 from mypyc.subtype import is_subtype
 from mypyc.sametype import is_same_type
@@ -93,6 +102,10 @@ class LowLevelIRBuilder:
         self.blocks = []  # type: List[BasicBlock]
         # Stack of except handler entry blocks
         self.error_handlers = [None]  # type: List[Optional[BasicBlock]]
+        # Pointer to the error code register of a nogil function, if we are
+        # generating one. Int operations then use the GIL-free primitives
+        # (see mypyc.irbuild.nogil).
+        self.nogil_error = None  # type: Optional[Value]
 
     # Basic operations
 
@@ -160,6 +173,9 @@ class LowLevelIRBuilder:
         """
         if src.type.is_unboxed and not target_type.is_unboxed:
             return self.box(src)
+        if is_c_py_ssize_t_rprimitive(src.type) and is_int_rprimitive(target_type):
+            # Results of native __hash__ and __len__ methods
+            return self.call_c(ssize_t_to_int_op, [src], line)
         if ((src.type.is_unboxed and target_type.is_unboxed)
                 and not is_runtime_subtype(src.type, target_type)):
             # To go from one unboxed type to another, we go through a boxed
@@ -181,12 +197,34 @@ class LowLevelIRBuilder:
         """Get a native or Python attribute of an object."""
         if (isinstance(obj.type, RInstance) and obj.type.class_ir.is_ext_class
                 and obj.type.class_ir.has_attr(attr)):
+            if self.nogil_error is not None:
+                return self.nogil_get_attr(obj, obj.type, attr, line)
             return self.add(GetAttr(obj, attr, line))
         elif isinstance(obj.type, RUnion):
             return self.union_get_attr(obj, obj.type, attr, result_type, line)
         else:
             return self.py_get_attr(obj, attr, line)
 
+    def nogil_get_attr(self, obj: Value, rtype: RInstance, attr: str, line: int) -> Value:
+        """Get a native int or bool attribute in a nogil function.
+
+        The attribute is borrowed and then checked, so that the undefined
+        attribute error is recorded instead of raised, and long ints are
+        rejected. Other attributes use the normal op (and are rejected later).
+        """
+        attr_type = rtype.attr_type(attr)
+        if not rtype.class_ir.get_method(attr):
+            if is_tagged(attr_type):
+                desc = int_nogil_check_attr_op
+            elif is_bool_rprimitive(attr_type):
+                desc = bool_nogil_check_attr_op
+            else:
+                return self.add(GetAttr(obj, attr, line))
+            value = self.add(GetAttr(obj, attr, line, borrow=True))
+            assert self.nogil_error is not None
+            return self.call_c(desc, [value, self.nogil_error], line)
+        return self.add(GetAttr(obj, attr, line))
+
     def union_get_attr(self,
                        obj: Value,
                        rtype: RUnion,
@@ -206,7 +244,8 @@ class LowLevelIRBuilder:
         Prefer get_attr() which generates optimized code for native classes.
         """
         key = self.load_str(attr)
-        return self.call_c(py_getattr_op, [obj, key], line)
+        cache = self.add(LoadInlineCache(line))
+        return self.call_c(py_getattr_cached_op, [obj, key, cache], line)
 
     # isinstance() checks
 
@@ -375,7 +414,9 @@ class LowLevelIRBuilder:
         if arg_kinds is None or all(kind == ARG_POS for kind in arg_kinds):
             # Use legacy method call API
             method_name_reg = self.load_str(method_name)
-            return self.call_c(py_method_call_op, [obj, method_name_reg] + arg_values, line)
+            cache = self.add(LoadInlineCache(line))
+            return self.call_c(py_method_call_cached_op,
+                               [obj, method_name_reg, cache] + arg_values, line)
         else:
             # Use py_call since it supports keyword arguments (and vectorcalls).
             method = self.py_get_attr(obj, method_name, line)
@@ -403,12 +444,14 @@ class LowLevelIRBuilder:
             arg_ptr = self.add(LoadAddress(object_pointer_rprimitive, array))
             num_pos = num_positional_args(arg_values, arg_kinds)
             keywords = self._vectorcall_keywords(arg_names)
-            value = self.call_c(py_vectorcall_method_op,
+            cache = self.add(LoadInlineCache(line))
+            value = self.call_c(py_vectorcall_method_cached_op,
                                 [method_name_reg,
                                  arg_ptr,
                                  Integer((num_pos + 1) | PY_VECTORCALL_ARGUMENTS_OFFSET,
                                          c_size_t_rprimitive),
-                                 keywords],
+                                 keywords,
+                                 cache],
                                 line)
             # Make sure arguments won't be freed until after the call.
             # We need this because RArray doesn't support automatic
@@ -582,7 +625,7 @@ class LowLevelIRBuilder:
 
     def load_bytes(self, value: bytes) -> Value:
         """Load a bytes literal value."""
-        return self.add(LoadLiteral(value, object_rprimitive))
+        return self.add(LoadLiteral(value, bytes_rprimitive))
 
     def load_complex(self, value: complex) -> Value:
         """Load a complex literal value."""
@@ -646,12 +689,30 @@ class LowLevelIRBuilder:
         if is_bool_rprimitive(ltype) and is_bool_rprimitive(rtype) and op in (
                 '&', '&=', '|', '|=', '^', '^='):
             return self.bool_bitwise_op(lreg, rreg, op[0], line)
+        if self.nogil_error is not None and is_tagged(ltype) and is_tagged(rtype):
+            value = self.nogil_int_binary_op(lreg, rreg, op, line)
+            if value is not None:
+                return value
 
         call_c_ops_candidates = binary_ops.get(op, [])
         target = self.matching_call_c(call_c_ops_candidates, [lreg, rreg], line)
         assert target, 'Unsupported binary operation: %s' % op
         return target
 
+    def nogil_int_binary_op(self, lreg: Value, rreg: Value, op: str,
+                            line: int) -> Optional[Value]:
+        """Generate a short int binary op in a nogil function (or return None)."""
+        # Comparisons were handled already, so this only strips augmented assignments
+        op = op.rstrip('=')
+        if op in ('&', '|', '^'):
+            # Bitwise ops on short ints are also bitwise ops on the tagged values
+            code = {'&': IntOp.AND, '|': IntOp.OR, '^': IntOp.XOR}[op]
+            return self.int_op(int_rprimitive, lreg, rreg, code, line)
+        if op in int_nogil_binary_ops:
+            assert self.nogil_error is not None
+            return self.call_c(int_nogil_binary_ops[op], [lreg, rreg, self.nogil_error], line)
+        return None
+
     def check_tagged_short_int(self, val: Value, line: int, negated: bool = False) -> Value:
         """Check if a tagged integer is a short integer.
 
@@ -852,6 +913,13 @@ class LowLevelIRBuilder:
                  line: int) -> Value:
         if (is_bool_rprimitive(lreg.type) or is_bit_rprimitive(lreg.type)) and expr_op == 'not':
             return self.unary_not(lreg, line)
+        if self.nogil_error is not None and is_tagged(lreg.type):
+            if expr_op == '-':
+                return self.call_c(int_nogil_neg_op, [lreg, self.nogil_error], line)
+            elif expr_op == '~':
+                return self.call_c(int_nogil_invert_op, [lreg], line)
+            elif expr_op == '+':
+                return lreg
         call_c_ops_candidates = unary_ops.get(expr_op, [])
         target = self.matching_call_c(call_c_ops_candidates, [lreg], line)
         assert target, 'Unsupported unary operation: %s' % expr_op
@@ -992,8 +1060,12 @@ class LowLevelIRBuilder:
                 always_truthy = False
                 if isinstance(value_type, RInstance):
                     # check whether X.__bool__ is always just the default (object.__bool__)
-                    if (not value_type.class_ir.has_method('__bool__')
-                            and value_type.class_ir.is_method_final('__bool__')):
+                    # and there is no __len__ that could make X falsey
+                    class_ir = value_type.class_ir
+                    if (not class_ir.has_method('__bool__')
+                            and class_ir.is_method_final('__bool__')
+                            and not class_ir.has_method('__len__')
+                            and class_ir.is_method_final('__len__')):
                         always_truthy = True
 
                 if not always_truthy:
@@ -1041,7 +1113,7 @@ class LowLevelIRBuilder:
             extra_int_constant = Integer(val, typ, line)
             coerced.append(extra_int_constant)
         error_kind = desc.error_kind
-        if error_kind == ERR_NEG_INT:
+        if error_kind == ERR_NEG_INT or error_kind == ERR_NEG_ONE:
             # Handled with an explicit comparison
             error_kind = ERR_NEVER
         target = self.add(CallC(desc.c_function_name, coerced, desc.return_type, desc.steals,
@@ -1053,6 +1125,13 @@ class LowLevelIRBuilder:
                                 line)
             comp.error_kind = ERR_FALSE
             self.add(comp)
+        elif desc.error_kind == ERR_NEG_ONE:
+            comp = ComparisonOp(target,
+                                Integer(-1, desc.return_type, line),
+                                ComparisonOp.NEQ,
+                                line)
+            comp.error_kind = ERR_FALSE
+            self.add(comp)
 
         if desc.truncated_type is None:
             result = target
@@ -1089,6 +1168,11 @@ class LowLevelIRBuilder:
                 else:
                     matching = desc
         if matching:
+            variant = str_literal_ops.get(matching.c_function_name)
+            if variant is not None:
+                arg = args[variant[1]]
+                if isinstance(arg, LoadLiteral) and type(arg.value) is str:
+                    matching = variant[0]
             target = self.call_c(matching, args, line, result_type)
             return target
         return None
@@ -1119,6 +1203,13 @@ class LowLevelIRBuilder:
             offset = Integer(1, c_pyssize_t_rprimitive, line)
             return self.int_op(short_int_rprimitive, size_value, offset,
                                IntOp.LEFT_SHIFT, line)
+        elif is_bytes_rprimitive(typ):
+            size_value = self.call_c(bytes_len_op, [val], line)
+            if use_pyssize_t:
+                return size_value
+            offset = Integer(1, c_pyssize_t_rprimitive, line)
+            return self.int_op(short_int_rprimitive, size_value, offset,
+                               IntOp.LEFT_SHIFT, line)
         elif is_set_rprimitive(typ):
             elem_address = self.add(GetElementPtr(val, PySetObject, 'used'))
             size_value = self.add(LoadMem(c_pyssize_t_rprimitive, elem_address))
@@ -1128,6 +1219,13 @@ class LowLevelIRBuilder:
             offset = Integer(1, c_pyssize_t_rprimitive, line)
             return self.int_op(short_int_rprimitive, size_value, offset,
                                IntOp.LEFT_SHIFT, line)
+        elif self.has_native_ssize_t_method(typ, '__len__'):
+            size_value = self.gen_method_call(val, '__len__', [], c_pyssize_t_rprimitive, line)
+            if use_pyssize_t:
+                return size_value
+            offset = Integer(1, c_pyssize_t_rprimitive, line)
+            return self.int_op(short_int_rprimitive, size_value, offset,
+                               IntOp.LEFT_SHIFT, line)
         # generic case
         else:
             if use_pyssize_t:
@@ -1135,6 +1233,50 @@ class LowLevelIRBuilder:
             else:
                 return self.call_c(generic_len_op, [val], line)
 
+    def builtin_hash(self, val: Value, line: int, use_pyssize_t: bool = False) -> Value:
+        """Return int_rprimitive by default."""
+        if self.has_native_ssize_t_method(val.type, '__hash__'):
+            hash_value = self.gen_method_call(val, '__hash__', [], c_pyssize_t_rprimitive, line)
+        elif use_pyssize_t:
+            return self.call_c(generic_ssize_t_hash_op, [val], line)
+        else:
+            return self.call_c(generic_hash_op, [val], line)
+        if use_pyssize_t:
+            return hash_value
+        return self.coerce(hash_value, int_rprimitive, line)
+
+    def has_native_ssize_t_method(self, typ: RType, name: str) -> bool:
+        """Does a native class have a __hash__ or __len__ method that returns a C integer?"""
+        if (isinstance(typ, RInstance) and typ.class_ir.is_ext_class
+                and not typ.class_ir.builtin_base and typ.class_ir.has_method(name)):
+            return is_c_py_ssize_t_rprimitive(typ.class_ir.method_sig(name).ret_type)
+        return False
+
+    def str_build(self, pieces: List[Value], line: int) -> Value:
+        """Concatenate pieces into a new str.
+
+        The pieces must be strs or ints. Ints are formatted in decimal without
+        boxing them first.
+        """
+        if len(pieces) > STR_BUILD_MAX_PIECES:
+            # Build the prefix separately, since the C function takes a limited
+            # number of pieces.
+            prefix = self.str_build(pieces[:STR_BUILD_MAX_PIECES], line)
+            return self.str_build([prefix] + pieces[STR_BUILD_MAX_PIECES:], line)
+        args = [Integer(len(pieces), c_pyssize_t_rprimitive)]  # type: List[Value]
+        int_mask = 0
+        for i, piece in enumerate(pieces):
+            if is_int_rprimitive(piece.type) or is_short_int_rprimitive(piece.type):
+                int_mask |= 1 << i
+            else:
+                piece = self.coerce(piece, str_rprimitive, line)
+            args.append(piece)
+        args.insert(1, Integer(int_mask, uint32_rprimitive))
+        desc = str_build_op
+        return self.add(CallC(desc.c_function_name, args,
+                              desc.return_type, desc.steals, desc.is_borrowed,
+                              desc.error_kind, line, var_arg_idx=len(desc.arg_types)))
+
     def new_tuple(self, items: List[Value], line: int) -> Value:
         size = Integer(len(items), c_pyssize_t_rprimitive)  # type: Value
         return self.call_c(new_tuple_op, [size] + items, line)
@@ -1302,10 +1444,30 @@ class LowLevelIRBuilder:
         # keys and values should have the same number of items
         size = len(keys)
         if size > 0:
-            size_value = Integer(size, c_pyssize_t_rprimitive)  # type: Value
-            # merge keys and values
-            items = [i for t in list(zip(keys, values)) for i in t]
-            return self.call_c(dict_build_op, [size_value] + items, line)
+            keys_tuple = None  # type: Optional[Value]
+            if all(isinstance(key, LoadLiteral) and type(key.value) is str for key in keys):
+                # All keys are str literals, so we can copy a template dict
+                # that already has the keys.
+                key_strs = tuple(cast(LoadLiteral, key).value for key in keys)
+                keys_tuple = self.add(LoadLiteral(key_strs, object_rprimitive))
+                items = values
+            else:
+                # merge keys and values
+                items = [i for t in list(zip(keys, values)) for i in t]
+            # Create a C array containing all items as boxed values.
+            array = Register(RArray(object_rprimitive, len(items)))
+            coerced_items = [self.coerce(item, object_rprimitive, line) for item in items]
+            self.add(AssignMulti(array, coerced_items))
+            items_ptr = self.add(LoadAddress(object_pointer_rprimitive, array))
+            if keys_tuple is not None:
+                result = self.call_c(dict_from_template_op, [keys_tuple, items_ptr], line)
+            else:
+                size_value = Integer(size, c_pyssize_t_rprimitive)
+                result = self.call_c(dict_build_op, [size_value, items_ptr], line)
+            # Make sure the items won't be freed until the dict has references
+            # to them. (RArray doesn't support automatic memory management.)
+            self.add(KeepAlive(coerced_items))
+            return result
         else:
             return self.call_c(dict_new_op, [], line)
 
@@ -11,8 +11,8 @@ from mypy.types import (
 
 from mypyc.ir.rtypes import (
     RType, RUnion, RTuple, RInstance, object_rprimitive, dict_rprimitive, tuple_rprimitive,
-    none_rprimitive, int_rprimitive, float_rprimitive, str_rprimitive, bool_rprimitive,
-    list_rprimitive, set_rprimitive
+    none_rprimitive, int_rprimitive, float_rprimitive, str_rprimitive, bytes_rprimitive,
+    bool_rprimitive, list_rprimitive, set_rprimitive, c_pyssize_t_rprimitive, is_int_rprimitive
 )
 from mypyc.ir.func_ir import FuncSignature, FuncDecl, RuntimeArg
 from mypyc.ir.class_ir import ClassIR
@@ -45,6 +45,8 @@ class Mapper:
                 return float_rprimitive
             elif typ.type.fullname == 'builtins.str':
                 return str_rprimitive
+            elif typ.type.fullname == 'builtins.bytes':
+                return bytes_rprimitive
             elif typ.type.fullname == 'builtins.bool':
                 return bool_rprimitive
             elif typ.type.fullname == 'builtins.list':
@@ -139,4 +141,10 @@ class Mapper:
         # since tp_richcompare needs an object anyways.
         if fdef.name in ('__eq__', '__ne__', '__lt__', '__gt__', '__le__', '__ge__'):
             ret = object_rprimitive
+        # Native __hash__ and __len__ methods return a C integer that is ready
+        # to be used as the tp_hash or mp_length result, so that hash values
+        # that don't fit in a short int never get boxed.
+        if (fdef.name in ('__hash__', '__len__') and is_int_rprimitive(ret)
+                and fdef.info in self.type_to_ir and self.type_to_ir[fdef.info].is_ext_class):
+            ret = c_pyssize_t_rprimitive
         return FuncSignature(args, ret)
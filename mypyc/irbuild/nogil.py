@@ -0,0 +1,113 @@
+"""Generate IR for nogil functions, which run without the GIL.
+
+A module-level function decorated with @mypyc_attr(nogil=True) releases
+the GIL after checking its arguments and reacquires it when it returns,
+so that other threads can run while it computes:
+
+    @mypyc_attr(nogil=True)
+    def collatz_steps(x: int) -> int:
+        ...
+
+While the GIL is released, the body can only use operations that don't
+touch Python objects: arithmetic and comparisons on ints and bools, and
+reads of int and bool attributes of native objects. All int values are
+short. An operation that would need a long int or raise an exception
+stores an error code instead and branches to an error handler, which
+reacquires the GIL and raises the exception.
+
+This generates the entry and exit code. While the body is generated,
+LowLevelIRBuilder.nogil_error is set so that int operations use the
+GIL-free primitives. Any other operations in the body are rejected by
+mypyc.transform.nogil after the exception and refcount transforms.
+"""
+
+from typing import Optional
+
+from mypy.nodes import FuncDef, FuncItem, ClassDef
+
+from mypyc.ir.ops import BasicBlock, Value, Register, Integer, Assign, LoadAddress, Unreachable
+from mypyc.ir.rtypes import (
+    RType, RInstance, is_tagged, is_bool_rprimitive, is_none_rprimitive, c_int_rprimitive,
+    nogil_error_rprimitive
+)
+from mypyc.ir.func_ir import FuncSignature
+from mypyc.primitives.int_ops import nogil_check_int_op, nogil_enter_op, nogil_raise_op
+from mypyc.irbuild.builder import IRBuilder
+from mypyc.irbuild.nonlocalcontrol import NoGILNonlocalControl
+
+
+class NoGILRegion:
+    """State of the GIL-released body of a nogil function."""
+
+    def __init__(self, thread_state: Value, error_code: Register,
+                 error_block: BasicBlock) -> None:
+        self.thread_state = thread_state
+        # Set by operations that fail (0 if nothing has failed)
+        self.error_code = error_code
+        # Error handler that reacquires the GIL and raises an exception
+        self.error_block = error_block
+
+
+def is_nogil_arg_type(typ: RType) -> bool:
+    if isinstance(typ, RInstance):
+        # Trait attribute lookups update a shared cache, so we don't allow traits
+        return typ.class_ir.is_ext_class and not typ.class_ir.is_trait
+    return is_tagged(typ) or is_bool_rprimitive(typ)
+
+
+def is_nogil_func(builder: IRBuilder, fitem: FuncItem, sig: FuncSignature,
+                  cdef: Optional[ClassDef]) -> bool:
+    """Should fitem be compiled as a nogil function?
+
+    Report an error if fitem is marked as nogil but can't be one.
+    """
+    if fitem not in builder.nogil_funcs:
+        return False
+    assert isinstance(fitem, FuncDef)
+    if (cdef is not None or fitem in builder.nested_fitems or fitem.is_generator
+            or fitem.is_coroutine or fitem.is_async_generator):
+        builder.error('Only module-level functions can be nogil functions', fitem.line)
+        return False
+    ok = True
+    for arg in sig.args:
+        if not is_nogil_arg_type(arg.type):
+            builder.error('Argument "{}" of a nogil function must be an int, a bool or a '
+                          'native class instance'.format(arg.name), fitem.line)
+            ok = False
+    ret_type = sig.ret_type
+    if not (is_tagged(ret_type) or is_bool_rprimitive(ret_type) or is_none_rprimitive(ret_type)):
+        builder.error('A nogil function must return an int, a bool or None', fitem.line)
+        ok = False
+    return ok
+
+
+def gen_nogil_entry(builder: IRBuilder, line: int) -> NoGILRegion:
+    """Check the arguments, release the GIL and start generating the body."""
+    for arg in builder.builder.args:
+        if is_tagged(arg.type):
+            builder.call_c(nogil_check_int_op, [arg], line)
+    error_code = Register(c_int_rprimitive)
+    builder.add(Assign(error_code, Integer(0, c_int_rprimitive), line))
+    error_ptr = builder.add(LoadAddress(nogil_error_rprimitive, error_code, line))
+    thread_state = builder.call_c(nogil_enter_op, [], line)
+    region = NoGILRegion(thread_state, error_code, BasicBlock())
+
+    builder.builder.push_error_handler(region.error_block)
+    builder.goto_and_activate(BasicBlock())
+    builder.nonlocal_control.append(
+        NoGILNonlocalControl(builder.nonlocal_control[-1], thread_state))
+    builder.builder.nogil_error = error_ptr
+    return region
+
+
+def gen_nogil_exit(builder: IRBuilder, region: NoGILRegion, line: int) -> None:
+    """Finish the body and generate the error handler.
+
+    Returns reacquire the GIL in NoGILNonlocalControl.
+    """
+    builder.builder.nogil_error = None
+    builder.nonlocal_control.pop()
+    builder.builder.pop_error_handler()
+    builder.activate_block(region.error_block)
+    builder.call_c(nogil_raise_op, [region.thread_state, region.error_code], line)
+    builder.add(Unreachable())
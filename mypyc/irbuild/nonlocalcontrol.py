@@ -11,7 +11,8 @@ from mypyc.ir.ops import (
     Branch, BasicBlock, Unreachable, Value, Goto, Integer, Assign, Register, Return,
     NO_TRACEBACK_LINE_NO
 )
-from mypyc.primitives.exc_ops import set_stop_iteration_value, restore_exc_info_op
+from mypyc.primitives.exc_ops import set_generator_return_value, restore_exc_info_op
+from mypyc.primitives.int_ops import nogil_exit_op
 from mypyc.irbuild.targets import AssignmentTarget
 
 if TYPE_CHECKING:
@@ -99,8 +100,12 @@ class GeneratorNonlocalControl(BaseNonlocalControl):
         # case.  Also we call a special internal function to set
         # StopIteration instead of using RaiseStandardError because
         # the obvious thing doesn't work if the value is a tuple
-        # (???).
-        builder.call_c(set_stop_iteration_value, [value], NO_TRACEBACK_LINE_NO)
+        # (???). If the caller passed a pointer for the return value,
+        # this stores the value there and doesn't raise anything.
+        stop_iter_ptr = builder.fn_info.generator_class.stop_iter_value_reg
+        assert stop_iter_ptr is not None
+        builder.call_c(set_generator_return_value, [value, stop_iter_ptr],
+                       NO_TRACEBACK_LINE_NO)
         builder.add(Unreachable())
         builder.builder.pop_error_handler()
 
@@ -190,3 +195,17 @@ class FinallyNonlocalControl(CleanupNonlocalControl):
         builder.activate_block(cleanup)
         builder.call_c(restore_exc_info_op, [self.saved], line)
         builder.goto_and_activate(target)
+
+
+class NoGILNonlocalControl(CleanupNonlocalControl):
+    """Nonlocal control for the body of a nogil function.
+
+    Reacquires the GIL when returning.
+    """
+
+    def __init__(self, outer: NonlocalControl, thread_state: Value) -> None:
+        super().__init__(outer)
+        self.thread_state = thread_state
+
+    def gen_cleanup(self, builder: 'IRBuilder', line: int) -> None:
+        builder.call_c(nogil_exit_op, [self.thread_state], line)
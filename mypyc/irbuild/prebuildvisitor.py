@@ -5,6 +5,8 @@ from mypy.nodes import (
 )
 from mypy.traverser import TraverserVisitor
 
+from mypyc.irbuild.util import get_mypyc_attr_call, get_mypyc_attrs
+
 
 class PreBuildVisitor(TraverserVisitor):
     """Mypy file AST visitor run before building the IR.
@@ -16,6 +18,7 @@ class PreBuildVisitor(TraverserVisitor):
     * Find non-local variables (free variables)
     * Find property setters
     * Find decorators of functions
+    * Find nogil functions
 
     The main IR build pass uses this information.
     """
@@ -50,8 +53,15 @@ class PreBuildVisitor(TraverserVisitor):
         # Map function to its non-special decorators.
         self.funcs_to_decorators = {}  # type: Dict[FuncDef, List[Expression]]
 
+        # Functions decorated with @mypyc_attr(nogil=True).
+        self.nogil_funcs = set()  # type: Set[FuncDef]
+
     def visit_decorator(self, dec: Decorator) -> None:
-        if dec.decorators:
+        if get_mypyc_attrs(dec).get('nogil'):
+            self.nogil_funcs.add(dec.func)
+        # mypyc_attr only affects compilation, so it's not treated as a decorator.
+        decorators = [d for d in dec.decorators if not get_mypyc_attr_call(d)]
+        if decorators:
             # Only add the function being decorated if there exist
             # (ordinary) decorators in the decorator list. Certain
             # decorators (such as @property, @abstractmethod) are
@@ -59,11 +69,11 @@ class PreBuildVisitor(TraverserVisitor):
             # mypy. Functions decorated only by special decorators
             # (and property setters) are not treated as decorated
             # functions by the IR builder.
-            if isinstance(dec.decorators[0], MemberExpr) and dec.decorators[0].name == 'setter':
+            if isinstance(decorators[0], MemberExpr) and decorators[0].name == 'setter':
                 # Property setters are not treated as decorated methods.
                 self.prop_setters.add(dec.func)
             else:
-                self.funcs_to_decorators[dec.func] = dec.decorators
+                self.funcs_to_decorators[dec.func] = decorators
         super().visit_decorator(dec)
 
     def visit_func_def(self, fdef: FuncItem) -> None:
@@ -29,7 +29,8 @@ from mypyc.ir.class_ir import ClassIR
 from mypyc.common import PROPSET_PREFIX
 from mypyc.irbuild.mapper import Mapper
 from mypyc.irbuild.util import (
-    get_func_def, is_dataclass, is_trait, is_extension_class, get_mypyc_attrs
+    get_func_def, is_dataclass, is_trait, is_extension_class, get_mypyc_attrs,
+    get_mypyc_attr_call
 )
 from mypyc.errors import Errors
 from mypyc.options import CompilerOptions
@@ -124,9 +125,10 @@ def prepare_method_def(ir: ClassIR, module_name: str, cdef: ClassDef, mapper: Ma
         # TODO: do something about abstract methods here. Currently, they are handled just like
         # normal methods.
         decl = prepare_func_def(module_name, cdef.name, node.func, mapper)
-        if not node.decorators:
+        decorators = [d for d in node.decorators if not get_mypyc_attr_call(d)]
+        if not decorators:
             ir.method_decls[node.name] = decl
-        elif isinstance(node.decorators[0], MemberExpr) and node.decorators[0].name == 'setter':
+        elif isinstance(decorators[0], MemberExpr) and decorators[0].name == 'setter':
             # Make property setter name different than getter name so there are no
             # name clashes when generating C code, and property lookup at the IR level
             # works correctly.
@@ -170,6 +172,10 @@ def prepare_class_def(path: str, module_name: str, cdef: ClassDef,
     attrs = get_mypyc_attrs(cdef)
     if attrs.get("allow_interpreted_subclasses") is True:
         ir.allow_interpreted_subclasses = True
+    if attrs.get("free_list") is True:
+        ir.use_free_list = True
+    if attrs.get("compact_pickle") is True:
+        ir.compact_pickle = True
 
     # We sort the table for determinism here on Python 3.5
     for name, node in sorted(info.names.items()):
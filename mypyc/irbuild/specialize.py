@@ -14,23 +14,34 @@ See comment below for more documentation.
 
 from typing import Callable, Optional, Dict, Tuple, List
 
-from mypy.nodes import CallExpr, RefExpr, MemberExpr, TupleExpr, GeneratorExpr, ARG_POS
-from mypy.types import AnyType, TypeOfAny
+from mypy.nodes import (
+    CallExpr, RefExpr, MemberExpr, TupleExpr, ListExpr, GeneratorExpr, StrExpr, StarExpr,
+    Expression, ARG_POS, ARG_NAMED
+)
+from mypy.types import AnyType, TypeOfAny, Instance, get_proper_type
 
 from mypyc.ir.ops import (
-    Value, Register, BasicBlock, Integer, RaiseStandardError, Unreachable
+    Value, Register, BasicBlock, Integer, IntOp, RaiseStandardError, Unreachable
 )
 from mypyc.ir.rtypes import (
     RType, RTuple, str_rprimitive, list_rprimitive, dict_rprimitive, set_rprimitive,
-    bool_rprimitive, is_dict_rprimitive
+    bool_rprimitive, object_rprimitive, is_dict_rprimitive, is_bool_rprimitive,
+    is_str_rprimitive, is_int_rprimitive, short_int_rprimitive, c_pyssize_t_rprimitive
+)
+from mypyc.primitives.dict_ops import (
+    dict_keys_op, dict_values_op, dict_items_op, dict_view_len_ops
 )
-from mypyc.primitives.dict_ops import dict_keys_op, dict_values_op, dict_items_op
-from mypyc.primitives.list_ops import new_list_set_item_op
+from mypyc.primitives.list_ops import new_list_set_item_op, list_sort_key_op, sorted_op
 from mypyc.primitives.tuple_ops import new_tuple_set_item_op
+from mypyc.primitives.str_ops import str_format_simple_op
+from mypyc.primitives.misc_ops import (
+    deque_append_op, deque_append_left_op, deque_pop_op, deque_pop_left_op, deque_len_op,
+    id_ssize_t_op
+)
 from mypyc.irbuild.builder import IRBuilder
 from mypyc.irbuild.for_helpers import (
     translate_list_comprehension, translate_set_comprehension,
-    comprehension_helper, sequence_from_generator_preallocate_helper
+    comprehension_helper, sequence_from_generator_preallocate_helper, dict_view_call
 )
 
 
@@ -78,17 +89,104 @@ def translate_len(
     if (len(expr.args) == 1
             and expr.arg_kinds == [ARG_POS]):
         expr_rtype = builder.node_type(expr.args[0])
+        view = dict_view_call(builder, expr.args[0])
         if isinstance(expr_rtype, RTuple):
             # len() of fixed-length tuple can be trivially determined statically,
             # though we still need to evaluate it.
             builder.accept(expr.args[0])
             return Integer(len(expr_rtype.types))
+        elif view is not None:
+            # len() of a dict view is the length of the dict, unless a dict
+            # subclass overrides the view method.
+            obj = builder.accept(view[0])
+            size = builder.call_c(dict_view_len_ops[view[1]], [obj], expr.line)
+            return builder.int_op(short_int_rprimitive, size,
+                                  Integer(1, c_pyssize_t_rprimitive), IntOp.LEFT_SHIFT,
+                                  expr.line)
+        elif is_deque_expr(builder, expr.args[0]):
+            obj = builder.accept(expr.args[0])
+            return builder.call_c(deque_len_op, [obj], expr.line)
         else:
             obj = builder.accept(expr.args[0])
             return builder.builtin_len(obj, -1)
     return None
 
 
+@specialize_function('builtins.hash')
+def translate_hash(
+        builder: IRBuilder, expr: CallExpr, callee: RefExpr) -> Optional[Value]:
+    # Special case builtins.hash, which directly calls native __hash__ methods
+    if len(expr.args) == 1 and expr.arg_kinds == [ARG_POS]:
+        obj = builder.accept(expr.args[0])
+        return builder.builder.builtin_hash(obj, expr.line)
+    return None
+
+
+def translate_ssize_t_call(
+        builder: IRBuilder, expr: Expression, non_negative: bool) -> Optional[Value]:
+    """Translate hash(x), len(x) or id(x) to a Py_ssize_t that is never -1.
+
+    This is used for return values of native __hash__ and __len__ methods,
+    which are C integers, so that results that don't fit in a short int
+    (such as half of all hash values) are never boxed. If non_negative is
+    true, only len() is translated. Return None if expr is something else.
+    """
+    if not (isinstance(expr, CallExpr) and isinstance(expr.callee, RefExpr)
+            and len(expr.args) == 1 and expr.arg_kinds == [ARG_POS]):
+        return None
+    fullname = expr.callee.fullname
+    arg = expr.args[0]
+    if (fullname == 'builtins.len' and not isinstance(builder.node_type(arg), RTuple)
+            and dict_view_call(builder, arg) is None and not is_deque_expr(builder, arg)):
+        obj = builder.accept(arg)
+        return builder.builder.builtin_len(obj, expr.line, use_pyssize_t=True)
+    elif non_negative:
+        return None
+    elif fullname == 'builtins.hash':
+        obj = builder.accept(arg)
+        return builder.builder.builtin_hash(obj, expr.line, use_pyssize_t=True)
+    elif fullname == 'builtins.id':
+        obj = builder.accept(arg)
+        return builder.call_c(id_ssize_t_op, [obj], expr.line)
+    return None
+
+
+def is_deque_expr(builder: IRBuilder, expr: Expression) -> bool:
+    typ = get_proper_type(builder.types.get(expr))
+    return isinstance(typ, Instance) and typ.type.fullname == 'collections.deque'
+
+
+@specialize_function('append', object_rprimitive)
+@specialize_function('appendleft', object_rprimitive)
+def translate_deque_append(
+        builder: IRBuilder, expr: CallExpr, callee: RefExpr) -> Optional[Value]:
+    # Special case deque.append(x) and deque.appendleft(x)
+    if (isinstance(callee, MemberExpr)
+            and is_deque_expr(builder, callee.expr)
+            and len(expr.args) == 1
+            and expr.arg_kinds == [ARG_POS]):
+        op = deque_append_op if callee.name == 'append' else deque_append_left_op
+        deque = builder.accept(callee.expr)
+        item = builder.accept(expr.args[0])
+        builder.call_c(op, [deque, item], expr.line)
+        return builder.none()
+    return None
+
+
+@specialize_function('pop', object_rprimitive)
+@specialize_function('popleft', object_rprimitive)
+def translate_deque_pop(
+        builder: IRBuilder, expr: CallExpr, callee: RefExpr) -> Optional[Value]:
+    # Special case deque.pop() and deque.popleft()
+    if (isinstance(callee, MemberExpr)
+            and is_deque_expr(builder, callee.expr)
+            and len(expr.args) == 0):
+        op = deque_pop_op if callee.name == 'pop' else deque_pop_left_op
+        deque = builder.accept(callee.expr)
+        return builder.call_c(op, [deque], expr.line)
+    return None
+
+
 @specialize_function('builtins.list')
 def dict_methods_fast_path(
         builder: IRBuilder, expr: CallExpr, callee: RefExpr) -> Optional[Value]:
@@ -142,6 +240,146 @@ def translate_set_from_generator_call(
     return None
 
 
+def sort_keyword_args_supported(builder: IRBuilder, expr: CallExpr, first: int) -> bool:
+    """Are the arguments of a sort call from index "first" onwards supported?
+
+    They must all be key= or reverse= keyword arguments, and reverse must be a bool.
+    """
+    names = expr.arg_names[first:]
+    if (any(kind != ARG_NAMED for kind in expr.arg_kinds[first:])
+            or len(set(names)) != len(names)
+            or not set(names) <= {'key', 'reverse'}):
+        return False
+    return all(name != 'reverse' or is_bool_rprimitive(builder.node_type(arg))
+               for arg, name in zip(expr.args[first:], names))
+
+
+def gen_sort_keyword_args(
+        builder: IRBuilder, expr: CallExpr, first: int) -> Tuple[Value, Value]:
+    """Generate the key and reverse arguments of a sort call, using defaults if missing."""
+    key = None  # type: Optional[Value]
+    reverse = None  # type: Optional[Value]
+    for arg, name in zip(expr.args[first:], expr.arg_names[first:]):
+        if name == 'key':
+            key = builder.coerce(builder.accept(arg), object_rprimitive, arg.line)
+        else:
+            reverse = builder.accept(arg)
+    if key is None:
+        key = builder.none_object()
+    if reverse is None:
+        reverse = builder.false()
+    return key, reverse
+
+
+@specialize_function('sort', list_rprimitive)
+def translate_list_sort(
+        builder: IRBuilder, expr: CallExpr, callee: RefExpr) -> Optional[Value]:
+    # Special case list.sort(key=f, reverse=b). A plain list.sort() is a
+    # regular primitive.
+    if (isinstance(callee, MemberExpr)
+            and expr.args
+            and sort_keyword_args_supported(builder, expr, 0)):
+        list_val = builder.accept(callee.expr)
+        key, reverse = gen_sort_keyword_args(builder, expr, 0)
+        builder.call_c(list_sort_key_op, [list_val, key, reverse], expr.line)
+        return builder.none()
+    return None
+
+
+@specialize_function('builtins.sorted')
+def translate_sorted(
+        builder: IRBuilder, expr: CallExpr, callee: RefExpr) -> Optional[Value]:
+    # Special case sorted(x, key=f, reverse=b). A generator argument is
+    # compiled into a list that is then sorted in place.
+    if not (expr.args
+            and expr.arg_kinds[0] == ARG_POS
+            and sort_keyword_args_supported(builder, expr, 1)):
+        return None
+    arg = expr.args[0]
+    if isinstance(arg, GeneratorExpr):
+        list_val = translate_list_comprehension(builder, arg)
+        key, reverse = gen_sort_keyword_args(builder, expr, 1)
+        builder.call_c(list_sort_key_op, [list_val, key, reverse], expr.line)
+        return list_val
+    obj = builder.accept(arg)
+    key, reverse = gen_sort_keyword_args(builder, expr, 1)
+    return builder.call_c(sorted_op, [obj, key, reverse], expr.line)
+
+
+def simple_format_arg(builder: IRBuilder, expr: Expression) -> Optional[Expression]:
+    """Match "'{:{}}'.format(x, '')" where x is an int or a str and return x.
+
+    The parser translates f-string components such as "{x}" to these calls.
+    Ints and strs can be used directly when building a str (see str_build),
+    after checking that a str isn't an instance of a str subclass (see
+    translate_simple_format).
+    """
+    if (isinstance(expr, CallExpr)
+            and isinstance(expr.callee, MemberExpr)
+            and isinstance(expr.callee.expr, StrExpr)
+            and expr.callee.expr.value == '{:{}}'
+            and expr.callee.name == 'format'
+            and expr.arg_kinds == [ARG_POS, ARG_POS]
+            and isinstance(expr.args[1], StrExpr)
+            and expr.args[1].value == ''):
+        arg_type = builder.node_type(expr.args[0])
+        if is_int_rprimitive(arg_type) or is_str_rprimitive(arg_type):
+            return expr.args[0]
+    return None
+
+
+def translate_simple_format(builder: IRBuilder, arg: Expression) -> Value:
+    """Translate an argument matched by simple_format_arg into a str build piece."""
+    val = builder.accept(arg)
+    if is_str_rprimitive(val.type):
+        # A str subclass could override __format__
+        return builder.call_c(str_format_simple_op, [val], arg.line)
+    return val
+
+
+@specialize_function('format', str_rprimitive)
+def translate_str_format(
+        builder: IRBuilder, expr: CallExpr, callee: RefExpr) -> Optional[Value]:
+    # Special case f"{x}" for an int or str x.
+    arg = simple_format_arg(builder, expr)
+    if arg is None:
+        return None
+    val = translate_simple_format(builder, arg)
+    if is_str_rprimitive(val.type):
+        return val
+    return builder.builder.str_build([val], expr.line)
+
+
+@specialize_function('join', str_rprimitive)
+def translate_str_join_display(
+        builder: IRBuilder, expr: CallExpr, callee: RefExpr) -> Optional[Value]:
+    # Special case "<literal>.join([x, y, ...])", which is how f-strings are compiled.
+    # We build the result directly instead of creating a list first.
+    if not (isinstance(callee, MemberExpr)
+            and isinstance(callee.expr, StrExpr)
+            and len(expr.args) == 1
+            and expr.arg_kinds == [ARG_POS]
+            and isinstance(expr.args[0], (ListExpr, TupleExpr))):
+        return None
+    items = expr.args[0].items
+    for item in items:
+        if isinstance(item, StarExpr) or not is_str_rprimitive(builder.node_type(item)):
+            return None
+    sep = callee.expr.value
+    pieces = []  # type: List[Value]
+    for i, item in enumerate(items):
+        if i > 0 and sep:
+            pieces.append(builder.load_str(sep))
+        if isinstance(item, StrExpr) and not item.value:
+            continue
+        arg = simple_format_arg(builder, item)
+        if arg is not None:
+            pieces.append(translate_simple_format(builder, arg))
+        else:
+            pieces.append(builder.accept(item))
+    return builder.builder.str_build(pieces, expr.line)
+
+
 @specialize_function('builtins.tuple')
 @specialize_function('builtins.frozenset')
 @specialize_function('builtins.dict')
@@ -13,19 +13,20 @@ from mypy.nodes import (
     Block, ExpressionStmt, ReturnStmt, AssignmentStmt, OperatorAssignmentStmt, IfStmt, WhileStmt,
     ForStmt, BreakStmt, ContinueStmt, RaiseStmt, TryStmt, WithStmt, AssertStmt, DelStmt,
     Expression, StrExpr, TempNode, Lvalue, Import, ImportFrom, ImportAll, TupleExpr, ListExpr,
-    StarExpr
+    StarExpr, Statement, PassStmt, NameExpr, Var, IntExpr, FloatExpr, BytesExpr, LDEF
 )
 
 from mypyc.ir.ops import (
     Assign, Unreachable, RaiseStandardError, LoadErrorValue, BasicBlock, TupleGet, Value, Register,
     Branch, NO_TRACEBACK_LINE_NO
 )
-from mypyc.ir.rtypes import exc_rtuple
+from mypyc.ir.rtypes import exc_rtuple, is_c_py_ssize_t_rprimitive
 from mypyc.primitives.generic_ops import py_delattr_op
 from mypyc.primitives.misc_ops import type_op
 from mypyc.primitives.exc_ops import (
     raise_exception_op, reraise_exception_op, error_catch_op, exc_matches_op, restore_exc_info_op,
-    get_exc_value_op, keep_propagating_op, get_exc_info_op
+    get_exc_value_op, keep_propagating_op, get_exc_info_op, error_fetch_op,
+    fetched_exc_matches_op, restore_error_op, chain_error_op
 )
 from mypyc.irbuild.targets import (
     AssignmentTarget, AssignmentTargetRegister, AssignmentTargetIndex, AssignmentTargetAttr,
@@ -36,6 +37,7 @@ from mypyc.irbuild.nonlocalcontrol import (
 )
 from mypyc.irbuild.for_helpers import for_loop_helper
 from mypyc.irbuild.builder import IRBuilder
+from mypyc.irbuild.specialize import translate_ssize_t_call
 
 GenFunc = Callable[[], None]
 
@@ -63,11 +65,17 @@ def transform_expression_stmt(builder: IRBuilder, stmt: ExpressionStmt) -> None:
 
 
 def transform_return_stmt(builder: IRBuilder, stmt: ReturnStmt) -> None:
+    retval = None  # type: Optional[Value]
     if stmt.expr:
-        retval = builder.accept(stmt.expr)
+        if is_c_py_ssize_t_rprimitive(builder.ret_types[-1]):
+            # Native __hash__ or __len__ method
+            retval = translate_ssize_t_call(builder, stmt.expr,
+                                            non_negative=builder.fn_info.name == '__len__')
+        if retval is None:
+            retval = builder.accept(stmt.expr)
     else:
         retval = builder.builder.none()
-    retval = builder.coerce(retval, builder.ret_types[-1], stmt.line)
+    retval = builder.coerce_ret_value(retval, builder.fn_info.name, stmt.line)
     builder.nonlocal_control[-1].gen_return(builder, retval, stmt.line)
 
 
@@ -250,7 +258,7 @@ def transform_for_stmt(builder: IRBuilder, s: ForStmt) -> None:
         builder.accept(s.else_body)
 
     for_loop_helper(builder, s.index, s.expr, body,
-                    else_block if s.else_body else None, s.line)
+                    else_block if s.else_body else None, s.line, body=[s.body])
 
 
 def transform_break_stmt(builder: IRBuilder, node: BreakStmt) -> None:
@@ -362,6 +370,111 @@ def transform_try_except(builder: IRBuilder,
     builder.activate_block(exit_block)
 
 
+def transform_try_except_without_exc_info(builder: IRBuilder,
+                                          body: GenFunc,
+                                          handlers: Sequence[Tuple[Optional[Expression], GenFunc]],
+                                          else_body: Optional[GenFunc],
+                                          line: int) -> None:
+    """Try/except where none of the except blocks can observe the exception.
+
+    This is like transform_try_except, but the handlers must not bind the
+    exception or run any code that could raise or look at sys.exc_info().
+    Since nobody can see the exception, we don't normalize it, and it never
+    becomes the currently handled exception.
+    """
+    assert handlers, "try needs except"
+
+    except_entry, exit_block = BasicBlock(), BasicBlock()
+    else_block = BasicBlock() if else_body else exit_block
+
+    builder.builder.push_error_handler(except_entry)
+    builder.goto_and_activate(BasicBlock())
+    body()
+    builder.goto(else_block)
+    builder.builder.pop_error_handler()
+
+    # The error handler takes the error out of the error indicator and then
+    # checks it against the except clauses. Evaluating the types of the
+    # except clauses is done with the error cleared. If that fails, the
+    # fetched error becomes the context of the new one, like it would if
+    # it was the exception being handled.
+    chain_block = BasicBlock()
+    builder.activate_block(except_entry)
+    err = builder.maybe_spill(builder.call_c(error_fetch_op, [], line))
+    next_block = None
+    for type, handler_body in handlers:
+        next_block = None
+        if type:
+            next_block, body_block = BasicBlock(), BasicBlock()
+            builder.builder.push_error_handler(chain_block)
+            builder.goto_and_activate(BasicBlock())
+            type_val = builder.accept(type)
+            builder.builder.pop_error_handler()
+            matches = builder.call_c(
+                fetched_exc_matches_op, [builder.read(err), type_val], type.line
+            )
+            builder.add(Branch(matches, body_block, next_block, Branch.BOOL))
+            builder.activate_block(body_block)
+        handler_body()
+        builder.goto(exit_block)
+        if next_block:
+            builder.activate_block(next_block)
+
+    # Nothing matched, so put the error back and continue propagating it
+    if next_block:
+        builder.call_c(restore_error_op, [builder.read(err)], NO_TRACEBACK_LINE_NO)
+        builder.call_c(keep_propagating_op, [], NO_TRACEBACK_LINE_NO)
+        builder.add(Unreachable())
+
+    if any(type is not None for type, _ in handlers):
+        builder.activate_block(chain_block)
+        builder.call_c(chain_error_op, [builder.read(err)], NO_TRACEBACK_LINE_NO)
+        builder.call_c(keep_propagating_op, [], NO_TRACEBACK_LINE_NO)
+        builder.add(Unreachable())
+
+    if else_body:
+        builder.activate_block(else_block)
+        else_body()
+        builder.goto(exit_block)
+
+    builder.activate_block(exit_block)
+
+
+def is_literal_expr(expr: Expression) -> bool:
+    if isinstance(expr, (IntExpr, FloatExpr, StrExpr, BytesExpr)):
+        return True
+    return isinstance(expr, NameExpr) and expr.fullname in ('builtins.None',
+                                                            'builtins.True',
+                                                            'builtins.False')
+
+
+def is_trivial_handler_stmt(stmt: Statement) -> bool:
+    """Can stmt neither raise an exception nor observe sys.exc_info()?"""
+    if isinstance(stmt, (PassStmt, BreakStmt, ContinueStmt)):
+        return True
+    if isinstance(stmt, ReturnStmt):
+        return stmt.expr is None or is_literal_expr(stmt.expr)
+    if isinstance(stmt, AssignmentStmt):
+        if len(stmt.lvalues) != 1 or not is_literal_expr(stmt.rvalue):
+            return False
+        lvalue = stmt.lvalues[0]
+        return (isinstance(lvalue, NameExpr)
+                and lvalue.kind == LDEF
+                and isinstance(lvalue.node, Var))
+    return False
+
+
+def is_trivial_handler(var: Optional[NameExpr], body: Block) -> bool:
+    """Does an except block not need access to the exception being handled?
+
+    Exceptions raised within an except block get the handled exception as
+    the context, so only blocks that can't raise qualify.
+    """
+    return (var is None
+            and not body.is_unreachable
+            and all(is_trivial_handler_stmt(stmt) for stmt in body.body))
+
+
 def transform_try_except_stmt(builder: IRBuilder, t: TryStmt) -> None:
     def body() -> None:
         builder.accept(t.body)
@@ -370,9 +483,15 @@ def transform_try_except_stmt(builder: IRBuilder, t: TryStmt) -> None:
     def make_handler(body: Block) -> GenFunc:
         return lambda: builder.accept(body)
 
+    else_body = (lambda: builder.accept(t.else_body)) if t.else_body else None
+    if all(is_trivial_handler(var, body) for var, body in zip(t.vars, t.handlers)):
+        transform_try_except_without_exc_info(
+            builder, body,
+            [(type, make_handler(body)) for type, body in zip(t.types, t.handlers)],
+            else_body, t.line)
+        return
     handlers = [(type, var, make_handler(body))
                 for type, var, body in zip(t.types, t.vars, t.handlers)]
-    else_body = (lambda: builder.accept(t.else_body)) if t.else_body else None
     transform_try_except(builder, body, handlers, else_body, t.line)
 
 
@@ -67,6 +67,16 @@ typedef struct tuple_T4CIOO {
 static tuple_T4CIOO tuple_undefined_T4CIOO = { 2, CPY_INT_TAG, NULL, NULL };
 #endif
 
+// Return tuple for batched dictionary iteration.
+#ifndef MYPYC_DECLARED_tuple_T2II
+#define MYPYC_DECLARED_tuple_T2II
+typedef struct tuple_T2II {
+    CPyTagged f0;  // Number of objects in the batch
+    CPyTagged f1;  // Last dict offset
+} tuple_T2II;
+static tuple_T2II tuple_undefined_T2II = { CPY_INT_TAG, CPY_INT_TAG };
+#endif
+
 
 // Native object operations
 
@@ -94,6 +104,42 @@ static inline size_t CPy_FindAttrOffset(PyTypeObject *trait, CPyVTableItem *vtab
     }
 }
 
+// A monomorphic cache for the trait lookups at a single call site. It
+// remembers the vtable of the last receiver and the (trait, subvtable,
+// offset table) entry found for it, so that a call site that keeps seeing
+// the same class doesn't pay for a scan that grows with the number of
+// traits the class implements.
+typedef struct CPyTraitCache {
+    CPyVTableItem *vtable;
+    CPyVTableItem *entry;
+} CPyTraitCache;
+
+static inline CPyVTableItem *CPy_FindTraitEntryCached(PyTypeObject *trait, CPyVTableItem *vtable,
+                                                      CPyTraitCache *cache) {
+    if (likely(cache->vtable == vtable)) {
+        return cache->entry;
+    }
+    int i;
+    for (i = -3; ; i -= 3) {
+        if ((PyTypeObject *)vtable[i] == trait) {
+            break;
+        }
+    }
+    cache->entry = &vtable[i];
+    cache->vtable = vtable;
+    return &vtable[i];
+}
+
+static inline CPyVTableItem *CPy_FindTraitVtableCached(PyTypeObject *trait, CPyVTableItem *vtable,
+                                                       CPyTraitCache *cache) {
+    return (CPyVTableItem *)CPy_FindTraitEntryCached(trait, vtable, cache)[1];
+}
+
+static inline size_t CPy_FindAttrOffsetCached(PyTypeObject *trait, CPyVTableItem *vtable,
+                                              size_t index, CPyTraitCache *cache) {
+    return ((size_t *)CPy_FindTraitEntryCached(trait, vtable, cache)[2])[index];
+}
+
 // Get attribute value using vtable (may return an undefined value)
 #define CPY_GET_ATTR(obj, type, vtable_index, object_type, attr_type)    \
     ((attr_type (*)(object_type *))((object_type *)obj)->vtable[vtable_index])((object_type *)obj)
@@ -101,6 +147,9 @@ static inline size_t CPy_FindAttrOffset(PyTypeObject *trait, CPyVTableItem *vtab
 #define CPY_GET_ATTR_TRAIT(obj, trait, vtable_index, object_type, attr_type)   \
     ((attr_type (*)(object_type *))(CPy_FindTraitVtable(trait, ((object_type *)obj)->vtable))[vtable_index])((object_type *)obj)
 
+#define CPY_GET_ATTR_TRAIT_CACHED(obj, trait, vtable_index, object_type, attr_type, cache) \
+    ((attr_type (*)(object_type *))(CPy_FindTraitVtableCached(trait, ((object_type *)obj)->vtable, cache))[vtable_index])((object_type *)obj)
+
 // Set attribute value using vtable
 #define CPY_SET_ATTR(obj, type, vtable_index, value, object_type, attr_type) \
     ((bool (*)(object_type *, attr_type))((object_type *)obj)->vtable[vtable_index])( \
@@ -110,23 +159,43 @@ static inline size_t CPy_FindAttrOffset(PyTypeObject *trait, CPyVTableItem *vtab
     ((bool (*)(object_type *, attr_type))(CPy_FindTraitVtable(trait, ((object_type *)obj)->vtable))[vtable_index])( \
         (object_type *)obj, value)
 
+#define CPY_SET_ATTR_TRAIT_CACHED(obj, trait, vtable_index, value, object_type, attr_type, cache) \
+    ((bool (*)(object_type *, attr_type))(CPy_FindTraitVtableCached(trait, ((object_type *)obj)->vtable, cache))[vtable_index])( \
+        (object_type *)obj, value)
+
 #define CPY_GET_METHOD(obj, type, vtable_index, object_type, method_type) \
     ((method_type)(((object_type *)obj)->vtable[vtable_index]))
 
 #define CPY_GET_METHOD_TRAIT(obj, trait, vtable_index, object_type, method_type) \
     ((method_type)(CPy_FindTraitVtable(trait, ((object_type *)obj)->vtable)[vtable_index]))
 
+#define CPY_GET_METHOD_TRAIT_CACHED(obj, trait, vtable_index, object_type, method_type, cache) \
+    ((method_type)(CPy_FindTraitVtableCached(trait, ((object_type *)obj)->vtable, cache)[vtable_index]))
+
 
 // Int operations
 
 
+// Counters for the optional boxed int cache (see MYPYC_INT_CACHE in int_ops.c).
+// Each miss allocates a new object; an eviction is a miss that replaced
+// another cached value. These are always zero if the cache is disabled.
+typedef struct CPyIntCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} CPyIntCacheStats;
+
 CPyTagged CPyTagged_FromSsize_t(Py_ssize_t value);
 CPyTagged CPyTagged_FromObject(PyObject *object);
 CPyTagged CPyTagged_StealFromObject(PyObject *object);
 CPyTagged CPyTagged_BorrowFromObject(PyObject *object);
 PyObject *CPyTagged_AsObject(CPyTagged x);
 PyObject *CPyTagged_StealAsObject(CPyTagged x);
+void CPyTagged_GetBoxCacheStats(CPyIntCacheStats *stats);
+void CPyTagged_ClearBoxCache(void);
 Py_ssize_t CPyTagged_AsSsize_t(CPyTagged x);
+Py_hash_t CPyTagged_AsHashValue(CPyTagged x);
+Py_ssize_t CPyTagged_AsLenValue(CPyTagged x);
 void CPyTagged_IncRef(CPyTagged x);
 void CPyTagged_DecRef(CPyTagged x);
 void CPyTagged_XDecRef(CPyTagged x);
@@ -145,8 +214,11 @@ CPyTagged CPyTagged_Lshift(CPyTagged left, CPyTagged right);
 bool CPyTagged_IsEq_(CPyTagged left, CPyTagged right);
 bool CPyTagged_IsLt_(CPyTagged left, CPyTagged right);
 PyObject *CPyTagged_Str(CPyTagged n);
-PyObject *CPyLong_FromStrWithBase(PyObject *o, CPyTagged base);
-PyObject *CPyLong_FromStr(PyObject *o);
+PyObject *CPyTagged_Hex(CPyTagged n);
+int CPy_FormatSsize_t(char *out, Py_ssize_t n);
+int CPy_FormatSsize_tHex(char *out, Py_ssize_t n);
+CPyTagged CPyTagged_FromStrWithBase(PyObject *o, CPyTagged base);
+CPyTagged CPyTagged_FromStr(PyObject *o);
 PyObject *CPyLong_FromFloat(PyObject *o);
 PyObject *CPyBool_Str(bool b);
 
@@ -190,7 +262,116 @@ static inline bool CPyTagged_IsMultiplyOverflow(CPyTagged left, CPyTagged right)
 }
 
 static inline bool CPyTagged_MaybeFloorDivideFault(CPyTagged left, CPyTagged right) {
-    return right == 0 || left == -((size_t)1 << (CPY_INT_BITS-1));
+    // Dividing the most negative short int by -1 is the only case where the
+    // result doesn't fit (-1 is represented as -2 since the values are tagged).
+    return right == 0 || (left == -((size_t)1 << (CPY_INT_BITS-1)) && right == (CPyTagged)-2);
+}
+
+
+// Exact overflow-checked arithmetic on short tagged ints
+//
+// Each of these takes two short ints and stores the (tagged) result in *result.
+// They return true if the result doesn't fit in a short int, in which case the
+// caller must fall back to a boxed operation and *result is undefined. Unlike
+// the CPyTagged_Is*Overflow checks above, these never report an overflow
+// unless the result really needs a long int.
+
+static inline bool CPyTagged_ShortAddOverflow(CPyTagged left, CPyTagged right,
+                                              CPyTagged *result) {
+#ifdef CPY_HAVE_OVERFLOW_BUILTINS
+    // Tagging is just a shift, so the tagged sum overflows exactly when the
+    // untagged sum doesn't fit in a short int.
+    Py_ssize_t sum;
+    bool overflow = __builtin_add_overflow((Py_ssize_t)left, (Py_ssize_t)right, &sum);
+    *result = (CPyTagged)sum;
+    return overflow;
+#else
+    CPyTagged sum = left + right;
+    *result = sum;
+    return CPyTagged_IsAddOverflow(sum, left, right);
+#endif
+}
+
+static inline bool CPyTagged_ShortSubtractOverflow(CPyTagged left, CPyTagged right,
+                                                   CPyTagged *result) {
+#ifdef CPY_HAVE_OVERFLOW_BUILTINS
+    Py_ssize_t diff;
+    bool overflow = __builtin_sub_overflow((Py_ssize_t)left, (Py_ssize_t)right, &diff);
+    *result = (CPyTagged)diff;
+    return overflow;
+#else
+    CPyTagged diff = left - right;
+    *result = diff;
+    return CPyTagged_IsSubtractOverflow(diff, left, right);
+#endif
+}
+
+static inline bool CPyTagged_ShortMultiplyOverflow(CPyTagged left, CPyTagged right,
+                                                   CPyTagged *result) {
+    // Multiply the tagged left operand by the untagged right operand, which
+    // produces a tagged result directly.
+    Py_ssize_t a = (Py_ssize_t)left;
+    Py_ssize_t b = CPyTagged_ShortAsSsize_t(right);
+#if defined(CPY_HAVE_OVERFLOW_BUILTINS)
+    Py_ssize_t product;
+    bool overflow = __builtin_mul_overflow(a, b, &product);
+    *result = (CPyTagged)product;
+    return overflow;
+#elif defined(CPY_HAVE_INT128)
+    __int128 product = (__int128)a * b;
+    *result = (CPyTagged)(Py_ssize_t)product;
+    return product != (Py_ssize_t)product;
+#else
+    if (!CPyTagged_IsMultiplyOverflow(left, right)) {
+        // Both operands are small and non-negative, so this can't overflow
+        *result = (CPyTagged)(a * b);
+        return false;
+    }
+    // Portable exact check (used on MSVC). Avoid the undefined behavior in
+    // signed overflow by checking the bounds before multiplying.
+    if (a == 0 || b == 0) {
+        *result = 0;
+        return false;
+    }
+    if (a > 0) {
+        if (b > 0 ? a > PY_SSIZE_T_MAX / b : b < PY_SSIZE_T_MIN / a) {
+            return true;
+        }
+    } else {
+        if (b > 0 ? a < PY_SSIZE_T_MIN / b : b < PY_SSIZE_T_MAX / a) {
+            return true;
+        }
+    }
+    *result = (CPyTagged)(a * b);
+    return false;
+#endif
+}
+
+static inline bool CPyTagged_ShortLshiftOverflow(CPyTagged left, Py_ssize_t shift,
+                                                 CPyTagged *result) {
+    // The shift count must be in range 0 <= shift < CPY_INT_BITS.
+    // Shift as unsigned to avoid undefined behavior with negative values.
+    Py_ssize_t shifted = (Py_ssize_t)(left << shift);
+    *result = (CPyTagged)shifted;
+    return (shifted >> shift) != (Py_ssize_t)left;
+}
+
+static inline bool CPyTagged_ShortFloorDivideOverflow(CPyTagged left, CPyTagged right,
+                                                      CPyTagged *result) {
+    // Division by zero is reported as an overflow so that the caller falls
+    // back to the generic operation, which raises ZeroDivisionError.
+    if (unlikely(CPyTagged_MaybeFloorDivideFault(left, right))) {
+        return true;
+    }
+    Py_ssize_t x = CPyTagged_ShortAsSsize_t(left);
+    Py_ssize_t y = CPyTagged_ShortAsSsize_t(right);
+    Py_ssize_t quotient = x / y;
+    if ((x < 0) != (y < 0) && quotient * y != x) {
+        // Round down
+        quotient--;
+    }
+    *result = (CPyTagged)quotient << 1;
+    return false;
 }
 
 static inline bool CPyTagged_MaybeRemainderFault(CPyTagged left, CPyTagged right) {
@@ -250,6 +431,177 @@ static inline bool CPyTagged_IsLe(CPyTagged left, CPyTagged right) {
 }
 
 
+// Operations in functions that run without the GIL (see mypyc.transform.nogil)
+//
+// A nogil function checks that its int arguments are short, releases the GIL
+// with CPy_NoGIL_Enter and then only uses the operations below (and plain C
+// arithmetic) until it reacquires the GIL. All ints stay short: instead of
+// falling back to a long int or raising an exception, an operation stores one
+// of the CPY_NOGIL_* error codes in *error and returns an error value.
+// CPy_NoGIL_Raise then reacquires the GIL and raises the matching exception.
+
+#define CPY_NOGIL_OVERFLOW 1
+#define CPY_NOGIL_ZERO_DIVISION 2
+#define CPY_NOGIL_NEGATIVE_SHIFT 3
+#define CPY_NOGIL_UNDEFINED_ATTR 4
+
+char CPy_NoGIL_CheckInt(CPyTagged x);
+char CPy_NoGIL_Raise(PyThreadState *tstate, int error);
+
+static inline PyThreadState *CPy_NoGIL_Enter(void) {
+    return PyEval_SaveThread();
+}
+
+static inline void CPy_NoGIL_Exit(PyThreadState *tstate) {
+    PyEval_RestoreThread(tstate);
+}
+
+static inline CPyTagged CPyTagged_NoGIL_Fail(int *error, int code) {
+    *error = code;
+    return CPY_INT_TAG;
+}
+
+static inline CPyTagged CPyTagged_NoGIL_Add(CPyTagged left, CPyTagged right, int *error) {
+    CPyTagged result;
+    if (unlikely(CPyTagged_ShortAddOverflow(left, right, &result))) {
+        return CPyTagged_NoGIL_Fail(error, CPY_NOGIL_OVERFLOW);
+    }
+    return result;
+}
+
+static inline CPyTagged CPyTagged_NoGIL_Subtract(CPyTagged left, CPyTagged right, int *error) {
+    CPyTagged result;
+    if (unlikely(CPyTagged_ShortSubtractOverflow(left, right, &result))) {
+        return CPyTagged_NoGIL_Fail(error, CPY_NOGIL_OVERFLOW);
+    }
+    return result;
+}
+
+static inline CPyTagged CPyTagged_NoGIL_Multiply(CPyTagged left, CPyTagged right, int *error) {
+    CPyTagged result;
+    if (unlikely(CPyTagged_ShortMultiplyOverflow(left, right, &result))) {
+        return CPyTagged_NoGIL_Fail(error, CPY_NOGIL_OVERFLOW);
+    }
+    return result;
+}
+
+static inline CPyTagged CPyTagged_NoGIL_FloorDivide(CPyTagged left, CPyTagged right,
+                                                    int *error) {
+    CPyTagged result;
+    if (unlikely(right == 0)) {
+        return CPyTagged_NoGIL_Fail(error, CPY_NOGIL_ZERO_DIVISION);
+    } else if (unlikely(CPyTagged_ShortFloorDivideOverflow(left, right, &result))) {
+        return CPyTagged_NoGIL_Fail(error, CPY_NOGIL_OVERFLOW);
+    }
+    return result;
+}
+
+static inline CPyTagged CPyTagged_NoGIL_Remainder(CPyTagged left, CPyTagged right,
+                                                  int *error) {
+    if (unlikely(CPyTagged_MaybeRemainderFault(left, right))) {
+        return CPyTagged_NoGIL_Fail(error, CPY_NOGIL_ZERO_DIVISION);
+    }
+    Py_ssize_t result = (Py_ssize_t)left % (Py_ssize_t)right;
+    if (((Py_ssize_t)right < 0) != ((Py_ssize_t)left < 0) && result != 0) {
+        result += right;
+    }
+    return result;
+}
+
+static inline CPyTagged CPyTagged_NoGIL_Rshift(CPyTagged left, CPyTagged right, int *error) {
+    if (unlikely((Py_ssize_t)right < 0)) {
+        return CPyTagged_NoGIL_Fail(error, CPY_NOGIL_NEGATIVE_SHIFT);
+    }
+    Py_ssize_t count = CPyTagged_ShortAsSsize_t(right);
+    if (unlikely(count >= (Py_ssize_t)CPY_INT_BITS)) {
+        return (Py_ssize_t)left >= 0 ? 0 : CPyTagged_ShortFromInt(-1);
+    }
+    return ((Py_ssize_t)left >> count) & ~CPY_INT_TAG;
+}
+
+static inline CPyTagged CPyTagged_NoGIL_Lshift(CPyTagged left, CPyTagged right, int *error) {
+    CPyTagged result;
+    if (unlikely((Py_ssize_t)right < 0)) {
+        return CPyTagged_NoGIL_Fail(error, CPY_NOGIL_NEGATIVE_SHIFT);
+    } else if (left == 0) {
+        return 0;
+    } else if (unlikely(right >= CPY_INT_BITS * 2
+                        || CPyTagged_ShortLshiftOverflow(
+                            left, CPyTagged_ShortAsSsize_t(right), &result))) {
+        return CPyTagged_NoGIL_Fail(error, CPY_NOGIL_OVERFLOW);
+    }
+    return result;
+}
+
+static inline CPyTagged CPyTagged_NoGIL_Negate(CPyTagged num, int *error) {
+    // Only the most negative short int can't be negated
+    if (unlikely(num == (CPyTagged)((Py_ssize_t)1 << (CPY_INT_BITS - 1)))) {
+        return CPyTagged_NoGIL_Fail(error, CPY_NOGIL_OVERFLOW);
+    }
+    return -num;
+}
+
+static inline CPyTagged CPyTagged_NoGIL_Invert(CPyTagged num) {
+    return ~num & ~CPY_INT_TAG;
+}
+
+// Check a borrowed int attribute value, which may be undefined or a long int
+static inline CPyTagged CPyTagged_NoGIL_CheckAttr(CPyTagged x, int *error) {
+    if (likely(CPyTagged_CheckShort(x))) {
+        return x;
+    }
+    return CPyTagged_NoGIL_Fail(
+        error, x == CPY_INT_TAG ? CPY_NOGIL_UNDEFINED_ATTR : CPY_NOGIL_OVERFLOW);
+}
+
+static inline char CPyBool_NoGIL_CheckAttr(char x, int *error) {
+    if (unlikely(x == 2)) {
+        *error = CPY_NOGIL_UNDEFINED_ATTR;
+    }
+    return x;
+}
+
+
+// Float operations
+
+// Unboxed floats are plain C doubles, so +, -, * and comparisons are
+// just C operators. Functions that can fail set an exception and return
+// CPY_FLOAT_ERROR, which callers must disambiguate with PyErr_Occurred().
+
+#define CPY_FLOAT_ERROR -113.0
+
+double CPyFloat_FromTagged(CPyTagged x);
+double CPyFloat_FromObject(PyObject *o);
+CPyTagged CPyTagged_FromFloat(double x);
+double CPyFloat_TrueDivide(double x, double y);
+double CPyFloat_FloorDivide(double x, double y);
+double CPyFloat_Remainder(double x, double y);
+double CPyFloat_Sqrt(double x);
+double CPyFloat_Exp(double x);
+double CPyFloat_Log(double x);
+double CPyFloat_Sin(double x);
+double CPyFloat_Cos(double x);
+double CPyFloat_Tan(double x);
+CPyTagged CPyFloat_Floor(double x);
+CPyTagged CPyFloat_Ceil(double x);
+bool CPyFloat_IsEqTagged_(double x, CPyTagged y);
+
+static inline PyObject *CPyFloat_AsObject(double x) {
+    return PyFloat_FromDouble(x);
+}
+
+static inline bool CPyFloat_IsEqTagged(double x, CPyTagged y) {
+    if (likely(CPyTagged_CheckShort(y))) {
+        Py_ssize_t value = CPyTagged_ShortAsSsize_t(y);
+        // Doubles represent integers up to 2**53 exactly
+        if ((int64_t)value >= -((int64_t)1 << 53) && (int64_t)value <= ((int64_t)1 << 53)) {
+            return x == (double)value;
+        }
+    }
+    return CPyFloat_IsEqTagged_(x, y);
+}
+
+
 // Generic operations (that work with arbitrary types)
 
 
@@ -268,6 +620,25 @@ static void CPy_XDecRef(PyObject *p) {
     CPy_XDECREF(p);
 }
 
+// Native integer variants of hash() and id(). These return a plain
+// Py_hash_t/Py_ssize_t instead of a tagged int. CPyObject_HashNative returns
+// -1 on error (hash values are never -1 otherwise).
+
+static inline Py_hash_t CPyObject_HashNative(PyObject *o) {
+    if (PyUnicode_CheckExact(o)) {
+        // Skip the indirect call if the hash is already cached
+        Py_hash_t h = ((PyASCIIObject *)o)->hash;
+        if (h != -1) {
+            return h;
+        }
+    }
+    return PyObject_Hash(o);
+}
+
+static inline Py_ssize_t CPyObject_IdNative(PyObject *o) {
+    return (Py_ssize_t)o;
+}
+
 static inline CPyTagged CPyObject_Size(PyObject *obj) {
     Py_ssize_t s = PyObject_Size(obj);
     if (s < 0) {
@@ -281,38 +652,95 @@ static inline CPyTagged CPyObject_Size(PyObject *obj) {
     }
 }
 
-#ifdef MYPYC_LOG_GETATTR
-static void CPy_LogGetAttr(const char *method, PyObject *obj, PyObject *attr) {
-    PyObject *module = PyImport_ImportModule("getattr_hook");
-    if (module) {
-        PyObject *res = PyObject_CallMethod(module, method, "OO", obj, attr);
-        Py_XDECREF(res);
-        Py_DECREF(module);
+// Per-call-site cache for attribute lookups and dict lookups with a
+// constant key (see LoadInlineCache in mypyc.ir.ops). The owner is a type
+// or a dict, which is compared together with its version tag. A matching
+// version means that the owner hasn't been modified since the lookup and
+// still holds the cached value, so the cache doesn't own any references.
+typedef struct {
+    void *owner;
+    uint64_t version;
+    PyObject *value;
+    int kind;
+} CPyInlineCache;
+
+// Attribute access profiling, compiled in if MYPYC_PROFILE_ATTRS is defined
+// (see misc_ops.c). Generic attribute lookups and method calls are counted
+// per (call site, receiver type, attribute name). Call sites are identified
+// by their inline cache, and lookups without one share a NULL site. Only
+// every Nth access is recorded, so the fast path is a countdown.
+#ifdef MYPYC_PROFILE_ATTRS
+extern int CPyAttrProfile_Countdown;
+void CPyAttrProfile_RecordSlow(CPyInlineCache *site, PyObject *obj, PyObject *attr);
+int CPyAttrProfile_Register(CPyInlineCache *caches, const char * const *names,
+                            Py_ssize_t num);
+PyObject *CPyAttrProfile_Get(void);
+void CPyAttrProfile_Reset(void);
+
+static inline void CPyAttrProfile_Record(CPyInlineCache *site, PyObject *obj, PyObject *attr) {
+    if (unlikely(--CPyAttrProfile_Countdown <= 0)) {
+        CPyAttrProfile_RecordSlow(site, obj, attr);
     }
-    PyErr_Clear();
 }
 #else
-#define CPy_LogGetAttr(method, obj, attr) (void)0
+#define CPyAttrProfile_Record(site, obj, attr) (void)0
 #endif
 
-// Intercept a method call and log it. This needs to be a macro
-// because there is no API that accepts va_args for making a
-// call. Worse, it needs to use the comma operator to return the right
-// value.
+// Generic attribute lookup and method call without an inline cache. These
+// need to be macros because there is no API that accepts va_args for
+// making a call, so they use the comma operator to return the right value.
 #define CPyObject_CallMethodObjArgs(obj, attr, ...)             \
-    (CPy_LogGetAttr("log_method", (obj), (attr)),               \
+    (CPyAttrProfile_Record(NULL, (obj), (attr)),                \
      PyObject_CallMethodObjArgs((obj), (attr), __VA_ARGS__))
 
-// This one is a macro for consistency with the above, I guess.
 #define CPyObject_GetAttr(obj, attr)                       \
-    (CPy_LogGetAttr("log", (obj), (attr)),                 \
+    (CPyAttrProfile_Record(NULL, (obj), (attr)),           \
      PyObject_GetAttr((obj), (attr)))
 
 CPyTagged CPyObject_Hash(PyObject *o);
 PyObject *CPyObject_GetAttr3(PyObject *v, PyObject *name, PyObject *defl);
+int CPyObject_HasAttr(PyObject *v, PyObject *name);
+PyObject *CPyObject_GetAttrCached(PyObject *obj, PyObject *name, CPyInlineCache *cache);
+PyObject *CPyObject_CallMethodCached(PyObject *obj, PyObject *name, CPyInlineCache *cache, ...);
+#if PY_MAJOR_VERSION >= 3 && PY_MINOR_VERSION >= 9
+PyObject *CPyObject_VectorcallMethodCached(PyObject *name, PyObject *const *args, size_t nargsf,
+                                           PyObject *kwnames, CPyInlineCache *cache);
+#endif
 PyObject *CPyIter_Next(PyObject *iter);
 PyObject *CPyNumber_Power(PyObject *base, PyObject *index);
 PyObject *CPyObject_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end);
+PyObject *CPyObject_GetSliceStep(PyObject *obj, CPyTagged start, CPyTagged end, CPyTagged step);
+CPyTagged CPySequence_SliceIndex(PyObject *seq, CPyTagged index, CPyTagged step);
+
+// Clamp a slice bound to a sequence of the given length, like
+// PySlice_AdjustIndices(). A long int bound is always outside the sequence,
+// so it is clamped to the nearest end instead of being boxed.
+static inline Py_ssize_t CPySlice_AdjustIndex(CPyTagged index, Py_ssize_t length,
+                                              Py_ssize_t step) {
+    Py_ssize_t n;
+    if (likely(CPyTagged_CheckShort(index))) {
+        n = CPyTagged_ShortAsSsize_t(index);
+    } else {
+        n = Py_SIZE(CPyTagged_LongAsObject(index)) < 0 ? -length - 1 : length;
+    }
+    if (n < 0) {
+        n += length;
+        if (n < 0) {
+            n = step < 0 ? -1 : 0;
+        }
+    } else if (n >= length) {
+        n = step < 0 ? length - 1 : length;
+    }
+    return n;
+}
+
+// Return the number of items in a slice with adjusted bounds.
+static inline Py_ssize_t CPySlice_Length(Py_ssize_t start, Py_ssize_t stop, Py_ssize_t step) {
+    if (step < 0) {
+        return stop < start ? (start - stop - 1) / -step + 1 : 0;
+    }
+    return start < stop ? (stop - start - 1) / step + 1 : 0;
+}
 
 
 // List operations
@@ -321,6 +749,9 @@ PyObject *CPyObject_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end);
 PyObject *CPyList_GetItem(PyObject *list, CPyTagged index);
 PyObject *CPyList_GetItemUnsafe(PyObject *list, CPyTagged index);
 PyObject *CPyList_GetItemShort(PyObject *list, CPyTagged index);
+PyObject *CPyList_GetItemBorrow(PyObject *list, CPyTagged index);
+PyObject *CPyList_GetItemUnsafeBorrow(PyObject *list, CPyTagged index);
+PyObject *CPyList_GetItemShortBorrow(PyObject *list, CPyTagged index);
 bool CPyList_SetItem(PyObject *list, CPyTagged index, PyObject *value);
 bool CPyList_SetItemUnsafe(PyObject *list, CPyTagged index, PyObject *value);
 PyObject *CPyList_PopLast(PyObject *obj);
@@ -329,22 +760,62 @@ CPyTagged CPyList_Count(PyObject *obj, PyObject *value);
 int CPyList_Insert(PyObject *list, CPyTagged index, PyObject *value);
 PyObject *CPyList_Extend(PyObject *o1, PyObject *o2);
 int CPyList_Remove(PyObject *list, PyObject *obj);
+int CPyList_Contains(PyObject *list, PyObject *obj);
 CPyTagged CPyList_Index(PyObject *list, PyObject *obj);
+int CPyList_Sort(PyObject *list);
+int CPyList_SortKey(PyObject *list, PyObject *key, bool reverse);
+PyObject *CPyList_Sorted(PyObject *iterable, PyObject *key, bool reverse);
 PyObject *CPySequence_Multiply(PyObject *seq, CPyTagged t_size);
 PyObject *CPySequence_RMultiply(CPyTagged t_size, PyObject *seq);
 PyObject *CPyList_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end);
+PyObject *CPyList_GetSliceStep(PyObject *obj, CPyTagged start, CPyTagged end, CPyTagged step);
+PyObject *CPyList_NewPresized(Py_ssize_t capacity);
+bool CPyList_AppendStealSlow(PyObject *list, PyObject *value);
+void CPyList_ShrinkToFit(PyObject *list);
+
+// Append to a list created by CPyList_NewPresized, stealing a reference to
+// value. This only reallocates if the capacity hint was too small.
+static inline bool CPyList_AppendSteal(PyObject *list, PyObject *value) {
+    PyListObject *op = (PyListObject *)list;
+    Py_ssize_t n = Py_SIZE(op);
+    if (likely(n < op->allocated)) {
+        op->ob_item[n] = value;
+        Py_SIZE(op) = n + 1;
+        return true;
+    }
+    return CPyList_AppendStealSlow(list, value);
+}
+
+// Number of items in range(start, end), or 0 if it isn't cheap to compute.
+// This is only used as a capacity hint.
+static inline Py_ssize_t CPyTagged_RangeLengthHint(CPyTagged start, CPyTagged end) {
+    if (CPyTagged_CheckShort(start) && CPyTagged_CheckShort(end)
+            && (Py_ssize_t)end > (Py_ssize_t)start) {
+        return CPyTagged_ShortAsSsize_t(end) - CPyTagged_ShortAsSsize_t(start);
+    }
+    return 0;
+}
 
 
 // Dict operations
 
 
 PyObject *CPyDict_GetItem(PyObject *dict, PyObject *key);
+PyObject *CPyDict_GetItemCached(PyObject *dict, PyObject *key, CPyInlineCache *cache);
 int CPyDict_SetItem(PyObject *dict, PyObject *key, PyObject *value);
 PyObject *CPyDict_Get(PyObject *dict, PyObject *key, PyObject *fallback);
 PyObject *CPyDict_GetWithNone(PyObject *dict, PyObject *key);
 PyObject *CPyDict_SetDefault(PyObject *dict, PyObject *key, PyObject *value);
 PyObject *CPyDict_SetDefaultWithNone(PyObject *dict, PyObject *key);
-PyObject *CPyDict_Build(Py_ssize_t size, ...);
+PyObject *CPyDict_BuildArray(Py_ssize_t size, PyObject **items);
+PyObject *CPyDict_GetItemKnownHash(PyObject *dict, PyObject *key);
+PyObject *CPyDict_GetKnownHash(PyObject *dict, PyObject *key, PyObject *fallback);
+PyObject *CPyDict_GetWithNoneKnownHash(PyObject *dict, PyObject *key);
+int CPyDict_SetItemKnownHash(PyObject *dict, PyObject *key, PyObject *value);
+int CPyDict_ContainsKnownHash(PyObject *dict, PyObject *key);
+PyObject *CPyDict_SetDefaultKnownHash(PyObject *dict, PyObject *key, PyObject *value);
+PyObject *CPyDict_SetDefaultWithNoneKnownHash(PyObject *dict, PyObject *key);
+PyObject *CPyDict_FromTemplate(PyObject *keys, PyObject **values);
 int CPyDict_Update(PyObject *dict, PyObject *stuff);
 int CPyDict_UpdateInDisplay(PyObject *dict, PyObject *stuff);
 int CPyDict_UpdateFromAny(PyObject *dict, PyObject *stuff);
@@ -355,6 +826,9 @@ PyObject *CPyDict_ItemsView(PyObject *dict);
 PyObject *CPyDict_Keys(PyObject *dict);
 PyObject *CPyDict_Values(PyObject *dict);
 PyObject *CPyDict_Items(PyObject *dict);
+PyObject *CPyDict_ItemsFlat(PyObject *dict);
+Py_ssize_t CPyDict_ViewLen(PyObject *dict, int kind);
+int CPyDict_ViewContains(PyObject *dict, PyObject *item, int kind);
 char CPyDict_Clear(PyObject *dict);
 PyObject *CPyDict_Copy(PyObject *dict);
 PyObject *CPyDict_GetKeysIter(PyObject *dict);
@@ -364,10 +838,53 @@ tuple_T3CIO CPyDict_NextKey(PyObject *dict_or_iter, CPyTagged offset);
 tuple_T3CIO CPyDict_NextValue(PyObject *dict_or_iter, CPyTagged offset);
 tuple_T4CIOO CPyDict_NextItem(PyObject *dict_or_iter, CPyTagged offset);
 
+// Batched dict iteration. CPyDict_NextBatch writes up to n keys, values or
+// key/value pairs to buf, and returns the number of objects written (0 once
+// the dict is exhausted) together with the new dict offset.
+//
+// With CPY_DICT_BATCH_BORROWED the objects in buf are borrowed, and they are
+// only valid as long as the dict isn't modified, which the caller has to
+// check with CPyDict_CheckBatch before reading the next object. The iterator
+// must then come from CPyDict_GetBatchIter using the same kind. Otherwise
+// the caller owns the references.
+#define CPY_DICT_BATCH_KEYS 1
+#define CPY_DICT_BATCH_VALUES 2
+#define CPY_DICT_BATCH_ITEMS (CPY_DICT_BATCH_KEYS | CPY_DICT_BATCH_VALUES)
+#define CPY_DICT_BATCH_BORROWED 4
+
+PyObject *CPyDict_GetBatchIter(PyObject *dict, int kind);
+tuple_T2II CPyDict_NextBatch(PyObject *dict_or_iter, CPyTagged offset, PyObject **buf,
+                             Py_ssize_t n, int kind);
+
+static inline PyObject *CPyDict_BatchItem(PyObject **buf, CPyTagged index) {
+    return buf[CPyTagged_ShortAsSsize_t(index)];
+}
+
+bool CPyDict_CheckNativeSubclass(PyObject *dict);
+
+// Can we store and iterate over items like in an exact dict? This is true
+// for dict, defaultdict and Counter.
+static inline bool CPyDict_CheckNative(PyObject *dict) {
+    if (likely(PyDict_CheckExact(dict))) {
+        return true;
+    }
+    return PyDict_Check(dict) && CPyDict_CheckNativeSubclass(dict);
+}
+
+// The version tag changes whenever a dict is modified (new in Python 3.6).
+static inline uint64_t CPyDict_Version(PyObject *dict) {
+#if PY_MAJOR_VERSION >= 3 && PY_MINOR_VERSION >= 6
+    if (CPyDict_CheckNative(dict)) {
+        return ((PyDictObject *)dict)->ma_version_tag;
+    }
+#endif
+    return 0;
+}
+
 // Check that dictionary didn't change size during iteration.
 static inline char CPyDict_CheckSize(PyObject *dict, CPyTagged size) {
-    if (!PyDict_CheckExact(dict)) {
-        // Dict subclasses will be checked by Python runtime.
+    if (!CPyDict_CheckNative(dict)) {
+        // Other dict subclasses will be checked by Python runtime.
         return 1;
     }
     Py_ssize_t py_size = CPyTagged_AsSsize_t(size);
@@ -379,33 +896,108 @@ static inline char CPyDict_CheckSize(PyObject *dict, CPyTagged size) {
     return 1;
 }
 
+// Check a borrowed batch after the loop body. Like CPython, only a size change
+// is an error (-1). If some values were replaced, return 1: the remaining
+// borrowed items may be stale, so the caller must fetch them again starting
+// from CPyDict_BatchOffset. Otherwise return 0.
+static inline int CPyDict_CheckBatch(PyObject *dict, CPyTagged size, uint64_t version) {
+    if (unlikely(CPyDict_Version(dict) != version)) {
+        return CPyDict_CheckSize(dict, size) ? 1 : -1;
+    }
+#if PY_MAJOR_VERSION >= 3 && PY_MINOR_VERSION >= 6
+    return 0;
+#else
+    // No version tags, but batches hold a single item so a size check is enough
+    return CPyDict_CheckSize(dict, size) ? 0 : -1;
+#endif
+}
+
+CPyTagged CPyDict_BatchOffset(PyObject *dict_or_iter, CPyTagged offset, CPyTagged pos, int kind);
+
 
 // Str operations
 
 
+// Maximum length of a formatted Py_ssize_t, including the sign and a NUL
+#define CPY_MAX_INT_CHARS 22
+
+// Maximum number of pieces that CPyStr_Build accepts
+#define CPY_STR_BUILD_MAX_PIECES 32
+
+PyObject *CPyStr_FromChar(Py_UCS4 ch);
 PyObject *CPyStr_GetItem(PyObject *str, CPyTagged index);
+PyObject *CPyStr_GetItemUnsafe(PyObject *str, CPyTagged index);
+int CPyStr_IndexEqualsChar(PyObject *str, CPyTagged index, int32_t ch);
 PyObject *CPyStr_Split(PyObject *str, PyObject *sep, CPyTagged max_split);
+PyObject *CPyStr_SplitMax(PyObject *str, PyObject *sep, Py_ssize_t max_split);
 PyObject *CPyStr_Replace(PyObject *str, PyObject *old_substr, PyObject *new_substr, CPyTagged max_replace);
+PyObject *CPyStr_ReplaceMax(PyObject *str, PyObject *old_substr, PyObject *new_substr,
+                           Py_ssize_t max_replace);
+CPyTagged CPyStr_Find(PyObject *str, PyObject *sub);
+int CPyStr_Contains(PyObject *str, PyObject *sub);
+CPyTagged CPyStr_Count(PyObject *str, PyObject *sub);
 PyObject *CPyStr_Append(PyObject *o1, PyObject *o2);
 PyObject *CPyStr_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end);
+PyObject *CPyStr_GetSliceStep(PyObject *obj, CPyTagged start, CPyTagged end, CPyTagged step);
 bool CPyStr_Startswith(PyObject *self, PyObject *subobj);
 bool CPyStr_Endswith(PyObject *self, PyObject *subobj);
 bool CPyStr_IsTrue(PyObject *obj);
+PyObject *CPyStr_Build(Py_ssize_t n, uint32_t int_mask, ...);
+
+// Format a str as f"{s}" does. This is s itself, unless s is an instance of
+// a str subclass, which might override __format__.
+static inline PyObject *CPyStr_FormatSimple(PyObject *str) {
+    if (likely(PyUnicode_CheckExact(str))) {
+        Py_INCREF(str);
+        return str;
+    }
+    return PyObject_Format(str, NULL);
+}
+
+
+// Bytes operations
+
+
+// mypy promotes bytearray and memoryview to bytes
+#define CPyBytes_Check(o) (PyBytes_Check(o) || PyByteArray_Check(o) || PyMemoryView_Check(o))
+
+Py_ssize_t CPyBytes_Size(PyObject *obj);
+CPyTagged CPyBytes_GetItem(PyObject *obj, CPyTagged index);
+PyObject *CPyBytes_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end);
+PyObject *CPyBytes_Concat(PyObject *a, PyObject *b);
+PyObject *CPyBytes_Join(PyObject *sep, PyObject *iter);
+int CPyBytes_Startswith(PyObject *self, PyObject *prefix);
+int CPyBytes_Endswith(PyObject *self, PyObject *suffix);
+PyObject *CPyBytes_Decode(PyObject *obj, PyObject *encoding, PyObject *errors);
 
 
 // Set operations
 
 
 bool CPySet_Remove(PyObject *set, PyObject *key);
+PyObject *CPySet_GetIter(PyObject *set);
+tuple_T3CIO CPySet_Next(PyObject *set_or_iter, CPyTagged offset);
+char CPySet_CheckSize(PyObject *set, CPyTagged size);
+PyObject *CPySet_Union(PyObject *set, PyObject *other);
+PyObject *CPySet_InPlaceUnion(PyObject *set, PyObject *other);
+int CPySet_ContainsInt(PyObject *set, CPyTagged key);
 
 
 // Tuple operations
 
 
 PyObject *CPySequenceTuple_GetItem(PyObject *tuple, CPyTagged index);
+PyObject *CPySequenceTuple_GetItemBorrow(PyObject *tuple, CPyTagged index);
 PyObject *CPySequenceTuple_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end);
+PyObject *CPySequenceTuple_GetSliceStep(PyObject *obj, CPyTagged start, CPyTagged end,
+                                        CPyTagged step);
 bool CPySequenceTuple_SetItemUnsafe(PyObject *tuple, CPyTagged index, PyObject *value);
 
+// Get a borrowed item of a tuple, when the index is known to be in range
+static inline PyObject *CPySequenceTuple_GetItemUnsafeBorrow(PyObject *tuple, CPyTagged index) {
+    return PyTuple_GET_ITEM(tuple, CPyTagged_ShortAsSsize_t(index));
+}
+
 
 // Exception operations
 
@@ -454,12 +1046,18 @@ void CPyErr_SetObjectAndTraceback(PyObject *type, PyObject *value, PyObject *tra
 tuple_T3OOO CPy_CatchError(void);
 void CPy_RestoreExcInfo(tuple_T3OOO info);
 bool CPy_ExceptionMatches(PyObject *type);
+tuple_T3OOO CPy_FetchError(void);
+bool CPy_ErrorMatches(tuple_T3OOO err, PyObject *type);
+void CPy_RestoreError(tuple_T3OOO err);
+void CPy_ChainError(tuple_T3OOO err);
 PyObject *CPy_GetExcValue(void);
 tuple_T3OOO CPy_GetExcInfo(void);
 void _CPy_GetExcInfo(PyObject **p_type, PyObject **p_value, PyObject **p_traceback);
 void CPyError_OutOfMemory(void);
 void CPy_TypeError(const char *expected, PyObject *value);
 void CPy_AddTraceback(const char *filename, const char *funcname, int line, PyObject *globals);
+void CPy_AddTracebackCached(PyCodeObject **cache, const char *filename, const char *funcname,
+                            int line, PyObject *globals);
 
 
 // Misc operations
@@ -488,6 +1086,81 @@ typedef struct CPyArg_Parser {
     struct CPyArg_Parser *next;
 } CPyArg_Parser;
 
+// A type to create from a template, and the static that holds the type
+typedef struct CPyType_Template {
+    PyTypeObject **type;
+    PyTypeObject *template_;
+} CPyType_Template;
+
+// An entry in the table of module init functions exported by a shared
+// library. The table is terminated by an entry with a NULL name, and the
+// context of the capsule holding it is the number of other entries.
+// module_shim.tmpl mirrors this layout since shims don't include CPy.h.
+typedef struct CPyModule_InitEntry {
+    const char *name;
+    PyObject *(*init)(void);
+} CPyModule_InitEntry;
+
+// Kinds of literals, in the order they are stored in the array of literals
+// after None, False and True
+#define CPYLIT_STR 0
+#define CPYLIT_BYTES 1
+#define CPYLIT_INT 2
+#define CPYLIT_FLOAT 3
+#define CPYLIT_COMPLEX 4
+#define CPYLIT_TUPLE 5
+#define CPYLIT_FROZENSET 6
+
+// State used to create literals on demand (see CPyStatics_InitializeLazy)
+typedef struct CPyStatics_Table {
+    PyObject **statics;
+    const void **locations;  /* where each literal is described */
+    Py_ssize_t starts[CPYLIT_FROZENSET + 1];  /* index of first literal of each kind */
+} CPyStatics_Table;
+
+// Kinds of named arguments that the descriptor based parser can check
+// (and unbox) by itself. Anything else is left to the caller as an object.
+#define CPYARG_OBJECT 0
+#define CPYARG_INT 1       /* unboxed into a borrowed tagged int */
+#define CPYARG_BOOL 2      /* unboxed into a char */
+#define CPYARG_STR 3
+#define CPYARG_LIST 4
+#define CPYARG_DICT 5
+#define CPYARG_INSTANCE 6  /* instance of the type stored in *type */
+
+typedef struct CPyArg_Type {
+    int kind;
+    PyTypeObject **type;   /* type of CPYARG_INSTANCE arguments */
+    const char *name;      /* expected type name used in error messages */
+} CPyArg_Type;
+
+// A parsed argument. Missing optional arguments are set to the error
+// value of the type: NULL, CPY_INT_TAG or 2.
+typedef union CPyArg_Slot {
+    PyObject *obj;
+    CPyTagged tagged;
+    char boolean;
+} CPyArg_Slot;
+
+// Argument parser descriptor with everything precomputed from the
+// signature at compile time, so no format string is interpreted at
+// call time. Arguments are stored into an array of slots in keyword
+// order, followed by *args and **kwargs if the function accepts them.
+typedef struct CPyArg_Descriptor {
+    const char * const *keywords;  /* names of named arguments */
+    const char *fname;     /* function name used in error messages */
+    int len;               /* number of named arguments */
+    int min;               /* minimal number of arguments */
+    int max;               /* maximal number of positional arguments */
+    int required_kwonly_start;  /* index of first required kwonly arg, or INT_MAX */
+    int has_star;          /* does the function accept *args? */
+    int has_star2;         /* does the function accept **kwargs? */
+    const CPyArg_Type *types;  /* types of named arguments, or NULL if all are objects */
+    PyObject *kwtuple;     /* tuple of interned keyword names, created lazily */
+    int *kwtable;          /* hash table of keyword indexes (plus one), created lazily */
+    size_t kwmask;         /* kwtable size minus one */
+} CPyArg_Descriptor;
+
 // mypy lets ints silently coerce to floats, so a mypyc runtime float
 // might be an int also
 static inline bool CPyFloat_Check(PyObject *o) {
@@ -504,13 +1177,58 @@ static inline PyObject *CPy_CalculateMetaclass(PyObject *type, PyObject *o) {
     return (PyObject *)_PyType_CalculateMetaclass((PyTypeObject *)type, o);
 }
 
+// Native generator and coroutine classes have a tp_as_async table with this
+// layout, which lets native code resume them without going through method
+// lookups or raising StopIteration. The send and throw functions return one
+// of the CPY_GEN_* codes below and store the yielded or returned value in
+// *result. On Python 3.10 and later the send function is also am_send.
+//
+// A type has this table only if its tp_iternext is CPyGen_IterNext.
+#define CPY_GEN_RETURN 0
+#define CPY_GEN_ERROR -1
+#define CPY_GEN_NEXT 1
+
+typedef int (*CPyGen_SendFunc)(PyObject *self, PyObject *arg, PyObject **result);
+typedef int (*CPyGen_ThrowFunc)(PyObject *self, PyObject *type, PyObject *value,
+                                PyObject *traceback, PyObject **result);
+
+typedef struct {
+    PyAsyncMethods base;
+    CPyGen_SendFunc send;
+    CPyGen_ThrowFunc throw_;
+} CPyAsyncMethods;
+
+PyObject *CPyGen_IterNext(PyObject *self);
+
+static inline CPyAsyncMethods *CPyGen_NativeMethods(PyObject *obj) {
+    if (Py_TYPE(obj)->tp_iternext == CPyGen_IterNext) {
+        return (CPyAsyncMethods *)Py_TYPE(obj)->tp_as_async;
+    }
+    return NULL;
+}
+
+// Convert the result of a generator helper call to a CPY_GEN_* code.
+// retval is the value stored by a return statement in the generator, if any.
+static inline int CPyGen_SendResult(PyObject *res, PyObject *retval, PyObject **result) {
+    if (res != NULL) {
+        *result = res;
+        return CPY_GEN_NEXT;
+    }
+    *result = retval;
+    return retval != NULL ? CPY_GEN_RETURN : CPY_GEN_ERROR;
+}
+
+void CPyGen_SetReturnValue(PyObject *value, PyObject **stop_iter_ptr);
 PyObject *CPy_GetCoro(PyObject *obj);
 PyObject *CPyIter_Send(PyObject *iter, PyObject *val);
+int CPyIter_SendStatus(PyObject *iter, PyObject *val, PyObject **result);
 int CPy_YieldFromErrorHandle(PyObject *iter, PyObject **outp);
 PyObject *CPy_FetchStopIterationValue(void);
 PyObject *CPyType_FromTemplate(PyObject *template_,
                                PyObject *orig_bases,
                                PyObject *modname);
+int CPyType_FromTemplates(const CPyType_Template *templates, Py_ssize_t num,
+                          PyObject *modname);
 PyObject *CPyType_FromTemplateWarpper(PyObject *template_,
                                       PyObject *orig_bases,
                                       PyObject *modname);
@@ -518,7 +1236,13 @@ int CPyDataclass_SleightOfHand(PyObject *dataclass_dec, PyObject *tp,
                                PyObject *dict, PyObject *annotations);
 PyObject *CPyPickle_SetState(PyObject *obj, PyObject *state);
 PyObject *CPyPickle_GetState(PyObject *obj);
+int CPyPickle_InitKeys(PyObject **keys, const char * const *names, Py_ssize_t count);
 CPyTagged CPyTagged_Id(PyObject *o);
+int CPyDeque_Append(PyObject *deque, PyObject *value);
+int CPyDeque_AppendLeft(PyObject *deque, PyObject *value);
+PyObject *CPyDeque_Pop(PyObject *deque);
+PyObject *CPyDeque_PopLeft(PyObject *deque);
+CPyTagged CPyDeque_Len(PyObject *deque);
 void CPyDebug_Print(const char *msg);
 void CPy_Init(void);
 int CPyArg_ParseTupleAndKeywords(PyObject *, PyObject *,
@@ -531,18 +1255,135 @@ int CPyArg_ParseStackAndKeywordsOneArg(PyObject *const *args, Py_ssize_t nargs,
                                        CPyArg_Parser *parser, ...);
 int CPyArg_ParseStackAndKeywordsSimple(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames,
                                        CPyArg_Parser *parser, ...);
+int CPyArg_ParseStackAndKeywordsSlots(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames,
+                                      CPyArg_Descriptor *desc, CPyArg_Slot *slots);
+
+int CPySequence_UnpackCountError(Py_ssize_t actual, Py_ssize_t expected);
+
+// Check that a list or a tuple has the expected number of items for unpacking
+static inline int CPySequence_CheckUnpackCount(PyObject *sequence, Py_ssize_t expected) {
+    Py_ssize_t actual = Py_SIZE(sequence);
+    if (unlikely(actual != expected)) {
+        return CPySequence_UnpackCountError(actual, expected);
+    }
+    return 0;
+}
 
-int CPySequence_CheckUnpackCount(PyObject *sequence, Py_ssize_t expected);
 int CPyStatics_Initialize(PyObject **statics,
                           const char * const *strings,
                           const char * const *bytestrings,
                           const char * const *ints,
                           const double *floats,
                           const double *complex_numbers,
-                          const int *tuples);
+                          const int *tuples,
+                          const int *frozensets);
+int CPyStatics_InitializeLazy(CPyStatics_Table *table,
+                              PyObject **statics,
+                              Py_ssize_t num_literals,
+                              const char * const *strings,
+                              const char * const *bytestrings,
+                              const char * const *ints,
+                              const double *floats,
+                              const double *complex_numbers,
+                              const int *tuples,
+                              const int *frozensets);
+PyObject *CPyStatics_Load(CPyStatics_Table *table, Py_ssize_t index);
+
+// Get the literal at index from the array of literals of the current group.
+// With MYPYC_LAZY_STATICS, literals are created on first use.
+static inline PyObject *CPyStatics_Get(CPyStatics_Table *table, Py_ssize_t index) {
+    PyObject *obj = table->statics[index];
+    if (unlikely(obj == NULL)) {
+        obj = CPyStatics_Load(table, index);
+    }
+    return obj;
+}
+
+#ifdef MYPYC_LAZY_STATICS
+#define CPyStatic(index) CPyStatics_Get(&CPyStatics_Lazy, index)
+#else
+#define CPyStatic(index) (CPyStatics[index])
+#endif
+
+// Import-time profiling (see MYPYC_PROFILE_IMPORT in misc_ops.c). The macros
+// time the code between them, and are no-ops unless profiling is compiled in.
+#ifdef MYPYC_PROFILE_IMPORT
+typedef struct CPyImportProfileMark {
+    int64_t start;          /* start time in nanoseconds, or -1 if not recording */
+    Py_ssize_t blocks;      /* number of allocated memory blocks at start */
+} CPyImportProfileMark;
+
+void CPyImportProfile_Start(CPyImportProfileMark *mark);
+void CPyImportProfile_End(CPyImportProfileMark *mark, const char *phase, const char *name);
+
+#define CPyImportProfile_START(mark) CPyImportProfileMark mark; CPyImportProfile_Start(&mark)
+#define CPyImportProfile_END(mark, phase, name) CPyImportProfile_End(&mark, phase, name)
+#else
+#define CPyImportProfile_START(mark)
+#define CPyImportProfile_END(mark, phase, name)
+#endif
+
+// Runtime statistics (see MYPYC_STATS in misc_ops.c). The counters
+// themselves are declared in mypyc_util.h.
+#ifdef MYPYC_STATS
+void CPyStats_Init(void);
+PyObject *CPyStats_Get(void);
+void CPyStats_Reset(void);
+#endif
+
+// Free lists for instances of native classes that opt in with
+// @mypyc_attr(free_list=True) (see misc_ops.c). These count how the
+// memory of such instances is recycled.
+typedef struct CPyFreeListStats {
+    size_t hits;        /* allocations served from a free list */
+    size_t misses;      /* allocations that went to tp_alloc */
+    size_t frees;       /* deallocations that kept the memory */
+    size_t releases;    /* deallocations that released it, since the lists were full */
+    size_t bytes;       /* memory currently kept in free lists */
+} CPyFreeListStats;
+
+PyObject *CPyFreeList_Alloc(PyTypeObject *type);
+void CPyFreeList_Free(PyObject *obj);
+void CPyFreeList_GetStats(CPyFreeListStats *stats);
+void CPyFreeList_Clear(void);
+
+// Receiver type profiling of native method call sites, emitted when
+// compiling with profile_dispatch (see CPyDispatchProfile_Register in
+// misc_ops.c). A site counts the first few receiver types it sees and
+// lumps the rest together.
+#define CPY_DISPATCH_PROFILE_TYPES 4
+
+typedef struct CPyDispatchSite {
+    PyTypeObject *types[CPY_DISPATCH_PROFILE_TYPES];  /* new references */
+    uint64_t counts[CPY_DISPATCH_PROFILE_TYPES];
+    uint64_t other;
+} CPyDispatchSite;
+
+int CPyDispatchProfile_Register(CPyDispatchSite *sites, const char * const *names,
+                                Py_ssize_t num);
+
+static inline void CPyDispatchProfile_Record(CPyDispatchSite *site, PyObject *obj) {
+    PyTypeObject *type = Py_TYPE(obj);
+    int i;
+    for (i = 0; i < CPY_DISPATCH_PROFILE_TYPES; i++) {
+        if (site->types[i] == type) {
+            site->counts[i]++;
+            return;
+        }
+        if (site->types[i] == NULL) {
+            Py_INCREF(type);
+            site->types[i] = type;
+            site->counts[i] = 1;
+            return;
+        }
+    }
+    site->other++;
+}
 
 #ifdef __cplusplus
 }
 #endif
 
+#include "native_int_ops.h"
+
 #endif // CPY_CPY_H
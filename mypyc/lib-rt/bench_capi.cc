@@ -0,0 +1,488 @@
+// Microbenchmarks for C runtime library primitives
+//
+// These are built by setup.py together with the unit tests, and run like this:
+//
+//     python3 -c "import bench_capi; bench_capi.run_benchmarks()"
+//
+// run_benchmarks(filter=None, min_time=0.05, repeat=5) prints one
+// "name<TAB>ns/op<TAB>allocs/op" line per benchmark and returns the results
+// as a list of (name, ns_per_op, allocs_per_op) tuples. Only benchmarks
+// whose name contains filter are run. The time is the best of repeat runs
+// that take at least min_time seconds each, which is much less noisy than
+// the mean. Allocations are counted in a separate run through counting
+// PyMem allocators, so counting doesn't affect the timings. Allocations
+// made through PyMem_Raw* aren't counted.
+
+#include <Python.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "CPy.h"
+
+static PyObject *moduleDict;
+
+static PyObject *eval(const char *expr) {
+    PyObject *dict = PyDict_New();
+    PyObject *result = PyRun_String(expr, Py_eval_input, moduleDict, dict);
+    Py_DECREF(dict);
+    if (result == NULL) {
+        PyErr_Print();
+        fprintf(stderr, "bench_capi: can't evaluate %s\n", expr);
+        abort();
+    }
+    return result;
+}
+
+// Results of tagged integer operations are stored here so that the
+// compiler can't optimize the operations away
+static volatile CPyTagged sink;
+
+// Timing
+
+typedef std::chrono::steady_clock Clock;
+
+static Clock::time_point bench_start_time;
+static double bench_elapsed;
+
+// Allocation counting (see start_counting_allocs)
+
+static PyMemAllocatorEx orig_mem_allocator, orig_obj_allocator;
+static uint64_t num_allocs;
+static uint64_t bench_start_allocs;
+static uint64_t bench_allocs;
+
+// Benchmarks call these around the loop they measure, so that setup and
+// cleanup aren't included in the results
+static void bench_start(void) {
+    bench_start_allocs = num_allocs;
+    bench_start_time = Clock::now();
+}
+
+static void bench_stop(void) {
+    bench_elapsed = std::chrono::duration<double>(Clock::now() - bench_start_time).count();
+    bench_allocs = num_allocs - bench_start_allocs;
+}
+
+// Run the statement that follows n times between bench_start() and
+// bench_stop(), with the iteration number in i. The outer loop runs once,
+// since run_once() sets bench_elapsed to a negative value.
+#define BENCH_LOOP(n) for (bench_start(); bench_elapsed < 0; bench_stop()) \
+        for (Py_ssize_t i = 0; i < (n); i++)
+
+static void *counting_malloc(void *ctx, size_t size) {
+    num_allocs++;
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    return alloc->malloc(alloc->ctx, size);
+}
+
+static void *counting_calloc(void *ctx, size_t nelem, size_t elsize) {
+    num_allocs++;
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    return alloc->calloc(alloc->ctx, nelem, elsize);
+}
+
+static void *counting_realloc(void *ctx, void *ptr, size_t new_size) {
+    // Growing a block in place is cheap, so only count new blocks
+    if (ptr == NULL) {
+        num_allocs++;
+    }
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    return alloc->realloc(alloc->ctx, ptr, new_size);
+}
+
+static void counting_free(void *ctx, void *ptr) {
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    alloc->free(alloc->ctx, ptr);
+}
+
+// The counting allocators delegate to the original ones, so blocks can be
+// freed with either
+static void start_counting_allocs(void) {
+    PyMemAllocatorEx mem = {&orig_mem_allocator, counting_malloc, counting_calloc,
+                            counting_realloc, counting_free};
+    PyMemAllocatorEx obj = {&orig_obj_allocator, counting_malloc, counting_calloc,
+                            counting_realloc, counting_free};
+    PyMem_GetAllocator(PYMEM_DOMAIN_MEM, &orig_mem_allocator);
+    PyMem_GetAllocator(PYMEM_DOMAIN_OBJ, &orig_obj_allocator);
+    PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &mem);
+    PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &obj);
+}
+
+static void stop_counting_allocs(void) {
+    PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &orig_mem_allocator);
+    PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &orig_obj_allocator);
+}
+
+// Tagged integer arithmetic
+
+static void bench_int_add_short(Py_ssize_t n) {
+    CPyTagged x = CPyTagged_ShortFromSsize_t(12345);
+    BENCH_LOOP(n) {
+        sink = CPyTagged_Add(x, CPyTagged_ShortFromSsize_t(i));
+    }
+}
+
+static void bench_int_multiply_short(Py_ssize_t n) {
+    CPyTagged x = CPyTagged_ShortFromSsize_t(12345);
+    BENCH_LOOP(n) {
+        sink = CPyTagged_Multiply(x, CPyTagged_ShortFromSsize_t(i));
+    }
+}
+
+static void bench_int_add_long(Py_ssize_t n) {
+    CPyTagged x = CPyTagged_FromObject(eval("2**70"));
+    CPyTagged y = CPyTagged_FromObject(eval("3**50"));
+    BENCH_LOOP(n) {
+        CPyTagged r = CPyTagged_Add(x, y);
+        CPyTagged_DecRef(r);
+    }
+    CPyTagged_DecRef(x);
+    CPyTagged_DecRef(y);
+}
+
+static void bench_int_compare_long(Py_ssize_t n) {
+    CPyTagged x = CPyTagged_FromObject(eval("2**70"));
+    CPyTagged y = CPyTagged_FromObject(eval("2**70 + 1"));
+    BENCH_LOOP(n) {
+        sink = CPyTagged_IsLt(x, y);
+    }
+    CPyTagged_DecRef(x);
+    CPyTagged_DecRef(y);
+}
+
+static void bench_int_box_short(Py_ssize_t n) {
+    BENCH_LOOP(n) {
+        PyObject *obj = CPyTagged_AsObject(CPyTagged_ShortFromSsize_t(i + 1000));
+        Py_DECREF(obj);
+    }
+}
+
+// Lists
+
+static void bench_list_get_item(Py_ssize_t n) {
+    PyObject *list = eval("list(range(100))");
+    BENCH_LOOP(n) {
+        PyObject *item = CPyList_GetItem(list, CPyTagged_ShortFromSsize_t(i % 100));
+        Py_DECREF(item);
+    }
+    Py_DECREF(list);
+}
+
+static void bench_list_set_item(Py_ssize_t n) {
+    PyObject *list = eval("list(range(100))");
+    PyObject *value = eval("'x'");
+    BENCH_LOOP(n) {
+        Py_INCREF(value);
+        CPyList_SetItem(list, CPyTagged_ShortFromSsize_t(i % 100), value);
+    }
+    Py_DECREF(list);
+    Py_DECREF(value);
+}
+
+static void bench_list_index(Py_ssize_t n) {
+    PyObject *list = eval("[str(i) for i in range(10)]");
+    PyObject *value = eval("str(9)");
+    BENCH_LOOP(n) {
+        sink = CPyList_Index(list, value);
+    }
+    Py_DECREF(list);
+    Py_DECREF(value);
+}
+
+static void bench_list_append(Py_ssize_t n) {
+    PyObject *value = eval("'x'");
+    BENCH_LOOP(n) {
+        PyObject *list = CPyList_NewPresized(4);
+        for (int j = 0; j < 4; j++) {
+            Py_INCREF(value);
+            CPyList_AppendSteal(list, value);
+        }
+        Py_DECREF(list);
+    }
+    Py_DECREF(value);
+}
+
+// Dicts
+
+static void bench_dict_get_item(Py_ssize_t n) {
+    PyObject *dict = eval("{str(i): i for i in range(100)}");
+    PyObject *key = eval("'50'");
+    BENCH_LOOP(n) {
+        PyObject *value = CPyDict_GetItem(dict, key);
+        Py_DECREF(value);
+    }
+    Py_DECREF(dict);
+    Py_DECREF(key);
+}
+
+// One op is a step of the iteration
+static void bench_dict_next_item(Py_ssize_t n) {
+    PyObject *dict = eval("{str(i): i for i in range(100)}");
+    CPyTagged offset = 0;
+    BENCH_LOOP(n) {
+        tuple_T4CIOO r = CPyDict_NextItem(dict, offset);
+        if (r.f0) {
+            offset = r.f1;
+        } else {
+            offset = 0;
+        }
+        Py_DECREF(r.f2);
+        Py_DECREF(r.f3);
+    }
+    Py_DECREF(dict);
+}
+
+static void bench_dict_build(Py_ssize_t n) {
+    PyObject *items[] = {eval("'a'"), eval("1"), eval("'b'"), eval("2"), eval("'c'"), eval("3")};
+    BENCH_LOOP(n) {
+        PyObject *dict = CPyDict_BuildArray(3, items);
+        Py_DECREF(dict);
+    }
+    for (size_t j = 0; j < sizeof(items) / sizeof(items[0]); j++) {
+        Py_DECREF(items[j]);
+    }
+}
+
+static void bench_dict_from_template(Py_ssize_t n) {
+    PyObject *keys = eval("('a', 'b', 'c')");
+    PyObject *values[] = {eval("1"), eval("2"), eval("3")};
+    BENCH_LOOP(n) {
+        PyObject *dict = CPyDict_FromTemplate(keys, values);
+        Py_DECREF(dict);
+    }
+    for (int j = 0; j < 3; j++) {
+        Py_DECREF(values[j]);
+    }
+    // The template cache keeps a reference to the keys
+    Py_DECREF(keys);
+}
+
+// Strings
+
+static void bench_str_get_item(Py_ssize_t n) {
+    PyObject *str = eval("'abcdefghij' * 10");
+    BENCH_LOOP(n) {
+        PyObject *item = CPyStr_GetItem(str, CPyTagged_ShortFromSsize_t(i % 100));
+        Py_DECREF(item);
+    }
+    Py_DECREF(str);
+}
+
+static void bench_str_slice(Py_ssize_t n) {
+    PyObject *str = eval("'abcdefghij' * 10");
+    CPyTagged start = CPyTagged_ShortFromSsize_t(10);
+    CPyTagged end = CPyTagged_ShortFromSsize_t(30);
+    BENCH_LOOP(n) {
+        PyObject *slice = CPyStr_GetSlice(str, start, end);
+        Py_DECREF(slice);
+    }
+    Py_DECREF(str);
+}
+
+static void bench_str_split(Py_ssize_t n) {
+    PyObject *str = eval("'alpha beta gamma delta'");
+    BENCH_LOOP(n) {
+        PyObject *parts = CPyStr_Split(str, NULL, CPyTagged_ShortFromSsize_t(-1));
+        Py_DECREF(parts);
+    }
+    Py_DECREF(str);
+}
+
+// Argument parsing, like in the wrapper of "def f(a, b, c=None)"
+
+static void bench_parse_args_positional(Py_ssize_t n) {
+    static const char * const kwlist[] = {"a", "b", "c", 0};
+    static CPyArg_Descriptor desc = {kwlist, "f", 3, 2, 3, INT_MAX, 0, 0};
+    PyObject *args[] = {eval("1"), eval("2")};
+    CPyArg_Slot slots[3];
+    BENCH_LOOP(n) {
+        sink = CPyArg_ParseStackAndKeywordsSlots(args, 2, NULL, &desc, slots);
+    }
+    Py_DECREF(args[0]);
+    Py_DECREF(args[1]);
+}
+
+static void bench_parse_args_keywords(Py_ssize_t n) {
+    static const char * const kwlist[] = {"a", "b", "c", 0};
+    static CPyArg_Descriptor desc = {kwlist, "f", 3, 2, 3, INT_MAX, 0, 0};
+    PyObject *args[] = {eval("1"), eval("2"), eval("3")};
+    PyObject *kwnames = eval("(__import__('sys').intern('c'), __import__('sys').intern('b'))");
+    CPyArg_Slot slots[3];
+    BENCH_LOOP(n) {
+        sink = CPyArg_ParseStackAndKeywordsSlots(args, 1, kwnames, &desc, slots);
+    }
+    for (int j = 0; j < 3; j++) {
+        Py_DECREF(args[j]);
+    }
+    Py_DECREF(kwnames);
+}
+
+static void bench_parse_args_format(Py_ssize_t n) {
+    static const char * const kwlist[] = {"a", "b", "c", 0};
+    static CPyArg_Parser parser = {"OO|O:f", kwlist, 0};
+    PyObject *args[] = {eval("1"), eval("2")};
+    BENCH_LOOP(n) {
+        PyObject *a, *b, *c = NULL;
+        sink = CPyArg_ParseStackAndKeywordsSimple(args, 2, NULL, &parser, &a, &b, &c);
+    }
+    Py_DECREF(args[0]);
+    Py_DECREF(args[1]);
+}
+
+// Tracebacks
+
+static void bench_add_traceback(Py_ssize_t n) {
+    BENCH_LOOP(n) {
+        PyErr_SetNone(PyExc_ValueError);
+        CPy_AddTraceback("file.py", "func", 12, moduleDict);
+        PyErr_Clear();
+    }
+}
+
+static void bench_add_traceback_cached(Py_ssize_t n) {
+    PyCodeObject *cache = NULL;
+    BENCH_LOOP(n) {
+        PyErr_SetNone(PyExc_ValueError);
+        CPy_AddTracebackCached(&cache, "file.py", "func", 12, moduleDict);
+        PyErr_Clear();
+    }
+    Py_XDECREF(cache);
+}
+
+// Statics initialization of a small module: 8 str literals, 2 ints, 1 float
+// and a tuple. One op initializes all the statics.
+
+static void bench_statics_init(Py_ssize_t n) {
+    static const char * const strings[] = {
+        "\x08\x07" "foo\x07" "bar\x0b" "alpha\x09" "beta\x0b" "gamma\x0b" "delta\x03" "x\x03" "y",
+        ""};
+    static const char * const ints[] = {"\x02" "12\0-123456789012345678901234567890", ""};
+    static const double floats[] = {1, 1.5};
+    static const int tuples[] = {1, 2, 3, 4};
+    const int num = 3 + 8 + 2 + 1 + 1;
+    PyObject *statics[num];
+    BENCH_LOOP(n) {
+        CPyStatics_Initialize(statics, strings, NULL, ints, floats, NULL, tuples, NULL);
+#ifndef CPY_IMMORTAL_STATICS
+        for (int j = 3; j < num; j++) {
+            Py_DECREF(statics[j]);
+        }
+#endif
+    }
+}
+
+typedef void (*BenchFunc)(Py_ssize_t n);
+
+typedef struct {
+    const char *name;
+    BenchFunc func;
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    {"int_add_short", bench_int_add_short},
+    {"int_multiply_short", bench_int_multiply_short},
+    {"int_add_long", bench_int_add_long},
+    {"int_compare_long", bench_int_compare_long},
+    {"int_box_short", bench_int_box_short},
+    {"list_get_item", bench_list_get_item},
+    {"list_set_item", bench_list_set_item},
+    {"list_index", bench_list_index},
+    {"list_append", bench_list_append},
+    {"dict_get_item", bench_dict_get_item},
+    {"dict_next_item", bench_dict_next_item},
+    {"dict_build", bench_dict_build},
+    {"dict_from_template", bench_dict_from_template},
+    {"str_get_item", bench_str_get_item},
+    {"str_slice", bench_str_slice},
+    {"str_split", bench_str_split},
+    {"parse_args_positional", bench_parse_args_positional},
+    {"parse_args_keywords", bench_parse_args_keywords},
+    {"parse_args_format", bench_parse_args_format},
+    {"add_traceback", bench_add_traceback},
+    {"add_traceback_cached", bench_add_traceback_cached},
+    {"statics_init", bench_statics_init},
+};
+
+static double run_once(BenchFunc func, Py_ssize_t n) {
+    bench_elapsed = -1;
+    func(n);
+    return bench_elapsed;
+}
+
+static PyObject *run_benchmarks(PyObject *self, PyObject *args, PyObject *kwds) {
+    static const char *kwlist[] = {"filter", "min_time", "repeat", NULL};
+    const char *filter = NULL;
+    double min_time = 0.05;
+    int repeat = 5;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|zdi:run_benchmarks", (char **)kwlist,
+                                     &filter, &min_time, &repeat)) {
+        return NULL;
+    }
+    PyObject *results = PyList_New(0);
+    if (results == NULL) {
+        return NULL;
+    }
+    for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+        const Benchmark *bench = &benchmarks[b];
+        if (filter != NULL && strstr(bench->name, filter) == NULL) {
+            continue;
+        }
+        // Warm up (e.g. caches and free lists) and find a size that takes long enough
+        Py_ssize_t n = 1;
+        while (run_once(bench->func, n) < min_time && n < PY_SSIZE_T_MAX / 2) {
+            n *= 2;
+        }
+        double best = HUGE_VAL;
+        for (int r = 0; r < repeat; r++) {
+            double t = run_once(bench->func, n);
+            if (t < best) {
+                best = t;
+            }
+        }
+        const Py_ssize_t alloc_n = 1000;
+        start_counting_allocs();
+        run_once(bench->func, alloc_n);
+        stop_counting_allocs();
+        double ns_per_op = best * 1e9 / n;
+        double allocs_per_op = (double)bench_allocs / alloc_n;
+        if (PyErr_Occurred()) {
+            Py_DECREF(results);
+            return NULL;
+        }
+        printf("%s\t%.1f\t%.2f\n", bench->name, ns_per_op, allocs_per_op);
+        fflush(stdout);
+        PyObject *item = Py_BuildValue("(sdd)", bench->name, ns_per_op, allocs_per_op);
+        if (item == NULL || PyList_Append(results, item) < 0) {
+            Py_XDECREF(item);
+            Py_DECREF(results);
+            return NULL;
+        }
+        Py_DECREF(item);
+    }
+    return results;
+}
+
+static PyMethodDef bench_methods[] = {
+    {"run_benchmarks", (PyCFunction)(void (*)(void))run_benchmarks,
+     METH_VARARGS | METH_KEYWORDS, "Run the C API microbenchmarks"},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef bench_module = {
+    PyModuleDef_HEAD_INIT,
+    "bench_capi",
+    NULL,
+    -1,
+    bench_methods
+};
+
+PyMODINIT_FUNC
+PyInit_bench_capi(void)
+{
+    PyObject *module = PyModule_Create(&bench_module);
+    if (module) {
+        moduleDict = PyModule_GetDict(module);
+    }
+    CPy_Init();
+    return module;
+}
@@ -0,0 +1,253 @@
+// Bytes primitive operations
+//
+// These are registered in mypyc.primitives.bytes_ops.
+//
+// Since mypy promotes bytearray and memoryview to bytes, the "bytes" argument
+// can be any of these. We have fast paths for bytes and bytearray objects,
+// and other arguments use the buffer protocol where the semantics allow it,
+// so they aren't copied.
+
+#include <Python.h>
+#include "CPy.h"
+
+// Get the contents of a bytes or bytearray object without copying.
+static inline bool CPyBytes_Data(PyObject *obj, const char **data, Py_ssize_t *size) {
+    if (PyBytes_Check(obj)) {
+        *data = PyBytes_AS_STRING(obj);
+        *size = PyBytes_GET_SIZE(obj);
+        return true;
+    } else if (PyByteArray_Check(obj)) {
+        *data = PyByteArray_AS_STRING(obj);
+        *size = PyByteArray_GET_SIZE(obj);
+        return true;
+    }
+    return false;
+}
+
+Py_ssize_t CPyBytes_Size(PyObject *obj) {
+    if (likely(PyBytes_Check(obj) || PyByteArray_Check(obj))) {
+        return Py_SIZE(obj);
+    }
+    return PyObject_Size(obj);
+}
+
+CPyTagged CPyBytes_GetItem(PyObject *obj, CPyTagged index) {
+    const char *data;
+    Py_ssize_t size;
+    if (likely(CPyTagged_CheckShort(index) && CPyBytes_Data(obj, &data, &size))) {
+        Py_ssize_t n = CPyTagged_ShortAsSsize_t(index);
+        if (n < 0) {
+            n += size;
+        }
+        if (unlikely(n < 0 || n >= size)) {
+            PyErr_SetString(PyExc_IndexError,
+                            PyBytes_Check(obj) ? "index out of range"
+                                               : "bytearray index out of range");
+            return CPY_INT_TAG;
+        }
+        return CPyTagged_ShortFromSsize_t((unsigned char)data[n]);
+    }
+    PyObject *index_obj = CPyTagged_AsObject(index);
+    if (index_obj == NULL) {
+        return CPY_INT_TAG;
+    }
+    PyObject *result = PyObject_GetItem(obj, index_obj);
+    Py_DECREF(index_obj);
+    if (result == NULL) {
+        return CPY_INT_TAG;
+    }
+    if (unlikely(!PyLong_Check(result))) {
+        CPy_TypeError("int", result);
+        Py_DECREF(result);
+        return CPY_INT_TAG;
+    }
+    CPyTagged value = CPyTagged_FromObject(result);
+    Py_DECREF(result);
+    return value;
+}
+
+PyObject *CPyBytes_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end) {
+    if (likely(PyBytes_CheckExact(obj)
+               && CPyTagged_CheckShort(start) && CPyTagged_CheckShort(end))) {
+        Py_ssize_t size = PyBytes_GET_SIZE(obj);
+        Py_ssize_t startn = CPySlice_AdjustIndex(start, size, 1);
+        Py_ssize_t endn = CPySlice_AdjustIndex(end, size, 1);
+        if (startn == 0 && endn == size) {
+            Py_INCREF(obj);
+            return obj;
+        }
+        return PyBytes_FromStringAndSize(PyBytes_AS_STRING(obj) + startn,
+                                         endn > startn ? endn - startn : 0);
+    }
+    // Slices of bytearray and memoryview objects preserve the type
+    return CPyObject_GetSlice(obj, start, end);
+}
+
+// bytes + bytes
+//
+// The right operand can be any object supporting the buffer protocol.
+PyObject *CPyBytes_Concat(PyObject *a, PyObject *b) {
+    if (likely(PyBytes_CheckExact(a))) {
+        Py_buffer view;
+        const char *data;
+        Py_ssize_t size;
+        bool has_view = false;
+        if (!CPyBytes_Data(b, &data, &size)) {
+            if (PyObject_GetBuffer(b, &view, PyBUF_SIMPLE) < 0) {
+                PyErr_Format(PyExc_TypeError, "can't concat %.100s to %.100s",
+                             Py_TYPE(b)->tp_name, Py_TYPE(a)->tp_name);
+                return NULL;
+            }
+            data = (const char *)view.buf;
+            size = view.len;
+            has_view = true;
+        }
+        PyObject *result;
+        Py_ssize_t a_size = PyBytes_GET_SIZE(a);
+        if (size == 0) {
+            result = a;
+            Py_INCREF(result);
+        } else if (unlikely(size > PY_SSIZE_T_MAX - a_size)) {
+            result = PyErr_NoMemory();
+        } else {
+            result = PyBytes_FromStringAndSize(NULL, a_size + size);
+            if (result != NULL) {
+                memcpy(PyBytes_AS_STRING(result), PyBytes_AS_STRING(a), a_size);
+                memcpy(PyBytes_AS_STRING(result) + a_size, data, size);
+            }
+        }
+        if (has_view) {
+            PyBuffer_Release(&view);
+        }
+        return result;
+    }
+    // bytearray concatenation produces a bytearray
+    return PyNumber_Add(a, b);
+}
+
+PyObject *CPyBytes_Join(PyObject *sep, PyObject *iter) {
+    if (likely(PyBytes_CheckExact(sep))) {
+        // This acquires buffers of the items instead of copying them
+        // and presizes the result.
+        return _PyBytes_Join(sep, iter);
+    }
+    _Py_IDENTIFIER(join);
+    return _PyObject_CallMethodIdObjArgs(sep, &PyId_join, iter, NULL);
+}
+
+// Implement bytes.startswith (direction < 0) and bytes.endswith
+// (direction > 0). Return 1 if there is a match, 0 if not, and -1 on error.
+static int CPyBytes_Tailmatch(PyObject *self, PyObject *sub, int direction) {
+    const char *data;
+    Py_ssize_t size;
+    if (unlikely(!CPyBytes_Data(self, &data, &size))) {
+        // Not a bytes or a bytearray, so it may not have the method
+        PyObject *result = PyObject_CallMethod(self, direction < 0 ? "startswith" : "endswith",
+                                               "O", sub);
+        if (result == NULL) {
+            return -1;
+        }
+        int res = PyObject_IsTrue(result);
+        Py_DECREF(result);
+        return res;
+    }
+    Py_buffer view;
+    if (PyObject_GetBuffer(sub, &view, PyBUF_SIMPLE) < 0) {
+        return -1;
+    }
+    int res = 0;
+    if (view.len <= size) {
+        const char *start = direction < 0 ? data : data + size - view.len;
+        res = memcmp(start, view.buf, view.len) == 0;
+    }
+    PyBuffer_Release(&view);
+    return res;
+}
+
+int CPyBytes_Startswith(PyObject *self, PyObject *prefix) {
+    return CPyBytes_Tailmatch(self, prefix, -1);
+}
+
+int CPyBytes_Endswith(PyObject *self, PyObject *suffix) {
+    return CPyBytes_Tailmatch(self, suffix, 1);
+}
+
+// Is data[:size] all ASCII? This checks a word at a time.
+static bool CPyBytes_IsASCII(const char *data, Py_ssize_t size) {
+    const char *p = data;
+    const char *end = data + size;
+    const size_t mask = (size_t)0x8080808080808080ULL;
+    while (p + sizeof(size_t) <= end) {
+        size_t word;
+        memcpy(&word, p, sizeof(size_t));
+        if (word & mask) {
+            return false;
+        }
+        p += sizeof(size_t);
+    }
+    while (p < end) {
+        if (*p & 0x80) {
+            return false;
+        }
+        p++;
+    }
+    return true;
+}
+
+// Is the encoding one that maps ASCII bytes to the same code points?
+static bool CPyBytes_IsASCIICompatibleEncoding(PyObject *encoding) {
+    static const char *const names[] = {"utf-8", "utf8", "ascii", "latin-1", "latin1", NULL};
+    int i;
+    if (encoding == NULL) {
+        return true;
+    }
+    for (i = 0; names[i] != NULL; i++) {
+        if (PyUnicode_CompareWithASCIIString(encoding, names[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// bytes.decode(encoding, errors). The encoding and errors can be NULL for
+// the defaults ('utf-8' and 'strict'), but errors must be NULL if encoding is.
+PyObject *CPyBytes_Decode(PyObject *obj, PyObject *encoding, PyObject *errors) {
+    const char *data;
+    Py_ssize_t size;
+    if (unlikely(!CPyBytes_Data(obj, &data, &size))) {
+        // memoryview has no decode method, so use a regular method call
+        _Py_IDENTIFIER(decode);
+        return _PyObject_CallMethodIdObjArgs(obj, &PyId_decode, encoding, errors, NULL);
+    }
+    if (CPyBytes_IsASCIICompatibleEncoding(encoding) && CPyBytes_IsASCII(data, size)) {
+        // Decoding can't fail, so this doesn't depend on the error handler
+        if (size == 1) {
+            return CPyStr_FromChar((Py_UCS1)data[0]);
+        }
+        PyObject *result = PyUnicode_New(size, 127);
+        if (result != NULL) {
+            memcpy(PyUnicode_1BYTE_DATA(result), data, size);
+        }
+        return result;
+    }
+    const char *encoding_str = NULL;
+    const char *errors_str = NULL;
+    if (encoding != NULL) {
+        encoding_str = PyUnicode_AsUTF8(encoding);
+        if (encoding_str == NULL) {
+            return NULL;
+        }
+    }
+    if (errors != NULL) {
+        errors_str = PyUnicode_AsUTF8(errors);
+        if (errors_str == NULL) {
+            return NULL;
+        }
+    }
+    if (!PyBytes_Check(obj)) {
+        // This exports a buffer, so that a codec can't resize the bytearray
+        return PyUnicode_FromEncodedObject(obj, encoding_str, errors_str);
+    }
+    // This has fast paths for common encodings (a NULL encoding means UTF-8)
+    return PyUnicode_Decode(data, size, encoding_str, errors_str);
+}
@@ -9,43 +9,267 @@
 // ways, so we don't want to just directly use the dict methods. Not
 // sure if it is actually worth doing all this stuff, but it saves
 // some indirections.
+//
+// The stdlib subclasses defaultdict, Counter and OrderedDict are common
+// enough that we handle them natively when the type matches exactly:
+//
+// * Lookups of existing keys don't go through __getitem__ in any of them,
+//   and defaultdict and Counter only add a __missing__ method.
+// * defaultdict and Counter store and iterate over items exactly like
+//   dict, so the exact dict fast paths can be used for them. OrderedDict
+//   has its own __setitem__ and iteration order, so it only gets the
+//   lookup fast path.
+//
+// Other subclasses use the generic fallbacks.
+
+enum {
+    CPY_DICT_OTHER,
+    CPY_DICT_DEFAULTDICT,
+    CPY_DICT_COUNTER,
+    CPY_DICT_ORDEREDDICT,
+};
+
+// Same layout as defdictobject in CPython
+typedef struct {
+    PyDictObject dict;
+    PyObject *default_factory;
+} CPyDefaultDictObject;
+
+static PyTypeObject *CPyDict_DefaultDictType;
+static PyTypeObject *CPyDict_CounterType;
+static PyTypeObject *CPyDict_OrderedDictType;
+
+static PyTypeObject *CPyDict_LoadType(PyObject *module, const char *name) {
+    PyObject *type = PyObject_GetAttrString(module, name);
+    if (type == NULL) {
+        PyErr_Clear();
+        return NULL;
+    }
+    if (!PyType_Check(type) || !PyType_IsSubtype((PyTypeObject *)type, &PyDict_Type)) {
+        Py_DECREF(type);
+        return NULL;
+    }
+    return (PyTypeObject *)type;
+}
+
+// Look up the stdlib subclasses in the collections module. Instances can
+// only exist after collections has been imported, so we don't import it
+// here but try again later.
+static bool CPyDict_LoadSubclassTypes(void) {
+    PyObject *module = PyDict_GetItemString(PyImport_GetModuleDict(), "collections");
+    if (module == NULL) {
+        return false;
+    }
+    PyTypeObject *defaultdict_type = CPyDict_LoadType(module, "defaultdict");
+    PyTypeObject *counter_type = CPyDict_LoadType(module, "Counter");
+    PyTypeObject *ordereddict_type = CPyDict_LoadType(module, "OrderedDict");
+    if (defaultdict_type == NULL || counter_type == NULL || ordereddict_type == NULL) {
+        // Probably a partially initialized module
+        Py_XDECREF(defaultdict_type);
+        Py_XDECREF(counter_type);
+        Py_XDECREF(ordereddict_type);
+        return false;
+    }
+    CPyDict_DefaultDictType = defaultdict_type;
+    CPyDict_CounterType = counter_type;
+    CPyDict_OrderedDictType = ordereddict_type;
+    return true;
+}
+
+// Classify a dict subclass instance as one of the CPY_DICT_* constants
+static int CPyDict_SubclassKind(PyObject *dict) {
+    if (unlikely(CPyDict_OrderedDictType == NULL) && !CPyDict_LoadSubclassTypes()) {
+        return CPY_DICT_OTHER;
+    }
+    PyTypeObject *type = Py_TYPE(dict);
+    if (type == CPyDict_DefaultDictType) {
+        return CPY_DICT_DEFAULTDICT;
+    } else if (type == CPyDict_CounterType) {
+        return CPY_DICT_COUNTER;
+    } else if (type == CPyDict_OrderedDictType) {
+        return CPY_DICT_ORDEREDDICT;
+    }
+    return CPY_DICT_OTHER;
+}
+
+// Slow path of CPyDict_CheckNative for instances of dict subclasses
+bool CPyDict_CheckNativeSubclass(PyObject *dict) {
+    int kind = CPyDict_SubclassKind(dict);
+    return kind == CPY_DICT_DEFAULTDICT || kind == CPY_DICT_COUNTER;
+}
+
+// Can we look up existing keys like in an exact dict?
+static inline bool CPyDict_CheckNativeLookup(PyObject *dict) {
+    return PyDict_CheckExact(dict) || CPyDict_SubclassKind(dict) != CPY_DICT_OTHER;
+}
+
+// Produce the result of d[key] for a key that isn't in a dict that
+// supports native lookups.
+static PyObject *CPyDict_Missing(PyObject *dict, PyObject *key) {
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    if (!PyDict_CheckExact(dict)) {
+        int kind = CPyDict_SubclassKind(dict);
+        if (kind == CPY_DICT_DEFAULTDICT) {
+            // Same as defdict_missing in CPython
+            PyObject *factory = ((CPyDefaultDictObject *)dict)->default_factory;
+            if (factory != NULL && factory != Py_None) {
+                PyObject *value = PyObject_CallObject(factory, NULL);
+                if (value == NULL) {
+                    return NULL;
+                }
+                if (PyDict_SetItem(dict, key, value) < 0) {
+                    Py_DECREF(value);
+                    return NULL;
+                }
+                return value;
+            }
+        } else if (kind == CPY_DICT_COUNTER) {
+            // Counter.__missing__ returns 0 without inserting the key
+            return PyLong_FromLong(0);
+        }
+    }
+    PyErr_SetObject(PyExc_KeyError, key);
+    return NULL;
+}
+
 PyObject *CPyDict_GetItem(PyObject *dict, PyObject *key) {
-    if (PyDict_CheckExact(dict)) {
+    if (CPyDict_CheckNativeLookup(dict)) {
+        CPyStats_INC(dict_get_item_fast);
         PyObject *res = PyDict_GetItemWithError(dict, key);
         if (!res) {
-            if (!PyErr_Occurred()) {
-                PyErr_SetObject(PyExc_KeyError, key);
-            }
-        } else {
-            Py_INCREF(res);
+            return CPyDict_Missing(dict, key);
         }
+        Py_INCREF(res);
         return res;
     } else {
+        CPyStats_INC(dict_get_item_slow);
         return PyObject_GetItem(dict, key);
     }
 }
 
-PyObject *CPyDict_Build(Py_ssize_t size, ...) {
-    Py_ssize_t i;
-
+// Build a dict from an array of alternating keys and values
+// (key1, value1, ..., keyN, valueN).
+PyObject *CPyDict_BuildArray(Py_ssize_t size, PyObject **items) {
     PyObject *res = _PyDict_NewPresized(size);
-    if (res == NULL) {
+    if (unlikely(res == NULL)) {
         return NULL;
     }
+    Py_ssize_t i;
+    for (i = 0; i < size; i++) {
+        if (unlikely(PyDict_SetItem(res, items[2 * i], items[2 * i + 1]) < 0)) {
+            Py_DECREF(res);
+            return NULL;
+        }
+    }
+    return res;
+}
 
-    va_list args;
-    va_start(args, size);
+// Dict displays with only str literal keys are created by copying a template
+// dict that has the keys, which avoids hashing keys and resizing the dict.
+// Templates are kept in a small open addressing hash table keyed by the
+// address of the keys tuple. The keys tuples are literals that live as long as
+// the module, and the table keeps a reference to them, so addresses can't be
+// reused.
+
+typedef struct {
+    PyObject *keys;
+    PyObject *dict;
+} CPyDictTemplate;
+
+static CPyDictTemplate *dict_templates;
+// The capacity is always zero or a power of two
+static size_t dict_templates_capacity;
+static size_t dict_templates_used;
+
+static inline size_t CPyDict_TemplateSlot(PyObject *keys, size_t mask) {
+    // The low bits of object addresses are always zero
+    return ((size_t)keys >> 4) & mask;
+}
 
+static bool CPyDict_GrowTemplates(void) {
+    size_t new_capacity = dict_templates_capacity == 0 ? 32 : dict_templates_capacity * 2;
+    CPyDictTemplate *new_templates = PyMem_Calloc(new_capacity, sizeof(CPyDictTemplate));
+    if (unlikely(new_templates == NULL)) {
+        PyErr_NoMemory();
+        return false;
+    }
+    size_t i;
+    for (i = 0; i < dict_templates_capacity; i++) {
+        CPyDictTemplate *t = &dict_templates[i];
+        if (t->keys != NULL) {
+            size_t j = CPyDict_TemplateSlot(t->keys, new_capacity - 1);
+            while (new_templates[j].keys != NULL) {
+                j = (j + 1) & (new_capacity - 1);
+            }
+            new_templates[j] = *t;
+        }
+    }
+    PyMem_Free(dict_templates);
+    dict_templates = new_templates;
+    dict_templates_capacity = new_capacity;
+    return true;
+}
+
+// Return a borrowed reference to the template dict for a tuple of str keys,
+// creating it if needed. The values of the template are all None.
+static PyObject *CPyDict_GetTemplate(PyObject *keys) {
+    if (unlikely((dict_templates_used + 1) * 2 > dict_templates_capacity)) {
+        if (!CPyDict_GrowTemplates()) {
+            return NULL;
+        }
+    }
+    size_t mask = dict_templates_capacity - 1;
+    size_t i = CPyDict_TemplateSlot(keys, mask);
+    while (dict_templates[i].keys != NULL) {
+        if (likely(dict_templates[i].keys == keys)) {
+            return dict_templates[i].dict;
+        }
+        i = (i + 1) & mask;
+    }
+    Py_ssize_t size = PyTuple_GET_SIZE(keys);
+    PyObject *dict = _PyDict_NewPresized(size);
+    if (unlikely(dict == NULL)) {
+        return NULL;
+    }
+    Py_ssize_t j;
+    for (j = 0; j < size; j++) {
+        // This also caches the hashes of the keys
+        if (unlikely(PyDict_SetItem(dict, PyTuple_GET_ITEM(keys, j), Py_None) < 0)) {
+            Py_DECREF(dict);
+            return NULL;
+        }
+    }
+    Py_INCREF(keys);
+    dict_templates[i].keys = keys;
+    dict_templates[i].dict = dict;
+    dict_templates_used++;
+    return dict;
+}
+
+// Build a dict from a tuple of str keys and an array with the corresponding
+// values. The keys tuple must be a literal.
+PyObject *CPyDict_FromTemplate(PyObject *keys, PyObject **values) {
+    PyObject *template = CPyDict_GetTemplate(keys);
+    if (unlikely(template == NULL)) {
+        return NULL;
+    }
+    PyObject *res = PyDict_Copy(template);
+    if (unlikely(res == NULL)) {
+        return NULL;
+    }
+    Py_ssize_t size = PyTuple_GET_SIZE(keys);
+    Py_ssize_t i;
     for (i = 0; i < size; i++) {
-        PyObject *key = va_arg(args, PyObject *);
-        PyObject *value = va_arg(args, PyObject *);
-        if (PyDict_SetItem(res, key, value)) {
+        PyObject *key = PyTuple_GET_ITEM(keys, i);
+        // The key is already in the dict, so this only replaces the value
+        Py_hash_t hash = ((PyASCIIObject *)key)->hash;
+        if (unlikely(_PyDict_SetItem_KnownHash(res, key, values[i], hash) < 0)) {
             Py_DECREF(res);
             return NULL;
         }
     }
-
-    va_end(args);
     return res;
 }
 
@@ -68,7 +292,7 @@ PyObject *CPyDict_GetWithNone(PyObject *dict, PyObject *key) {
 }
 
 PyObject *CPyDict_SetDefault(PyObject *dict, PyObject *key, PyObject *value) {
-    if (PyDict_CheckExact(dict)){
+    if (CPyDict_CheckNative(dict)) {
         PyObject* ret = PyDict_SetDefault(dict, key, value);
         Py_XINCREF(ret);
         return ret;
@@ -81,13 +305,121 @@ PyObject *CPyDict_SetDefaultWithNone(PyObject *dict, PyObject *key) {
 }
 
 int CPyDict_SetItem(PyObject *dict, PyObject *key, PyObject *value) {
-    if (PyDict_CheckExact(dict)) {
+    if (CPyDict_CheckNative(dict)) {
+        CPyStats_INC(dict_set_item_fast);
         return PyDict_SetItem(dict, key, value);
     } else {
+        CPyStats_INC(dict_set_item_slow);
+        return PyObject_SetItem(dict, key, value);
+    }
+}
+
+// Variants of the above for str literal keys. CPyStatics_Initialize caches
+// the hashes of all str literals, so we can pass the hash directly to the
+// dict lookup functions.
+
+static inline Py_hash_t CPyStr_KnownHash(PyObject *key) {
+    Py_hash_t hash = ((PyASCIIObject *)key)->hash;
+    if (unlikely(hash == -1)) {
+        // Not cached yet; computing a str hash can't fail
+        hash = PyObject_Hash(key);
+    }
+    return hash;
+}
+
+PyObject *CPyDict_GetItemKnownHash(PyObject *dict, PyObject *key) {
+    if (CPyDict_CheckNativeLookup(dict)) {
+        CPyStats_INC(dict_get_item_fast);
+        PyObject *res = _PyDict_GetItem_KnownHash(dict, key, CPyStr_KnownHash(key));
+        if (!res) {
+            return CPyDict_Missing(dict, key);
+        }
+        Py_INCREF(res);
+        return res;
+    } else {
+        CPyStats_INC(dict_get_item_slow);
+        return PyObject_GetItem(dict, key);
+    }
+}
+
+// d[key] for a str literal key, using an inline cache. This is used for
+// lookups of module globals and entries of sys.modules, which change rarely.
+PyObject *CPyDict_GetItemCached(PyObject *dict, PyObject *key, CPyInlineCache *cache) {
+    uint64_t version = CPyDict_Version(dict);
+    if (cache->owner == dict && cache->version == version) {
+        Py_INCREF(cache->value);
+        return cache->value;
+    }
+    PyObject *res = CPyDict_GetItemKnownHash(dict, key);
+    // Versions are never 0. Only cache values of exact dicts, since a missing
+    // key in a Counter produces a value that the dict doesn't hold.
+    version = CPyDict_Version(dict);
+    if (res != NULL && version != 0 && PyDict_CheckExact(dict)) {
+        // The dict holds a reference to the value until it's modified
+        cache->owner = dict;
+        cache->version = version;
+        cache->value = res;
+    }
+    return res;
+}
+
+PyObject *CPyDict_GetKnownHash(PyObject *dict, PyObject *key, PyObject *fallback) {
+    // Like CPyDict_Get, this assumes that get on a subclass behaves the same
+    PyObject *res = _PyDict_GetItem_KnownHash(dict, key, CPyStr_KnownHash(key));
+    if (!res) {
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+        res = fallback;
+    }
+    Py_INCREF(res);
+    return res;
+}
+
+PyObject *CPyDict_GetWithNoneKnownHash(PyObject *dict, PyObject *key) {
+    return CPyDict_GetKnownHash(dict, key, Py_None);
+}
+
+int CPyDict_SetItemKnownHash(PyObject *dict, PyObject *key, PyObject *value) {
+    if (CPyDict_CheckNative(dict)) {
+        CPyStats_INC(dict_set_item_fast);
+        return _PyDict_SetItem_KnownHash(dict, key, value, CPyStr_KnownHash(key));
+    } else {
+        CPyStats_INC(dict_set_item_slow);
         return PyObject_SetItem(dict, key, value);
     }
 }
 
+int CPyDict_ContainsKnownHash(PyObject *dict, PyObject *key) {
+    if (PyDict_CheckExact(dict)) {
+        if (_PyDict_GetItem_KnownHash(dict, key, CPyStr_KnownHash(key)) != NULL) {
+            return 1;
+        }
+        return PyErr_Occurred() ? -1 : 0;
+    }
+    return PyDict_Contains(dict, key);
+}
+
+PyObject *CPyDict_SetDefaultKnownHash(PyObject *dict, PyObject *key, PyObject *value) {
+    if (CPyDict_CheckNative(dict)) {
+        Py_hash_t hash = CPyStr_KnownHash(key);
+        PyObject *res = _PyDict_GetItem_KnownHash(dict, key, hash);
+        if (res == NULL) {
+            if (PyErr_Occurred() || _PyDict_SetItem_KnownHash(dict, key, value, hash) < 0) {
+                return NULL;
+            }
+            res = value;
+        }
+        Py_INCREF(res);
+        return res;
+    }
+    return PyObject_CallMethod(dict, "setdefault", "(OO)", key, value);
+}
+
+PyObject *CPyDict_SetDefaultWithNoneKnownHash(PyObject *dict, PyObject *key) {
+    return CPyDict_SetDefaultKnownHash(dict, key, Py_None);
+}
+
 static inline int CPy_ObjectToStatus(PyObject *obj) {
     if (obj) {
         Py_DECREF(obj);
@@ -98,6 +430,7 @@ static inline int CPy_ObjectToStatus(PyObject *obj) {
 }
 
 static int CPyDict_UpdateGeneral(PyObject *dict, PyObject *stuff) {
+    CPyStats_INC(dict_update_slow);
     _Py_IDENTIFIER(update);
     PyObject *res = _PyObject_CallMethodIdObjArgs(dict, &PyId_update, stuff, NULL);
     return CPy_ObjectToStatus(res);
@@ -162,28 +495,28 @@ PyObject *CPyDict_FromAny(PyObject *obj) {
 }
 
 PyObject *CPyDict_KeysView(PyObject *dict) {
-    if (PyDict_CheckExact(dict)){
+    if (CPyDict_CheckNative(dict)) {
         return _CPyDictView_New(dict, &PyDictKeys_Type);
     }
     return PyObject_CallMethod(dict, "keys", NULL);
 }
 
 PyObject *CPyDict_ValuesView(PyObject *dict) {
-    if (PyDict_CheckExact(dict)){
+    if (CPyDict_CheckNative(dict)) {
         return _CPyDictView_New(dict, &PyDictValues_Type);
     }
     return PyObject_CallMethod(dict, "values", NULL);
 }
 
 PyObject *CPyDict_ItemsView(PyObject *dict) {
-    if (PyDict_CheckExact(dict)){
+    if (CPyDict_CheckNative(dict)) {
         return _CPyDictView_New(dict, &PyDictItems_Type);
     }
     return PyObject_CallMethod(dict, "items", NULL);
 }
 
 PyObject *CPyDict_Keys(PyObject *dict) {
-    if (PyDict_CheckExact(dict)) {
+    if (CPyDict_CheckNative(dict)) {
         return PyDict_Keys(dict);
     }
     // Inline generic fallback logic to also return a list.
@@ -202,7 +535,7 @@ PyObject *CPyDict_Keys(PyObject *dict) {
 }
 
 PyObject *CPyDict_Values(PyObject *dict) {
-    if (PyDict_CheckExact(dict)) {
+    if (CPyDict_CheckNative(dict)) {
         return PyDict_Values(dict);
     }
     // Inline generic fallback logic to also return a list.
@@ -221,7 +554,7 @@ PyObject *CPyDict_Values(PyObject *dict) {
 }
 
 PyObject *CPyDict_Items(PyObject *dict) {
-    if (PyDict_CheckExact(dict)) {
+    if (CPyDict_CheckNative(dict)) {
         return PyDict_Items(dict);
     }
     // Inline generic fallback logic to also return a list.
@@ -239,8 +572,134 @@ PyObject *CPyDict_Items(PyObject *dict) {
     return list;
 }
 
+// Keys, values or items of a dict as a flat list (key1, value1, key2, ...).
+// This avoids allocating a tuple per item for list(d.items()).
+PyObject *CPyDict_ItemsFlat(PyObject *dict) {
+    if (CPyDict_CheckNative(dict)) {
+        PyObject *list = PyList_New(2 * PyDict_GET_SIZE(dict));
+        if (list == NULL) {
+            return NULL;
+        }
+        Py_ssize_t pos = 0, i = 0;
+        PyObject *key, *value;
+        while (PyDict_Next(dict, &pos, &key, &value)) {
+            Py_INCREF(key);
+            Py_INCREF(value);
+            PyList_SET_ITEM(list, i, key);
+            PyList_SET_ITEM(list, i + 1, value);
+            i += 2;
+        }
+        return list;
+    }
+    PyObject *iter = CPyDict_GetItemsIter(dict);
+    if (iter == NULL) {
+        return NULL;
+    }
+    PyObject *list = PyList_New(0);
+    if (list == NULL) {
+        Py_DECREF(iter);
+        return NULL;
+    }
+    PyObject *item;
+    while ((item = PyIter_Next(iter)) != NULL) {
+        if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2) {
+            PyErr_SetString(PyExc_TypeError, "a tuple of length 2 expected");
+            Py_DECREF(item);
+            goto fail;
+        }
+        int res = PyList_Append(list, PyTuple_GET_ITEM(item, 0));
+        if (res == 0) {
+            res = PyList_Append(list, PyTuple_GET_ITEM(item, 1));
+        }
+        Py_DECREF(item);
+        if (res < 0) {
+            goto fail;
+        }
+    }
+    if (PyErr_Occurred()) {
+        goto fail;
+    }
+    Py_DECREF(iter);
+    return list;
+
+fail:
+    Py_DECREF(iter);
+    Py_DECREF(list);
+    return NULL;
+}
+
+// Call d.keys(), d.values() or d.items() of a dict subclass that might
+// override them, depending on kind.
+static PyObject *CPyDict_CallViewMethod(PyObject *dict, int kind) {
+    const char *method = kind == CPY_DICT_BATCH_KEYS ? "keys"
+        : kind == CPY_DICT_BATCH_VALUES ? "values" : "items";
+    return PyObject_CallMethod(dict, method, NULL);
+}
+
+// Implement "len(d.keys())" (and values/items) without creating the view.
+// kind is CPY_DICT_BATCH_KEYS, CPY_DICT_BATCH_VALUES or CPY_DICT_BATCH_ITEMS.
+Py_ssize_t CPyDict_ViewLen(PyObject *dict, int kind) {
+    if (CPyDict_CheckNative(dict)) {
+        return PyDict_GET_SIZE(dict);
+    }
+    PyObject *view = CPyDict_CallViewMethod(dict, kind);
+    if (view == NULL) {
+        return -1;
+    }
+    Py_ssize_t res = PyObject_Size(view);
+    Py_DECREF(view);
+    return res;
+}
+
+// Implement "item in d.keys()" (and values/items) without creating the view.
+// kind is CPY_DICT_BATCH_KEYS, CPY_DICT_BATCH_VALUES or CPY_DICT_BATCH_ITEMS.
+int CPyDict_ViewContains(PyObject *dict, PyObject *item, int kind) {
+    if (!CPyDict_CheckNative(dict)) {
+        PyObject *view = CPyDict_CallViewMethod(dict, kind);
+        if (view == NULL) {
+            return -1;
+        }
+        int res = PySequence_Contains(view, item);
+        Py_DECREF(view);
+        return res;
+    }
+    if (kind == CPY_DICT_BATCH_KEYS) {
+        return PyDict_Contains(dict, item);
+    } else if (kind == CPY_DICT_BATCH_ITEMS) {
+        // Same as dictitems_contains in CPython
+        if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2) {
+            return 0;
+        }
+        PyObject *found = PyDict_GetItemWithError(dict, PyTuple_GET_ITEM(item, 0));
+        if (found == NULL) {
+            return PyErr_Occurred() ? -1 : 0;
+        }
+        Py_INCREF(found);
+        int res = PyObject_RichCompareBool(found, PyTuple_GET_ITEM(item, 1), Py_EQ);
+        Py_DECREF(found);
+        return res;
+    }
+    // Values need a linear scan
+    Py_ssize_t size = PyDict_GET_SIZE(dict);
+    Py_ssize_t pos = 0;
+    PyObject *key, *value;
+    while (PyDict_Next(dict, &pos, &key, &value)) {
+        Py_INCREF(value);
+        int res = PyObject_RichCompareBool(value, item, Py_EQ);
+        Py_DECREF(value);
+        if (res != 0) {
+            return res;
+        }
+        if (PyDict_GET_SIZE(dict) != size) {
+            PyErr_SetString(PyExc_RuntimeError, "dictionary changed size during iteration");
+            return -1;
+        }
+    }
+    return 0;
+}
+
 char CPyDict_Clear(PyObject *dict) {
-    if (PyDict_CheckExact(dict)) {
+    if (CPyDict_CheckNative(dict)) {
         PyDict_Clear(dict);
     } else {
         PyObject *res = PyObject_CallMethod(dict, "clear", NULL);
@@ -259,7 +718,7 @@ PyObject *CPyDict_Copy(PyObject *dict) {
 }
 
 PyObject *CPyDict_GetKeysIter(PyObject *dict) {
-    if (PyDict_CheckExact(dict)) {
+    if (CPyDict_CheckNative(dict)) {
         // Return dict itself to indicate we can use fast path instead.
         Py_INCREF(dict);
         return dict;
@@ -268,7 +727,7 @@ PyObject *CPyDict_GetKeysIter(PyObject *dict) {
 }
 
 PyObject *CPyDict_GetItemsIter(PyObject *dict) {
-    if (PyDict_CheckExact(dict)) {
+    if (CPyDict_CheckNative(dict)) {
         // Return dict itself to indicate we can use fast path instead.
         Py_INCREF(dict);
         return dict;
@@ -283,7 +742,7 @@ PyObject *CPyDict_GetItemsIter(PyObject *dict) {
 }
 
 PyObject *CPyDict_GetValuesIter(PyObject *dict) {
-    if (PyDict_CheckExact(dict)) {
+    if (CPyDict_CheckNative(dict)) {
         // Return dict itself to indicate we can use fast path instead.
         Py_INCREF(dict);
         return dict;
@@ -310,14 +769,15 @@ static void _CPyDict_FromNext(tuple_T3CIO *ret, PyObject *dict_iter) {
 }
 
 // Helpers for fast dictionary iteration, return a single tuple
-// instead of writing to multiple registers, for exact dicts use
-// the fast path, and fall back to generic iterator logic for subclasses.
+// instead of writing to multiple registers, for exact dicts (and
+// defaultdict and Counter) use the fast path, and fall back to
+// generic iterator logic for other subclasses.
 tuple_T3CIO CPyDict_NextKey(PyObject *dict_or_iter, CPyTagged offset) {
     tuple_T3CIO ret;
     Py_ssize_t py_offset = CPyTagged_AsSsize_t(offset);
     PyObject *dummy;
 
-    if (PyDict_CheckExact(dict_or_iter)) {
+    if (CPyDict_CheckNative(dict_or_iter)) {
         ret.f0 = PyDict_Next(dict_or_iter, &py_offset, &ret.f2, &dummy);
         if (ret.f0) {
             ret.f1 = CPyTagged_FromSsize_t(py_offset);
@@ -341,7 +801,7 @@ tuple_T3CIO CPyDict_NextValue(PyObject *dict_or_iter, CPyTagged offset) {
     Py_ssize_t py_offset = CPyTagged_AsSsize_t(offset);
     PyObject *dummy;
 
-    if (PyDict_CheckExact(dict_or_iter)) {
+    if (CPyDict_CheckNative(dict_or_iter)) {
         ret.f0 = PyDict_Next(dict_or_iter, &py_offset, &dummy, &ret.f2);
         if (ret.f0) {
             ret.f1 = CPyTagged_FromSsize_t(py_offset);
@@ -364,7 +824,7 @@ tuple_T4CIOO CPyDict_NextItem(PyObject *dict_or_iter, CPyTagged offset) {
     tuple_T4CIOO ret;
     Py_ssize_t py_offset = CPyTagged_AsSsize_t(offset);
 
-    if (PyDict_CheckExact(dict_or_iter)) {
+    if (CPyDict_CheckNative(dict_or_iter)) {
         ret.f0 = PyDict_Next(dict_or_iter, &py_offset, &ret.f2, &ret.f3);
         if (ret.f0) {
             ret.f1 = CPyTagged_FromSsize_t(py_offset);
@@ -388,7 +848,13 @@ tuple_T4CIOO CPyDict_NextItem(PyObject *dict_or_iter, CPyTagged offset) {
             ret.f0 = 1;
             ret.f2 = PyTuple_GET_ITEM(item, 0);
             ret.f3 = PyTuple_GET_ITEM(item, 1);
+            // Take the references before releasing the item, which may free it.
+            // If nothing else refers to the item, an items iterator can reuse it
+            // for the next item instead of allocating a new tuple.
+            Py_INCREF(ret.f2);
+            Py_INCREF(ret.f3);
             Py_DECREF(item);
+            return ret;
         }
     }
     // PyDict_Next() returns borrowed references.
@@ -396,3 +862,152 @@ tuple_T4CIOO CPyDict_NextItem(PyObject *dict_or_iter, CPyTagged offset) {
     Py_INCREF(ret.f3);
     return ret;
 }
+
+PyObject *CPyDict_GetBatchIter(PyObject *dict, int kind) {
+    PyObject *iter;
+    switch (kind & CPY_DICT_BATCH_ITEMS) {
+    case CPY_DICT_BATCH_KEYS:
+        iter = CPyDict_GetKeysIter(dict);
+        break;
+    case CPY_DICT_BATCH_VALUES:
+        iter = CPyDict_GetValuesIter(dict);
+        break;
+    default:
+        iter = CPyDict_GetItemsIter(dict);
+        break;
+    }
+    if (iter == NULL || iter == dict || !(kind & CPY_DICT_BATCH_BORROWED)) {
+        return iter;
+    }
+    // Subclasses produce new references, so in borrowed mode we keep the
+    // current batch alive in a list that is paired with the iterator.
+    PyObject *holder = PyList_New(0);
+    if (holder == NULL) {
+        Py_DECREF(iter);
+        return NULL;
+    }
+    PyObject *res = PyTuple_Pack(2, iter, holder);
+    Py_DECREF(iter);
+    Py_DECREF(holder);
+    return res;
+}
+
+// Fill a batch from a generic iterator (used for dict subclasses).
+static Py_ssize_t CPyDict_NextBatchFromIter(PyObject *iter, PyObject *holder, PyObject **buf,
+                                            Py_ssize_t n, int kind) {
+    Py_ssize_t count = 0;
+    if (holder != NULL && PyList_SetSlice(holder, 0, PY_SSIZE_T_MAX, NULL) < 0) {
+        return -1;
+    }
+    while (n > 0) {
+        PyObject *item = PyIter_Next(iter);
+        if (item == NULL) {
+            if (PyErr_Occurred()) {
+                goto fail;
+            }
+            break;
+        }
+        if (holder != NULL && PyList_Append(holder, item) < 0) {
+            Py_DECREF(item);
+            goto fail;
+        }
+        if (kind == CPY_DICT_BATCH_ITEMS) {
+            if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2) {
+                PyErr_SetString(PyExc_TypeError, "a tuple of length 2 expected");
+                Py_DECREF(item);
+                goto fail;
+            }
+            buf[count] = PyTuple_GET_ITEM(item, 0);
+            buf[count + 1] = PyTuple_GET_ITEM(item, 1);
+            if (holder == NULL) {
+                Py_INCREF(buf[count]);
+                Py_INCREF(buf[count + 1]);
+            }
+            count += 2;
+            Py_DECREF(item);
+        } else {
+            buf[count++] = item;
+            if (holder != NULL) {
+                Py_DECREF(item);
+            }
+        }
+        n--;
+    }
+    return count;
+
+fail:
+    if (holder == NULL) {
+        while (count > 0) {
+            Py_DECREF(buf[--count]);
+        }
+    }
+    return -1;
+}
+
+tuple_T2II CPyDict_NextBatch(PyObject *dict_or_iter, CPyTagged offset, PyObject **buf,
+                             Py_ssize_t n, int kind) {
+    tuple_T2II ret;
+    bool borrowed = kind & CPY_DICT_BATCH_BORROWED;
+    kind &= CPY_DICT_BATCH_ITEMS;
+    Py_ssize_t count = 0;
+
+    if (CPyDict_CheckNative(dict_or_iter)) {
+        Py_ssize_t py_offset = CPyTagged_AsSsize_t(offset);
+        PyObject *key, *value;
+#if PY_MAJOR_VERSION >= 3 && PY_MINOR_VERSION < 6
+        if (borrowed) {
+            // Without version tags, stale borrowed items can't be detected
+            n = 1;
+        }
+#endif
+        while (n > 0 && PyDict_Next(dict_or_iter, &py_offset, &key, &value)) {
+            if (kind & CPY_DICT_BATCH_KEYS) {
+                buf[count++] = key;
+            }
+            if (kind & CPY_DICT_BATCH_VALUES) {
+                buf[count++] = value;
+            }
+            n--;
+        }
+        if (!borrowed) {
+            // PyDict_Next() returns borrowed references.
+            Py_ssize_t i;
+            for (i = 0; i < count; i++) {
+                Py_INCREF(buf[i]);
+            }
+        }
+        ret.f1 = CPyTagged_FromSsize_t(py_offset);
+    } else {
+        // offset is dummy in this case, just use the old value.
+        PyObject *iter = dict_or_iter;
+        PyObject *holder = NULL;
+        if (borrowed) {
+            iter = PyTuple_GET_ITEM(dict_or_iter, 0);
+            holder = PyTuple_GET_ITEM(dict_or_iter, 1);
+        }
+        count = CPyDict_NextBatchFromIter(iter, holder, buf, n, kind);
+        if (count < 0) {
+            return tuple_undefined_T2II;
+        }
+        ret.f1 = offset;
+    }
+    ret.f0 = CPyTagged_ShortFromSsize_t(count);
+    return ret;
+}
+
+// Return the dict offset after the first pos objects of a batch that was
+// fetched from the given offset.
+CPyTagged CPyDict_BatchOffset(PyObject *dict_or_iter, CPyTagged offset, CPyTagged pos, int kind) {
+    if (!CPyDict_CheckNative(dict_or_iter)) {
+        return offset;
+    }
+    Py_ssize_t py_offset = CPyTagged_AsSsize_t(offset);
+    Py_ssize_t n = CPyTagged_ShortAsSsize_t(pos);
+    if ((kind & CPY_DICT_BATCH_ITEMS) == CPY_DICT_BATCH_ITEMS) {
+        n /= 2;
+    }
+    while (n > 0 && PyDict_Next(dict_or_iter, &py_offset, NULL, NULL)) {
+        n--;
+    }
+    return CPyTagged_FromSsize_t(py_offset);
+}
@@ -74,6 +74,43 @@ void CPy_RestoreExcInfo(tuple_T3OOO info) {
     PyErr_SetExcInfo(_CPy_FromDummy(info.f0), _CPy_FromDummy(info.f1), _CPy_FromDummy(info.f2));
 }
 
+// Lightweight alternative to CPy_CatchError for except blocks that can't
+// observe the exception (they don't bind it, re-raise it or call anything
+// that might see sys.exc_info()). This fetches the raised exception without
+// normalizing it or touching sys.exc_info(), and clears the error indicator.
+// NULL values are converted to the ExcDummy object, as in CPy_CatchError.
+tuple_T3OOO CPy_FetchError(void) {
+    tuple_T3OOO ret;
+    PyErr_Fetch(&ret.f0, &ret.f1, &ret.f2);
+    if (ret.f0 == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "CPy_FetchError called with no error!");
+        PyErr_Fetch(&ret.f0, &ret.f1, &ret.f2);
+    }
+    _CPy_ToDummy(&ret.f1);
+    _CPy_ToDummy(&ret.f2);
+    return ret;
+}
+
+// Check whether an exception returned from CPy_FetchError matches a
+// particular type. This works on the unnormalized exception type.
+bool CPy_ErrorMatches(tuple_T3OOO err, PyObject *type) {
+    return PyErr_GivenExceptionMatches(err.f0, type);
+}
+
+// Make a fetched exception propagate again, since no except clause matched it.
+void CPy_RestoreError(tuple_T3OOO err) {
+    Py_INCREF(err.f0);
+    PyErr_Restore(err.f0, _CPy_FromDummy(err.f1), _CPy_FromDummy(err.f2));
+}
+
+// Make a fetched exception the __context__ of the exception being raised, as
+// if the new exception had been raised while handling it. This is used if
+// evaluating the type of an except clause fails.
+void CPy_ChainError(tuple_T3OOO err) {
+    Py_INCREF(err.f0);
+    _PyErr_ChainExceptions(err.f0, _CPy_FromDummy(err.f1), _CPy_FromDummy(err.f2));
+}
+
 bool CPy_ExceptionMatches(PyObject *type) {
     return PyErr_GivenExceptionMatches(CPy_ExcState()->exc_type, type);
 }
@@ -191,7 +228,7 @@ void CPy_TypeError(const char *expected, PyObject *value) {
 
 // These functions are basically exactly PyCode_NewEmpty and
 // _PyTraceback_Add which are available in all the versions we support.
-// We're continuing to use them because we'll probably optimize them later.
+// We use our own versions so that code objects can be cached per call site.
 static PyCodeObject *CPy_CreateCodeObject(const char *filename, const char *funcname, int line) {
     PyObject *filename_obj = PyUnicode_FromString(filename);
     PyObject *funcname_obj = PyUnicode_FromString(funcname);
@@ -221,10 +258,16 @@ static PyCodeObject *CPy_CreateCodeObject(const char *filename, const char *func
     return code_obj;
 }
 
-void CPy_AddTraceback(const char *filename, const char *funcname, int line, PyObject *globals) {
+// Add a traceback entry. If cache is not NULL, it points to a static slot
+// that holds the code object of the call site (or NULL if it hasn't been
+// created yet), so that the code object is only created once. The cached
+// code object is never freed.
+static void CPy_AddTracebackEntry(PyCodeObject **cache, const char *filename,
+                                  const char *funcname, int line, PyObject *globals) {
     PyObject *exc, *val, *tb;
     PyThreadState *thread_state = PyThreadState_GET();
     PyFrameObject *frame_obj;
+    CPyStats_INC(traceback);
 
     // We need to save off the exception state because in 3.8,
     // PyFrame_New fails if there is an error set and it fails to look
@@ -233,9 +276,19 @@ void CPy_AddTraceback(const char *filename, const char *funcname, int line, PyOb
     // FS encoding, which could have a decoder in Python. We don't do
     // that so *that* doesn't apply to us.)
     PyErr_Fetch(&exc, &val, &tb);
-    PyCodeObject *code_obj = CPy_CreateCodeObject(filename, funcname, line);
+    PyCodeObject *code_obj = cache != NULL ? *cache : NULL;
     if (code_obj == NULL) {
-        goto error;
+        code_obj = CPy_CreateCodeObject(filename, funcname, line);
+        if (code_obj == NULL) {
+            goto error;
+        }
+        if (cache != NULL) {
+            // The cache owns this reference
+            *cache = code_obj;
+        }
+    }
+    if (cache != NULL) {
+        Py_INCREF(code_obj);
     }
 
     frame_obj = PyFrame_New(thread_state, code_obj, globals, 0);
@@ -254,3 +307,15 @@ void CPy_AddTraceback(const char *filename, const char *funcname, int line, PyOb
 error:
     _PyErr_ChainExceptions(exc, val, tb);
 }
+
+void CPy_AddTraceback(const char *filename, const char *funcname, int line, PyObject *globals) {
+    CPy_AddTracebackEntry(NULL, filename, funcname, line, globals);
+}
+
+// Generated code uses this, with a static code object slot for each distinct
+// traceback entry. After the first exception at a call site, adding the
+// traceback entry only needs to create a frame.
+void CPy_AddTracebackCached(PyCodeObject **cache, const char *filename, const char *funcname,
+                            int line, PyObject *globals) {
+    CPy_AddTracebackEntry(cache, filename, funcname, line, globals);
+}
@@ -0,0 +1,171 @@
+// Float primitive operations
+//
+// These work with unboxed C doubles. See the comment in CPy.h.
+
+#include <Python.h>
+#include "CPy.h"
+
+double CPyFloat_FromTagged(CPyTagged x) {
+    if (likely(CPyTagged_CheckShort(x))) {
+        return CPyTagged_ShortAsSsize_t(x);
+    }
+    double result = PyLong_AsDouble(CPyTagged_LongAsObject(x));
+    if (unlikely(result == -1.0 && PyErr_Occurred())) {
+        return CPY_FLOAT_ERROR;
+    }
+    return result;
+}
+
+double CPyFloat_FromObject(PyObject *o) {
+    if (likely(PyFloat_CheckExact(o))) {
+        return PyFloat_AS_DOUBLE(o);
+    } else if (PyLong_Check(o)) {
+        // mypy lets ints silently coerce to floats
+        double result = PyLong_AsDouble(o);
+        if (unlikely(result == -1.0 && PyErr_Occurred())) {
+            return CPY_FLOAT_ERROR;
+        }
+        return result;
+    } else if (PyFloat_Check(o)) {
+        return PyFloat_AS_DOUBLE(o);
+    }
+    CPy_TypeError("float", o);
+    return CPY_FLOAT_ERROR;
+}
+
+// Truncate towards zero, like int(x)
+CPyTagged CPyTagged_FromFloat(double x) {
+    // The comparisons are false for NaN
+    if (x >= (double)CPY_TAGGED_MIN && x < (double)CPY_TAGGED_MAX) {
+        return CPyTagged_ShortFromSsize_t((Py_ssize_t)x);
+    }
+    PyObject *result = PyLong_FromDouble(x);
+    if (result == NULL) {
+        return CPY_INT_TAG;
+    }
+    return CPyTagged_StealFromObject(result);
+}
+
+bool CPyFloat_IsEqTagged_(double x, CPyTagged y) {
+    PyObject *xobj = PyFloat_FromDouble(x);
+    if (xobj == NULL) {
+        CPyError_OutOfMemory();
+    }
+    PyObject *yobj = CPyTagged_AsObject(y);
+    // Comparing a float and an int can't fail
+    int result = PyObject_RichCompareBool(xobj, yobj, Py_EQ);
+    Py_DECREF(xobj);
+    Py_DECREF(yobj);
+    return result == 1;
+}
+
+double CPyFloat_TrueDivide(double x, double y) {
+    if (unlikely(y == 0.0)) {
+        PyErr_SetString(PyExc_ZeroDivisionError, "float division by zero");
+        return CPY_FLOAT_ERROR;
+    }
+    return x / y;
+}
+
+// Floor division and modulus follow float_divmod() in CPython's floatobject.c
+
+double CPyFloat_FloorDivide(double x, double y) {
+    if (unlikely(y == 0.0)) {
+        PyErr_SetString(PyExc_ZeroDivisionError, "float divmod()");
+        return CPY_FLOAT_ERROR;
+    }
+    double mod = fmod(x, y);
+    double div = (x - mod) / y;
+    if (mod && ((y < 0) != (mod < 0))) {
+        div -= 1.0;
+    }
+    if (div) {
+        double floordiv = floor(div);
+        if (div - floordiv > 0.5) {
+            floordiv += 1.0;
+        }
+        return floordiv;
+    }
+    return copysign(0.0, x / y);
+}
+
+double CPyFloat_Remainder(double x, double y) {
+    if (unlikely(y == 0.0)) {
+        PyErr_SetString(PyExc_ZeroDivisionError, "float modulo");
+        return CPY_FLOAT_ERROR;
+    }
+    double mod = fmod(x, y);
+    if (mod) {
+        if ((y < 0) != (mod < 0)) {
+            mod += y;
+        }
+        return mod;
+    }
+    return copysign(0.0, y);
+}
+
+
+// Fast versions of math module functions. These raise the same exceptions
+// as the math module.
+
+
+static double CPyFloat_DomainError(void) {
+    PyErr_SetString(PyExc_ValueError, "math domain error");
+    return CPY_FLOAT_ERROR;
+}
+
+static double CPyFloat_RangeError(void) {
+    PyErr_SetString(PyExc_OverflowError, "math range error");
+    return CPY_FLOAT_ERROR;
+}
+
+double CPyFloat_Sqrt(double x) {
+    if (unlikely(x < 0.0)) {
+        return CPyFloat_DomainError();
+    }
+    return sqrt(x);
+}
+
+double CPyFloat_Exp(double x) {
+    double result = exp(x);
+    if (unlikely(Py_IS_INFINITY(result) && Py_IS_FINITE(x))) {
+        return CPyFloat_RangeError();
+    }
+    return result;
+}
+
+double CPyFloat_Log(double x) {
+    if (unlikely(x <= 0.0)) {
+        return CPyFloat_DomainError();
+    }
+    return log(x);
+}
+
+double CPyFloat_Sin(double x) {
+    if (unlikely(Py_IS_INFINITY(x))) {
+        return CPyFloat_DomainError();
+    }
+    return sin(x);
+}
+
+double CPyFloat_Cos(double x) {
+    if (unlikely(Py_IS_INFINITY(x))) {
+        return CPyFloat_DomainError();
+    }
+    return cos(x);
+}
+
+double CPyFloat_Tan(double x) {
+    if (unlikely(Py_IS_INFINITY(x))) {
+        return CPyFloat_DomainError();
+    }
+    return tan(x);
+}
+
+CPyTagged CPyFloat_Floor(double x) {
+    return CPyTagged_FromFloat(floor(x));
+}
+
+CPyTagged CPyFloat_Ceil(double x) {
+    return CPyTagged_FromFloat(ceil(x));
+}
@@ -6,7 +6,7 @@
 #include "CPy.h"
 
 CPyTagged CPyObject_Hash(PyObject *o) {
-    Py_hash_t h = PyObject_Hash(o);
+    Py_hash_t h = CPyObject_HashNative(o);
     if (h == -1) {
         return CPY_INT_TAG;
     } else {
@@ -15,22 +15,291 @@ CPyTagged CPyObject_Hash(PyObject *o) {
         // cover 63. This means that half the time we are boxing the
         // result for basically no good reason. To add insult to
         // injury it is probably about to be immediately unboxed by a
-        // tp_hash wrapper.
+        // tp_hash wrapper. Use CPyObject_HashNative to avoid this
+        // where a native integer will do.
         return CPyTagged_FromSsize_t(h);
     }
 }
 
 PyObject *CPyObject_GetAttr3(PyObject *v, PyObject *name, PyObject *defl)
 {
-    PyObject *result = PyObject_GetAttr(v, name);
-    if (!result && PyErr_ExceptionMatches(PyExc_AttributeError)) {
-        PyErr_Clear();
+    PyObject *result;
+    if (CPyObject_LookupAttr(v, name, &result) == 0) {
         Py_INCREF(defl);
         result = defl;
     }
     return result;
 }
 
+// hasattr(v, name). Unlike PyObject_HasAttr, this propagates errors other
+// than AttributeError, like the builtin does.
+int CPyObject_HasAttr(PyObject *v, PyObject *name)
+{
+    PyObject *result;
+    int found = CPyObject_LookupAttr(v, name, &result);
+    Py_XDECREF(result);
+    return found;
+}
+
+// Inline caches for attribute lookups on non-native objects
+//
+// Objects that use the generic attribute lookup cache the result of the
+// MRO lookup, keyed by the version tag of the type. CPython invalidates
+// the version tag whenever the type or one of its bases is modified.
+// Module attributes are cached using the version tag of the module dict.
+
+#define CPY_CACHE_ATTR 1        // Value is a non-data descriptor, a class attribute or NULL
+#define CPY_CACHE_DATA_DESCR 2  // Value is a data descriptor
+#define CPY_CACHE_MODULE 3      // Value is an item of the module dict, which is the owner
+
+#if PY_MAJOR_VERSION >= 3 && PY_MINOR_VERSION >= 6
+// Maximum number of arguments of a method call that are passed on the stack
+#define CPY_CACHE_MAX_ARGS 8
+#else
+// No fast calls, so always pass arguments in a tuple
+#define CPY_CACHE_MAX_ARGS 0
+#endif
+
+static inline uint64_t CPyType_Version(PyTypeObject *type) {
+    if (PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG)) {
+        return type->tp_version_tag;
+    }
+    return 0;
+}
+
+static inline bool CPyInlineCache_CheckType(CPyInlineCache *cache, PyTypeObject *type) {
+    return cache->owner == type && cache->kind != CPY_CACHE_MODULE
+        && cache->version == CPyType_Version(type);
+}
+
+// Look up name in the MRO of type and record the result. Return false if
+// the type has no valid version tag.
+static bool CPyInlineCache_LookupType(CPyInlineCache *cache, PyTypeObject *type,
+                                      PyObject *name) {
+    // This also assigns a version tag to the type if needed
+    PyObject *descr = _PyType_Lookup(type, name);
+    uint64_t version = CPyType_Version(type);
+    if (version == 0) {
+        return false;
+    }
+    cache->owner = type;
+    cache->version = version;
+    cache->value = descr;
+    if (descr != NULL && Py_TYPE(descr)->tp_descr_get != NULL
+            && Py_TYPE(descr)->tp_descr_set != NULL) {
+        cache->kind = CPY_CACHE_DATA_DESCR;
+    } else {
+        cache->kind = CPY_CACHE_ATTR;
+    }
+    return true;
+}
+
+// Look up name in the instance dict of obj. Return a new reference, or NULL
+// if not found or on error.
+static PyObject *CPyObject_InstanceDictLookup(PyObject *obj, PyObject *name) {
+    if (Py_TYPE(obj)->tp_dictoffset == 0) {
+        return NULL;
+    }
+    PyObject **dictptr = _PyObject_GetDictPtr(obj);
+    if (dictptr == NULL || *dictptr == NULL) {
+        return NULL;
+    }
+    PyObject *dict = *dictptr;
+    Py_INCREF(dict);
+    PyObject *res = PyDict_GetItemWithError(dict, name);
+    Py_XINCREF(res);
+    Py_DECREF(dict);
+    return res;
+}
+
+// Same as PyObject_GenericGetAttr, but use the MRO lookup result in the cache
+static PyObject *CPyObject_GenericGetAttrCached(PyObject *obj, PyObject *name,
+                                                CPyInlineCache *cache) {
+    PyObject *type = (PyObject *)Py_TYPE(obj);
+    PyObject *descr = cache->value;
+    PyObject *res;
+    // The descriptor could be freed if the type is modified during the lookup
+    Py_XINCREF(descr);
+    if (cache->kind == CPY_CACHE_DATA_DESCR) {
+        res = Py_TYPE(descr)->tp_descr_get(descr, obj, type);
+    } else {
+        res = CPyObject_InstanceDictLookup(obj, name);
+        if (res == NULL && !PyErr_Occurred()) {
+            if (descr == NULL) {
+                // Produce the usual AttributeError
+                res = PyObject_GetAttr(obj, name);
+            } else if (Py_TYPE(descr)->tp_descr_get != NULL) {
+                res = Py_TYPE(descr)->tp_descr_get(descr, obj, type);
+            } else {
+                Py_INCREF(descr);
+                res = descr;
+            }
+        }
+    }
+    Py_XDECREF(descr);
+    return res;
+}
+
+static PyObject *CPyModule_GetAttrCached(PyObject *module, PyObject *name,
+                                         CPyInlineCache *cache) {
+    PyObject *dict = PyModule_GetDict(module);
+    if (cache->owner == dict && cache->kind == CPY_CACHE_MODULE
+            && cache->version == CPyDict_Version(dict)) {
+        Py_INCREF(cache->value);
+        return cache->value;
+    }
+    PyObject *res = PyObject_GetAttr(module, name);
+    // Only cache items of the module dict, and not results of a module
+    // __getattr__ or attributes of the module type
+    if (res != NULL && _PyType_Lookup(Py_TYPE(module), name) == NULL
+            && PyDict_GetItem(dict, name) == res) {
+        uint64_t version = CPyDict_Version(dict);
+        if (version != 0) {
+            cache->owner = dict;
+            cache->version = version;
+            cache->value = res;
+            cache->kind = CPY_CACHE_MODULE;
+        }
+    }
+    return res;
+}
+
+// getattr(obj, 'name') with a constant attribute name
+PyObject *CPyObject_GetAttrCached(PyObject *obj, PyObject *name, CPyInlineCache *cache) {
+    CPyAttrProfile_Record(cache, obj, name);
+    PyTypeObject *type = Py_TYPE(obj);
+    if (type->tp_getattro == PyObject_GenericGetAttr) {
+        if (CPyInlineCache_CheckType(cache, type)
+                || CPyInlineCache_LookupType(cache, type, name)) {
+            return CPyObject_GenericGetAttrCached(obj, name, cache);
+        }
+    } else if (type == &PyModule_Type) {
+        return CPyModule_GetAttrCached(obj, name, cache);
+    }
+    return PyObject_GetAttr(obj, name);
+}
+
+static inline bool CPy_IsMethodDescriptor(PyObject *descr) {
+#if PY_MAJOR_VERSION >= 3 && PY_MINOR_VERSION >= 8
+    return PyType_HasFeature(Py_TYPE(descr), Py_TPFLAGS_METHOD_DESCRIPTOR);
+#else
+    return PyFunction_Check(descr) || Py_TYPE(descr) == &PyMethodDescr_Type;
+#endif
+}
+
+// Look up a method to call it. If it's a function or a method descriptor
+// in the type, return it without binding it to obj and set *unbound. This
+// avoids creating a bound method object, like _PyObject_GetMethod.
+static PyObject *CPyObject_GetMethodCached(PyObject *obj, PyObject *name,
+                                           CPyInlineCache *cache, bool *unbound) {
+    PyTypeObject *type = Py_TYPE(obj);
+    *unbound = false;
+    if (type->tp_getattro == PyObject_GenericGetAttr) {
+        if (!CPyInlineCache_CheckType(cache, type)
+                && !CPyInlineCache_LookupType(cache, type, name)) {
+            return PyObject_GetAttr(obj, name);
+        }
+        PyObject *descr = cache->value;
+        if (cache->kind == CPY_CACHE_ATTR && descr != NULL && CPy_IsMethodDescriptor(descr)) {
+            Py_INCREF(descr);
+            PyObject *attr = CPyObject_InstanceDictLookup(obj, name);
+            if (attr != NULL || PyErr_Occurred()) {
+                Py_DECREF(descr);
+                return attr;
+            }
+            *unbound = true;
+            return descr;
+        }
+        return CPyObject_GenericGetAttrCached(obj, name, cache);
+    } else if (type == &PyModule_Type) {
+        return CPyModule_GetAttrCached(obj, name, cache);
+    }
+    return PyObject_GetAttr(obj, name);
+}
+
+// obj.name(arg, ...) with a NULL terminated list of positional arguments
+PyObject *CPyObject_CallMethodCached(PyObject *obj, PyObject *name, CPyInlineCache *cache, ...) {
+    CPyAttrProfile_Record(cache, obj, name);
+    Py_ssize_t nargs = 0;
+    va_list vargs;
+    va_start(vargs, cache);
+    while (va_arg(vargs, PyObject *) != NULL) {
+        nargs++;
+    }
+    va_end(vargs);
+
+    if (CPY_CACHE_MAX_ARGS == 0 || nargs > CPY_CACHE_MAX_ARGS) {
+        PyObject *args = PyTuple_New(nargs);
+        if (args == NULL) {
+            return NULL;
+        }
+        Py_ssize_t i;
+        va_start(vargs, cache);
+        for (i = 0; i < nargs; i++) {
+            PyObject *arg = va_arg(vargs, PyObject *);
+            Py_INCREF(arg);
+            PyTuple_SET_ITEM(args, i, arg);
+        }
+        va_end(vargs);
+        PyObject *res = NULL;
+        PyObject *meth = CPyObject_GetAttrCached(obj, name, cache);
+        if (meth != NULL) {
+            res = PyObject_Call(meth, args, NULL);
+            Py_DECREF(meth);
+        }
+        Py_DECREF(args);
+        return res;
+    }
+
+#if CPY_CACHE_MAX_ARGS > 0
+    PyObject *stack[CPY_CACHE_MAX_ARGS + 1];
+    stack[0] = obj;
+    Py_ssize_t i;
+    va_start(vargs, cache);
+    for (i = 1; i <= nargs; i++) {
+        stack[i] = va_arg(vargs, PyObject *);
+    }
+    va_end(vargs);
+    bool unbound;
+    PyObject *meth = CPyObject_GetMethodCached(obj, name, cache, &unbound);
+    if (meth == NULL) {
+        return NULL;
+    }
+    PyObject *res;
+    if (unbound) {
+        res = _PyObject_FastCall(meth, stack, nargs + 1);
+    } else {
+        res = _PyObject_FastCall(meth, stack + 1, nargs);
+    }
+    Py_DECREF(meth);
+    return res;
+#endif
+}
+
+#if PY_MAJOR_VERSION >= 3 && PY_MINOR_VERSION >= 9
+// Same as PyObject_VectorcallMethod, but use an inline cache
+PyObject *CPyObject_VectorcallMethodCached(PyObject *name, PyObject *const *args, size_t nargsf,
+                                           PyObject *kwnames, CPyInlineCache *cache) {
+    CPyAttrProfile_Record(cache, args[0], name);
+    bool unbound;
+    PyObject *meth = CPyObject_GetMethodCached(args[0], name, cache, &unbound);
+    if (meth == NULL) {
+        return NULL;
+    }
+    size_t nargs = PyVectorcall_NARGS(nargsf);
+    PyObject *res;
+    if (unbound) {
+        res = PyObject_Vectorcall(meth, args, nargs, kwnames);
+    } else {
+        // The callee may temporarily overwrite args[0]
+        res = PyObject_Vectorcall(meth, args + 1, (nargs - 1) | PY_VECTORCALL_ARGUMENTS_OFFSET,
+                                  kwnames);
+    }
+    Py_DECREF(meth);
+    return res;
+}
+#endif
+
 PyObject *CPyIter_Next(PyObject *iter)
 {
     return (*iter->ob_type->tp_iternext)(iter);
@@ -42,6 +311,7 @@ PyObject *CPyNumber_Power(PyObject *base, PyObject *index)
 }
 
 PyObject *CPyObject_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end) {
+    CPyStats_INC(get_slice_generic);
     PyObject *start_obj = CPyTagged_AsObject(start);
     PyObject *end_obj = CPyTagged_AsObject(end);
     if (unlikely(start_obj == NULL || end_obj == NULL)) {
@@ -57,3 +327,38 @@ PyObject *CPyObject_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end) {
     Py_DECREF(slice);
     return result;
 }
+
+PyObject *CPyObject_GetSliceStep(PyObject *obj, CPyTagged start, CPyTagged end, CPyTagged step) {
+    CPyStats_INC(get_slice_generic);
+    PyObject *start_obj = CPyTagged_AsObject(start);
+    PyObject *end_obj = CPyTagged_AsObject(end);
+    PyObject *step_obj = CPyTagged_AsObject(step);
+    PyObject *slice = NULL;
+    if (likely(start_obj != NULL && end_obj != NULL && step_obj != NULL)) {
+        slice = PySlice_New(start_obj, end_obj, step_obj);
+    }
+    Py_XDECREF(start_obj);
+    Py_XDECREF(end_obj);
+    Py_XDECREF(step_obj);
+    if (unlikely(slice == NULL)) {
+        return NULL;
+    }
+    PyObject *result = PyObject_GetItem(obj, slice);
+    Py_DECREF(slice);
+    return result;
+}
+
+// Return the first index of seq[index::step] (or the end of seq[:index:step]).
+// seq must be an exact list, tuple or str. This is used to iterate over a slice
+// without creating it. Since the length is only used for clamping, the result
+// stays valid (although possibly out of range) if a list shrinks afterwards.
+CPyTagged CPySequence_SliceIndex(PyObject *seq, CPyTagged index, CPyTagged step) {
+    Py_ssize_t length;
+    if (PyUnicode_Check(seq)) {
+        length = PyUnicode_GET_LENGTH(seq);
+    } else {
+        length = Py_SIZE(seq);
+    }
+    Py_ssize_t n = CPySlice_AdjustIndex(index, length, CPyTagged_ShortAsSsize_t(step));
+    return CPyTagged_ShortFromSsize_t(n);
+}
@@ -13,6 +13,9 @@
  *    variety of vararg.
  *    Unlike most format specifiers, the caller takes ownership of these objects
  *    and is responsible for decrefing them.
+ *  - CPyArg_ParseStackAndKeywordsSlots takes a CPyArg_Descriptor generated by the
+ *    compiler instead of a format string, and stores the arguments into an array
+ *    of slots instead of varargs.
  */
 
 #include <Python.h>
@@ -127,6 +130,7 @@ parser_init(CPyArg_Parser *parser)
     if (parser->kwtuple != NULL) {
         return 1;
     }
+    CPyStats_INC(arg_parser_init);
 
     keywords = parser->keywords;
     /* scan keywords and count the number of positional-only parameters */
@@ -555,6 +559,343 @@ latefail:
     return 0;
 }
 
+/* Create the tuple of interned keyword names of a descriptor, and a hash
+ * table mapping the names to argument indexes */
+static int
+descriptor_init(CPyArg_Descriptor *desc)
+{
+    PyObject *kwtuple;
+    int *kwtable;
+    int i, size;
+
+    if (desc->kwtuple != NULL) {
+        return 1;
+    }
+    CPyStats_INC(arg_parser_init);
+
+    /* keep the table at most half full so that probe sequences stay short */
+    for (size = 1; size < 2 * desc->len; size <<= 1) {
+    }
+    kwtable = PyMem_Calloc(size, sizeof(int));
+    if (kwtable == NULL) {
+        PyErr_NoMemory();
+        return 0;
+    }
+    kwtuple = PyTuple_New(desc->len);
+    if (kwtuple == NULL) {
+        PyMem_Free(kwtable);
+        return 0;
+    }
+    for (i = 0; i < desc->len; i++) {
+        Py_hash_t hash;
+        size_t j;
+        PyObject *str = PyUnicode_FromString(desc->keywords[i]);
+        if (str == NULL) {
+            goto fail;
+        }
+        PyUnicode_InternInPlace(&str);
+        PyTuple_SET_ITEM(kwtuple, i, str);
+        hash = PyObject_Hash(str);
+        if (hash == -1) {
+            goto fail;
+        }
+        for (j = (size_t)hash & (size - 1); kwtable[j] != 0; j = (j + 1) & (size - 1)) {
+        }
+        kwtable[j] = i + 1;
+    }
+    desc->kwtable = kwtable;
+    desc->kwmask = size - 1;
+    desc->kwtuple = kwtuple;
+    return 1;
+fail:
+    Py_DECREF(kwtuple);
+    PyMem_Free(kwtable);
+    return 0;
+}
+
+/* Return the index of the argument with the given name, or -1 if there is none */
+static int
+descriptor_find_keyword(CPyArg_Descriptor *desc, PyObject *key)
+{
+    /* str objects cache their hash, so this is cheap for keyword names */
+    size_t j = (size_t)PyObject_Hash(key) & desc->kwmask;
+    int index;
+
+    /* Identity almost always matches, since keyword names are normally interned */
+    while ((index = desc->kwtable[j]) != 0) {
+        PyObject *kwname = PyTuple_GET_ITEM(desc->kwtuple, index - 1);
+        if (kwname == key || _PyUnicode_EQ(kwname, key)) {
+            return index - 1;
+        }
+        j = (j + 1) & desc->kwmask;
+    }
+    return -1;
+}
+
+static int
+parse_slots_impl(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames,
+                 CPyArg_Descriptor *desc, CPyArg_Slot *slots)
+{
+    PyObject *keyword;
+    int i, index, len, bound_pos_args;
+    Py_ssize_t j, nkwargs, nextra;
+    PyObject *const *kwstack = NULL;
+    PyObject **p_args = NULL, **p_kwargs = NULL;
+
+    len = desc->len;
+    if (desc->has_star) {
+        p_args = &slots[len].obj;
+    }
+    if (desc->has_star2) {
+        p_kwargs = &slots[len + desc->has_star].obj;
+    }
+
+    if (kwnames != NULL) {
+        nkwargs = PyTuple_GET_SIZE(kwnames);
+        kwstack = args + nargs;
+        if (!descriptor_init(desc)) {
+            return 0;
+        }
+    }
+    else {
+        nkwargs = 0;
+    }
+    if (nargs + nkwargs > len && !p_args && !p_kwargs) {
+        PyErr_Format(PyExc_TypeError,
+                     "%.200s() takes at most %d %sargument%s (%zd given)",
+                     desc->fname,
+                     len,
+                     (nargs == 0) ? "keyword " : "",
+                     (len == 1) ? "" : "s",
+                     nargs + nkwargs);
+        return 0;
+    }
+    if (desc->max < nargs && !p_args) {
+        if (desc->max == 0) {
+            PyErr_Format(PyExc_TypeError,
+                         "%.200s() takes no positional arguments",
+                         desc->fname);
+        }
+        else {
+            PyErr_Format(PyExc_TypeError,
+                         "%.200s() takes %s %d positional argument%s (%zd given)",
+                         desc->fname,
+                         (desc->min < desc->max) ? "at most" : "exactly",
+                         desc->max,
+                         desc->max == 1 ? "" : "s",
+                         nargs);
+        }
+        return 0;
+    }
+
+    bound_pos_args = Py_MIN(nargs, desc->max);
+    for (i = 0; i < bound_pos_args; i++) {
+        slots[i].obj = args[i];
+    }
+    for (; i < len; i++) {
+        slots[i].obj = NULL;
+    }
+
+    /* bind keyword arguments, looking up each given name only once */
+    nextra = 0;
+    for (j = 0; j < nkwargs; j++) {
+        index = descriptor_find_keyword(desc, PyTuple_GET_ITEM(kwnames, j));
+        if (index >= bound_pos_args) {
+            slots[index].obj = kwstack[j];
+        }
+        else {
+            /* unknown keyword, or the argument was also given by position */
+            nextra++;
+        }
+    }
+
+    for (i = bound_pos_args; i < len; i++) {
+        if (slots[i].obj == NULL && (i < desc->min || i >= desc->required_kwonly_start)) {
+            /* Less arguments than required */
+            if (i >= desc->max) {
+                PyErr_Format(PyExc_TypeError,  "%.200s() missing required "
+                             "keyword-only argument '%s'",
+                             desc->fname, desc->keywords[i]);
+            }
+            else {
+                PyErr_Format(PyExc_TypeError,  "%.200s() missing required "
+                             "argument '%s' (pos %d)",
+                             desc->fname, desc->keywords[i], i+1);
+            }
+            return 0;
+        }
+    }
+    if (!nextra && !p_args && !p_kwargs) {
+        return 1;
+    }
+
+    if (p_args) {
+        *p_args = PyTuple_New(nargs - bound_pos_args);
+        if (!*p_args) {
+            return 0;
+        }
+        for (i = bound_pos_args; i < nargs; i++) {
+            PyObject *arg = args[i];
+            Py_INCREF(arg);
+            PyTuple_SET_ITEM(*p_args, i - bound_pos_args, arg);
+        }
+    }
+
+    if (p_kwargs) {
+        if (nargs > 0 && len == 0 && !p_args) {
+            PyErr_Format(PyExc_TypeError,
+                         "%.200s() takes no positional arguments",
+                         desc->fname);
+            return 0;
+        }
+
+        *p_kwargs = PyDict_New();
+        if (!*p_kwargs) {
+            goto latefail;
+        }
+    }
+
+    if (nextra > 0) {
+        /* make sure there are no arguments given by name and position */
+        for (j = 0; j < nkwargs; j++) {
+            index = descriptor_find_keyword(desc, PyTuple_GET_ITEM(kwnames, j));
+            if (index >= 0 && index < bound_pos_args) {
+                PyErr_Format(PyExc_TypeError,
+                             "argument for %.200s() given by name ('%U') "
+                             "and position (%d)",
+                             desc->fname, PyTuple_GET_ITEM(kwnames, j), index+1);
+                goto latefail;
+            }
+        }
+        /* make sure there are no extraneous keyword arguments */
+        for (j = 0; j < nkwargs; j++) {
+            keyword = PyTuple_GET_ITEM(kwnames, j);
+            if (descriptor_find_keyword(desc, keyword) < 0) {
+                if (!p_kwargs) {
+                    PyErr_Format(PyExc_TypeError,
+                                 "'%S' is an invalid keyword "
+                                 "argument for %.200s()",
+                                 keyword, desc->fname);
+                    goto latefail;
+                }
+                if (PyDict_SetItem(*p_kwargs, keyword, kwstack[j]) < 0) {
+                    goto latefail;
+                }
+            }
+        }
+    }
+
+    return 1;
+latefail:
+    if (p_args) {
+        Py_CLEAR(*p_args);
+    }
+    if (p_kwargs) {
+        Py_CLEAR(*p_kwargs);
+    }
+    return 0;
+}
+
+/* Type check the named arguments in slots and unbox ints and bools in place.
+ * Return 0 and raise TypeError if an argument has the wrong type. */
+static int
+unbox_slots(CPyArg_Descriptor *desc, CPyArg_Slot *slots)
+{
+    const CPyArg_Type *types = desc->types;
+    int i;
+
+    for (i = 0; i < desc->len; i++) {
+        PyObject *obj = slots[i].obj;
+        switch (types[i].kind) {
+        case CPYARG_INT:
+            if (obj == NULL) {
+                slots[i].tagged = CPY_INT_TAG;
+                continue;
+            }
+            if (likely(PyLong_Check(obj))) {
+                slots[i].tagged = CPyTagged_BorrowFromObject(obj);
+                continue;
+            }
+            break;
+        case CPYARG_BOOL:
+            if (obj == NULL) {
+                slots[i].boolean = 2;
+                continue;
+            }
+            if (likely(PyBool_Check(obj))) {
+                slots[i].boolean = obj == Py_True;
+                continue;
+            }
+            break;
+        case CPYARG_STR:
+            if (obj == NULL || likely(PyUnicode_Check(obj))) {
+                continue;
+            }
+            break;
+        case CPYARG_LIST:
+            if (obj == NULL || likely(PyList_Check(obj))) {
+                continue;
+            }
+            break;
+        case CPYARG_DICT:
+            if (obj == NULL || likely(PyDict_Check(obj))) {
+                continue;
+            }
+            break;
+        case CPYARG_INSTANCE:
+            if (obj == NULL || likely(PyObject_TypeCheck(obj, *types[i].type))) {
+                continue;
+            }
+            break;
+        default:
+            continue;
+        }
+        CPy_TypeError(types[i].name, obj);
+        return 0;
+    }
+    return 1;
+}
+
+/* Parse args using a precomputed descriptor, storing them into an array of slots.
+ *
+ * Optional arguments that weren't given are set to NULL. The caller owns the
+ * *args and **kwargs objects, if the descriptor accepts them.
+ *
+ * If the descriptor has argument types, the named arguments are also type
+ * checked, and ints and bools are unboxed (missing ones are set to the error
+ * value). Return -1 if an argument has the wrong type, and 0 if the arguments
+ * don't match the signature, so that the caller can tell which errors happened
+ * inside the function. */
+int
+CPyArg_ParseStackAndKeywordsSlots(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames,
+                                  CPyArg_Descriptor *desc, CPyArg_Slot *slots)
+{
+    if (kwnames == NULL && nargs >= desc->min && nargs <= desc->max
+            && desc->required_kwonly_start == INT_MAX && !desc->has_star && !desc->has_star2) {
+        // Fast path: correct number of positional arguments only
+        Py_ssize_t i;
+        for (i = 0; i < nargs; i++) {
+            slots[i].obj = args[i];
+        }
+        for (; i < desc->len; i++) {
+            slots[i].obj = NULL;
+        }
+    }
+    else if (!parse_slots_impl(args, nargs, kwnames, desc, slots)) {
+        return 0;
+    }
+    if (desc->types != NULL && !unbox_slots(desc, slots)) {
+        if (desc->has_star) {
+            Py_CLEAR(slots[desc->len].obj);
+        }
+        if (desc->has_star2) {
+            Py_CLEAR(slots[desc->len + desc->has_star].obj);
+        }
+        return -1;
+    }
+    return 1;
+}
+
 static void
 skipitem_fast(const char **p_format, va_list *p_va)
 {
@@ -10,4 +10,7 @@ PyObject *_CPy_ExcDummy = (PyObject *)&_CPy_ExcDummyStruct;
 // things at load time.
 void CPy_Init(void) {
     _CPy_ExcDummyStruct.ob_base.ob_type = &PyBaseObject_Type;
+#ifdef MYPYC_STATS
+    CPyStats_Init();
+#endif
 }
@@ -31,9 +31,11 @@ CPyTagged CPyTagged_FromObject(PyObject *object) {
     // The overflow check knows about CPyTagged's width
     Py_ssize_t value = CPyLong_AsSsize_tAndOverflow(object, &overflow);
     if (unlikely(overflow != 0)) {
+        CPyStats_INC(int_unbox_long);
         Py_INCREF(object);
         return ((CPyTagged)object) | CPY_INT_TAG;
     } else {
+        CPyStats_INC(int_unbox_short);
         return value << 1;
     }
 }
@@ -43,8 +45,10 @@ CPyTagged CPyTagged_StealFromObject(PyObject *object) {
     // The overflow check knows about CPyTagged's width
     Py_ssize_t value = CPyLong_AsSsize_tAndOverflow(object, &overflow);
     if (unlikely(overflow != 0)) {
+        CPyStats_INC(int_unbox_long);
         return ((CPyTagged)object) | CPY_INT_TAG;
     } else {
+        CPyStats_INC(int_unbox_short);
         Py_DECREF(object);
         return value << 1;
     }
@@ -55,19 +59,107 @@ CPyTagged CPyTagged_BorrowFromObject(PyObject *object) {
     // The overflow check knows about CPyTagged's width
     Py_ssize_t value = CPyLong_AsSsize_tAndOverflow(object, &overflow);
     if (unlikely(overflow != 0)) {
+        CPyStats_INC(int_unbox_long);
         return ((CPyTagged)object) | CPY_INT_TAG;
     } else {
+        CPyStats_INC(int_unbox_short);
         return value << 1;
     }
 }
 
+#ifdef MYPYC_INT_CACHE
+
+// Optional cache of boxed short ints, enabled by defining MYPYC_INT_CACHE
+// when compiling. CPython already shares int objects in a small range
+// around zero; this keeps recently boxed values outside that range around
+// so that boxing the same value repeatedly doesn't allocate each time.
+//
+// The cache is a direct-mapped table indexed by the low bits of the value,
+// so a contiguous range of MYPYC_INT_CACHE_SIZE values can be cached at
+// once. The size must be a power of two.
+
+#ifndef MYPYC_INT_CACHE_SIZE
+#define MYPYC_INT_CACHE_SIZE 4096
+#endif
+
+#if (MYPYC_INT_CACHE_SIZE & (MYPYC_INT_CACHE_SIZE - 1)) != 0
+#error "MYPYC_INT_CACHE_SIZE must be a power of two"
+#endif
+
+// Range of values that CPython caches by itself
+#define CPY_SMALL_INT_MIN -5
+#define CPY_SMALL_INT_MAX 256
+
+static PyObject *CPyIntCache_Objects[MYPYC_INT_CACHE_SIZE];
+static Py_ssize_t CPyIntCache_Values[MYPYC_INT_CACHE_SIZE];
+static CPyIntCacheStats CPyIntCache_Stats;
+
+static PyObject *CPyTagged_BoxShort(Py_ssize_t value) {
+    if (value >= CPY_SMALL_INT_MIN && value <= CPY_SMALL_INT_MAX) {
+        return CPyLong_FromSsize_t(value);
+    }
+    size_t index = (size_t)value & (MYPYC_INT_CACHE_SIZE - 1);
+    PyObject *cached = CPyIntCache_Objects[index];
+    if (likely(cached != NULL && CPyIntCache_Values[index] == value)) {
+        CPyIntCache_Stats.hits++;
+        Py_INCREF(cached);
+        return cached;
+    }
+    PyObject *obj = CPyLong_FromSsize_t(value);
+    if (unlikely(obj == NULL)) {
+        return NULL;
+    }
+    CPyIntCache_Stats.misses++;
+    if (cached != NULL) {
+        CPyIntCache_Stats.evictions++;
+    }
+    // Install the new object before releasing the old one, since releasing
+    // it may run arbitrary code.
+    Py_INCREF(obj);
+    CPyIntCache_Objects[index] = obj;
+    CPyIntCache_Values[index] = value;
+    Py_XDECREF(cached);
+    return obj;
+}
+
+void CPyTagged_GetBoxCacheStats(CPyIntCacheStats *stats) {
+    *stats = CPyIntCache_Stats;
+}
+
+void CPyTagged_ClearBoxCache(void) {
+    Py_ssize_t i;
+    for (i = 0; i < MYPYC_INT_CACHE_SIZE; i++) {
+        PyObject *obj = CPyIntCache_Objects[i];
+        CPyIntCache_Objects[i] = NULL;
+        Py_XDECREF(obj);
+    }
+    memset(&CPyIntCache_Stats, 0, sizeof(CPyIntCache_Stats));
+}
+
+#else
+
+static inline PyObject *CPyTagged_BoxShort(Py_ssize_t value) {
+    return CPyLong_FromSsize_t(value);
+}
+
+void CPyTagged_GetBoxCacheStats(CPyIntCacheStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void CPyTagged_ClearBoxCache(void) {
+}
+
+#endif
+
 PyObject *CPyTagged_AsObject(CPyTagged x) {
     PyObject *value;
     if (unlikely(CPyTagged_CheckLong(x))) {
+        CPyStats_INC(int_box_long);
         value = CPyTagged_LongAsObject(x);
         Py_INCREF(value);
     } else {
-        value = CPyLong_FromSsize_t(CPyTagged_ShortAsSsize_t(x));
+        CPyStats_INC(int_box_short);
+        value = CPyTagged_BoxShort(CPyTagged_ShortAsSsize_t(x));
         if (value == NULL) {
             CPyError_OutOfMemory();
         }
@@ -78,9 +170,11 @@ PyObject *CPyTagged_AsObject(CPyTagged x) {
 PyObject *CPyTagged_StealAsObject(CPyTagged x) {
     PyObject *value;
     if (unlikely(CPyTagged_CheckLong(x))) {
+        CPyStats_INC(int_box_long);
         value = CPyTagged_LongAsObject(x);
     } else {
-        value = CPyLong_FromSsize_t(CPyTagged_ShortAsSsize_t(x));
+        CPyStats_INC(int_box_short);
+        value = CPyTagged_BoxShort(CPyTagged_ShortAsSsize_t(x));
         if (value == NULL) {
             CPyError_OutOfMemory();
         }
@@ -96,27 +190,248 @@ Py_ssize_t CPyTagged_AsSsize_t(CPyTagged x) {
     }
 }
 
+// Convert the result of a native __hash__ method to a tp_hash result the
+// same way as slot_tp_hash does for __hash__ methods defined in Python:
+// -1 becomes -2, and ints that don't fit in Py_hash_t are hashed.
+Py_hash_t CPyTagged_AsHashValue(CPyTagged x) {
+    if (likely(CPyTagged_CheckShort(x))) {
+        Py_hash_t h = CPyTagged_ShortAsSsize_t(x);
+        return h == -1 ? -2 : h;
+    }
+    PyObject *obj = CPyTagged_LongAsObject(x);
+    Py_hash_t h = PyLong_AsSsize_t(obj);
+    if (h == -1 && PyErr_Occurred()) {
+        PyErr_Clear();
+        return PyObject_Hash(obj);
+    }
+    return h;
+}
+
+// Convert the result of a native __len__ method to an mp_length result,
+// like slot_sq_length. Return -1 on error.
+Py_ssize_t CPyTagged_AsLenValue(CPyTagged x) {
+    Py_ssize_t n = CPyTagged_AsSsize_t(x);
+    if (n == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+    if (n < 0) {
+        PyErr_SetString(PyExc_ValueError, "__len__() should return >= 0");
+        return -1;
+    }
+    return n;
+}
+
 CPy_NOINLINE
 void CPyTagged_IncRef(CPyTagged x) {
-    if (unlikely(CPyTagged_CheckLong(x))) {
+    CPyStats_INC(int_incref);
+    if (unlikely(CPyTagged_CheckLong(x)) && !CPy_IsImmortal(CPyTagged_LongAsObject(x))) {
         Py_INCREF(CPyTagged_LongAsObject(x));
     }
 }
 
 CPy_NOINLINE
 void CPyTagged_DecRef(CPyTagged x) {
-    if (unlikely(CPyTagged_CheckLong(x))) {
+    CPyStats_INC(int_decref);
+    if (unlikely(CPyTagged_CheckLong(x)) && !CPy_IsImmortal(CPyTagged_LongAsObject(x))) {
         Py_DECREF(CPyTagged_LongAsObject(x));
     }
 }
 
 CPy_NOINLINE
 void CPyTagged_XDecRef(CPyTagged x) {
-    if (unlikely(CPyTagged_CheckLong(x))) {
+    CPyStats_INC(int_decref);
+    if (unlikely(CPyTagged_CheckLong(x)) && !CPy_IsImmortal(CPyTagged_LongAsObject(x))) {
         Py_XDECREF(CPyTagged_LongAsObject(x));
     }
 }
 
+static void CPyLong_NormalizeUnsigned(PyLongObject *v) {
+    Py_ssize_t i = v->ob_base.ob_size;
+    while (i > 0 && v->ob_digit[i - 1] == 0)
+        i--;
+    v->ob_base.ob_size = i;
+}
+
+// Number of digits needed to hold the absolute value of any short int
+#define CPY_SHORT_INT_DIGITS ((CPY_INT_BITS + PyLong_SHIFT - 1) / PyLong_SHIFT)
+
+// Return pointer to digits of a PyLong object. If it's a short
+// integer, place digits in the buffer buf instead to avoid memory
+// allocation (it must have room for CPY_SHORT_INT_DIGITS digits). Return
+// the number of digits in *size. *size is negative if the integer is negative.
+static digit *GetIntDigits(CPyTagged n, Py_ssize_t *size, digit *buf) {
+    if (CPyTagged_CheckShort(n)) {
+        Py_ssize_t val = CPyTagged_ShortAsSsize_t(n);
+        bool neg = val < 0;
+        int len = 1;
+        if (neg) {
+            val = -val;
+        }
+        buf[0] = val & PyLong_MASK;
+        while (val > PyLong_MASK) {
+            val >>= PyLong_SHIFT;
+            buf[len++] = val & PyLong_MASK;
+        }
+        *size = neg ? -len : len;
+        return buf;
+    } else {
+        PyLongObject *obj = (PyLongObject *)CPyTagged_LongAsObject(n);
+        *size = obj->ob_base.ob_size;
+        return obj->ob_digit;
+    }
+}
+
+// Add absolute values of two ints given as digit arrays. The result is non-negative.
+static PyLongObject *DigitsAbsAdd(digit *a, Py_ssize_t size_a, digit *b, Py_ssize_t size_b) {
+    if (size_a < size_b) {
+        digit *tmp = a;
+        a = b;
+        b = tmp;
+        Py_ssize_t tmp_size = size_a;
+        size_a = size_b;
+        size_b = tmp_size;
+    }
+    PyLongObject *r = _PyLong_New(size_a + 1);
+    if (unlikely(r == NULL)) {
+        return NULL;
+    }
+    digit carry = 0;
+    Py_ssize_t i;
+    for (i = 0; i < size_b; i++) {
+        carry += a[i] + b[i];
+        r->ob_digit[i] = carry & PyLong_MASK;
+        carry >>= PyLong_SHIFT;
+    }
+    for (; i < size_a; i++) {
+        carry += a[i];
+        r->ob_digit[i] = carry & PyLong_MASK;
+        carry >>= PyLong_SHIFT;
+    }
+    r->ob_digit[i] = carry;
+    CPyLong_NormalizeUnsigned(r);
+    return r;
+}
+
+// Subtract absolute value of b from absolute value of a, given as digit arrays.
+// The result may be negative.
+static PyLongObject *DigitsAbsSubtract(digit *a, Py_ssize_t size_a,
+                                       digit *b, Py_ssize_t size_b) {
+    bool negate = false;
+    if (size_a < size_b) {
+        negate = true;
+    } else if (size_a == size_b) {
+        // Find highest digit where a and b differ
+        Py_ssize_t i = size_a;
+        while (--i >= 0 && a[i] == b[i])
+            ;
+        if (i < 0) {
+            return _PyLong_New(0);
+        }
+        if (a[i] < b[i]) {
+            negate = true;
+        }
+        size_a = size_b = i + 1;
+    }
+    if (negate) {
+        digit *tmp = a;
+        a = b;
+        b = tmp;
+        Py_ssize_t tmp_size = size_a;
+        size_a = size_b;
+        size_b = tmp_size;
+    }
+    PyLongObject *r = _PyLong_New(size_a);
+    if (unlikely(r == NULL)) {
+        return NULL;
+    }
+    digit borrow = 0;
+    Py_ssize_t i;
+    for (i = 0; i < size_b; i++) {
+        // The following assumes unsigned arithmetic works modulo 2**N for some N > PyLong_SHIFT
+        borrow = a[i] - b[i] - borrow;
+        r->ob_digit[i] = borrow & PyLong_MASK;
+        borrow >>= PyLong_SHIFT;
+        borrow &= 1;  // Keep only one sign bit
+    }
+    for (; i < size_a; i++) {
+        borrow = a[i] - borrow;
+        r->ob_digit[i] = borrow & PyLong_MASK;
+        borrow >>= PyLong_SHIFT;
+        borrow &= 1;
+    }
+    assert(borrow == 0);
+    CPyLong_NormalizeUnsigned(r);
+    if (negate) {
+        r->ob_base.ob_size = -r->ob_base.ob_size;
+    }
+    return r;
+}
+
+// Add or subtract two ints, at least one of which is long (or the result overflows).
+// This operates directly on the digits so that a short operand doesn't need to be boxed.
+static CPyTagged LongAddOrSubtract(CPyTagged a, CPyTagged b, bool subtract) {
+    digit abuf[CPY_SHORT_INT_DIGITS];
+    digit bbuf[CPY_SHORT_INT_DIGITS];
+    Py_ssize_t asize;
+    Py_ssize_t bsize;
+    digit *adigits = GetIntDigits(a, &asize, abuf);
+    digit *bdigits = GetIntDigits(b, &bsize, bbuf);
+    if (subtract) {
+        bsize = -bsize;
+    }
+    bool aneg = asize < 0;
+    bool bneg = bsize < 0;
+    Py_ssize_t alen = aneg ? -asize : asize;
+    Py_ssize_t blen = bneg ? -bsize : bsize;
+
+    PyLongObject *r;
+    if (aneg == bneg) {
+        // -(|a| + |b|) or |a| + |b|
+        r = DigitsAbsAdd(adigits, alen, bdigits, blen);
+    } else {
+        // -(|a| - |b|) or |a| - |b|
+        r = DigitsAbsSubtract(adigits, alen, bdigits, blen);
+    }
+    if (unlikely(r == NULL)) {
+        CPyError_OutOfMemory();
+    }
+    if (aneg) {
+        r->ob_base.ob_size = -r->ob_base.ob_size;
+    }
+    return CPyTagged_StealFromObject((PyObject *)r);
+}
+
+// Compare two ints without boxing. Return -1, 0 or 1 if a is less than, equal to
+// or greater than b, respectively.
+static int LongCompare(CPyTagged a, CPyTagged b) {
+    if (CPyTagged_CheckShort(a) && CPyTagged_CheckShort(b)) {
+        return (Py_ssize_t)a < (Py_ssize_t)b ? -1 : (a != b);
+    } else if (CPyTagged_CheckShort(a) || CPyTagged_CheckShort(b)) {
+        // Long ints are always normalized, so their magnitude is larger than
+        // that of any short int and only the sign matters.
+        if (CPyTagged_CheckShort(a)) {
+            return Py_SIZE(CPyTagged_LongAsObject(b)) < 0 ? 1 : -1;
+        } else {
+            return Py_SIZE(CPyTagged_LongAsObject(a)) < 0 ? -1 : 1;
+        }
+    }
+    PyLongObject *aobj = (PyLongObject *)CPyTagged_LongAsObject(a);
+    PyLongObject *bobj = (PyLongObject *)CPyTagged_LongAsObject(b);
+    Py_ssize_t asize = aobj->ob_base.ob_size;
+    Py_ssize_t bsize = bobj->ob_base.ob_size;
+    if (asize != bsize) {
+        return asize < bsize ? -1 : 1;
+    }
+    Py_ssize_t i = asize < 0 ? -asize : asize;
+    while (--i >= 0 && aobj->ob_digit[i] == bobj->ob_digit[i])
+        ;
+    if (i < 0) {
+        return 0;
+    }
+    int result = aobj->ob_digit[i] < bobj->ob_digit[i] ? -1 : 1;
+    return asize < 0 ? -result : result;
+}
+
 CPyTagged CPyTagged_Negate(CPyTagged num) {
     if (CPyTagged_CheckShort(num)
             && num != (CPyTagged) ((Py_ssize_t)1 << (CPY_INT_BITS - 1))) {
@@ -134,48 +449,30 @@ CPyTagged CPyTagged_Negate(CPyTagged num) {
 }
 
 CPyTagged CPyTagged_Add(CPyTagged left, CPyTagged right) {
-    // TODO: Use clang/gcc extension __builtin_saddll_overflow instead.
     if (likely(CPyTagged_CheckShort(left) && CPyTagged_CheckShort(right))) {
-        CPyTagged sum = left + right;
-        if (likely(!CPyTagged_IsAddOverflow(sum, left, right))) {
+        CPyTagged sum;
+        if (likely(!CPyTagged_ShortAddOverflow(left, right, &sum))) {
             return sum;
         }
     }
-    PyObject *left_obj = CPyTagged_AsObject(left);
-    PyObject *right_obj = CPyTagged_AsObject(right);
-    PyObject *result = PyNumber_Add(left_obj, right_obj);
-    if (result == NULL) {
-        CPyError_OutOfMemory();
-    }
-    Py_DECREF(left_obj);
-    Py_DECREF(right_obj);
-    return CPyTagged_StealFromObject(result);
+    return LongAddOrSubtract(left, right, false);
 }
 
 CPyTagged CPyTagged_Subtract(CPyTagged left, CPyTagged right) {
-    // TODO: Use clang/gcc extension __builtin_saddll_overflow instead.
     if (likely(CPyTagged_CheckShort(left) && CPyTagged_CheckShort(right))) {
-        CPyTagged diff = left - right;
-        if (likely(!CPyTagged_IsSubtractOverflow(diff, left, right))) {
+        CPyTagged diff;
+        if (likely(!CPyTagged_ShortSubtractOverflow(left, right, &diff))) {
             return diff;
         }
     }
-    PyObject *left_obj = CPyTagged_AsObject(left);
-    PyObject *right_obj = CPyTagged_AsObject(right);
-    PyObject *result = PyNumber_Subtract(left_obj, right_obj);
-    if (result == NULL) {
-        CPyError_OutOfMemory();
-    }
-    Py_DECREF(left_obj);
-    Py_DECREF(right_obj);
-    return CPyTagged_StealFromObject(result);
+    return LongAddOrSubtract(left, right, true);
 }
 
 CPyTagged CPyTagged_Multiply(CPyTagged left, CPyTagged right) {
-    // TODO: Consider using some clang/gcc extension
     if (CPyTagged_CheckShort(left) && CPyTagged_CheckShort(right)) {
-        if (!CPyTagged_IsMultiplyOverflow(left, right)) {
-            return left * CPyTagged_ShortAsSsize_t(right);
+        CPyTagged product;
+        if (likely(!CPyTagged_ShortMultiplyOverflow(left, right, &product))) {
+            return product;
         }
     }
     PyObject *left_obj = CPyTagged_AsObject(left);
@@ -190,16 +487,11 @@ CPyTagged CPyTagged_Multiply(CPyTagged left, CPyTagged right) {
 }
 
 CPyTagged CPyTagged_FloorDivide(CPyTagged left, CPyTagged right) {
-    if (CPyTagged_CheckShort(left) && CPyTagged_CheckShort(right)
-        && !CPyTagged_MaybeFloorDivideFault(left, right)) {
-        Py_ssize_t result = ((Py_ssize_t)left / CPyTagged_ShortAsSsize_t(right)) & ~1;
-        if (((Py_ssize_t)left < 0) != (((Py_ssize_t)right) < 0)) {
-            if (result / 2 * right != left) {
-                // Round down
-                result -= 2;
-            }
+    if (CPyTagged_CheckShort(left) && CPyTagged_CheckShort(right)) {
+        CPyTagged quotient;
+        if (likely(!CPyTagged_ShortFloorDivideOverflow(left, right, &quotient))) {
+            return quotient;
         }
-        return result;
     }
     PyObject *left_obj = CPyTagged_AsObject(left);
     PyObject *right_obj = CPyTagged_AsObject(right);
@@ -240,35 +532,97 @@ bool CPyTagged_IsEq_(CPyTagged left, CPyTagged right) {
     if (CPyTagged_CheckShort(right)) {
         return false;
     } else {
-        int result = PyObject_RichCompareBool(CPyTagged_LongAsObject(left),
-                                              CPyTagged_LongAsObject(right), Py_EQ);
-        if (result == -1) {
-            CPyError_OutOfMemory();
-        }
-        return result;
+        return LongCompare(left, right) == 0;
     }
 }
 
 bool CPyTagged_IsLt_(CPyTagged left, CPyTagged right) {
-    PyObject *left_obj = CPyTagged_AsObject(left);
-    PyObject *right_obj = CPyTagged_AsObject(right);
-    int result = PyObject_RichCompareBool(left_obj, right_obj, Py_LT);
-    Py_DECREF(left_obj);
-    Py_DECREF(right_obj);
-    if (result == -1) {
-        CPyError_OutOfMemory();
+    return LongCompare(left, right) < 0;
+}
+
+static inline bool CPy_IsAsciiSpace(Py_UCS1 c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Parse a str with the given base (2 to 36) directly into a short int.
+//
+// Only 1-byte kind strs with ASCII digits, an optional sign and surrounding
+// ASCII whitespace are accepted, and the value must fit in a short int (such
+// as any decimal number of up to 18 digits on 64-bit platforms). Return false
+// without raising an exception if the str needs the generic implementation,
+// which also reports any errors.
+static bool CPyTagged_ParseShort(PyObject *o, int base, CPyTagged *result) {
+    if (!PyUnicode_IS_READY(o) || PyUnicode_KIND(o) != PyUnicode_1BYTE_KIND) {
+        return false;
     }
-    return result;
+    const Py_UCS1 *s = PyUnicode_1BYTE_DATA(o);
+    const Py_UCS1 *end = s + PyUnicode_GET_LENGTH(o);
+    while (s < end && CPy_IsAsciiSpace(*s)) {
+        s++;
+    }
+    bool neg = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        neg = *s == '-';
+        s++;
+    }
+    const Py_UCS1 *digits = s;
+    // Accumulate the negated value, since the range of short ints is
+    // asymmetric, and stop before the value could overflow.
+    Py_ssize_t limit = CPY_TAGGED_MIN + (neg ? 0 : 1);
+    Py_ssize_t value = 0;
+    for (; s < end; s++) {
+        int d;
+        Py_UCS1 c = *s;
+        if (c >= '0' && c <= '9') {
+            d = c - '0';
+        } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') {
+            d = (c | 0x20) - 'a' + 10;
+        } else {
+            break;
+        }
+        if (d >= base || value < (limit + d) / base) {
+            return false;
+        }
+        value = value * base - d;
+    }
+    if (s == digits) {
+        return false;
+    }
+    while (s < end && CPy_IsAsciiSpace(*s)) {
+        s++;
+    }
+    if (s != end) {
+        return false;
+    }
+    *result = (CPyTagged)(neg ? value : -value) << 1;
+    return true;
 }
 
-PyObject *CPyLong_FromStrWithBase(PyObject *o, CPyTagged base) {
-    Py_ssize_t base_size_t = CPyTagged_AsSsize_t(base);
-    return PyLong_FromUnicodeObject(o, base_size_t);
+CPyTagged CPyTagged_FromStrWithBase(PyObject *o, CPyTagged base) {
+    // Any invalid base, including a long one, is reported by PyLong_FromUnicodeObject
+    Py_ssize_t base_size_t = CPyTagged_CheckShort(base) ? CPyTagged_ShortAsSsize_t(base) : -1;
+    CPyTagged result;
+    if (base_size_t >= 2 && base_size_t <= 36
+            && CPyTagged_ParseShort(o, (int)base_size_t, &result)) {
+        return result;
+    }
+    PyObject *obj = PyLong_FromUnicodeObject(o, base_size_t);
+    if (obj == NULL) {
+        return CPY_INT_TAG;
+    }
+    return CPyTagged_StealFromObject(obj);
 }
 
-PyObject *CPyLong_FromStr(PyObject *o) {
-    CPyTagged base = CPyTagged_FromSsize_t(10);
-    return CPyLong_FromStrWithBase(o, base);
+CPyTagged CPyTagged_FromStr(PyObject *o) {
+    CPyTagged result;
+    if (CPyTagged_ParseShort(o, 10, &result)) {
+        return result;
+    }
+    PyObject *obj = PyLong_FromUnicodeObject(o, 10);
+    if (obj == NULL) {
+        return CPY_INT_TAG;
+    }
+    return CPyTagged_StealFromObject(obj);
 }
 
 PyObject *CPyLong_FromFloat(PyObject *o) {
@@ -284,80 +638,170 @@ PyObject *CPyBool_Str(bool b) {
     return PyObject_Str(b ? Py_True : Py_False);
 }
 
-static void CPyLong_NormalizeUnsigned(PyLongObject *v) {
-    Py_ssize_t i = v->ob_base.ob_size;
-    while (i > 0 && v->ob_digit[i - 1] == 0)
-        i--;
-    v->ob_base.ob_size = i;
+// Per-digit kernels for the bitwise operations. These are kept as simple
+// loops over non-aliasing arrays so that compilers can auto-vectorize them.
+static void DigitsAnd(digit *CPY_RESTRICT r, const digit *CPY_RESTRICT a,
+                      const digit *CPY_RESTRICT b, Py_ssize_t n) {
+    Py_ssize_t i;
+    for (i = 0; i < n; i++) {
+        r[i] = a[i] & b[i];
+    }
+}
+
+static void DigitsOr(digit *CPY_RESTRICT r, const digit *CPY_RESTRICT a,
+                     const digit *CPY_RESTRICT b, Py_ssize_t n) {
+    Py_ssize_t i;
+    for (i = 0; i < n; i++) {
+        r[i] = a[i] | b[i];
+    }
 }
 
-// Bitwise op '&', '|' or '^' using the generic (slow) API
-static CPyTagged GenericBitwiseOp(CPyTagged a, CPyTagged b, char op) {
-    PyObject *aobj = CPyTagged_AsObject(a);
-    PyObject *bobj = CPyTagged_AsObject(b);
-    PyObject *r;
+static void DigitsXor(digit *CPY_RESTRICT r, const digit *CPY_RESTRICT a,
+                      const digit *CPY_RESTRICT b, Py_ssize_t n) {
+    Py_ssize_t i;
+    for (i = 0; i < n; i++) {
+        r[i] = a[i] ^ b[i];
+    }
+}
+
+static void DigitsInvert(digit *CPY_RESTRICT r, const digit *CPY_RESTRICT a, Py_ssize_t n) {
+    Py_ssize_t i;
+    for (i = 0; i < n; i++) {
+        r[i] = a[i] ^ PyLong_MASK;
+    }
+}
+
+static void DigitsBitwise(digit *r, const digit *a, const digit *b, Py_ssize_t n, char op) {
     if (op == '&') {
-        r = PyNumber_And(aobj, bobj);
+        DigitsAnd(r, a, b, n);
     } else if (op == '|') {
-        r = PyNumber_Or(aobj, bobj);
+        DigitsOr(r, a, b, n);
     } else {
-        r = PyNumber_Xor(aobj, bobj);
+        DigitsXor(r, a, b, n);
     }
-    if (unlikely(r == NULL)) {
-        CPyError_OutOfMemory();
+}
+
+// Convert between sign-magnitude and two's complement representations of
+// a negative int: dst = ~src + 1 (modulo the width of n digits). Works in place.
+static void DigitsComplement(digit *dst, const digit *src, Py_ssize_t n) {
+    digit carry = 1;
+    Py_ssize_t i;
+    for (i = 0; i < n; i++) {
+        carry += src[i] ^ PyLong_MASK;
+        dst[i] = carry & PyLong_MASK;
+        carry >>= PyLong_SHIFT;
     }
-    Py_DECREF(aobj);
-    Py_DECREF(bobj);
-    return CPyTagged_StealFromObject(r);
 }
 
-// Return pointer to digits of a PyLong object. If it's a short
-// integer, place digits in the buffer buf instead to avoid memory
-// allocation (it's assumed to be big enough). Return the number of
-// digits in *size. *size is negative if the integer is negative.
-static digit *GetIntDigits(CPyTagged n, Py_ssize_t *size, digit *buf) {
-    if (CPyTagged_CheckShort(n)) {
-        Py_ssize_t val = CPyTagged_ShortAsSsize_t(n);
-        bool neg = val < 0;
-        int len = 1;
-        if (neg) {
-            val = -val;
-        }
-        buf[0] = val & PyLong_MASK;
-        if (val > PyLong_MASK) {
-            val >>= PyLong_SHIFT;
-            buf[1] = val & PyLong_MASK;
-            if (val > PyLong_MASK) {
-                buf[2] = val >> PyLong_SHIFT;
-                len = 3;
-            } else {
-                len = 2;
-            }
+// Number of temporary two's complement digits kept on the stack by
+// BitwiseSignedLongOp; larger operands use a heap buffer.
+#define CPY_BITWISE_STACK_DIGITS 32
+
+// Bitwise op '&', '|' or '^' where at least one operand is negative. Negative
+// operands are converted to two's complement for the operation and the result
+// is converted back, like CPython does, but without boxing short operands.
+static CPyTagged BitwiseSignedLongOp(digit *adigits, Py_ssize_t asize,
+                                     digit *bdigits, Py_ssize_t bsize, char op) {
+    bool nega = asize < 0;
+    bool negb = bsize < 0;
+    if (nega) {
+        asize = -asize;
+    }
+    if (negb) {
+        bsize = -bsize;
+    }
+    // Swap a and b as needed to ensure a is at least as long as b.
+    if (asize < bsize) {
+        digit *tmp = adigits;
+        adigits = bdigits;
+        bdigits = tmp;
+        Py_ssize_t tmp_size = asize;
+        asize = bsize;
+        bsize = tmp_size;
+        bool tmp_neg = nega;
+        nega = negb;
+        negb = tmp_neg;
+    }
+
+    digit stack_buf[CPY_BITWISE_STACK_DIGITS];
+    digit *buf = stack_buf;
+    Py_ssize_t buf_size = (nega ? asize : 0) + (negb ? bsize : 0);
+    if (unlikely(buf_size > CPY_BITWISE_STACK_DIGITS)) {
+        buf = PyMem_Malloc(buf_size * sizeof(digit));
+        if (buf == NULL) {
+            CPyError_OutOfMemory();
         }
-        *size = neg ? -len : len;
-        return buf;
+    }
+    digit *p = buf;
+    if (nega) {
+        DigitsComplement(p, adigits, asize);
+        adigits = p;
+        p += asize;
+    }
+    if (negb) {
+        DigitsComplement(p, bdigits, bsize);
+        bdigits = p;
+    }
+
+    // The result can be shorter than the longer operand: the sign extension
+    // of b is all ones if b is negative and all zeros otherwise.
+    bool negr;
+    Py_ssize_t rsize;
+    if (op == '&') {
+        negr = nega && negb;
+        rsize = negb ? asize : bsize;
+    } else if (op == '|') {
+        negr = nega || negb;
+        rsize = negb ? bsize : asize;
     } else {
-        PyLongObject *obj = (PyLongObject *)CPyTagged_LongAsObject(n);
-        *size = obj->ob_base.ob_size;
-        return obj->ob_digit;
+        negr = nega != negb;
+        rsize = asize;
     }
+    // Allow an extra digit for a negative result, since converting it back
+    // from two's complement can carry into a new digit.
+    PyLongObject *r = _PyLong_New(rsize + negr);
+    if (unlikely(r == NULL)) {
+        CPyError_OutOfMemory();
+    }
+    DigitsBitwise(r->ob_digit, adigits, bdigits, bsize, op);
+    if (rsize > bsize) {
+        if (op == '^' && negb) {
+            DigitsInvert(r->ob_digit + bsize, adigits + bsize, rsize - bsize);
+        } else {
+            memcpy(r->ob_digit + bsize, adigits + bsize, (rsize - bsize) * sizeof(digit));
+        }
+    }
+    if (buf != stack_buf) {
+        PyMem_Free(buf);
+    }
+    if (negr) {
+        r->ob_digit[rsize] = PyLong_MASK;
+        DigitsComplement(r->ob_digit, r->ob_digit, rsize + 1);
+    }
+    CPyLong_NormalizeUnsigned(r);
+    if (negr) {
+        r->ob_base.ob_size = -r->ob_base.ob_size;
+    }
+    return CPyTagged_StealFromObject((PyObject *)r);
 }
 
 // Shared implementation of bitwise '&', '|' and '^' (specified by op) for at least
 // one long operand. This is somewhat optimized for performance.
 static CPyTagged BitwiseLongOp(CPyTagged a, CPyTagged b, char op) {
     // Directly access the digits, as there is no fast C API function for this.
-    digit abuf[3];
-    digit bbuf[3];
+    digit abuf[CPY_SHORT_INT_DIGITS];
+    digit bbuf[CPY_SHORT_INT_DIGITS];
     Py_ssize_t asize;
     Py_ssize_t bsize;
     digit *adigits = GetIntDigits(a, &asize, abuf);
     digit *bdigits = GetIntDigits(b, &bsize, bbuf);
+    CPyStats_INC(int_bitwise_long);
 
     PyLongObject *r;
     if (unlikely(asize < 0 || bsize < 0)) {
-        // Negative operand. This is slower, but bitwise ops on them are pretty rare.
-        return GenericBitwiseOp(a, b, op);
+        // Negative operand. This is a bit slower, since we need to convert to
+        // two's complement and back.
+        return BitwiseSignedLongOp(adigits, asize, bdigits, bsize, op);
     }
     // Optimized implementation for two non-negative integers.
     // Swap a and b as needed to ensure a is no longer than b.
@@ -373,24 +817,9 @@ static CPyTagged BitwiseLongOp(CPyTagged a, CPyTagged b, char op) {
     if (unlikely(r == NULL)) {
         CPyError_OutOfMemory();
     }
-    Py_ssize_t i;
-    if (op == '&') {
-        for (i = 0; i < asize; i++) {
-            r->ob_digit[i] = adigits[i] & bdigits[i];
-        }
-    } else {
-        if (op == '|') {
-            for (i = 0; i < asize; i++) {
-                r->ob_digit[i] = adigits[i] | bdigits[i];
-            }
-        } else {
-            for (i = 0; i < asize; i++) {
-                r->ob_digit[i] = adigits[i] ^ bdigits[i];
-            }
-        }
-        for (; i < bsize; i++) {
-            r->ob_digit[i] = bdigits[i];
-        }
+    DigitsBitwise(r->ob_digit, adigits, bdigits, asize, op);
+    if (op != '&' && bsize > asize) {
+        memcpy(r->ob_digit + asize, bdigits + asize, (bsize - asize) * sizeof(digit));
     }
     CPyLong_NormalizeUnsigned(r);
     return CPyTagged_StealFromObject((PyObject *)r);
@@ -464,20 +893,17 @@ CPyTagged CPyTagged_Rshift(CPyTagged left, CPyTagged right) {
     }
 }
 
-static inline bool IsShortLshiftOverflow(Py_ssize_t short_int, Py_ssize_t shift) {
-    return ((Py_ssize_t)(short_int << shift) >> shift) != short_int;
-}
-
 // Bitwise '<<'
 CPyTagged CPyTagged_Lshift(CPyTagged left, CPyTagged right) {
     if (likely(CPyTagged_CheckShort(left)
                && CPyTagged_CheckShort(right)
                && (Py_ssize_t)right >= 0
                && right < CPY_INT_BITS * 2)) {
-        CPyTagged shift = CPyTagged_ShortAsSsize_t(right);
-        if (!IsShortLshiftOverflow(left, shift))
+        Py_ssize_t shift = CPyTagged_ShortAsSsize_t(right);
+        CPyTagged result;
+        if (!CPyTagged_ShortLshiftOverflow(left, shift, &result))
             // Short integers, no overflow
-            return left << shift;
+            return result;
     }
     // Long integer or out of range shift -- use generic op
     PyObject *lobj = CPyTagged_AsObject(left);
@@ -491,3 +917,162 @@ CPyTagged CPyTagged_Lshift(CPyTagged left, CPyTagged right) {
     }
     return CPyTagged_StealFromObject(result);
 }
+
+// Nogil functions (see CPy_NoGIL_Enter in CPy.h)
+
+// Check that an int argument of a nogil function is short (called with the GIL held)
+char CPy_NoGIL_CheckInt(CPyTagged x) {
+    if (unlikely(CPyTagged_CheckLong(x))) {
+        PyErr_SetString(PyExc_OverflowError, "int argument too large for a nogil function");
+        return 0;
+    }
+    return 1;
+}
+
+// Reacquire the GIL and raise the exception for an error recorded by a nogil
+// operation. Always returns 0 (error).
+char CPy_NoGIL_Raise(PyThreadState *tstate, int error) {
+    PyEval_RestoreThread(tstate);
+    switch (error) {
+    case CPY_NOGIL_OVERFLOW:
+        PyErr_SetString(PyExc_OverflowError, "int too large in a nogil function");
+        break;
+    case CPY_NOGIL_ZERO_DIVISION:
+        PyErr_SetString(PyExc_ZeroDivisionError, "integer division or modulo by zero");
+        break;
+    case CPY_NOGIL_NEGATIVE_SHIFT:
+        PyErr_SetString(PyExc_ValueError, "negative shift count");
+        break;
+    case CPY_NOGIL_UNDEFINED_ATTR:
+        PyErr_SetString(PyExc_AttributeError, "attribute undefined in a nogil function");
+        break;
+    default:
+        PyErr_SetString(PyExc_SystemError, "unknown error in a nogil function");
+        break;
+    }
+    return 0;
+}
+
+// Native fixed-width integers (see native_int_ops.h)
+
+void CPyInt64_Overflow(void) {
+    PyErr_SetString(PyExc_OverflowError, "int too large to convert to i64");
+}
+
+void CPyInt32_Overflow(void) {
+    PyErr_SetString(PyExc_OverflowError, "int too large to convert to i32");
+}
+
+int64_t CPyLong_AsInt64(PyObject *o) {
+    if (unlikely(!PyLong_Check(o))) {
+        CPy_TypeError("int", o);
+        return CPY_LL_INT_ERROR;
+    }
+    int overflow;
+    long long result = PyLong_AsLongLongAndOverflow(o, &overflow);
+    if (unlikely(overflow != 0)) {
+        CPyInt64_Overflow();
+        return CPY_LL_INT_ERROR;
+    }
+    return result;
+}
+
+int32_t CPyLong_AsInt32(PyObject *o) {
+    if (unlikely(!PyLong_Check(o))) {
+        CPy_TypeError("int", o);
+        return CPY_INT_ERROR;
+    }
+    int overflow;
+    long result = PyLong_AsLongAndOverflow(o, &overflow);
+    if (unlikely(overflow != 0 || result < INT32_MIN || result > INT32_MAX)) {
+        CPyInt32_Overflow();
+        return CPY_INT_ERROR;
+    }
+    return result;
+}
+
+int64_t CPyTagged_AsInt64(CPyTagged x) {
+    if (likely(CPyTagged_CheckShort(x))) {
+        return CPyTagged_ShortAsSsize_t(x);
+    }
+    return CPyLong_AsInt64(CPyTagged_LongAsObject(x));
+}
+
+int32_t CPyTagged_AsInt32(CPyTagged x) {
+    if (likely(CPyTagged_CheckShort(x))) {
+        Py_ssize_t value = CPyTagged_ShortAsSsize_t(x);
+        if (unlikely(value < INT32_MIN || value > INT32_MAX)) {
+            CPyInt32_Overflow();
+            return CPY_INT_ERROR;
+        }
+        return value;
+    }
+    return CPyLong_AsInt32(CPyTagged_LongAsObject(x));
+}
+
+int64_t CPyInt64_Divide(int64_t x, int64_t y) {
+    if (unlikely(y == 0)) {
+        PyErr_SetString(PyExc_ZeroDivisionError, "integer division or modulo by zero");
+        return CPY_LL_INT_ERROR;
+    }
+    if (unlikely(y == -1 && x == INT64_MIN)) {
+        CPyInt64_Overflow();
+        return CPY_LL_INT_ERROR;
+    }
+    int64_t d = x / y;
+    // Adjust for Python semantics
+    if (((x < 0) != (y < 0)) && d * y != x) {
+        d--;
+    }
+    return d;
+}
+
+int64_t CPyInt64_Remainder(int64_t x, int64_t y) {
+    if (unlikely(y == 0)) {
+        PyErr_SetString(PyExc_ZeroDivisionError, "integer division or modulo by zero");
+        return CPY_LL_INT_ERROR;
+    }
+    // C99 leaves INT64_MIN % -1 undefined, but the result is always zero
+    if (unlikely(y == -1)) {
+        return 0;
+    }
+    int64_t d = x % y;
+    // Adjust for Python semantics
+    if (((x < 0) != (y < 0)) && d != 0) {
+        d += y;
+    }
+    return d;
+}
+
+int32_t CPyInt32_Divide(int32_t x, int32_t y) {
+    if (unlikely(y == 0)) {
+        PyErr_SetString(PyExc_ZeroDivisionError, "integer division or modulo by zero");
+        return CPY_INT_ERROR;
+    }
+    if (unlikely(y == -1 && x == INT32_MIN)) {
+        CPyInt32_Overflow();
+        return CPY_INT_ERROR;
+    }
+    int32_t d = x / y;
+    // Adjust for Python semantics
+    if (((x < 0) != (y < 0)) && d * y != x) {
+        d--;
+    }
+    return d;
+}
+
+int32_t CPyInt32_Remainder(int32_t x, int32_t y) {
+    if (unlikely(y == 0)) {
+        PyErr_SetString(PyExc_ZeroDivisionError, "integer division or modulo by zero");
+        return CPY_INT_ERROR;
+    }
+    if (unlikely(y == -1)) {
+        return 0;
+    }
+    int32_t d = x % y;
+    // Adjust for Python semantics
+    if (((x < 0) != (y < 0)) && d != 0) {
+        d += y;
+    }
+    return d;
+}
@@ -5,14 +5,23 @@
 #include <Python.h>
 #include "CPy.h"
 
-PyObject *CPyList_GetItemUnsafe(PyObject *list, CPyTagged index) {
+// The *Borrow variants return a borrowed reference to the item. The
+// reference stays valid only while the list is alive and the item isn't
+// replaced or removed, so the caller must not run arbitrary code (which
+// could mutate the list) while it still uses the result.
+
+PyObject *CPyList_GetItemUnsafeBorrow(PyObject *list, CPyTagged index) {
     Py_ssize_t n = CPyTagged_ShortAsSsize_t(index);
-    PyObject *result = PyList_GET_ITEM(list, n);
+    return PyList_GET_ITEM(list, n);
+}
+
+PyObject *CPyList_GetItemUnsafe(PyObject *list, CPyTagged index) {
+    PyObject *result = CPyList_GetItemUnsafeBorrow(list, index);
     Py_INCREF(result);
     return result;
 }
 
-PyObject *CPyList_GetItemShort(PyObject *list, CPyTagged index) {
+PyObject *CPyList_GetItemShortBorrow(PyObject *list, CPyTagged index) {
     Py_ssize_t n = CPyTagged_ShortAsSsize_t(index);
     Py_ssize_t size = PyList_GET_SIZE(list);
     if (n >= 0) {
@@ -27,36 +36,30 @@ PyObject *CPyList_GetItemShort(PyObject *list, CPyTagged index) {
             return NULL;
         }
     }
-    PyObject *result = PyList_GET_ITEM(list, n);
-    Py_INCREF(result);
+    return PyList_GET_ITEM(list, n);
+}
+
+PyObject *CPyList_GetItemShort(PyObject *list, CPyTagged index) {
+    PyObject *result = CPyList_GetItemShortBorrow(list, index);
+    Py_XINCREF(result);
     return result;
 }
 
-PyObject *CPyList_GetItem(PyObject *list, CPyTagged index) {
+PyObject *CPyList_GetItemBorrow(PyObject *list, CPyTagged index) {
     if (CPyTagged_CheckShort(index)) {
-        Py_ssize_t n = CPyTagged_ShortAsSsize_t(index);
-        Py_ssize_t size = PyList_GET_SIZE(list);
-        if (n >= 0) {
-            if (n >= size) {
-                PyErr_SetString(PyExc_IndexError, "list index out of range");
-                return NULL;
-            }
-        } else {
-            n += size;
-            if (n < 0) {
-                PyErr_SetString(PyExc_IndexError, "list index out of range");
-                return NULL;
-            }
-        }
-        PyObject *result = PyList_GET_ITEM(list, n);
-        Py_INCREF(result);
-        return result;
+        return CPyList_GetItemShortBorrow(list, index);
     } else {
         PyErr_SetString(PyExc_OverflowError, CPYTHON_LARGE_INT_ERRMSG);
         return NULL;
     }
 }
 
+PyObject *CPyList_GetItem(PyObject *list, CPyTagged index) {
+    PyObject *result = CPyList_GetItemBorrow(list, index);
+    Py_XINCREF(result);
+    return result;
+}
+
 bool CPyList_SetItem(PyObject *list, CPyTagged index, PyObject *value) {
     if (CPyTagged_CheckShort(index)) {
         Py_ssize_t n = CPyTagged_ShortAsSsize_t(index);
@@ -84,6 +87,36 @@ bool CPyList_SetItem(PyObject *list, CPyTagged index, PyObject *value) {
     }
 }
 
+PyObject *CPyList_GetItemInt64(PyObject *list, int64_t index) {
+    Py_ssize_t size = PyList_GET_SIZE(list);
+    if (index < 0) {
+        index += size;
+    }
+    if (unlikely((uint64_t)index >= (uint64_t)size)) {
+        PyErr_SetString(PyExc_IndexError, "list index out of range");
+        return NULL;
+    }
+    PyObject *result = PyList_GET_ITEM(list, index);
+    Py_INCREF(result);
+    return result;
+}
+
+bool CPyList_SetItemInt64(PyObject *list, int64_t index, PyObject *value) {
+    Py_ssize_t size = PyList_GET_SIZE(list);
+    if (index < 0) {
+        index += size;
+    }
+    if (unlikely((uint64_t)index >= (uint64_t)size)) {
+        PyErr_SetString(PyExc_IndexError, "list assignment index out of range");
+        return false;
+    }
+    // PyList_SET_ITEM doesn't decref the old element, so we do
+    Py_DECREF(PyList_GET_ITEM(list, index));
+    // N.B: Steals reference
+    PyList_SET_ITEM(list, index, value);
+    return true;
+}
+
 // This function should only be used to fill in brand new lists.
 bool CPyList_SetItemUnsafe(PyObject *list, CPyTagged index, PyObject *value) {
     if (CPyTagged_CheckShort(index)) {
@@ -96,6 +129,62 @@ bool CPyList_SetItemUnsafe(PyObject *list, CPyTagged index, PyObject *value) {
     }
 }
 
+// Presized list building
+//
+// Comprehensions whose final length is usually the length of their source
+// allocate the item array once, append without bounds checks and release
+// the unused capacity at the end. Unlike with CPyList_SetItemUnsafe, the
+// list is always in a consistent state, so arbitrary code can run while it
+// is being built.
+
+// Don't preallocate more than this many items, in case the comprehension
+// stops early. Longer lists grow as usual once this is used up.
+#define CPY_LIST_MAX_PRESIZE (1 << 20)
+
+PyObject *CPyList_NewPresized(Py_ssize_t capacity) {
+    PyListObject *list = (PyListObject *)PyList_New(0);
+    if (list == NULL) {
+        return NULL;
+    }
+    // The capacity is just a hint, so don't fail if it can't be allocated
+    if (capacity > CPY_LIST_MAX_PRESIZE) {
+        capacity = CPY_LIST_MAX_PRESIZE;
+    }
+    if (capacity > 0) {
+        list->ob_item = PyMem_New(PyObject *, capacity);
+        if (list->ob_item != NULL) {
+            list->allocated = capacity;
+        }
+    }
+    return (PyObject *)list;
+}
+
+bool CPyList_AppendStealSlow(PyObject *list, PyObject *value) {
+    int result = PyList_Append(list, value);
+    Py_DECREF(value);
+    return result >= 0;
+}
+
+void CPyList_ShrinkToFit(PyObject *list) {
+    PyListObject *op = (PyListObject *)list;
+    Py_ssize_t n = Py_SIZE(op);
+    if (n == op->allocated) {
+        return;
+    }
+    if (n == 0) {
+        PyMem_Free(op->ob_item);
+        op->ob_item = NULL;
+        op->allocated = 0;
+        return;
+    }
+    PyObject **items = (PyObject **)PyMem_Realloc(op->ob_item, n * sizeof(PyObject *));
+    // Keep the original allocation if shrinking fails
+    if (items != NULL) {
+        op->ob_item = items;
+        op->allocated = n;
+    }
+}
+
 PyObject *CPyList_PopLast(PyObject *obj)
 {
     // I tried a specalized version of pop_impl for just removing the
@@ -115,11 +204,6 @@ PyObject *CPyList_Pop(PyObject *obj, CPyTagged index)
     }
 }
 
-CPyTagged CPyList_Count(PyObject *obj, PyObject *value)
-{
-    return list_count((PyListObject *)obj, value);
-}
-
 int CPyList_Insert(PyObject *list, CPyTagged index, PyObject *value)
 {
     if (CPyTagged_CheckShort(index)) {
@@ -136,13 +220,104 @@ PyObject *CPyList_Extend(PyObject *o1, PyObject *o2) {
     return _PyList_Extend((PyListObject *)o1, o2);
 }
 
-// Return -2 or error, -1 if not found, or index of first match otherwise.
-static Py_ssize_t _CPyList_Find(PyObject *list, PyObject *obj) {
+// Fast equality checks for exact str and int objects, which can't override __eq__
+
+static inline bool CPyStr_EqualExact(PyObject *a, PyObject *b) {
+    Py_ssize_t len = PyUnicode_GET_LENGTH(a);
+    if (len != PyUnicode_GET_LENGTH(b)) {
+        return false;
+    }
+    Py_hash_t ha = ((PyASCIIObject *)a)->hash;
+    Py_hash_t hb = ((PyASCIIObject *)b)->hash;
+    if (ha != -1 && hb != -1 && ha != hb) {
+        return false;
+    }
+    // Strings always use the narrowest kind that fits, so the kinds of
+    // equal strings match
+    int kind = PyUnicode_KIND(a);
+    if (kind != PyUnicode_KIND(b)) {
+        return false;
+    }
+    return memcmp(PyUnicode_DATA(a), PyUnicode_DATA(b), len * kind) == 0;
+}
+
+static inline bool CPyLong_EqualExact(PyObject *a, PyObject *b) {
+    Py_ssize_t size = Py_SIZE(a);
+    if (size != Py_SIZE(b)) {
+        return false;
+    }
+    Py_ssize_t n = size < 0 ? -size : size;
+    const digit *da = ((PyLongObject *)a)->ob_digit;
+    const digit *db = ((PyLongObject *)b)->ob_digit;
+    Py_ssize_t i;
+    for (i = 0; i < n; i++) {
+        if (da[i] != db[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Try to decide whether a list item equals an exact str or int needle
+// without calling __eq__. Return 1 if equal, 0 if not and -1 if a rich
+// comparison is needed.
+static inline int CPyList_QuickEq(PyObject *item, PyObject *obj, PyTypeObject *obj_type) {
+    PyTypeObject *item_type = Py_TYPE(item);
+    if (obj_type == &PyUnicode_Type) {
+        if (item_type == &PyUnicode_Type) {
+            if (unlikely(!PyUnicode_IS_READY(item) || !PyUnicode_IS_READY(obj))) {
+                return -1;
+            }
+            return CPyStr_EqualExact(item, obj);
+        }
+        // These builtin types never compare equal to a str
+        if (item_type == &PyLong_Type || item_type == &PyFloat_Type
+                || item_type == &PyBool_Type || item == Py_None) {
+            return 0;
+        }
+    } else {
+        if (item_type == &PyLong_Type) {
+            return CPyLong_EqualExact(item, obj);
+        }
+        // An int can be equal to a bool or a float, but never to these
+        if (item_type == &PyUnicode_Type || item == Py_None) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Find the first item equal to obj in list[start:]. Return its index, -1 if
+// there is none, or -2 on error.
+//
+// Identical items match without a comparison, like in PyObject_RichCompareBool().
+// If obj is an exact str or int, most items can also be checked without calling
+// __eq__ or touching reference counts. Other items are compared using
+// "obj == item" if obj_first is true (like in list.__contains__), and using
+// "item == obj" otherwise (like in list.index()).
+static Py_ssize_t CPyList_FindFrom(PyObject *list, PyObject *obj, Py_ssize_t start,
+                                   bool obj_first) {
+    PyTypeObject *obj_type = Py_TYPE(obj);
+    bool quick = obj_type == &PyUnicode_Type || obj_type == &PyLong_Type;
     Py_ssize_t i;
-    for (i = 0; i < Py_SIZE(list); i++) {
+    // __eq__ may mutate the list, so the size is reloaded on each iteration
+    for (i = start; i < Py_SIZE(list); i++) {
         PyObject *item = PyList_GET_ITEM(list, i);
+        if (item == obj) {
+            return i;
+        }
+        if (quick) {
+            int result = CPyList_QuickEq(item, obj, obj_type);
+            if (result == 1) {
+                return i;
+            } else if (result == 0) {
+                continue;
+            }
+        }
+        // The item could be freed during the comparison if the list is mutated
         Py_INCREF(item);
-        int cmp = PyObject_RichCompareBool(item, obj, Py_EQ);
+        int cmp = obj_first ? PyObject_RichCompareBool(obj, item, Py_EQ)
+                            : PyObject_RichCompareBool(item, obj, Py_EQ);
         Py_DECREF(item);
         if (cmp != 0) {
             if (cmp > 0) {
@@ -155,6 +330,11 @@ static Py_ssize_t _CPyList_Find(PyObject *list, PyObject *obj) {
     return -1;
 }
 
+// Return -2 or error, -1 if not found, or index of first match otherwise.
+static inline Py_ssize_t _CPyList_Find(PyObject *list, PyObject *obj) {
+    return CPyList_FindFrom(list, obj, 0, false);
+}
+
 int CPyList_Remove(PyObject *list, PyObject *obj) {
     Py_ssize_t index = _CPyList_Find(list, obj);
     if (index == -2) {
@@ -167,6 +347,32 @@ int CPyList_Remove(PyObject *list, PyObject *obj) {
     return PyList_SetSlice(list, index, index + 1, NULL);
 }
 
+int CPyList_Contains(PyObject *list, PyObject *obj) {
+    if (!PyList_CheckExact(list)) {
+        // Subclasses may override __contains__
+        return PySequence_Contains(list, obj);
+    }
+    Py_ssize_t index = CPyList_FindFrom(list, obj, 0, true);
+    if (index == -2) {
+        return -1;
+    }
+    return index >= 0;
+}
+
+CPyTagged CPyList_Count(PyObject *obj, PyObject *value)
+{
+    Py_ssize_t count = 0;
+    Py_ssize_t index = CPyList_FindFrom(obj, value, 0, false);
+    while (index >= 0) {
+        count++;
+        index = CPyList_FindFrom(obj, value, index + 1, false);
+    }
+    if (index == -2) {
+        return CPY_INT_TAG;
+    }
+    return CPyTagged_ShortFromSsize_t(count);
+}
+
 CPyTagged CPyList_Index(PyObject *list, PyObject *obj) {
     Py_ssize_t index = _CPyList_Find(list, obj);
     if (index == -2) {
@@ -179,6 +385,398 @@ CPyTagged CPyList_Index(PyObject *list, PyObject *obj) {
     return index << 1;
 }
 
+// Sorting
+//
+// list.sort() and sorted() scan the keys first, and if they all have the same
+// exact type, use a stable merge sort over (key, value) pairs with a
+// comparison specialized for that type instead of rich comparisons. Ints
+// that fit in a long long are compared unboxed, and 1-byte kind strs are
+// compared using memcmp(). Other keys are sorted by CPython's list.sort().
+
+typedef struct {
+    PyObject *key;
+    PyObject *value;
+    long long ikey;
+} CPySortItem;
+
+// Return 1 if a < b, 0 if not, and -1 on error
+typedef int (*CPySortLt)(const CPySortItem *a, const CPySortItem *b);
+
+// Runs shorter than this are sorted using insertion sort
+#define CPY_SORT_MIN_RUN 32
+
+static int CPySort_IntLt(const CPySortItem *a, const CPySortItem *b) {
+    return a->ikey < b->ikey;
+}
+
+static int CPySort_Latin1Lt(const CPySortItem *a, const CPySortItem *b) {
+    Py_ssize_t len_a = PyUnicode_GET_LENGTH(a->key);
+    Py_ssize_t len_b = PyUnicode_GET_LENGTH(b->key);
+    int cmp = memcmp(PyUnicode_1BYTE_DATA(a->key), PyUnicode_1BYTE_DATA(b->key),
+                     len_a < len_b ? len_a : len_b);
+    return cmp != 0 ? cmp < 0 : len_a < len_b;
+}
+
+static int CPySort_StrLt(const CPySortItem *a, const CPySortItem *b) {
+    // This can't fail, since both are exact strs
+    return PyUnicode_Compare(a->key, b->key) < 0;
+}
+
+// Compare exact tuples like tuple rich comparison would: find the first
+// differing items and compare them. Exact str and int items are checked
+// for equality without calling __eq__.
+static int CPySort_TupleLt(const CPySortItem *a, const CPySortItem *b) {
+    Py_ssize_t len_a = PyTuple_GET_SIZE(a->key);
+    Py_ssize_t len_b = PyTuple_GET_SIZE(b->key);
+    Py_ssize_t i;
+    for (i = 0; i < len_a && i < len_b; i++) {
+        PyObject *x = PyTuple_GET_ITEM(a->key, i);
+        PyObject *y = PyTuple_GET_ITEM(b->key, i);
+        if (x == y) {
+            continue;
+        }
+        PyTypeObject *type = Py_TYPE(x);
+        if (type == Py_TYPE(y)) {
+            if (type == &PyUnicode_Type && PyUnicode_IS_READY(x) && PyUnicode_IS_READY(y)) {
+                if (CPyStr_EqualExact(x, y)) {
+                    continue;
+                }
+                return PyUnicode_Compare(x, y) < 0;
+            } else if (type == &PyLong_Type) {
+                if (CPyLong_EqualExact(x, y)) {
+                    continue;
+                }
+                return PyObject_RichCompareBool(x, y, Py_LT);
+            }
+        }
+        int eq = PyObject_RichCompareBool(x, y, Py_EQ);
+        if (eq != 0) {
+            if (eq < 0) {
+                return -1;
+            }
+            continue;
+        }
+        return PyObject_RichCompareBool(x, y, Py_LT);
+    }
+    return len_a < len_b;
+}
+
+// Pick a comparison function based on the types of the keys, or return NULL
+// if there is no specialized one. This also fills in the unboxed keys if all
+// keys are small enough ints.
+static CPySortLt CPySort_SelectLt(CPySortItem *items, Py_ssize_t n) {
+    PyTypeObject *type = Py_TYPE(items[0].key);
+    Py_ssize_t i;
+    for (i = 1; i < n; i++) {
+        if (Py_TYPE(items[i].key) != type) {
+            return NULL;
+        }
+    }
+    if (type == &PyLong_Type) {
+        for (i = 0; i < n; i++) {
+            int overflow;
+            items[i].ikey = PyLong_AsLongLongAndOverflow(items[i].key, &overflow);
+            if (overflow != 0) {
+                return NULL;
+            }
+        }
+        return CPySort_IntLt;
+    } else if (type == &PyUnicode_Type) {
+        bool latin1 = true;
+        for (i = 0; i < n; i++) {
+            PyObject *key = items[i].key;
+            if (unlikely(!PyUnicode_IS_READY(key))) {
+                return NULL;
+            }
+            if (PyUnicode_KIND(key) != PyUnicode_1BYTE_KIND) {
+                latin1 = false;
+            }
+        }
+        return latin1 ? CPySort_Latin1Lt : CPySort_StrLt;
+    } else if (type == &PyTuple_Type) {
+        return CPySort_TupleLt;
+    }
+    return NULL;
+}
+
+// Sort items[lo:hi] in place using a stable insertion sort. All items stay
+// in the array even if a comparison fails.
+static int CPySort_InsertionSort(CPySortItem *items, Py_ssize_t lo, Py_ssize_t hi,
+                                 CPySortLt lt) {
+    Py_ssize_t i, j;
+    for (i = lo + 1; i < hi; i++) {
+        CPySortItem item = items[i];
+        int result = 0;
+        for (j = i; j > lo; j--) {
+            result = lt(&item, &items[j - 1]);
+            if (result <= 0) {
+                break;
+            }
+            items[j] = items[j - 1];
+        }
+        items[j] = item;
+        if (unlikely(result < 0)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Merge sorted runs src[lo:mid] and src[mid:hi] into dst[lo:hi]
+static int CPySort_Merge(const CPySortItem *src, CPySortItem *dst,
+                         Py_ssize_t lo, Py_ssize_t mid, Py_ssize_t hi, CPySortLt lt) {
+    Py_ssize_t i = lo;
+    Py_ssize_t j = mid;
+    Py_ssize_t k = lo;
+    while (i < mid && j < hi) {
+        int result = lt(&src[j], &src[i]);
+        if (unlikely(result < 0)) {
+            return -1;
+        }
+        dst[k++] = result ? src[j++] : src[i++];
+    }
+    memcpy(&dst[k], &src[i], (mid - i) * sizeof(CPySortItem));
+    k += mid - i;
+    memcpy(&dst[k], &src[j], (hi - j) * sizeof(CPySortItem));
+    return 0;
+}
+
+// Sort items using a bottom-up merge sort. On error, the items are left in an
+// unspecified order.
+static int CPySort_Items(CPySortItem *items, Py_ssize_t n, CPySortLt lt) {
+    Py_ssize_t lo, mid, hi, width;
+    for (lo = 0; lo < n; lo += CPY_SORT_MIN_RUN) {
+        hi = lo + CPY_SORT_MIN_RUN < n ? lo + CPY_SORT_MIN_RUN : n;
+        if (unlikely(CPySort_InsertionSort(items, lo, hi, lt) < 0)) {
+            return -1;
+        }
+    }
+    if (n <= CPY_SORT_MIN_RUN) {
+        return 0;
+    }
+    CPySortItem *buf = PyMem_New(CPySortItem, n);
+    if (unlikely(buf == NULL)) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    // Each pass merges pairs of runs from src to dst. Since a failed merge
+    // only reads from src, src always has all the items.
+    CPySortItem *src = items;
+    CPySortItem *dst = buf;
+    int status = 0;
+    for (width = CPY_SORT_MIN_RUN; width < n && status == 0; width *= 2) {
+        for (lo = 0; lo < n; lo += 2 * width) {
+            mid = lo + width < n ? lo + width : n;
+            hi = lo + 2 * width < n ? lo + 2 * width : n;
+            if (mid < hi) {
+                // Runs that are already in order are copied as is
+                int result = lt(&src[mid], &src[mid - 1]);
+                if (result != 0) {
+                    if (result < 0 || CPySort_Merge(src, dst, lo, mid, hi, lt) < 0) {
+                        status = -1;
+                        break;
+                    }
+                    continue;
+                }
+            }
+            memcpy(&dst[lo], &src[lo], (hi - lo) * sizeof(CPySortItem));
+        }
+        if (status == 0) {
+            CPySortItem *tmp = src;
+            src = dst;
+            dst = tmp;
+        }
+    }
+    if (src != items) {
+        memcpy(items, src, n * sizeof(CPySortItem));
+    }
+    PyMem_Free(buf);
+    return status;
+}
+
+// Sort items by their keys using list.sort(). The keys have already been
+// computed, so sort a list of indexes with the key list's __getitem__ as the
+// key function, and then reorder the items to match.
+static int CPySort_ItemsGeneric(CPySortItem *items, Py_ssize_t n) {
+    int status = -1;
+    PyObject *keys = PyList_New(n);
+    PyObject *order = PyList_New(n);
+    PyObject *sort = NULL;
+    PyObject *args = NULL;
+    PyObject *kwargs = NULL;
+    PyObject *res = NULL;
+    CPySortItem *sorted = NULL;
+    Py_ssize_t i;
+    if (keys == NULL || order == NULL) {
+        goto done;
+    }
+    for (i = 0; i < n; i++) {
+        PyObject *index = PyLong_FromSsize_t(i);
+        if (index == NULL) {
+            goto done;
+        }
+        PyList_SET_ITEM(order, i, index);
+        Py_INCREF(items[i].key);
+        PyList_SET_ITEM(keys, i, items[i].key);
+    }
+    sort = PyObject_GetAttrString(order, "sort");
+    if (sort == NULL) {
+        goto done;
+    }
+    args = PyTuple_New(0);
+    kwargs = PyDict_New();
+    if (args == NULL || kwargs == NULL) {
+        goto done;
+    }
+    PyObject *getitem = PyObject_GetAttrString(keys, "__getitem__");
+    if (getitem == NULL) {
+        goto done;
+    }
+    int err = PyDict_SetItemString(kwargs, "key", getitem);
+    Py_DECREF(getitem);
+    if (err < 0) {
+        goto done;
+    }
+    res = PyObject_Call(sort, args, kwargs);
+    if (res == NULL) {
+        goto done;
+    }
+    sorted = PyMem_New(CPySortItem, n);
+    if (sorted == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (i = 0; i < n; i++) {
+        sorted[i] = items[PyLong_AsSsize_t(PyList_GET_ITEM(order, i))];
+    }
+    memcpy(items, sorted, n * sizeof(CPySortItem));
+    PyMem_Free(sorted);
+    status = 0;
+done:
+    Py_XDECREF(keys);
+    Py_XDECREF(order);
+    Py_XDECREF(sort);
+    Py_XDECREF(args);
+    Py_XDECREF(kwargs);
+    Py_XDECREF(res);
+    return status;
+}
+
+static void CPySort_Reverse(CPySortItem *items, Py_ssize_t n) {
+    Py_ssize_t i;
+    for (i = 0; i < n / 2; i++) {
+        CPySortItem tmp = items[i];
+        items[i] = items[n - 1 - i];
+        items[n - 1 - i] = tmp;
+    }
+}
+
+// Implementation of list.sort(key=key, reverse=reverse). A key of None means
+// that the items are compared directly.
+int CPyList_SortKey(PyObject *list, PyObject *key, bool reverse) {
+    PyListObject *op = (PyListObject *)list;
+    Py_ssize_t n = Py_SIZE(op);
+    if (n == 0 || (n == 1 && key == Py_None)) {
+        return 0;
+    }
+    CPySortItem *items = PyMem_New(CPySortItem, n);
+    if (unlikely(items == NULL)) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    // Like list.sort(), empty the list while sorting, so that any changes made
+    // by key functions or comparisons can be detected.
+    PyObject **saved_items = op->ob_item;
+    Py_ssize_t saved_allocated = op->allocated;
+    Py_SIZE(op) = 0;
+    op->ob_item = NULL;
+    op->allocated = -1;
+
+    int status = 0;
+    Py_ssize_t i;
+    Py_ssize_t nkeys = 0;
+    for (i = 0; i < n; i++) {
+        PyObject *value = saved_items[i];
+        PyObject *item_key = value;
+        if (key != Py_None) {
+            item_key = PyObject_CallFunctionObjArgs(key, value, NULL);
+            if (unlikely(item_key == NULL)) {
+                status = -1;
+                break;
+            }
+            nkeys++;
+        }
+        items[i].key = item_key;
+        items[i].value = value;
+    }
+    CPySortLt lt = status == 0 ? CPySort_SelectLt(items, n) : NULL;
+    if (status == 0 && lt == NULL && key == Py_None && !reverse) {
+        // No specialized comparison applies, and no code has run yet, so
+        // just let CPython sort the list as usual
+        PyMem_Free(items);
+        Py_SIZE(op) = n;
+        op->ob_item = saved_items;
+        op->allocated = saved_allocated;
+        return PyList_Sort(list);
+    }
+    if (status == 0) {
+        // Reversing before and after the sort keeps equal items in their
+        // original order, as with list.sort().
+        if (reverse) {
+            CPySort_Reverse(items, n);
+        }
+        if (lt != NULL) {
+            status = CPySort_Items(items, n, lt);
+        } else {
+            status = CPySort_ItemsGeneric(items, n);
+        }
+        if (reverse) {
+            CPySort_Reverse(items, n);
+        }
+        for (i = 0; i < n; i++) {
+            saved_items[i] = items[i].value;
+        }
+    }
+    for (i = 0; i < nkeys; i++) {
+        Py_DECREF(items[i].key);
+    }
+    PyMem_Free(items);
+
+    PyObject **final_items = op->ob_item;
+    Py_ssize_t final_size = Py_SIZE(op);
+    if (op->allocated != -1 && status == 0) {
+        PyErr_SetString(PyExc_ValueError, "list modified during sort");
+        status = -1;
+    }
+    Py_SIZE(op) = n;
+    op->ob_item = saved_items;
+    op->allocated = saved_allocated;
+    if (final_items != NULL) {
+        for (i = 0; i < final_size; i++) {
+            Py_XDECREF(final_items[i]);
+        }
+        PyMem_Free(final_items);
+    }
+    return status;
+}
+
+int CPyList_Sort(PyObject *list) {
+    return CPyList_SortKey(list, Py_None, false);
+}
+
+PyObject *CPyList_Sorted(PyObject *iterable, PyObject *key, bool reverse) {
+    PyObject *list = PySequence_List(iterable);
+    if (unlikely(list == NULL)) {
+        return NULL;
+    }
+    if (unlikely(CPyList_SortKey(list, key, reverse) < 0)) {
+        Py_DECREF(list);
+        return NULL;
+    }
+    return list;
+}
+
 PyObject *CPySequence_Multiply(PyObject *seq, CPyTagged t_size) {
     Py_ssize_t size = CPyTagged_AsSsize_t(t_size);
     if (size == -1 && PyErr_Occurred()) {
@@ -206,3 +804,28 @@ PyObject *CPyList_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end) {
     }
     return CPyObject_GetSlice(obj, start, end);
 }
+
+PyObject *CPyList_GetSliceStep(PyObject *obj, CPyTagged start, CPyTagged end, CPyTagged step) {
+    if (likely(PyList_CheckExact(obj) && CPyTagged_CheckShort(step) && step != 0)) {
+        Py_ssize_t stepn = CPyTagged_ShortAsSsize_t(step);
+        Py_ssize_t length = PyList_GET_SIZE(obj);
+        Py_ssize_t startn = CPySlice_AdjustIndex(start, length, stepn);
+        Py_ssize_t endn = CPySlice_AdjustIndex(end, length, stepn);
+        if (stepn == 1) {
+            return PyList_GetSlice(obj, startn, endn);
+        }
+        Py_ssize_t n = CPySlice_Length(startn, endn, stepn);
+        PyObject *result = PyList_New(n);
+        if (unlikely(result == NULL)) {
+            return NULL;
+        }
+        Py_ssize_t i;
+        for (i = 0; i < n; i++) {
+            PyObject *item = PyList_GET_ITEM(obj, startn + i * stepn);
+            Py_INCREF(item);
+            PyList_SET_ITEM(result, i, item);
+        }
+        return result;
+    }
+    return CPyObject_GetSliceStep(obj, start, end, step);
+}
@@ -31,6 +31,63 @@ PyObject *CPyIter_Send(PyObject *iter, PyObject *val)
     }
 }
 
+// Do a send like CPyIter_Send, but return the yielded or returned value in
+// *result and a CPY_GEN_* code that tells them apart. A StopIteration raised
+// by the iterator is treated as a return. This avoids StopIteration
+// exceptions and method lookups for native generators, and for anything
+// that supports am_send on Python 3.10 and later.
+int CPyIter_SendStatus(PyObject *iter, PyObject *val, PyObject **result)
+{
+    int status;
+    CPyAsyncMethods *native = CPyGen_NativeMethods(iter);
+    if (native != NULL) {
+        status = native->send(iter, val, result);
+    } else {
+#if PY_VERSION_HEX >= 0x030A0000
+        status = PyIter_Send(iter, val, result);
+#else
+        *result = CPyIter_Send(iter, val);
+        status = *result != NULL ? CPY_GEN_NEXT : CPY_GEN_ERROR;
+#endif
+    }
+    if (status == CPY_GEN_ERROR) {
+        *result = CPy_FetchStopIterationValue();
+        if (*result != NULL) {
+            return CPY_GEN_RETURN;
+        }
+    }
+    return status;
+}
+
+// The tp_iternext slot of native generator classes
+PyObject *CPyGen_IterNext(PyObject *self)
+{
+    PyObject *result;
+    CPyAsyncMethods *native = (CPyAsyncMethods *)Py_TYPE(self)->tp_as_async;
+    if (native->send(self, Py_None, &result) == CPY_GEN_RETURN) {
+        // A NULL return without an exception set also means StopIteration
+        if (result != Py_None) {
+            CPyGen_SetStopIterationValue(result);
+        }
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Implement a return statement in a generator. If stop_iter_ptr is non-NULL,
+// the caller wants the value without StopIteration being raised, so store it
+// there. The caller signals an error in either case.
+void CPyGen_SetReturnValue(PyObject *value, PyObject **stop_iter_ptr)
+{
+    if (stop_iter_ptr != NULL) {
+        Py_INCREF(value);
+        *stop_iter_ptr = value;
+    } else {
+        CPyGen_SetStopIterationValue(value);
+    }
+}
+
 // A somewhat hairy implementation of specifically most of the error handling
 // in `yield from` error handling. The point here is to reduce code size.
 //
@@ -49,6 +106,7 @@ int CPy_YieldFromErrorHandle(PyObject *iter, PyObject **outp)
     PyObject *type, *value, *traceback;
     PyObject *_m;
     PyObject *res;
+    CPyAsyncMethods *native;
     *outp = NULL;
 
     if (PyErr_GivenExceptionMatches(exc_type, PyExc_GeneratorExit)) {
@@ -64,6 +122,20 @@ int CPy_YieldFromErrorHandle(PyObject *iter, PyObject **outp)
         } else {
             return 2;
         }
+    } else if ((native = CPyGen_NativeMethods(iter)) != NULL) {
+        _CPy_GetExcInfo(&type, &value, &traceback);
+        int status = native->throw_(iter, type, value, traceback, &res);
+        Py_DECREF(type);
+        Py_DECREF(value);
+        Py_DECREF(traceback);
+        if (status == CPY_GEN_ERROR) {
+            res = CPy_FetchStopIterationValue();
+            if (!res)
+                return 2;
+            status = CPY_GEN_RETURN;
+        }
+        *outp = res;
+        return status == CPY_GEN_RETURN;
     } else {
         _m = _PyObject_GetAttrId(iter, &PyId_throw);
         if (_m) {
@@ -107,8 +179,11 @@ static bool _CPy_IsSafeMetaClass(PyTypeObject *metaclass) {
     // manage to work with TypingMeta and its friends.
     if (metaclass == &PyType_Type)
         return true;
-    PyObject *module = PyObject_GetAttrString((PyObject *)metaclass, "__module__");
-    if (!module) {
+    _Py_IDENTIFIER(__module__);
+    PyObject *module_name = _PyUnicode_FromId(&PyId___module__);
+    PyObject *module;
+    if (module_name == NULL || CPyObject_LookupAttr((PyObject *)metaclass, module_name,
+                                                    &module) <= 0) {
         PyErr_Clear();
         return false;
     }
@@ -130,13 +205,46 @@ static bool _CPy_IsSafeMetaClass(PyTypeObject *metaclass) {
     return matches;
 }
 
+// Are all bases plain types with type as the metaclass?
+static bool _CPy_HasPlainTypeBases(PyObject *bases) {
+    Py_ssize_t i;
+    for (i = 0; i < PyTuple_GET_SIZE(bases); i++) {
+        PyObject *base = PyTuple_GET_ITEM(bases, i);
+        if (Py_TYPE(base) != &PyType_Type) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Does a base class of a new type define __init_subclass__, other than object?
+static bool _CPy_HasCustomInitSubclass(PyTypeObject *type) {
+    _Py_IDENTIFIER(__init_subclass__);
+    PyObject *mro = type->tp_mro;
+    Py_ssize_t i;
+    PyObject *name = _PyUnicode_FromId(&PyId___init_subclass__);
+    if (name == NULL || mro == NULL) {
+        PyErr_Clear();
+        return true;
+    }
+    // Skip the type itself, which has no class body yet
+    for (i = 1; i < PyTuple_GET_SIZE(mro); i++) {
+        PyTypeObject *base = (PyTypeObject *)PyTuple_GET_ITEM(mro, i);
+        if (base != &PyBaseObject_Type && base->tp_dict != NULL
+                && PyDict_GetItem(base->tp_dict, name) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Create a heap type based on a template non-heap type.
 // This is super hacky and maybe we should suck it up and use PyType_FromSpec instead.
 // We allow bases to be NULL to represent just inheriting from object.
 // We don't support NULL bases and a non-type metaclass.
-PyObject *CPyType_FromTemplate(PyObject *template,
-                               PyObject *orig_bases,
-                               PyObject *modname) {
+static PyObject *CPyType_FromTemplateImpl(PyObject *template,
+                                          PyObject *orig_bases,
+                                          PyObject *modname) {
     PyTypeObject *template_ = (PyTypeObject *)template;
     PyHeapTypeObject *t = NULL;
     PyTypeObject *dummy_class = NULL;
@@ -161,14 +269,17 @@ PyObject *CPyType_FromTemplate(PyObject *template,
 
         // Find the appropriate metaclass from our base classes. We
         // care about this because Generic uses a metaclass prior to
-        // Python 3.7.
-        metaclass = _PyType_CalculateMetaclass(metaclass, bases);
-        if (!metaclass)
-            goto error;
+        // Python 3.7. Usually all the bases are plain types, and then
+        // there is nothing to calculate.
+        if (metaclass != &PyType_Type || !_CPy_HasPlainTypeBases(bases)) {
+            metaclass = _PyType_CalculateMetaclass(metaclass, bases);
+            if (!metaclass)
+                goto error;
 
-        if (!_CPy_IsSafeMetaClass(metaclass)) {
-            PyErr_SetString(PyExc_TypeError, "mypyc classes can't have a metaclass");
-            goto error;
+            if (!_CPy_IsSafeMetaClass(metaclass)) {
+                PyErr_SetString(PyExc_TypeError, "mypyc classes can't have a metaclass");
+                goto error;
+            }
         }
     }
 
@@ -263,24 +374,30 @@ PyObject *CPyType_FromTemplate(PyObject *template,
     }
 
     // Reject anything that would give us a nontrivial __slots__,
-    // because the layout will conflict
-    slots = PyObject_GetAttrString((PyObject *)t, "__slots__");
+    // because the layout will conflict. This can only come from the bases,
+    // so look in the MRO directly, which can't raise an exception.
+    _Py_IDENTIFIER(__slots__);
+    PyObject *slots_name = _PyUnicode_FromId(&PyId___slots__);
+    if (!slots_name)
+        goto error;
+    slots = _PyType_Lookup((PyTypeObject *)t, slots_name);
     if (slots) {
         // don't fail on an empty __slots__
         int is_true = PyObject_IsTrue(slots);
-        Py_DECREF(slots);
         if (is_true > 0)
             PyErr_SetString(PyExc_TypeError, "mypyc classes can't have __slots__");
         if (is_true != 0)
             goto error;
-    } else {
-        PyErr_Clear();
     }
 
-    if (PyObject_SetAttrString((PyObject *)t, "__module__", modname) < 0)
+    // The type is brand new, so __module__ can go directly into the dict
+    _Py_IDENTIFIER(__module__);
+    if (_PyDict_SetItemId(t->ht_type.tp_dict, &PyId___module__, modname) < 0)
         goto error;
+    PyType_Modified((PyTypeObject *)t);
 
-    if (init_subclass((PyTypeObject *)t, NULL))
+    // object.__init_subclass__ does nothing, so only call a custom one
+    if (_CPy_HasCustomInitSubclass((PyTypeObject *)t) && init_subclass((PyTypeObject *)t, NULL))
         goto error;
 
     Py_XDECREF(dummy_class);
@@ -295,6 +412,131 @@ error:
     return NULL;
 }
 
+PyObject *CPyType_FromTemplate(PyObject *template,
+                               PyObject *orig_bases,
+                               PyObject *modname) {
+    CPyImportProfile_START(mark);
+    PyObject *t = CPyType_FromTemplateImpl(template, orig_bases, modname);
+    CPyImportProfile_END(mark, "CPyType_FromTemplate", ((PyTypeObject *)template)->tp_name);
+    return t;
+}
+
+// Create several types that have no explicit bases from templates in one call,
+// storing each into the static that holds it. Return -1 on error.
+int CPyType_FromTemplates(const CPyType_Template *templates, Py_ssize_t num,
+                          PyObject *modname) {
+    Py_ssize_t i;
+    for (i = 0; i < num; i++) {
+        PyObject *t = CPyType_FromTemplate((PyObject *)templates[i].template_, NULL, modname);
+        if (t == NULL) {
+            return -1;
+        }
+        *templates[i].type = (PyTypeObject *)t;
+    }
+    return 0;
+}
+
+// Free lists for instances of native classes with @mypyc_attr(free_list=True).
+//
+// Deallocating such an instance keeps its memory in a free list instead
+// of releasing it, and the next allocation of an instance of the same
+// size reuses it, skipping the allocator. Lists are kept per instance
+// size (a multiple of the pointer size), so that all classes of the same
+// size share memory, and MYPYC_FREE_LIST_LIMIT bounds the total number of
+// bytes kept.
+//
+// The memory of an instance comes from PyType_GenericAlloc, so it has
+// a GC header. Deallocation has untracked the instance, which leaves
+// the header zeroed just like a fresh allocation, as long as the type
+// has no finalizer that could have marked it.
+
+#ifndef MYPYC_FREE_LIST_LIMIT
+#define MYPYC_FREE_LIST_LIMIT (1 << 20)
+#endif
+
+// Largest instance size that gets a free list
+#define CPY_FREE_LIST_MAX_SIZE 512
+#define CPY_FREE_LIST_NUM_SIZES (CPY_FREE_LIST_MAX_SIZE / sizeof(void *) + 1)
+
+// A free block overlays the start of the dead instance
+typedef struct CPyFreeBlock {
+    struct CPyFreeBlock *next;
+} CPyFreeBlock;
+
+static CPyFreeBlock *CPyFreeList_Heads[CPY_FREE_LIST_NUM_SIZES];
+static CPyFreeListStats CPyFreeList_Stats;
+
+// Return the free list index for instances of a type, or -1 if it can't use one
+static Py_ssize_t CPyFreeList_Index(PyTypeObject *type) {
+    Py_ssize_t size = type->tp_basicsize;
+    if (type->tp_itemsize != 0 || size > CPY_FREE_LIST_MAX_SIZE
+            || size % sizeof(void *) != 0
+            || type->tp_alloc != PyType_GenericAlloc || type->tp_free != PyObject_GC_Del
+            || type->tp_finalize != NULL) {
+        return -1;
+    }
+    return size / sizeof(void *);
+}
+
+PyObject *CPyFreeList_Alloc(PyTypeObject *type) {
+    Py_ssize_t index = CPyFreeList_Index(type);
+    if (index >= 0 && CPyFreeList_Heads[index] != NULL) {
+        CPyFreeBlock *block = CPyFreeList_Heads[index];
+        CPyFreeList_Heads[index] = block->next;
+        CPyFreeList_Stats.hits++;
+        CPyFreeList_Stats.bytes -= type->tp_basicsize;
+        // Do what PyType_GenericAlloc does with fresh memory
+        memset(block, 0, type->tp_basicsize);
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION < 8
+        if (type->tp_flags & Py_TPFLAGS_HEAPTYPE) {
+            Py_INCREF(type);
+        }
+#endif
+        PyObject *obj = PyObject_INIT((PyObject *)block, type);
+        PyObject_GC_Track(obj);
+        return obj;
+    }
+    CPyFreeList_Stats.misses++;
+    return type->tp_alloc(type, 0);
+}
+
+// Release the memory of a deallocated (and untracked) instance
+void CPyFreeList_Free(PyObject *obj) {
+    PyTypeObject *type = Py_TYPE(obj);
+    Py_ssize_t index = CPyFreeList_Index(type);
+    if (index >= 0) {
+        if (CPyFreeList_Stats.bytes + type->tp_basicsize <= MYPYC_FREE_LIST_LIMIT) {
+            CPyFreeBlock *block = (CPyFreeBlock *)obj;
+            block->next = CPyFreeList_Heads[index];
+            CPyFreeList_Heads[index] = block;
+            CPyFreeList_Stats.frees++;
+            CPyFreeList_Stats.bytes += type->tp_basicsize;
+            return;
+        }
+        CPyFreeList_Stats.releases++;
+    }
+    type->tp_free(obj);
+}
+
+void CPyFreeList_GetStats(CPyFreeListStats *stats) {
+    *stats = CPyFreeList_Stats;
+}
+
+// Release all memory kept in free lists and reset the counters
+void CPyFreeList_Clear(void) {
+    size_t i;
+    for (i = 0; i < CPY_FREE_LIST_NUM_SIZES; i++) {
+        CPyFreeBlock *block = CPyFreeList_Heads[i];
+        CPyFreeList_Heads[i] = NULL;
+        while (block != NULL) {
+            CPyFreeBlock *next = block->next;
+            PyObject_GC_Del(block);
+            block = next;
+        }
+    }
+    memset(&CPyFreeList_Stats, 0, sizeof(CPyFreeList_Stats));
+}
+
 static int _CPy_UpdateObjFromDict(PyObject *obj, PyObject *dict)
 {
     Py_ssize_t pos = 0;
@@ -332,9 +574,9 @@ static int _CPy_UpdateObjFromDict(PyObject *obj, PyObject *dict)
  *   dict: The dictionary containing values that dataclasses needs
  *   annotations: The type annotation dictionary
  */
-int
-CPyDataclass_SleightOfHand(PyObject *dataclass_dec, PyObject *tp,
-                           PyObject *dict, PyObject *annotations) {
+static int
+CPyDataclass_SleightOfHandImpl(PyObject *dataclass_dec, PyObject *tp,
+                               PyObject *dict, PyObject *annotations) {
     PyTypeObject *ttp = (PyTypeObject *)tp;
     Py_ssize_t pos;
     PyObject *res;
@@ -379,6 +621,15 @@ fail:
     return 0;
 }
 
+int
+CPyDataclass_SleightOfHand(PyObject *dataclass_dec, PyObject *tp,
+                           PyObject *dict, PyObject *annotations) {
+    CPyImportProfile_START(mark);
+    int res = CPyDataclass_SleightOfHandImpl(dataclass_dec, tp, dict, annotations);
+    CPyImportProfile_END(mark, "CPyDataclass_SleightOfHand", ((PyTypeObject *)tp)->tp_name);
+    return res;
+}
+
 // Support for pickling; reusable getstate and setstate functions
 PyObject *
 CPyPickle_SetState(PyObject *obj, PyObject *state)
@@ -389,6 +640,26 @@ CPyPickle_SetState(PyObject *obj, PyObject *state)
     Py_RETURN_NONE;
 }
 
+// Intern the attribute names used as state keys by the generated
+// __getstate__ and __setstate__ methods (on the first call)
+int
+CPyPickle_InitKeys(PyObject **keys, const char * const *names, Py_ssize_t count)
+{
+    if (likely(keys[count - 1] != NULL)) {
+        return 0;
+    }
+    Py_ssize_t i;
+    for (i = 0; i < count; i++) {
+        if (keys[i] == NULL) {
+            keys[i] = PyUnicode_InternFromString(names[i]);
+            if (keys[i] == NULL) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
 PyObject *
 CPyPickle_GetState(PyObject *obj)
 {
@@ -412,13 +683,12 @@ CPyPickle_GetState(PyObject *obj)
     int i;
     for (i = 0; i < PyTuple_GET_SIZE(attrs); i++) {
         PyObject *key = PyTuple_GET_ITEM(attrs, i);
-        PyObject *value = PyObject_GetAttr(obj, key);
-        if (!value) {
-            if (PyErr_ExceptionMatches(PyExc_AttributeError)) {
-                PyErr_Clear();
-                continue;
-            }
+        PyObject *value;
+        int found = CPyObject_LookupAttr(obj, key, &value);
+        if (found < 0) {
             goto fail;
+        } else if (found == 0) {
+            continue;
         }
         int result = PyDict_SetItem(state, key, value);
         Py_DECREF(value);
@@ -437,57 +707,205 @@ fail:
 }
 
 CPyTagged CPyTagged_Id(PyObject *o) {
-    return CPyTagged_FromSsize_t((Py_ssize_t)o);
+    return CPyTagged_FromSsize_t(CPyObject_IdNative(o));
+}
+
+// collections.deque operations
+//
+// collections.deque is a constant time double-ended queue implemented in C,
+// but calling its methods from compiled code normally goes through a method
+// lookup and a bound method object. For exact deque instances we call the C
+// implementations of the methods directly. Subclasses could override the
+// methods, so they use generic method calls.
+
+static PyTypeObject *CPyDeque_Type;
+static PyCFunction CPyDeque_AppendFunc;
+static PyCFunction CPyDeque_AppendLeftFunc;
+static PyCFunction CPyDeque_PopFunc;
+static PyCFunction CPyDeque_PopLeftFunc;
+static bool CPyDeque_Initialized;
+
+static PyCFunction CPyDeque_LookupMethod(PyTypeObject *type, const char *name, int flags) {
+    PyObject *descr = PyDict_GetItemString(type->tp_dict, name);
+    if (descr == NULL || Py_TYPE(descr) != &PyMethodDescr_Type) {
+        return NULL;
+    }
+    PyMethodDef *def = ((PyMethodDescrObject *)descr)->d_method;
+    if ((def->ml_flags & (METH_VARARGS | METH_KEYWORDS | METH_NOARGS | METH_O)) != flags) {
+        return NULL;
+    }
+    return def->ml_meth;
+}
+
+// Find the deque type and its methods. If anything looks unexpected, we just
+// always use generic method calls.
+static void CPyDeque_Init(void) {
+    CPyDeque_Initialized = true;
+    PyObject *type = NULL;
+    PyObject *mod = PyImport_ImportModule("collections");
+    if (mod != NULL) {
+        type = PyObject_GetAttrString(mod, "deque");
+        Py_DECREF(mod);
+    }
+    if (type == NULL || !PyType_Check(type)) {
+        PyErr_Clear();
+        Py_XDECREF(type);
+        return;
+    }
+    PyTypeObject *tp = (PyTypeObject *)type;
+    CPyDeque_AppendFunc = CPyDeque_LookupMethod(tp, "append", METH_O);
+    CPyDeque_AppendLeftFunc = CPyDeque_LookupMethod(tp, "appendleft", METH_O);
+    CPyDeque_PopFunc = CPyDeque_LookupMethod(tp, "pop", METH_NOARGS);
+    CPyDeque_PopLeftFunc = CPyDeque_LookupMethod(tp, "popleft", METH_NOARGS);
+    if (CPyDeque_AppendFunc && CPyDeque_AppendLeftFunc
+            && CPyDeque_PopFunc && CPyDeque_PopLeftFunc) {
+        // Keep the reference; the type is never freed
+        CPyDeque_Type = tp;
+    } else {
+        Py_DECREF(type);
+    }
 }
 
-#define MAX_INT_CHARS 22
-#define _PyUnicode_LENGTH(op)                           \
-    (((PyASCIIObject *)(op))->length)
+static inline bool CPyDeque_CheckExact(PyObject *obj) {
+    if (unlikely(!CPyDeque_Initialized)) {
+        CPyDeque_Init();
+    }
+    return Py_TYPE(obj) == CPyDeque_Type;
+}
+
+static inline int CPyDeque_DiscardResult(PyObject *result) {
+    if (result == NULL) {
+        return -1;
+    }
+    Py_DECREF(result);
+    return 0;
+}
+
+int CPyDeque_Append(PyObject *deque, PyObject *value) {
+    if (likely(CPyDeque_CheckExact(deque))) {
+        return CPyDeque_DiscardResult(CPyDeque_AppendFunc(deque, value));
+    }
+    return CPyDeque_DiscardResult(PyObject_CallMethod(deque, "append", "O", value));
+}
+
+int CPyDeque_AppendLeft(PyObject *deque, PyObject *value) {
+    if (likely(CPyDeque_CheckExact(deque))) {
+        return CPyDeque_DiscardResult(CPyDeque_AppendLeftFunc(deque, value));
+    }
+    return CPyDeque_DiscardResult(PyObject_CallMethod(deque, "appendleft", "O", value));
+}
+
+PyObject *CPyDeque_Pop(PyObject *deque) {
+    if (likely(CPyDeque_CheckExact(deque))) {
+        return CPyDeque_PopFunc(deque, NULL);
+    }
+    return PyObject_CallMethod(deque, "pop", NULL);
+}
+
+PyObject *CPyDeque_PopLeft(PyObject *deque) {
+    if (likely(CPyDeque_CheckExact(deque))) {
+        return CPyDeque_PopLeftFunc(deque, NULL);
+    }
+    return PyObject_CallMethod(deque, "popleft", NULL);
+}
+
+CPyTagged CPyDeque_Len(PyObject *deque) {
+    if (likely(CPyDeque_CheckExact(deque))) {
+        // Deques store their length in ob_size
+        return CPyTagged_ShortFromSsize_t(Py_SIZE(deque));
+    }
+    return CPyObject_Size(deque);
+}
+
+// Pairs of decimal digits "00" to "99", so that we can format two digits
+// per division.
+static const char CPy_DigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
 
 // using snprintf or PyUnicode_FromFormat was way slower than
-// boxing the int and calling PyObject_Str on it, so we implement our own
-static int fmt_ssize_t(char *out, Py_ssize_t n) {
-	bool neg = n < 0;
-	if (neg) n = -n;
-
-	// buf gets filled backward and then we copy it forward
-	char buf[MAX_INT_CHARS];
-	int i = 0;
-	do {
-		buf[i] = (n % 10) + '0';
-		n /= 10;
-		i++;
-	} while (n);
-
-
-	int len = i;
-	int j = 0;
-	if (neg) {
-		out[j++] = '-';
-		len++;
-	}
-
-	for (; j < len; j++, i--) {
-		out[j] = buf[i-1];
-	}
-	out[j] = '\0';
-
-	return len;
-}
-
-static PyObject *CPyTagged_ShortToStr(Py_ssize_t n) {
-    PyObject *obj = PyUnicode_New(MAX_INT_CHARS, 127);
+// boxing the int and calling PyObject_Str on it, so we implement our own.
+// The output buffer must have room for CPY_MAX_INT_CHARS characters.
+int CPy_FormatSsize_t(char *out, Py_ssize_t n) {
+    // Negate as unsigned so that the most negative value doesn't overflow
+    size_t u = n < 0 ? (size_t)0 - (size_t)n : (size_t)n;
+
+    // buf gets filled backward and then we copy it forward
+    char buf[CPY_MAX_INT_CHARS];
+    char *p = buf + sizeof(buf);
+    while (u >= 100) {
+        size_t i = (u % 100) * 2;
+        u /= 100;
+        *--p = CPy_DigitPairs[i + 1];
+        *--p = CPy_DigitPairs[i];
+    }
+    if (u >= 10) {
+        *--p = CPy_DigitPairs[u * 2 + 1];
+        *--p = CPy_DigitPairs[u * 2];
+    } else {
+        *--p = (char)('0' + u);
+    }
+    if (n < 0) {
+        *--p = '-';
+    }
+
+    int len = (int)(buf + sizeof(buf) - p);
+    memcpy(out, p, len);
+    out[len] = '\0';
+    return len;
+}
+
+// Format n like hex(n), such as "0x1f" or "-0x1f". The output buffer must
+// have room for CPY_MAX_INT_CHARS characters.
+int CPy_FormatSsize_tHex(char *out, Py_ssize_t n) {
+    static const char hex_digits[] = "0123456789abcdef";
+    size_t u = n < 0 ? (size_t)0 - (size_t)n : (size_t)n;
+
+    char buf[CPY_MAX_INT_CHARS];
+    char *p = buf + sizeof(buf);
+    do {
+        *--p = hex_digits[u & 0xf];
+        u >>= 4;
+    } while (u);
+    *--p = 'x';
+    *--p = '0';
+    if (n < 0) {
+        *--p = '-';
+    }
+
+    int len = (int)(buf + sizeof(buf) - p);
+    memcpy(out, p, len);
+    out[len] = '\0';
+    return len;
+}
+
+// Create an ASCII str from a formatted short int.
+static PyObject *CPyTagged_FormattedToStr(const char *buf, int len) {
+    PyObject *obj = PyUnicode_New(len, 127);
     if (!obj) return NULL;
-    int len = fmt_ssize_t((char *)PyUnicode_1BYTE_DATA(obj), n);
-    _PyUnicode_LENGTH(obj) = len;
+    memcpy(PyUnicode_1BYTE_DATA(obj), buf, len);
     return obj;
 }
 
 PyObject *CPyTagged_Str(CPyTagged n) {
     if (CPyTagged_CheckShort(n)) {
-        return CPyTagged_ShortToStr(CPyTagged_ShortAsSsize_t(n));
+        char buf[CPY_MAX_INT_CHARS];
+        int len = CPy_FormatSsize_t(buf, CPyTagged_ShortAsSsize_t(n));
+        return CPyTagged_FormattedToStr(buf, len);
     } else {
-        return PyObject_Str(CPyTagged_AsObject(n));
+        // This is what PyObject_Str calls, but it can't be overridden for ints
+        return _PyLong_Format(CPyTagged_LongAsObject(n), 10);
+    }
+}
+
+PyObject *CPyTagged_Hex(CPyTagged n) {
+    if (CPyTagged_CheckShort(n)) {
+        char buf[CPY_MAX_INT_CHARS];
+        int len = CPy_FormatSsize_tHex(buf, CPyTagged_ShortAsSsize_t(n));
+        return CPyTagged_FormattedToStr(buf, len);
+    } else {
+        return _PyLong_Format(CPyTagged_LongAsObject(n), 16);
     }
 }
 
@@ -496,18 +914,15 @@ void CPyDebug_Print(const char *msg) {
     fflush(stdout);
 }
 
-int CPySequence_CheckUnpackCount(PyObject *sequence, Py_ssize_t expected) {
-    Py_ssize_t actual = Py_SIZE(sequence);
-    if (unlikely(actual != expected)) {
-        if (actual < expected) {
-            PyErr_Format(PyExc_ValueError, "not enough values to unpack (expected %zd, got %zd)",
-                         expected, actual);
-        } else {
-            PyErr_Format(PyExc_ValueError, "too many values to unpack (expected %zd)", expected);
-        }
-        return -1;
+// Slow path of CPySequence_CheckUnpackCount
+int CPySequence_UnpackCountError(Py_ssize_t actual, Py_ssize_t expected) {
+    if (actual < expected) {
+        PyErr_Format(PyExc_ValueError, "not enough values to unpack (expected %zd, got %zd)",
+                     expected, actual);
+    } else {
+        PyErr_Format(PyExc_ValueError, "too many values to unpack (expected %zd)", expected);
     }
-    return 0;
+    return -1;
 }
 
 // Parse an integer (size_t) encoded as a variable-length binary sequence.
@@ -522,6 +937,44 @@ static const char *parse_int(const char *s, size_t *len) {
     return s;
 }
 
+// Create a str literal from UTF-8 data. The header has the length of the data
+// shifted left by one, and the low bit is set for ASCII values, which can be
+// copied into a new object without decoding.
+static PyObject *make_str_literal(const char *data, size_t header) {
+    size_t len = header >> 1;
+    PyObject *obj;
+    if (header & 1) {
+        obj = PyUnicode_New(len, 127);
+        if (obj == NULL) {
+            return NULL;
+        }
+        memcpy(PyUnicode_1BYTE_DATA(obj), data, len);
+    } else {
+        obj = PyUnicode_FromStringAndSize(data, len);
+        if (obj == NULL) {
+            return NULL;
+        }
+    }
+    PyUnicode_InternInPlace(&obj);
+    // Make sure that the hash is cached, since dict operations
+    // with literal keys use it directly (see CPyDict_GetItemKnownHash)
+    if (PyObject_Hash(obj) == -1) {
+        Py_DECREF(obj);
+        return NULL;
+    }
+    return obj;
+}
+
+// Make literal objects immortal by convention (see CPY_IMMORTAL_STATICS)
+static void immortalize_statics(PyObject **statics, Py_ssize_t num) {
+#ifdef CPY_IMMORTAL_STATICS
+    Py_ssize_t i;
+    for (i = 0; i < num; i++) {
+        statics[i]->ob_refcnt += CPY_IMMORTAL_REFCNT_BIAS;
+    }
+#endif
+}
+
 // Initialize static constant array of literal values
 int CPyStatics_Initialize(PyObject **statics,
                           const char * const *strings,
@@ -529,7 +982,8 @@ int CPyStatics_Initialize(PyObject **statics,
                           const char * const *ints,
                           const double *floats,
                           const double *complex_numbers,
-                          const int *tuples) {
+                          const int *tuples,
+                          const int *frozensets) {
     PyObject **result = statics;
     // Start with some hard-coded values
     *result++ = Py_None;
@@ -544,15 +998,14 @@ int CPyStatics_Initialize(PyObject **statics,
             const char *data = *strings;
             data = parse_int(data, &num);
             while (num-- > 0) {
-                size_t len;
-                data = parse_int(data, &len);
-                PyObject *obj = PyUnicode_FromStringAndSize(data, len);
+                size_t header;
+                data = parse_int(data, &header);
+                PyObject *obj = make_str_literal(data, header);
                 if (obj == NULL) {
                     return -1;
                 }
-                PyUnicode_InternInPlace(&obj);
                 *result++ = obj;
-                data += len;
+                data += header >> 1;
             }
         }
     }
@@ -629,5 +1082,800 @@ int CPyStatics_Initialize(PyObject **statics,
             *result++ = obj;
         }
     }
+    if (frozensets) {
+        int num = *frozensets++;
+        while (num-- > 0) {
+            int num_items = *frozensets++;
+            PyObject *obj = PyFrozenSet_New(NULL);
+            if (obj == NULL) {
+                return -1;
+            }
+            int i;
+            for (i = 0; i < num_items; i++) {
+                PyObject *item = statics[*frozensets++];
+                if (PySet_Add(obj, item) < 0) {
+                    Py_DECREF(obj);
+                    return -1;
+                }
+            }
+            *result++ = obj;
+        }
+    }
+    immortalize_statics(statics, result - statics);
+    return 0;
+}
+
+// Lazy variant of CPyStatics_Initialize, used when compiled with
+// MYPYC_LAZY_STATICS. Only the singletons are created here. The literal
+// descriptions are scanned to find where each literal is described, and
+// each literal is created on first use by CPyStatics_Load. This avoids
+// creating objects for literals that a short-running program never uses.
+int CPyStatics_InitializeLazy(CPyStatics_Table *table,
+                              PyObject **statics,
+                              Py_ssize_t num_literals,
+                              const char * const *strings,
+                              const char * const *bytestrings,
+                              const char * const *ints,
+                              const double *floats,
+                              const double *complex_numbers,
+                              const int *tuples,
+                              const int *frozensets) {
+    const void **locations = PyMem_Calloc(num_literals, sizeof(const void *));
+    if (locations == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    Py_ssize_t index = 0;
+    statics[index++] = Py_None;
+    Py_INCREF(Py_None);
+    statics[index++] = Py_False;
+    Py_INCREF(Py_False);
+    statics[index++] = Py_True;
+    Py_INCREF(Py_True);
+    immortalize_statics(statics, index);
+
+    table->starts[CPYLIT_STR] = index;
+    if (strings) {
+        for (; **strings != '\0'; strings++) {
+            size_t num;
+            const char *data = parse_int(*strings, &num);
+            while (num-- > 0) {
+                size_t header;
+                locations[index++] = data;
+                data = parse_int(data, &header);
+                data += header >> 1;
+            }
+        }
+    }
+    table->starts[CPYLIT_BYTES] = index;
+    if (bytestrings) {
+        for (; **bytestrings != '\0'; bytestrings++) {
+            size_t num;
+            const char *data = parse_int(*bytestrings, &num);
+            while (num-- > 0) {
+                size_t len;
+                locations[index++] = data;
+                data = parse_int(data, &len);
+                data += len;
+            }
+        }
+    }
+    table->starts[CPYLIT_INT] = index;
+    if (ints) {
+        for (; **ints != '\0'; ints++) {
+            size_t num;
+            const char *data = parse_int(*ints, &num);
+            while (num-- > 0) {
+                locations[index++] = data;
+                data += strlen(data) + 1;
+            }
+        }
+    }
+    table->starts[CPYLIT_FLOAT] = index;
+    if (floats) {
+        size_t num = (size_t)*floats++;
+        while (num-- > 0) {
+            locations[index++] = floats++;
+        }
+    }
+    table->starts[CPYLIT_COMPLEX] = index;
+    if (complex_numbers) {
+        size_t num = (size_t)*complex_numbers++;
+        while (num-- > 0) {
+            locations[index++] = complex_numbers;
+            complex_numbers += 2;
+        }
+    }
+    table->starts[CPYLIT_TUPLE] = index;
+    if (tuples) {
+        int num = *tuples++;
+        while (num-- > 0) {
+            locations[index++] = tuples;
+            tuples += *tuples + 1;
+        }
+    }
+    table->starts[CPYLIT_FROZENSET] = index;
+    if (frozensets) {
+        int num = *frozensets++;
+        while (num-- > 0) {
+            locations[index++] = frozensets;
+            frozensets += *frozensets + 1;
+        }
+    }
+    for (index = table->starts[CPYLIT_STR]; index < num_literals; index++) {
+        statics[index] = NULL;
+    }
+    table->statics = statics;
+    table->locations = locations;
+    return 0;
+}
+
+static PyObject *load_literal(CPyStatics_Table *table, Py_ssize_t index) {
+    const void *location = table->locations[index];
+    if (index < table->starts[CPYLIT_BYTES]) {
+        size_t header;
+        const char *data = parse_int(location, &header);
+        return make_str_literal(data, header);
+    } else if (index < table->starts[CPYLIT_INT]) {
+        size_t len;
+        const char *data = parse_int(location, &len);
+        return PyBytes_FromStringAndSize(data, len);
+    } else if (index < table->starts[CPYLIT_FLOAT]) {
+        return PyLong_FromString(location, NULL, 10);
+    } else if (index < table->starts[CPYLIT_COMPLEX]) {
+        return PyFloat_FromDouble(*(const double *)location);
+    } else if (index < table->starts[CPYLIT_TUPLE]) {
+        const double *parts = location;
+        return PyComplex_FromDoubles(parts[0], parts[1]);
+    }
+    const int *items = location;
+    int num_items = *items++;
+    int i;
+    if (index < table->starts[CPYLIT_FROZENSET]) {
+        PyObject *obj = PyTuple_New(num_items);
+        if (obj == NULL) {
+            return NULL;
+        }
+        for (i = 0; i < num_items; i++) {
+            PyObject *item = CPyStatics_Get(table, items[i]);
+            Py_INCREF(item);
+            PyTuple_SET_ITEM(obj, i, item);
+        }
+        return obj;
+    } else {
+        PyObject *obj = PyFrozenSet_New(NULL);
+        if (obj == NULL) {
+            return NULL;
+        }
+        for (i = 0; i < num_items; i++) {
+            if (PySet_Add(obj, CPyStatics_Get(table, items[i])) < 0) {
+                Py_DECREF(obj);
+                return NULL;
+            }
+        }
+        return obj;
+    }
+}
+
+// Create a literal that hasn't been used yet (see CPyStatics_InitializeLazy).
+// Literal loads can't fail in generated code, and only running out of memory
+// can make this fail, so this treats errors as fatal.
+PyObject *CPyStatics_Load(CPyStatics_Table *table, Py_ssize_t index) {
+    PyObject *obj = load_literal(table, index);
+    if (obj == NULL) {
+        CPyError_OutOfMemory();
+    }
+    immortalize_statics(&obj, 1);
+    table->statics[index] = obj;
+    return obj;
+}
+
+#ifdef MYPYC_PROFILE_IMPORT
+
+// Import-time profiling, compiled in if MYPYC_PROFILE_IMPORT is defined.
+//
+// If the MYPYC_IMPORT_PROFILE environment variable names a file, the
+// phases of initializing compiled modules (literals, class creation,
+// module top levels, etc.) are timed, along with the number of memory
+// blocks allocated during each phase. The results are appended to the file
+// at exit as events in the Chrome trace array format, which can be viewed
+// in chrome://tracing or Perfetto. The closing bracket of the trace is
+// omitted, which the format allows, so that each compilation group in a
+// process can append its own events to the same file.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+PyAPI_FUNC(Py_ssize_t) _Py_GetAllocatedBlocks(void);
+
+typedef struct {
+    const char *phase;
+    char name[120];
+    int64_t start;
+    int64_t duration;
+    Py_ssize_t blocks;
+} CPyImportProfileEvent;
+
+static int CPyImportProfile_Enabled = -1;  // -1 if not checked yet
+static char *CPyImportProfile_Path;
+static CPyImportProfileEvent *CPyImportProfile_Events;
+static size_t CPyImportProfile_NumEvents;
+static size_t CPyImportProfile_Capacity;
+
+static int64_t CPyImportProfile_Now(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (int64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static void CPyImportProfile_WriteString(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', f);
+        }
+        if ((unsigned char)*s >= 0x20) {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+// Called by Py_AtExit, so this can't use the Python C API.
+static void CPyImportProfile_Dump(void) {
+    FILE *f = fopen(CPyImportProfile_Path, "a");
+    size_t i;
+    if (f == NULL) {
+        fprintf(stderr, "mypyc: can't write import profile to %s\n", CPyImportProfile_Path);
+        return;
+    }
+    fseek(f, 0, SEEK_END);
+    if (ftell(f) == 0) {
+        fputs("[\n", f);
+    }
+    for (i = 0; i < CPyImportProfile_NumEvents; i++) {
+        CPyImportProfileEvent *event = &CPyImportProfile_Events[i];
+        fputs("{\"name\": ", f);
+        CPyImportProfile_WriteString(f, event->name);
+        fputs(", \"cat\": ", f);
+        CPyImportProfile_WriteString(f, event->phase);
+        fprintf(f, ", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": 1, "
+                "\"args\": {\"allocated_blocks\": %zd}},\n",
+                event->start / 1000.0, event->duration / 1000.0, event->blocks);
+    }
+    fclose(f);
+    free(CPyImportProfile_Events);
+}
+
+void CPyImportProfile_Start(CPyImportProfileMark *mark) {
+    if (CPyImportProfile_Enabled < 0) {
+        const char *path = getenv("MYPYC_IMPORT_PROFILE");
+        CPyImportProfile_Enabled = 0;
+        if (path != NULL && *path != '\0') {
+            CPyImportProfile_Path = strdup(path);
+            if (CPyImportProfile_Path != NULL && Py_AtExit(CPyImportProfile_Dump) == 0) {
+                CPyImportProfile_Enabled = 1;
+            }
+        }
+    }
+    if (!CPyImportProfile_Enabled) {
+        mark->start = -1;
+        return;
+    }
+    mark->blocks = _Py_GetAllocatedBlocks();
+    mark->start = CPyImportProfile_Now();
+}
+
+void CPyImportProfile_End(CPyImportProfileMark *mark, const char *phase, const char *name) {
+    int64_t end = CPyImportProfile_Now();
+    CPyImportProfileEvent *event;
+    if (mark->start < 0) {
+        return;
+    }
+    if (CPyImportProfile_NumEvents == CPyImportProfile_Capacity) {
+        size_t capacity = CPyImportProfile_Capacity ? CPyImportProfile_Capacity * 2 : 256;
+        CPyImportProfileEvent *events = realloc(CPyImportProfile_Events,
+                                                capacity * sizeof(CPyImportProfileEvent));
+        if (events == NULL) {
+            // Profiling is best effort, so just drop the event
+            return;
+        }
+        CPyImportProfile_Events = events;
+        CPyImportProfile_Capacity = capacity;
+    }
+    event = &CPyImportProfile_Events[CPyImportProfile_NumEvents++];
+    event->phase = phase;
+    snprintf(event->name, sizeof(event->name), "%s", name ? name : "");
+    event->start = mark->start;
+    event->duration = end - mark->start;
+    event->blocks = _Py_GetAllocatedBlocks() - mark->blocks;
+}
+
+#endif
+
+// Receiver type profiling of native method call sites (see
+// CPyDispatchSite). If the MYPYC_DISPATCH_PROFILE environment variable
+// is set, the counts of each compilation group are appended to the file
+// it names when the interpreter exits, as one "site<TAB>type<TAB>count"
+// line per observed type, where "*" stands for all the types that didn't
+// fit in the table of a site. mypyc reads these files back through the
+// dispatch_profile option.
+
+typedef struct {
+    CPyDispatchSite *sites;
+    const char * const *names;
+    Py_ssize_t num;
+} CPyDispatchProfileGroup;
+
+static char *CPyDispatchProfile_Path;
+static CPyDispatchProfileGroup *CPyDispatchProfile_Groups;
+static Py_ssize_t CPyDispatchProfile_NumGroups;
+
+static void CPyDispatchProfile_WriteType(FILE *f, PyTypeObject *type) {
+    const char *name;
+    PyObject *module = PyObject_GetAttrString((PyObject *)type, "__module__");
+    PyObject *qualname = PyObject_GetAttrString((PyObject *)type, "__qualname__");
+    PyObject *fullname = NULL;
+    if (module != NULL && qualname != NULL && PyUnicode_Check(module)) {
+        fullname = PyUnicode_FromFormat("%U.%S", module, qualname);
+    }
+    name = fullname ? PyUnicode_AsUTF8(fullname) : NULL;
+    if (name == NULL) {
+        PyErr_Clear();
+        name = type->tp_name;
+    }
+    fputs(name, f);
+    Py_XDECREF(module);
+    Py_XDECREF(qualname);
+    Py_XDECREF(fullname);
+}
+
+// Registered with the atexit module, so that the types are still alive
+static PyObject *CPyDispatchProfile_Dump(PyObject *self, PyObject *unused) {
+    Py_ssize_t i, j;
+    int k;
+    FILE *f = fopen(CPyDispatchProfile_Path, "a");
+    if (f == NULL) {
+        return PyErr_SetFromErrnoWithFilename(PyExc_OSError, CPyDispatchProfile_Path);
+    }
+    for (i = 0; i < CPyDispatchProfile_NumGroups; i++) {
+        CPyDispatchProfileGroup *group = &CPyDispatchProfile_Groups[i];
+        for (j = 0; j < group->num; j++) {
+            CPyDispatchSite *site = &group->sites[j];
+            for (k = 0; k < CPY_DISPATCH_PROFILE_TYPES && site->types[k] != NULL; k++) {
+                fprintf(f, "%s\t", group->names[j]);
+                CPyDispatchProfile_WriteType(f, site->types[k]);
+                fprintf(f, "\t%llu\n", (unsigned long long)site->counts[k]);
+            }
+            if (site->other) {
+                fprintf(f, "%s\t*\t%llu\n", group->names[j], (unsigned long long)site->other);
+            }
+        }
+    }
+    fclose(f);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef CPyDispatchProfile_DumpDef = {
+    "_dump_dispatch_profile", CPyDispatchProfile_Dump, METH_NOARGS, NULL
+};
+
+// Register the call site table of a compilation group, which has num
+// entries named by the corresponding entries of names.
+int CPyDispatchProfile_Register(CPyDispatchSite *sites, const char * const *names,
+                                Py_ssize_t num) {
+    CPyDispatchProfileGroup *groups;
+    if (CPyDispatchProfile_Path == NULL) {
+        const char *path = getenv("MYPYC_DISPATCH_PROFILE");
+        PyObject *atexit, *func, *res;
+        if (path == NULL || *path == '\0') {
+            // Keep counting, since that is cheap, but don't write anything
+            return 0;
+        }
+        atexit = PyImport_ImportModule("atexit");
+        if (atexit == NULL) {
+            return -1;
+        }
+        func = PyCFunction_New(&CPyDispatchProfile_DumpDef, NULL);
+        if (func == NULL) {
+            Py_DECREF(atexit);
+            return -1;
+        }
+        CPyDispatchProfile_Path = strdup(path);
+        if (CPyDispatchProfile_Path == NULL) {
+            Py_DECREF(atexit);
+            Py_DECREF(func);
+            PyErr_NoMemory();
+            return -1;
+        }
+        res = PyObject_CallMethod(atexit, "register", "O", func);
+        Py_DECREF(atexit);
+        Py_DECREF(func);
+        if (res == NULL) {
+            free(CPyDispatchProfile_Path);
+            CPyDispatchProfile_Path = NULL;
+            return -1;
+        }
+        Py_DECREF(res);
+    }
+    groups = PyMem_RawRealloc(CPyDispatchProfile_Groups,
+                              (CPyDispatchProfile_NumGroups + 1) * sizeof(*groups));
+    if (groups == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    groups[CPyDispatchProfile_NumGroups].sites = sites;
+    groups[CPyDispatchProfile_NumGroups].names = names;
+    groups[CPyDispatchProfile_NumGroups].num = num;
+    CPyDispatchProfile_Groups = groups;
+    CPyDispatchProfile_NumGroups++;
     return 0;
 }
+
+#ifdef MYPYC_PROFILE_ATTRS
+
+// Attribute access profiling, compiled in if MYPYC_PROFILE_ATTRS is
+// defined (see CPyAttrProfile_Record). If the MYPYC_ATTR_PROFILE
+// environment variable is set, the counts are appended to the file it
+// names when the interpreter exits, as one "site<TAB>type<TAB>attr<TAB>count"
+// line per observed combination, where sites are named "module:line" and
+// "*" stands for all lookups that don't have an inline cache. If
+// MYPYC_ATTR_PROFILE_SAMPLE is set to N > 1, only every Nth lookup is
+// recorded and the counts written are scaled up by N.
+
+typedef struct {
+    CPyInlineCache *site;
+    PyTypeObject *type;
+    PyObject *attr;
+    uint64_t count;
+} CPyAttrProfileEntry;
+
+typedef struct {
+    CPyInlineCache *caches;
+    const char * const *names;
+    Py_ssize_t num;
+} CPyAttrProfileGroup;
+
+// Nothing is recorded until a group is registered while profiling is enabled
+int CPyAttrProfile_Countdown = INT_MAX;
+
+static int CPyAttrProfile_Enabled;
+static int CPyAttrProfile_SampleRate = 1;
+static char *CPyAttrProfile_Path;
+static CPyAttrProfileGroup *CPyAttrProfile_Groups;
+static Py_ssize_t CPyAttrProfile_NumGroups;
+
+// Open addressing hash table keyed by (site, type, attr). The entries own
+// references to the type and the attribute name.
+static CPyAttrProfileEntry *CPyAttrProfile_Table;
+static size_t CPyAttrProfile_Capacity;
+static size_t CPyAttrProfile_Size;
+
+static size_t CPyAttrProfile_Hash(CPyInlineCache *site, PyTypeObject *type, PyObject *attr) {
+    size_t h = (size_t)site;
+    h = h * 1000003 ^ (size_t)type;
+    h = h * 1000003 ^ (size_t)attr;
+    return h ^ (h >> 13);
+}
+
+static CPyAttrProfileEntry *CPyAttrProfile_Lookup(CPyAttrProfileEntry *table, size_t capacity,
+                                                  CPyInlineCache *site, PyTypeObject *type,
+                                                  PyObject *attr) {
+    size_t i = CPyAttrProfile_Hash(site, type, attr) & (capacity - 1);
+    while (table[i].type != NULL
+           && (table[i].site != site || table[i].type != type || table[i].attr != attr)) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &table[i];
+}
+
+// Keep the load factor at most 1/2. Returns false if out of memory.
+static bool CPyAttrProfile_Grow(void) {
+    size_t capacity = CPyAttrProfile_Capacity ? CPyAttrProfile_Capacity * 2 : 64;
+    CPyAttrProfileEntry *table = PyMem_RawCalloc(capacity, sizeof(*table));
+    size_t i;
+    if (table == NULL) {
+        return false;
+    }
+    for (i = 0; i < CPyAttrProfile_Capacity; i++) {
+        CPyAttrProfileEntry *old = &CPyAttrProfile_Table[i];
+        if (old->type != NULL) {
+            *CPyAttrProfile_Lookup(table, capacity, old->site, old->type, old->attr) = *old;
+        }
+    }
+    PyMem_RawFree(CPyAttrProfile_Table);
+    CPyAttrProfile_Table = table;
+    CPyAttrProfile_Capacity = capacity;
+    return true;
+}
+
+void CPyAttrProfile_RecordSlow(CPyInlineCache *site, PyObject *obj, PyObject *attr) {
+    CPyAttrProfileEntry *entry;
+    PyTypeObject *type = Py_TYPE(obj);
+    if (!CPyAttrProfile_Enabled) {
+        CPyAttrProfile_Countdown = INT_MAX;
+        return;
+    }
+    CPyAttrProfile_Countdown = CPyAttrProfile_SampleRate;
+    if (CPyAttrProfile_Size * 2 >= CPyAttrProfile_Capacity && !CPyAttrProfile_Grow()) {
+        // Drop the sample rather than fail the lookup being profiled
+        return;
+    }
+    entry = CPyAttrProfile_Lookup(CPyAttrProfile_Table, CPyAttrProfile_Capacity,
+                                  site, type, attr);
+    if (entry->type == NULL) {
+        Py_INCREF(type);
+        Py_INCREF(attr);
+        entry->site = site;
+        entry->type = type;
+        entry->attr = attr;
+        CPyAttrProfile_Size++;
+    }
+    entry->count++;
+}
+
+static const char *CPyAttrProfile_SiteName(CPyInlineCache *site) {
+    Py_ssize_t i;
+    if (site == NULL) {
+        return "*";
+    }
+    for (i = 0; i < CPyAttrProfile_NumGroups; i++) {
+        CPyAttrProfileGroup *group = &CPyAttrProfile_Groups[i];
+        if (site >= group->caches && site < group->caches + group->num) {
+            return group->names[site - group->caches];
+        }
+    }
+    return "?";
+}
+
+// Return "module.qualname" for a type, or tp_name if that isn't available
+static PyObject *CPyAttrProfile_TypeName(PyTypeObject *type) {
+    PyObject *module = PyObject_GetAttrString((PyObject *)type, "__module__");
+    PyObject *qualname = PyObject_GetAttrString((PyObject *)type, "__qualname__");
+    PyObject *result = NULL;
+    if (module != NULL && qualname != NULL && PyUnicode_Check(module)) {
+        result = PyUnicode_FromFormat("%U.%S", module, qualname);
+    }
+    Py_XDECREF(module);
+    Py_XDECREF(qualname);
+    if (result == NULL) {
+        PyErr_Clear();
+        result = PyUnicode_FromString(type->tp_name);
+    }
+    return result;
+}
+
+// Return the counts (scaled by the sample rate) as a dict that maps
+// (site, type name, attribute name) tuples to ints. Entries only differing
+// by the identity of equal attribute names are merged.
+PyObject *CPyAttrProfile_Get(void) {
+    PyObject *result = PyDict_New();
+    size_t i;
+    if (result == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < CPyAttrProfile_Capacity; i++) {
+        CPyAttrProfileEntry *entry = &CPyAttrProfile_Table[i];
+        unsigned long long count = entry->count * CPyAttrProfile_SampleRate;
+        PyObject *key, *value;
+        if (entry->type == NULL) {
+            continue;
+        }
+        key = Py_BuildValue("(sNO)", CPyAttrProfile_SiteName(entry->site),
+                            CPyAttrProfile_TypeName(entry->type), entry->attr);
+        if (key == NULL) {
+            Py_DECREF(result);
+            return NULL;
+        }
+        value = PyDict_GetItemWithError(result, key);
+        if (value != NULL) {
+            count += PyLong_AsUnsignedLongLong(value);
+        }
+        value = PyErr_Occurred() ? NULL : PyLong_FromUnsignedLongLong(count);
+        if (value == NULL || PyDict_SetItem(result, key, value) < 0) {
+            Py_DECREF(key);
+            Py_XDECREF(value);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(key);
+        Py_DECREF(value);
+    }
+    return result;
+}
+
+void CPyAttrProfile_Reset(void) {
+    size_t i;
+    for (i = 0; i < CPyAttrProfile_Capacity; i++) {
+        CPyAttrProfileEntry *entry = &CPyAttrProfile_Table[i];
+        if (entry->type != NULL) {
+            Py_DECREF(entry->type);
+            Py_DECREF(entry->attr);
+        }
+    }
+    PyMem_RawFree(CPyAttrProfile_Table);
+    CPyAttrProfile_Table = NULL;
+    CPyAttrProfile_Capacity = 0;
+    CPyAttrProfile_Size = 0;
+}
+
+// Registered with the atexit module, so that the types are still alive
+static PyObject *CPyAttrProfile_Dump(PyObject *self, PyObject *unused) {
+    PyObject *counts = CPyAttrProfile_Get();
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    FILE *f;
+    if (counts == NULL) {
+        return NULL;
+    }
+    f = fopen(CPyAttrProfile_Path, "a");
+    if (f == NULL) {
+        Py_DECREF(counts);
+        return PyErr_SetFromErrnoWithFilename(PyExc_OSError, CPyAttrProfile_Path);
+    }
+    while (PyDict_Next(counts, &pos, &key, &value)) {
+        const char *type_name = PyUnicode_AsUTF8(PyTuple_GET_ITEM(key, 1));
+        const char *attr = PyUnicode_AsUTF8(PyTuple_GET_ITEM(key, 2));
+        if (type_name == NULL || attr == NULL) {
+            fclose(f);
+            Py_DECREF(counts);
+            return NULL;
+        }
+        fprintf(f, "%s\t%s\t%s\t%llu\n", PyUnicode_AsUTF8(PyTuple_GET_ITEM(key, 0)),
+                type_name, attr, PyLong_AsUnsignedLongLong(value));
+    }
+    fclose(f);
+    Py_DECREF(counts);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef CPyAttrProfile_DumpDef = {
+    "_dump_attr_profile", CPyAttrProfile_Dump, METH_NOARGS, NULL
+};
+
+// Register the inline cache table of a compilation group, which has num
+// entries named by the corresponding entries of names. The first
+// registration reads the environment and enables profiling.
+int CPyAttrProfile_Register(CPyInlineCache *caches, const char * const *names,
+                            Py_ssize_t num) {
+    CPyAttrProfileGroup *groups;
+    if (CPyAttrProfile_Path == NULL) {
+        const char *path = getenv("MYPYC_ATTR_PROFILE");
+        const char *sample = getenv("MYPYC_ATTR_PROFILE_SAMPLE");
+        PyObject *atexit, *func, *res;
+        if (path == NULL || *path == '\0') {
+            return 0;
+        }
+        atexit = PyImport_ImportModule("atexit");
+        if (atexit == NULL) {
+            return -1;
+        }
+        func = PyCFunction_New(&CPyAttrProfile_DumpDef, NULL);
+        if (func == NULL) {
+            Py_DECREF(atexit);
+            return -1;
+        }
+        CPyAttrProfile_Path = strdup(path);
+        if (CPyAttrProfile_Path == NULL) {
+            Py_DECREF(atexit);
+            Py_DECREF(func);
+            PyErr_NoMemory();
+            return -1;
+        }
+        res = PyObject_CallMethod(atexit, "register", "O", func);
+        Py_DECREF(atexit);
+        Py_DECREF(func);
+        if (res == NULL) {
+            free(CPyAttrProfile_Path);
+            CPyAttrProfile_Path = NULL;
+            return -1;
+        }
+        Py_DECREF(res);
+        if (sample != NULL && atoi(sample) > 1) {
+            CPyAttrProfile_SampleRate = atoi(sample);
+        }
+        CPyAttrProfile_Enabled = 1;
+        CPyAttrProfile_Countdown = 1;
+    }
+    groups = PyMem_RawRealloc(CPyAttrProfile_Groups,
+                              (CPyAttrProfile_NumGroups + 1) * sizeof(*groups));
+    if (groups == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    groups[CPyAttrProfile_NumGroups].caches = caches;
+    groups[CPyAttrProfile_NumGroups].names = names;
+    groups[CPyAttrProfile_NumGroups].num = num;
+    CPyAttrProfile_Groups = groups;
+    CPyAttrProfile_NumGroups++;
+    return 0;
+}
+
+#endif
+
+#ifdef MYPYC_STATS
+
+// Runtime statistics, compiled in if MYPYC_STATS is defined (see
+// CPY_STATS_COUNTERS in mypyc_util.h). Each compilation group has its own
+// counters. If the MYPYC_STATS_FILE environment variable names a file,
+// the nonzero counters are appended to it at exit as "name<TAB>count"
+// lines, preceded by a "# mypyc stats" line. CPyStats_Get() returns the
+// current values as a dict.
+
+uint64_t CPyStats_Counters[CPY_NUM_STATS];
+
+#define CPY_STATS_NAME(name) #name,
+static const char * const CPyStats_Names[CPY_NUM_STATS] = {
+    CPY_STATS_COUNTERS(CPY_STATS_NAME)
+};
+#undef CPY_STATS_NAME
+
+static char *CPyStats_Path;
+
+// Called by Py_AtExit, so this can't use the Python C API.
+static void CPyStats_Dump(void) {
+    FILE *f = fopen(CPyStats_Path, "a");
+    int i;
+    if (f == NULL) {
+        fprintf(stderr, "mypyc: can't write stats to %s\n", CPyStats_Path);
+        return;
+    }
+    fputs("# mypyc stats\n", f);
+    for (i = 0; i < CPY_NUM_STATS; i++) {
+        if (CPyStats_Counters[i] != 0) {
+            fprintf(f, "%s\t%llu\n", CPyStats_Names[i],
+                    (unsigned long long)CPyStats_Counters[i]);
+        }
+    }
+    fclose(f);
+}
+
+void CPyStats_Init(void) {
+    const char *path = getenv("MYPYC_STATS_FILE");
+    if (CPyStats_Path != NULL || path == NULL || *path == '\0') {
+        return;
+    }
+    CPyStats_Path = strdup(path);
+    if (CPyStats_Path != NULL && Py_AtExit(CPyStats_Dump) < 0) {
+        fprintf(stderr, "mypyc: can't register stats dump\n");
+        free(CPyStats_Path);
+        CPyStats_Path = NULL;
+    }
+}
+
+PyObject *CPyStats_Get(void) {
+    PyObject *result = PyDict_New();
+    int i;
+    if (result == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < CPY_NUM_STATS; i++) {
+        PyObject *value = PyLong_FromUnsignedLongLong(CPyStats_Counters[i]);
+        if (value == NULL || PyDict_SetItemString(result, CPyStats_Names[i], value) < 0) {
+            Py_XDECREF(value);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(value);
+    }
+    return result;
+}
+
+void CPyStats_Reset(void) {
+    memset(CPyStats_Counters, 0, sizeof(CPyStats_Counters));
+}
+
+#endif
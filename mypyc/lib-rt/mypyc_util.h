@@ -23,13 +23,111 @@
 #define CPy_NOINLINE
 #endif
 
+// Pointer qualifier telling the compiler that arrays don't overlap. This
+// helps with vectorizing simple loops.
+#if defined(__cplusplus)
+#define CPY_RESTRICT
+#elif defined(_MSC_VER)
+#define CPY_RESTRICT __restrict
+#else
+#define CPY_RESTRICT restrict
+#endif
+
+// Compiler support for checked arithmetic (__builtin_add_overflow and friends)
+// and 128-bit integers. Only used to speed up the short int fast paths; there
+// is a portable fallback for other compilers (including MSVC).
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define CPY_HAVE_OVERFLOW_BUILTINS 1
+#endif
+
+#if defined(__SIZEOF_INT128__)
+#define CPY_HAVE_INT128 1
+#endif
+
+// Runtime statistics, compiled in if MYPYC_STATS is defined (see
+// misc_ops.c). Each counter counts how often generated
+// code or the runtime takes a particular path, such as boxing an int or
+// falling back to the generic implementation of a primitive.
+#define CPY_STATS_COUNTERS(X) \
+    X(incref)               /* CPy_INCREF */ \
+    X(decref)               /* CPy_DECREF and CPy_XDECREF */ \
+    X(int_incref)           /* CPyTagged_IncRef */ \
+    X(int_decref)           /* CPyTagged_DecRef and CPyTagged_XDecRef */ \
+    X(int_box_short)        /* short int boxed by CPyTagged_(Steal)AsObject */ \
+    X(int_box_long)         /* long int "boxed" by CPyTagged_(Steal)AsObject */ \
+    X(int_unbox_short)      /* CPyTagged_*FromObject producing a short int */ \
+    X(int_unbox_long)       /* CPyTagged_*FromObject producing a long int */ \
+    X(int_bitwise_long)     /* '&', '|' or '^' with a long operand */ \
+    X(dict_get_item_fast)   /* CPyDict_GetItem* with a native lookup */ \
+    X(dict_get_item_slow)   /* CPyDict_GetItem* calling __getitem__ */ \
+    X(dict_set_item_fast)   /* CPyDict_SetItem* with a native store */ \
+    X(dict_set_item_slow)   /* CPyDict_SetItem* calling __setitem__ */ \
+    X(dict_update_slow)     /* CPyDict_Update* on a dict subclass */ \
+    X(get_slice_generic)    /* CPyObject_GetSlice(Step) creating a slice */ \
+    X(traceback)            /* CPy_AddTraceback(Cached) */ \
+    X(arg_parser_init)      /* first use of a static argument parser */
+
+#ifdef MYPYC_STATS
+#define CPY_STATS_ENUM(name) CPY_STAT_##name,
+typedef enum { CPY_STATS_COUNTERS(CPY_STATS_ENUM) CPY_NUM_STATS } CPyStat;
+#undef CPY_STATS_ENUM
+extern uint64_t CPyStats_Counters[CPY_NUM_STATS];
+#define CPyStats_INC(name) (CPyStats_Counters[CPY_STAT_##name]++)
+#else
+#define CPyStats_INC(name) ((void)0)
+#endif
+
+// With MYPYC_IMMORTAL_STATICS, the objects in the literal table are
+// immortal by convention: their reference counts are raised by a bias
+// that no real count comes close to. Generated code skips increfs of
+// literal loads, and CPy_INCREF and CPy_DECREF leave immortal objects
+// alone, so references taken and dropped by generated code don't change
+// their counts. Only references handed over to CPython without an incref
+// (such as items stored in a new list) are decremented there, and half of
+// the bias allows for 2**59 of those.
+// This relies on 64-bit reference counts, so it's ignored elsewhere.
+#if defined(MYPYC_IMMORTAL_STATICS) && SIZEOF_VOID_P >= 8
+#define CPY_IMMORTAL_STATICS
+#define CPY_IMMORTAL_REFCNT_BIAS ((Py_ssize_t)1 << 60)
+#define CPy_IsImmortal(p) (((PyObject *)(p))->ob_refcnt >= CPY_IMMORTAL_REFCNT_BIAS / 2)
+#else
+#define CPy_IsImmortal(p) 0
+#endif
+
 // INCREF and DECREF that assert the pointer is not NULL.
 // asserts are disabled in release builds so there shouldn't be a perf hit.
 // I'm honestly kind of surprised that this isn't done by default.
-#define CPy_INCREF(p) do { assert(p); Py_INCREF(p); } while (0)
-#define CPy_DECREF(p) do { assert(p); Py_DECREF(p); } while (0)
+static inline void _CPy_INCREF(PyObject *p) {
+    assert(p);
+    CPyStats_INC(incref);
+    if (!CPy_IsImmortal(p)) {
+        Py_INCREF(p);
+    }
+}
+
+static inline void _CPy_DECREF(PyObject *p) {
+    assert(p);
+    CPyStats_INC(decref);
+    if (!CPy_IsImmortal(p)) {
+        Py_DECREF(p);
+    }
+}
+
 // Here just for consistency
-#define CPy_XDECREF(p) Py_XDECREF(p)
+static inline void _CPy_XDECREF(PyObject *p) {
+    if (p != NULL) {
+        CPyStats_INC(decref);
+        if (!CPy_IsImmortal(p)) {
+            Py_DECREF(p);
+        }
+    }
+}
+
+// Like Py_INCREF and friends, these accept any object pointer type and
+// evaluate their argument once.
+#define CPy_INCREF(p) _CPy_INCREF((PyObject *)(p))
+#define CPy_DECREF(p) _CPy_DECREF((PyObject *)(p))
+#define CPy_XDECREF(p) _CPy_XDECREF((PyObject *)(p))
 
 // Tagged integer -- our representation of Python 'int' objects.
 // Small enough integers are represented as unboxed integers (shifted
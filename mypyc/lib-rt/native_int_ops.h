@@ -0,0 +1,215 @@
+// Native fixed-width integer operations (int64_t and int32_t)
+//
+// These are unboxed alternatives to CPyTagged for values that are known to
+// fit in 64 (or 32) bits, such as counters and indices. Unlike tagged ints,
+// they never need tag checks or a boxed slow path, but arithmetic that
+// overflows raises OverflowError instead of producing a long int.
+//
+// Operations that can fail set an exception and return CPY_LL_INT_ERROR (or
+// CPY_INT_ERROR for 32-bit values). Since that is also a valid value, the
+// caller must check PyErr_Occurred() to tell the two apart.
+
+#ifndef CPY_NATIVE_INT_OPS_H
+#define CPY_NATIVE_INT_OPS_H
+
+#include "CPy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+} // why isn't emacs smart enough to not indent this
+#endif
+
+#define CPY_LL_INT_ERROR -113
+#define CPY_INT_ERROR -113
+
+
+// Conversions
+
+
+int64_t CPyLong_AsInt64(PyObject *o);
+int32_t CPyLong_AsInt32(PyObject *o);
+int64_t CPyTagged_AsInt64(CPyTagged x);
+int32_t CPyTagged_AsInt32(CPyTagged x);
+void CPyInt64_Overflow(void);
+void CPyInt32_Overflow(void);
+
+static inline PyObject *CPyInt64_AsObject(int64_t x) {
+    return PyLong_FromLongLong(x);
+}
+
+static inline PyObject *CPyInt32_AsObject(int32_t x) {
+    return PyLong_FromLong(x);
+}
+
+static inline CPyTagged CPyTagged_FromInt64(int64_t x) {
+    if (likely(x >= CPY_TAGGED_MIN && x <= CPY_TAGGED_MAX)) {
+        return CPyTagged_ShortFromSsize_t((Py_ssize_t)x);
+    }
+    PyObject *o = PyLong_FromLongLong(x);
+    if (unlikely(o == NULL)) {
+        CPyError_OutOfMemory();
+    }
+    return ((CPyTagged)o) | CPY_INT_TAG;
+}
+
+static inline CPyTagged CPyTagged_FromInt32(int32_t x) {
+    return CPyTagged_FromInt64(x);
+}
+
+
+// Checked arithmetic
+
+
+static inline int64_t CPyInt64_Add(int64_t x, int64_t y) {
+#ifdef CPY_HAVE_OVERFLOW_BUILTINS
+    int64_t result;
+    if (unlikely(__builtin_add_overflow(x, y, &result))) {
+        CPyInt64_Overflow();
+        return CPY_LL_INT_ERROR;
+    }
+    return result;
+#else
+    if (unlikely(y > 0 ? x > INT64_MAX - y : x < INT64_MIN - y)) {
+        CPyInt64_Overflow();
+        return CPY_LL_INT_ERROR;
+    }
+    return x + y;
+#endif
+}
+
+static inline int64_t CPyInt64_Subtract(int64_t x, int64_t y) {
+#ifdef CPY_HAVE_OVERFLOW_BUILTINS
+    int64_t result;
+    if (unlikely(__builtin_sub_overflow(x, y, &result))) {
+        CPyInt64_Overflow();
+        return CPY_LL_INT_ERROR;
+    }
+    return result;
+#else
+    if (unlikely(y > 0 ? x < INT64_MIN + y : x > INT64_MAX + y)) {
+        CPyInt64_Overflow();
+        return CPY_LL_INT_ERROR;
+    }
+    return x - y;
+#endif
+}
+
+static inline int64_t CPyInt64_Multiply(int64_t x, int64_t y) {
+#ifdef CPY_HAVE_OVERFLOW_BUILTINS
+    int64_t result;
+    if (unlikely(__builtin_mul_overflow(x, y, &result))) {
+        CPyInt64_Overflow();
+        return CPY_LL_INT_ERROR;
+    }
+    return result;
+#else
+    if (x != 0 && y != 0) {
+        bool overflow;
+        if (x > 0) {
+            overflow = y > 0 ? x > INT64_MAX / y : y < INT64_MIN / x;
+        } else {
+            overflow = y > 0 ? x < INT64_MIN / y : y < INT64_MAX / x;
+        }
+        if (unlikely(overflow)) {
+            CPyInt64_Overflow();
+            return CPY_LL_INT_ERROR;
+        }
+    }
+    return x * y;
+#endif
+}
+
+static inline int64_t CPyInt64_Negate(int64_t x) {
+    if (unlikely(x == INT64_MIN)) {
+        CPyInt64_Overflow();
+        return CPY_LL_INT_ERROR;
+    }
+    return -x;
+}
+
+// Floor division and modulus with Python semantics (round towards negative
+// infinity, remainder has the sign of the divisor). These raise
+// ZeroDivisionError or OverflowError as needed.
+int64_t CPyInt64_Divide(int64_t x, int64_t y);
+int64_t CPyInt64_Remainder(int64_t x, int64_t y);
+
+// 32-bit arithmetic is done in 64 bits, which can't overflow.
+
+static inline int32_t CPyInt32_Check(int64_t result) {
+    if (unlikely(result < INT32_MIN || result > INT32_MAX)) {
+        CPyInt32_Overflow();
+        return CPY_INT_ERROR;
+    }
+    return (int32_t)result;
+}
+
+static inline int32_t CPyInt32_Add(int32_t x, int32_t y) {
+    return CPyInt32_Check((int64_t)x + y);
+}
+
+static inline int32_t CPyInt32_Subtract(int32_t x, int32_t y) {
+    return CPyInt32_Check((int64_t)x - y);
+}
+
+static inline int32_t CPyInt32_Multiply(int32_t x, int32_t y) {
+    return CPyInt32_Check((int64_t)x * y);
+}
+
+static inline int32_t CPyInt32_Negate(int32_t x) {
+    return CPyInt32_Check(-(int64_t)x);
+}
+
+int32_t CPyInt32_Divide(int32_t x, int32_t y);
+int32_t CPyInt32_Remainder(int32_t x, int32_t y);
+
+
+// Comparisons
+
+
+// Native ints are compared with plain C comparisons. These compare a native
+// int with a tagged int without boxing. Return -1, 0 or 1 if x is less than,
+// equal to or greater than y, respectively.
+
+static inline int CPyInt64_CompareTagged(int64_t x, CPyTagged y) {
+    int64_t yval;
+    if (likely(CPyTagged_CheckShort(y))) {
+        yval = CPyTagged_ShortAsSsize_t(y);
+    } else {
+        int overflow;
+        yval = PyLong_AsLongLongAndOverflow(CPyTagged_LongAsObject(y), &overflow);
+        if (overflow != 0) {
+            // y is outside the int64 range
+            return -overflow;
+        }
+    }
+    return x < yval ? -1 : (x != yval);
+}
+
+static inline bool CPyInt64_IsEqTagged(int64_t x, CPyTagged y) {
+    if (likely(CPyTagged_CheckShort(y))) {
+        return x == (int64_t)CPyTagged_ShortAsSsize_t(y);
+    }
+    return CPyInt64_CompareTagged(x, y) == 0;
+}
+
+static inline bool CPyInt64_IsLtTagged(int64_t x, CPyTagged y) {
+    if (likely(CPyTagged_CheckShort(y))) {
+        return x < (int64_t)CPyTagged_ShortAsSsize_t(y);
+    }
+    return CPyInt64_CompareTagged(x, y) < 0;
+}
+
+
+// List operations with a native index
+
+
+PyObject *CPyList_GetItemInt64(PyObject *list, int64_t index);
+bool CPyList_SetItemInt64(PyObject *list, int64_t index, PyObject *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CPY_NATIVE_INT_OPS_H
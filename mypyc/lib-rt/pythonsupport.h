@@ -288,23 +288,6 @@ list_pop_impl(PyListObject *self, Py_ssize_t index)
     return v;
 }
 
-// Tweaked to directly use CPyTagged
-static CPyTagged
-list_count(PyListObject *self, PyObject *value)
-{
-    Py_ssize_t count = 0;
-    Py_ssize_t i;
-
-    for (i = 0; i < Py_SIZE(self); i++) {
-        int cmp = PyObject_RichCompareBool(self->ob_item[i], value, Py_EQ);
-        if (cmp > 0)
-            count++;
-        else if (cmp < 0)
-            return CPY_INT_TAG;
-    }
-    return CPyTagged_ShortFromSsize_t(count);
-}
-
 #if PY_MAJOR_VERSION >= 3 && PY_MINOR_VERSION < 8
 static PyObject *
 _PyDict_GetItemStringWithError(PyObject *v, const char *key)
@@ -385,6 +368,30 @@ _CPyDictView_New(PyObject *dict, PyTypeObject *type)
     return (PyObject *)dv;
 }
 
+// Look up an attribute without raising AttributeError if it's missing.
+// Return 1 and store a new reference in *result if the attribute was found,
+// and 0 (with *result set to NULL) if not. Return -1 on other errors.
+//
+// _PyObject_LookupAttr avoids creating an exception object for objects that
+// use generic attribute lookup, which includes types and modules.
+#if PY_MAJOR_VERSION >= 3 && PY_MINOR_VERSION >= 7
+#define CPyObject_LookupAttr _PyObject_LookupAttr
+#else
+static int
+CPyObject_LookupAttr(PyObject *v, PyObject *name, PyObject **result)
+{
+    *result = PyObject_GetAttr(v, name);
+    if (*result != NULL) {
+        return 1;
+    }
+    if (!PyErr_ExceptionMatches(PyExc_AttributeError)) {
+        return -1;
+    }
+    PyErr_Clear();
+    return 0;
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,3 +15,155 @@ bool CPySet_Remove(PyObject *set, PyObject *key) {
     }
     return false;
 }
+
+PyObject *CPySet_GetIter(PyObject *set) {
+    if (PyAnySet_CheckExact(set)) {
+        // Return the set itself to indicate we can use the fast path instead.
+        Py_INCREF(set);
+        return set;
+    }
+    return PyObject_GetIter(set);
+}
+
+// Helper for fast set iteration, similar to CPyDict_NextKey. Exact sets use
+// _PySet_NextEntry, and other objects use the iterator protocol.
+tuple_T3CIO CPySet_Next(PyObject *set_or_iter, CPyTagged offset) {
+    tuple_T3CIO ret;
+    if (PyAnySet_CheckExact(set_or_iter)) {
+        Py_ssize_t py_offset = CPyTagged_AsSsize_t(offset);
+        Py_hash_t hash;
+        ret.f0 = _PySet_NextEntry(set_or_iter, &py_offset, &ret.f2, &hash);
+        if (ret.f0) {
+            ret.f1 = CPyTagged_FromSsize_t(py_offset);
+        } else {
+            // Set key to None, so mypyc can manage refcounts.
+            ret.f1 = 0;
+            ret.f2 = Py_None;
+        }
+        // _PySet_NextEntry() returns a borrowed reference.
+        Py_INCREF(ret.f2);
+    } else {
+        // offset is dummy in this case, just use the old value.
+        ret.f1 = offset;
+        ret.f2 = PyIter_Next(set_or_iter);
+        if (ret.f2 == NULL) {
+            ret.f0 = 0;
+            Py_INCREF(Py_None);
+            ret.f2 = Py_None;
+        } else {
+            ret.f0 = 1;
+        }
+    }
+    return ret;
+}
+
+char CPySet_CheckSize(PyObject *set, CPyTagged size) {
+    if (!PyAnySet_CheckExact(set)) {
+        // Set subclasses will be checked by Python runtime.
+        return 1;
+    }
+    if (CPyTagged_AsSsize_t(size) != PySet_GET_SIZE(set)) {
+        PyErr_SetString(PyExc_RuntimeError, "Set changed size during iteration");
+        return 0;
+    }
+    return 1;
+}
+
+// set | other, where other is a set or a frozenset. Like set.__or__, this
+// always produces an instance of set (not a subclass).
+PyObject *CPySet_Union(PyObject *set, PyObject *other) {
+    PyObject *result = PySet_New(set);
+    if (result == NULL) {
+        return NULL;
+    }
+    if (_PySet_Update(result, other) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// set |= other. Sets, frozensets and dicts are merged directly into the
+// table, without creating an iterator.
+PyObject *CPySet_InPlaceUnion(PyObject *set, PyObject *other) {
+    if (_PySet_Update(set, other) < 0) {
+        return NULL;
+    }
+    Py_INCREF(set);
+    return set;
+}
+
+// The hash of a short int, as computed by long_hash() in Objects/longobject.c.
+static inline Py_hash_t CPySet_ShortIntHash(Py_ssize_t n) {
+    Py_hash_t hash;
+    if (n >= 0) {
+        hash = (Py_hash_t)((size_t)n % _PyHASH_MODULUS);
+    } else {
+        hash = -(Py_hash_t)((size_t)-n % _PyHASH_MODULUS);
+    }
+    return hash == -1 ? -2 : hash;
+}
+
+#if PY_VERSION_HEX >= 0x03070000 && PY_VERSION_HEX < 0x030D0000
+#define CPY_SET_LOOKUP_INT 1
+
+// These must match Objects/setobject.c.
+#define CPY_SET_LINEAR_PROBES 9
+#define CPY_SET_PERTURB_SHIFT 5
+
+// Look up a short int in a set table without boxing it, using the same
+// probe sequence as set_lookkey() in Objects/setobject.c. Return 1 if found,
+// 0 if not found, and -1 if an entry with the same hash isn't an exact int,
+// since comparing it could run arbitrary code (the caller must fall back
+// to the generic lookup).
+static int CPySet_LookupShortInt(PySetObject *so, Py_ssize_t value) {
+    Py_hash_t hash = CPySet_ShortIntHash(value);
+    size_t perturb = (size_t)hash;
+    size_t mask = (size_t)so->mask;
+    size_t i = (size_t)hash & mask;
+    while (1) {
+        setentry *entry = &so->table[i];
+        size_t probes = i + CPY_SET_LINEAR_PROBES <= mask ? CPY_SET_LINEAR_PROBES : 0;
+        size_t j;
+        for (j = 0; j <= probes; j++, entry++) {
+            if (entry->key == NULL) {
+                return 0;
+            }
+            if (entry->hash == hash) {
+                PyObject *key = entry->key;
+                if (!PyLong_CheckExact(key)) {
+                    return -1;
+                }
+                int overflow;
+                long long n = PyLong_AsLongLongAndOverflow(key, &overflow);
+                if (!overflow && n == value) {
+                    return 1;
+                }
+            }
+        }
+        perturb >>= CPY_SET_PERTURB_SHIFT;
+        i = (i * 5 + 1 + perturb) & mask;
+    }
+}
+#endif
+
+// int in set. For short ints we probe the set directly using the tagged value
+// to calculate the hash, so the int doesn't need to be boxed. This also
+// accepts frozensets. Return 1 if found, 0 if not found, and -1 on error.
+int CPySet_ContainsInt(PyObject *set, CPyTagged key) {
+#ifdef CPY_SET_LOOKUP_INT
+    if (likely(CPyTagged_CheckShort(key))) {
+        int res = CPySet_LookupShortInt((PySetObject *)set, CPyTagged_ShortAsSsize_t(key));
+        if (likely(res >= 0)) {
+            return res;
+        }
+    }
+#endif
+    PyObject *key_obj = CPyTagged_AsObject(key);
+    if (key_obj == NULL) {
+        return -1;
+    }
+    int res = PySet_Contains(set, key_obj);
+    Py_DECREF(key_obj);
+    return res;
+}
@@ -1,6 +1,8 @@
-"""Build script for mypyc C runtime library unit tests.
+"""Build script for mypyc C runtime library unit tests and microbenchmarks.
 
-The tests are written in C++ and use the Google Test framework.
+The tests are written in C++ and use the Google Test framework. The
+benchmarks (bench_capi.cc) don't depend on it, and they are built without
+the optional runtime features to measure the default configuration.
 """
 
 from distutils.core import setup, Extension
@@ -13,15 +15,34 @@ else:
     kwargs = {}  # type: ignore
     compile_args = ['--std=c++11']
 
+runtime_sources = ['init.c', 'int_ops.c', 'float_ops.c', 'list_ops.c', 'exc_ops.c',
+                   'generic_ops.c', 'dict_ops.c', 'str_ops.c', 'bytes_ops.c', 'set_ops.c',
+                   'tuple_ops.c', 'misc_ops.c', 'getargs.c', 'getargsfast.c']
+runtime_depends = ['CPy.h', 'mypyc_util.h', 'pythonsupport.h', 'native_int_ops.h']
+
 setup(name='test_capi',
       version='0.1',
-      ext_modules=[Extension(
-          'test_capi',
-          ['test_capi.cc', 'init.c', 'int_ops.c', 'list_ops.c', 'exc_ops.c', 'generic_ops.c'],
-          depends=['CPy.h', 'mypyc_util.h', 'pythonsupport.h'],
-          extra_compile_args=['-Wno-unused-function', '-Wno-sign-compare'] + compile_args,
-          library_dirs=['../external/googletest/make'],
-          libraries=['gtest'],
-          include_dirs=['../external/googletest', '../external/googletest/include'],
-          **kwargs
-      )])
+      ext_modules=[
+          Extension(
+              'test_capi',
+              ['test_capi.cc'] + runtime_sources,
+              depends=runtime_depends,
+              extra_compile_args=['-Wno-unused-function', '-Wno-sign-compare'] + compile_args,
+              library_dirs=['../external/googletest/make'],
+              libraries=['gtest'],
+              include_dirs=['../external/googletest', '../external/googletest/include'],
+              # Test the optional runtime features as well
+              define_macros=[('MYPYC_INT_CACHE', None), ('MYPYC_PROFILE_IMPORT', None),
+                             ('MYPYC_IMMORTAL_STATICS', None), ('MYPYC_STATS', None),
+                             ('MYPYC_PROFILE_ATTRS', None)],
+              **kwargs
+          ),
+          Extension(
+              'bench_capi',
+              ['bench_capi.cc'] + runtime_sources,
+              depends=runtime_depends,
+              extra_compile_args=['-O3', '-Wno-unused-function', '-Wno-sign-compare'] +
+                                 compile_args,
+              **kwargs
+          ),
+      ])
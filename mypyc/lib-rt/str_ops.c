@@ -5,6 +5,36 @@
 #include <Python.h>
 #include "CPy.h"
 
+// Shared one-character strings for code points 0-255. These are created on
+// first use and never freed, so indexing and iterating over mostly Latin-1
+// strings doesn't allocate.
+static PyObject *CPyStr_CharTable[256];
+
+PyObject *CPyStr_FromChar(Py_UCS4 ch) {
+    if (ch < 256) {
+        PyObject *unicode = CPyStr_CharTable[ch];
+        if (unlikely(unicode == NULL)) {
+            unicode = PyUnicode_New(1, ch);
+            if (unicode == NULL)
+                return NULL;
+            PyUnicode_1BYTE_DATA(unicode)[0] = (Py_UCS1)ch;
+            CPyStr_CharTable[ch] = unicode;
+        }
+        Py_INCREF(unicode);
+        return unicode;
+    }
+    PyObject *unicode = PyUnicode_New(1, ch);
+    if (unicode == NULL)
+        return NULL;
+    if (PyUnicode_KIND(unicode) == PyUnicode_2BYTE_KIND) {
+        PyUnicode_2BYTE_DATA(unicode)[0] = (Py_UCS2)ch;
+    } else {
+        assert(PyUnicode_KIND(unicode) == PyUnicode_4BYTE_KIND);
+        PyUnicode_4BYTE_DATA(unicode)[0] = ch;
+    }
+    return unicode;
+}
+
 PyObject *CPyStr_GetItem(PyObject *str, CPyTagged index) {
     if (PyUnicode_READY(str) != -1) {
         if (CPyTagged_CheckShort(index)) {
@@ -18,21 +48,7 @@ PyObject *CPyStr_GetItem(PyObject *str, CPyTagged index) {
                 n += size;
             enum PyUnicode_Kind kind = (enum PyUnicode_Kind)PyUnicode_KIND(str);
             void *data = PyUnicode_DATA(str);
-            Py_UCS4 ch = PyUnicode_READ(kind, data, n);
-            PyObject *unicode = PyUnicode_New(1, ch);
-            if (unicode == NULL)
-                return NULL;
-
-            if (PyUnicode_KIND(unicode) == PyUnicode_1BYTE_KIND) {
-                PyUnicode_1BYTE_DATA(unicode)[0] = (Py_UCS1)ch;
-            }
-            else if (PyUnicode_KIND(unicode) == PyUnicode_2BYTE_KIND) {
-                PyUnicode_2BYTE_DATA(unicode)[0] = (Py_UCS2)ch;
-            } else {
-                assert(PyUnicode_KIND(unicode) == PyUnicode_4BYTE_KIND);
-                PyUnicode_4BYTE_DATA(unicode)[0] = ch;
-            }
-            return unicode;
+            return CPyStr_FromChar(PyUnicode_READ(kind, data, n));
         } else {
             PyErr_SetString(PyExc_OverflowError, CPYTHON_LARGE_INT_ERRMSG);
             return NULL;
@@ -43,6 +59,33 @@ PyObject *CPyStr_GetItem(PyObject *str, CPyTagged index) {
     }
 }
 
+// Index a ready str with an in-range short int index (used by for loops).
+PyObject *CPyStr_GetItemUnsafe(PyObject *str, CPyTagged index) {
+    Py_ssize_t n = CPyTagged_ShortAsSsize_t(index);
+    return CPyStr_FromChar(PyUnicode_READ_CHAR(str, n));
+}
+
+// Compare str[index] with a single character without creating a str object.
+// Return 1 if equal, 0 if not, and -1 on error (such as an index out of range).
+int CPyStr_IndexEqualsChar(PyObject *str, CPyTagged index, int32_t ch) {
+    if (unlikely(PyUnicode_READY(str) == -1)) {
+        return -1;
+    }
+    if (unlikely(!CPyTagged_CheckShort(index))) {
+        PyErr_SetString(PyExc_OverflowError, CPYTHON_LARGE_INT_ERRMSG);
+        return -1;
+    }
+    Py_ssize_t n = CPyTagged_ShortAsSsize_t(index);
+    Py_ssize_t size = PyUnicode_GET_LENGTH(str);
+    if (n < 0)
+        n += size;
+    if (n < 0 || n >= size) {
+        PyErr_SetString(PyExc_IndexError, "string index out of range");
+        return -1;
+    }
+    return PyUnicode_READ_CHAR(str, n) == (Py_UCS4)ch;
+}
+
 PyObject *CPyStr_Split(PyObject *str, PyObject *sep, CPyTagged max_split)
 {
     Py_ssize_t temp_max_split = CPyTagged_AsSsize_t(max_split);
@@ -50,7 +93,7 @@ PyObject *CPyStr_Split(PyObject *str, PyObject *sep, CPyTagged max_split)
         PyErr_SetString(PyExc_OverflowError, CPYTHON_LARGE_INT_ERRMSG);
             return NULL;
     }
-    return PyUnicode_Split(str, sep, temp_max_split);
+    return CPyStr_SplitMax(str, sep, temp_max_split);
 }
 
 PyObject *CPyStr_Replace(PyObject *str, PyObject *old_substr, PyObject *new_substr, CPyTagged max_replace)
@@ -60,16 +103,32 @@ PyObject *CPyStr_Replace(PyObject *str, PyObject *old_substr, PyObject *new_subs
         PyErr_SetString(PyExc_OverflowError, CPYTHON_LARGE_INT_ERRMSG);
             return NULL;
     }
-    return PyUnicode_Replace(str, old_substr, new_substr, temp_max_replace);
+    return CPyStr_ReplaceMax(str, old_substr, new_substr, temp_max_replace);
 }
 
 bool CPyStr_Startswith(PyObject *self, PyObject *subobj) {
+    if (likely(PyUnicode_IS_READY(self) && PyUnicode_IS_READY(subobj)
+               && PyUnicode_KIND(self) == PyUnicode_KIND(subobj))) {
+        Py_ssize_t n = PyUnicode_GET_LENGTH(subobj);
+        return n <= PyUnicode_GET_LENGTH(self)
+            && memcmp(PyUnicode_DATA(self), PyUnicode_DATA(subobj),
+                      n * PyUnicode_KIND(self)) == 0;
+    }
     Py_ssize_t start = 0;
     Py_ssize_t end = PyUnicode_GET_LENGTH(self);
     return PyUnicode_Tailmatch(self, subobj, start, end, -1);
 }
 
 bool CPyStr_Endswith(PyObject *self, PyObject *subobj) {
+    if (likely(PyUnicode_IS_READY(self) && PyUnicode_IS_READY(subobj)
+               && PyUnicode_KIND(self) == PyUnicode_KIND(subobj))) {
+        Py_ssize_t n = PyUnicode_GET_LENGTH(subobj);
+        Py_ssize_t offset = PyUnicode_GET_LENGTH(self) - n;
+        int kind = PyUnicode_KIND(self);
+        return offset >= 0
+            && memcmp((char *)PyUnicode_DATA(self) + offset * kind, PyUnicode_DATA(subobj),
+                      n * kind) == 0;
+    }
     Py_ssize_t start = 0;
     Py_ssize_t end = PyUnicode_GET_LENGTH(self);
     return PyUnicode_Tailmatch(self, subobj, start, end, 1);
@@ -102,8 +161,376 @@ PyObject *CPyStr_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end) {
     }
     return CPyObject_GetSlice(obj, start, end);
 }
+
+PyObject *CPyStr_GetSliceStep(PyObject *obj, CPyTagged start, CPyTagged end, CPyTagged step) {
+    if (likely(PyUnicode_CheckExact(obj) && CPyTagged_CheckShort(step) && step != 0)) {
+        if (unlikely(PyUnicode_READY(obj) == -1)) {
+            return NULL;
+        }
+        Py_ssize_t stepn = CPyTagged_ShortAsSsize_t(step);
+        Py_ssize_t length = PyUnicode_GET_LENGTH(obj);
+        Py_ssize_t startn = CPySlice_AdjustIndex(start, length, stepn);
+        Py_ssize_t endn = CPySlice_AdjustIndex(end, length, stepn);
+        if (stepn == 1) {
+            return PyUnicode_Substring(obj, startn, endn < startn ? startn : endn);
+        }
+        Py_ssize_t n = CPySlice_Length(startn, endn, stepn);
+        enum PyUnicode_Kind kind = (enum PyUnicode_Kind)PyUnicode_KIND(obj);
+        void *data = PyUnicode_DATA(obj);
+        // Find the widest character first, since the result must use the
+        // narrowest kind that can hold all of its characters.
+        Py_UCS4 max_char = 0;
+        Py_ssize_t i;
+        for (i = 0; i < n; i++) {
+            Py_UCS4 ch = PyUnicode_READ(kind, data, startn + i * stepn);
+            if (ch > max_char) {
+                max_char = ch;
+            }
+        }
+        PyObject *result = PyUnicode_New(n, max_char);
+        if (unlikely(result == NULL)) {
+            return NULL;
+        }
+        enum PyUnicode_Kind result_kind = (enum PyUnicode_Kind)PyUnicode_KIND(result);
+        void *result_data = PyUnicode_DATA(result);
+        for (i = 0; i < n; i++) {
+            PyUnicode_WRITE(result_kind, result_data, i,
+                            PyUnicode_READ(kind, data, startn + i * stepn));
+        }
+        return result;
+    }
+    return CPyObject_GetSliceStep(obj, start, end, step);
+}
 /* Check if the given string is true (i.e. it's length isn't zero) */
 bool CPyStr_IsTrue(PyObject *obj) {
     Py_ssize_t length = PyUnicode_GET_LENGTH(obj);
     return length != 0;
 }
+
+// Concatenate n pieces into a new str, such as the parts of an f-string.
+//
+// Pieces are strs, except that if bit i of int_mask is set, piece i is a
+// tagged int that is formatted in decimal. The length and kind of the result
+// are computed first, so the result is allocated only once (unless there are
+// long ints, since formatting them is expensive).
+PyObject *CPyStr_Build(Py_ssize_t n, uint32_t int_mask, ...) {
+    assert(n <= CPY_STR_BUILD_MAX_PIECES);
+    char digits[CPY_STR_BUILD_MAX_PIECES][CPY_MAX_INT_CHARS];
+    int digit_lengths[CPY_STR_BUILD_MAX_PIECES];
+    Py_ssize_t length = 0;
+    Py_UCS4 max_char = 127;
+    Py_ssize_t i;
+    va_list args;
+
+    va_start(args, int_mask);
+    for (i = 0; i < n; i++) {
+        if (int_mask & (1U << i)) {
+            CPyTagged value = va_arg(args, CPyTagged);
+            if (CPyTagged_CheckShort(value)) {
+                digit_lengths[i] = CPy_FormatSsize_t(digits[i], CPyTagged_ShortAsSsize_t(value));
+                length += digit_lengths[i];
+            }
+        } else {
+            PyObject *str = va_arg(args, PyObject *);
+            if (unlikely(PyUnicode_READY(str) == -1)) {
+                va_end(args);
+                return NULL;
+            }
+            Py_UCS4 str_max_char = PyUnicode_MAX_CHAR_VALUE(str);
+            if (str_max_char > max_char) {
+                max_char = str_max_char;
+            }
+            if (unlikely(PyUnicode_GET_LENGTH(str) > PY_SSIZE_T_MAX - length)) {
+                va_end(args);
+                PyErr_NoMemory();
+                return NULL;
+            }
+            length += PyUnicode_GET_LENGTH(str);
+        }
+    }
+    va_end(args);
+
+    _PyUnicodeWriter writer;
+    _PyUnicodeWriter_Init(&writer);
+    if (unlikely(_PyUnicodeWriter_Prepare(&writer, length, max_char) < 0)) {
+        return NULL;
+    }
+    va_start(args, int_mask);
+    for (i = 0; i < n; i++) {
+        int res;
+        if (int_mask & (1U << i)) {
+            CPyTagged value = va_arg(args, CPyTagged);
+            if (CPyTagged_CheckShort(value)) {
+                res = _PyUnicodeWriter_WriteASCIIString(&writer, digits[i], digit_lengths[i]);
+            } else {
+                res = _PyLong_FormatWriter(&writer, CPyTagged_LongAsObject(value), 10, 0);
+            }
+        } else {
+            res = _PyUnicodeWriter_WriteStr(&writer, va_arg(args, PyObject *));
+        }
+        if (unlikely(res < 0)) {
+            va_end(args);
+            _PyUnicodeWriter_Dealloc(&writer);
+            return NULL;
+        }
+    }
+    va_end(args);
+    return _PyUnicodeWriter_Finish(&writer);
+}
+
+// ASCII and Latin-1 fast paths
+//
+// Most strs in practice are ASCII, so we special case 1-byte kind strs in
+// searching/splitting operations. These scan the raw data with memchr, which
+// is vectorized by the C library on common platforms. Strs of wider
+// kinds and long search strings use the generic CPython implementations.
+
+// Use the fast paths only for search strings up to this length, since the
+// search below is quadratic in the worst case (CPython uses a smarter
+// algorithm that is better for long search strings).
+#define CPY_STR_MAX_FAST_SEARCH 8
+
+// Are both strs using the 1-byte kind, with a short non-empty sub?
+static inline bool CPyStr_CanSearchFast(PyObject *str, PyObject *sub) {
+    Py_ssize_t m = PyUnicode_GET_LENGTH(sub);
+    return PyUnicode_KIND(str) == PyUnicode_1BYTE_KIND
+        && PyUnicode_KIND(sub) == PyUnicode_1BYTE_KIND
+        && m > 0 && m <= CPY_STR_MAX_FAST_SEARCH;
+}
+
+// Return the offset of the first occurrence of sub[:m] in s[:n] or -1.
+static inline Py_ssize_t CPyStr_FindBytes(const char *s, Py_ssize_t n,
+                                          const char *sub, Py_ssize_t m) {
+    if (m == 1) {
+        const char *p = (const char *)memchr(s, sub[0], n);
+        return p != NULL ? p - s : -1;
+    }
+    if (n < m) {
+        return -1;
+    }
+    const char *p = s;
+    const char *end = s + n - m + 1;
+    while (p < end) {
+        p = (const char *)memchr(p, sub[0], end - p);
+        if (p == NULL) {
+            return -1;
+        }
+        if (memcmp(p + 1, sub + 1, m - 1) == 0) {
+            return p - s;
+        }
+        p++;
+    }
+    return -1;
+}
+
+// Return the number of non-overlapping occurrences of sub[:m] in s[:n], but
+// at most max_count (if non-negative).
+static Py_ssize_t CPyStr_CountBytes(const char *s, Py_ssize_t n,
+                                    const char *sub, Py_ssize_t m, Py_ssize_t max_count) {
+    Py_ssize_t count = 0;
+    Py_ssize_t i = 0;
+    while (max_count < 0 || count < max_count) {
+        Py_ssize_t pos = CPyStr_FindBytes(s + i, n - i, sub, m);
+        if (pos < 0) {
+            break;
+        }
+        count++;
+        i += pos + m;
+    }
+    return count;
+}
+
+// Return str[start:end] for a 1-byte kind str.
+static PyObject *CPyStr_Substring1Byte(PyObject *str, Py_ssize_t start, Py_ssize_t end) {
+    Py_ssize_t len = end - start;
+    const Py_UCS1 *data = PyUnicode_1BYTE_DATA(str) + start;
+    if (len == 1) {
+        return CPyStr_FromChar(data[0]);
+    }
+    if (!PyUnicode_IS_ASCII(str)) {
+        // The substring may need a narrower representation
+        return PyUnicode_FromKindAndData(PyUnicode_1BYTE_KIND, data, len);
+    }
+    PyObject *result = PyUnicode_New(len, 127);
+    if (result != NULL && len > 0) {
+        memcpy(PyUnicode_1BYTE_DATA(result), data, len);
+    }
+    return result;
+}
+
+static PyObject *CPyStr_SplitWhitespaceASCII(PyObject *str, Py_ssize_t max_split) {
+    const Py_UCS1 *s = PyUnicode_1BYTE_DATA(str);
+    Py_ssize_t n = PyUnicode_GET_LENGTH(str);
+    Py_ssize_t pass, count = 0;
+    PyObject *list = NULL;
+    // Count the items first, then create them
+    for (pass = 0; pass < 2; pass++) {
+        Py_ssize_t i = 0;
+        Py_ssize_t k = 0;
+        for (;;) {
+            while (i < n && Py_UNICODE_ISSPACE(s[i])) {
+                i++;
+            }
+            if (i == n) {
+                break;
+            }
+            Py_ssize_t j = n;
+            if (max_split < 0 || k < max_split) {
+                j = i + 1;
+                while (j < n && !Py_UNICODE_ISSPACE(s[j])) {
+                    j++;
+                }
+            }
+            if (list != NULL) {
+                PyObject *item = CPyStr_Substring1Byte(str, i, j);
+                if (item == NULL) {
+                    Py_DECREF(list);
+                    return NULL;
+                }
+                PyList_SET_ITEM(list, k, item);
+            }
+            k++;
+            i = j;
+        }
+        if (list == NULL) {
+            count = k;
+            list = PyList_New(count);
+            if (list == NULL) {
+                return NULL;
+            }
+        }
+    }
+    return list;
+}
+
+static PyObject *CPyStr_SplitBytes(PyObject *str, PyObject *sep, Py_ssize_t max_split) {
+    const char *s = (const char *)PyUnicode_1BYTE_DATA(str);
+    Py_ssize_t n = PyUnicode_GET_LENGTH(str);
+    const char *sub = (const char *)PyUnicode_1BYTE_DATA(sep);
+    Py_ssize_t m = PyUnicode_GET_LENGTH(sep);
+    Py_ssize_t count = CPyStr_CountBytes(s, n, sub, m, max_split);
+    PyObject *list = PyList_New(count + 1);
+    if (list == NULL) {
+        return NULL;
+    }
+    Py_ssize_t i = 0;
+    Py_ssize_t k;
+    for (k = 0; k <= count; k++) {
+        Py_ssize_t end = n;
+        if (k < count) {
+            end = i + CPyStr_FindBytes(s + i, n - i, sub, m);
+        }
+        PyObject *item = CPyStr_Substring1Byte(str, i, end);
+        if (item == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, k, item);
+        i = end + m;
+    }
+    return list;
+}
+
+// Like PyUnicode_Split, but faster for 1-byte kind strs. The separator may
+// be NULL to split at whitespace.
+PyObject *CPyStr_SplitMax(PyObject *str, PyObject *sep, Py_ssize_t max_split) {
+    if (likely(PyUnicode_CheckExact(str) && PyUnicode_IS_READY(str))) {
+        if (sep == NULL) {
+            if (PyUnicode_IS_ASCII(str)) {
+                return CPyStr_SplitWhitespaceASCII(str, max_split);
+            }
+        } else if (PyUnicode_IS_READY(sep) && CPyStr_CanSearchFast(str, sep)) {
+            return CPyStr_SplitBytes(str, sep, max_split);
+        }
+    }
+    return PyUnicode_Split(str, sep, max_split);
+}
+
+// Like PyUnicode_Replace, but faster for ASCII strs.
+PyObject *CPyStr_ReplaceMax(PyObject *str, PyObject *old_substr, PyObject *new_substr,
+                           Py_ssize_t max_replace) {
+    if (likely(PyUnicode_CheckExact(str) && PyUnicode_IS_READY(str)
+               && PyUnicode_IS_READY(old_substr) && PyUnicode_IS_READY(new_substr)
+               && PyUnicode_IS_ASCII(str) && PyUnicode_IS_ASCII(new_substr)
+               && CPyStr_CanSearchFast(str, old_substr))) {
+        const char *s = (const char *)PyUnicode_1BYTE_DATA(str);
+        Py_ssize_t n = PyUnicode_GET_LENGTH(str);
+        const char *old = (const char *)PyUnicode_1BYTE_DATA(old_substr);
+        Py_ssize_t m = PyUnicode_GET_LENGTH(old_substr);
+        const char *new_data = (const char *)PyUnicode_1BYTE_DATA(new_substr);
+        Py_ssize_t new_len = PyUnicode_GET_LENGTH(new_substr);
+        Py_ssize_t count = CPyStr_CountBytes(s, n, old, m, max_replace);
+        if (count == 0) {
+            Py_INCREF(str);
+            return str;
+        }
+        if (new_len > m && count > (PY_SSIZE_T_MAX - n) / (new_len - m)) {
+            PyErr_SetString(PyExc_OverflowError, "replace string is too long");
+            return NULL;
+        }
+        PyObject *result = PyUnicode_New(n + count * (new_len - m), 127);
+        if (result == NULL) {
+            return NULL;
+        }
+        char *out = (char *)PyUnicode_1BYTE_DATA(result);
+        Py_ssize_t i = 0;
+        Py_ssize_t k;
+        for (k = 0; k < count; k++) {
+            Py_ssize_t pos = CPyStr_FindBytes(s + i, n - i, old, m);
+            memcpy(out, s + i, pos);
+            out += pos;
+            memcpy(out, new_data, new_len);
+            out += new_len;
+            i += pos + m;
+        }
+        memcpy(out, s + i, n - i);
+        return result;
+    }
+    return PyUnicode_Replace(str, old_substr, new_substr, max_replace);
+}
+
+// Return the index of the first occurrence of sub in str, or -1.
+CPyTagged CPyStr_Find(PyObject *str, PyObject *sub) {
+    if (likely(PyUnicode_IS_READY(str) && PyUnicode_IS_READY(sub)
+               && CPyStr_CanSearchFast(str, sub))) {
+        Py_ssize_t pos = CPyStr_FindBytes((const char *)PyUnicode_1BYTE_DATA(str),
+                                          PyUnicode_GET_LENGTH(str),
+                                          (const char *)PyUnicode_1BYTE_DATA(sub),
+                                          PyUnicode_GET_LENGTH(sub));
+        return CPyTagged_ShortFromSsize_t(pos);
+    }
+    Py_ssize_t pos = PyUnicode_Find(str, sub, 0, PY_SSIZE_T_MAX, 1);
+    if (pos == -2) {
+        return CPY_INT_TAG;
+    }
+    return CPyTagged_FromSsize_t(pos);
+}
+
+// Implement "sub in str". Return 1 if true, 0 if false and -1 on error.
+int CPyStr_Contains(PyObject *str, PyObject *sub) {
+    if (likely(PyUnicode_IS_READY(str) && PyUnicode_IS_READY(sub)
+               && CPyStr_CanSearchFast(str, sub))) {
+        return CPyStr_FindBytes((const char *)PyUnicode_1BYTE_DATA(str),
+                                PyUnicode_GET_LENGTH(str),
+                                (const char *)PyUnicode_1BYTE_DATA(sub),
+                                PyUnicode_GET_LENGTH(sub)) >= 0;
+    }
+    return PyUnicode_Contains(str, sub);
+}
+
+// Return the number of non-overlapping occurrences of sub in str.
+CPyTagged CPyStr_Count(PyObject *str, PyObject *sub) {
+    if (likely(PyUnicode_IS_READY(str) && PyUnicode_IS_READY(sub)
+               && CPyStr_CanSearchFast(str, sub))) {
+        Py_ssize_t count = CPyStr_CountBytes((const char *)PyUnicode_1BYTE_DATA(str),
+                                             PyUnicode_GET_LENGTH(str),
+                                             (const char *)PyUnicode_1BYTE_DATA(sub),
+                                             PyUnicode_GET_LENGTH(sub), -1);
+        return CPyTagged_ShortFromSsize_t(count);
+    }
+    Py_ssize_t count = PyUnicode_Count(str, sub, 0, PY_SSIZE_T_MAX);
+    if (count == -1) {
+        return CPY_INT_TAG;
+    }
+    return CPyTagged_FromSsize_t(count);
+}
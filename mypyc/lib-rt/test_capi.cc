@@ -198,6 +198,47 @@ TEST_F(CAPITest, test_long_int_to_obj) {
         EXPECT_TRUE(is_int_equal(x, y));  \
     } while (false)
 
+TEST_F(CAPITest, test_boxed_int_cache) {
+    CPyIntCacheStats stats;
+    CPyTagged_ClearBoxCache();
+    CPyTagged_GetBoxCacheStats(&stats);
+    EXPECT_EQ(stats.hits, 0u);
+    EXPECT_EQ(stats.misses, 0u);
+
+    CPyTagged x = CPyTagged_ShortFromInt(12345);
+    PyObject *a = CPyTagged_AsObject(x);
+    PyObject *b = CPyTagged_StealAsObject(x);
+    EXPECT_TRUE(is_py_equal(a, int_from_str("12345")));
+    CPyTagged_GetBoxCacheStats(&stats);
+#ifdef MYPYC_INT_CACHE
+    EXPECT_EQ(a, b);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+#endif
+    Py_DECREF(a);
+    Py_DECREF(b);
+
+    // CPython caches small ints by itself, so they aren't counted
+    a = CPyTagged_AsObject(CPyTagged_ShortFromInt(5));
+    EXPECT_TRUE(is_py_equal(a, int_from_str("5")));
+    Py_DECREF(a);
+
+    // Values that map to the same slot replace each other
+    for (int i = 0; i < 3; i++) {
+        Py_ssize_t value = -100000 - i * ((Py_ssize_t)1 << 20);
+        a = CPyTagged_AsObject(CPyTagged_ShortFromSsize_t(value));
+        EXPECT_TRUE(is_py_equal(a, PyLong_FromSsize_t(value)));
+        Py_DECREF(a);
+    }
+    CPyTagged_GetBoxCacheStats(&stats);
+#ifdef MYPYC_INT_CACHE
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 4u);
+    EXPECT_EQ(stats.evictions, 2u);
+#endif
+    CPyTagged_ClearBoxCache();
+}
+
 #define ASSERT_ADD(x, y, result) \
     EXPECT_TRUE(is_int_equal(CPyTagged_Add(eval_int(x), eval_int(y)), eval_int(result)))
 
@@ -234,6 +275,20 @@ TEST_F(CAPITest, test_add_short_edge_cases) {
     ASSERT_ADD("2**62 - 1", "-2**62", "-1");
 }
 
+TEST_F(CAPITest, test_add_long_and_short_mixed_signs) {
+    ASSERT_ADD("-1", "2**65", "2**65 - 1");
+    ASSERT_ADD("2**65", "-2**62", "2**65 - 2**62");
+    ASSERT_ADD("-2**65", "2**62 - 1", "-2**65 + 2**62 - 1");
+    ASSERT_ADD("-2**65", "-5", "-2**65 - 5");
+    // Result fits in a short int again
+    ASSERT_ADD("2**62", "-1", "2**62 - 1");
+    ASSERT_ADD("-2**62 - 1", "1", "-2**62");
+    ASSERT_ADD("2**65", "-2**65", "0");
+    ASSERT_ADD("2**64 + 1", "-2**64", "1");
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_Add(eval_int("2**62"), eval_int("-1"))));
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_Add(eval_int("2**70"), eval_int("-2**70"))));
+}
+
 #define ASSERT_SUBTRACT(x, y, result) \
     EXPECT_TRUE(is_int_equal(CPyTagged_Subtract(eval_int(x), eval_int(y)), eval_int(result)))
 
@@ -272,6 +327,39 @@ TEST_F(CAPITest, test_subtract_short_edge_cases) {
     ASSERT_SUBTRACT("-2**62", "2**62 - 1", "-2**63 + 1");
 }
 
+TEST_F(CAPITest, test_subtract_long_and_short_mixed_signs) {
+    ASSERT_SUBTRACT("-1", "2**65", "-1 - 2**65");
+    ASSERT_SUBTRACT("-2**65", "-1", "-2**65 + 1");
+    ASSERT_SUBTRACT("2**65", "2**62 - 1", "2**65 - 2**62 + 1");
+    ASSERT_SUBTRACT("2**62", "1", "2**62 - 1");
+    ASSERT_SUBTRACT("2**65", "2**65", "0");
+    ASSERT_SUBTRACT("2**64", "2**64 + 1", "-1");
+    ASSERT_SUBTRACT("2**100", "2**99", "2**99");
+}
+
+TEST_F(CAPITest, test_mixed_long_short_arithmetic_and_comparisons) {
+    // Check a grid of values around the short int boundaries against Python.
+    const char *values[] = {
+        "0", "1", "-1", "7", "-2**30", "2**30", "2**31 - 1", "2**61 + 3",
+        "2**62 - 1", "-2**62", "2**62", "-2**62 - 1", "2**63", "-2**63",
+        "2**64 - 1", "-2**64 + 1", "2**90 + 12345", "-2**90 - 12345", "2**120",
+    };
+    int n = sizeof(values) / sizeof(values[0]);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            std::string x = std::string("(") + values[i] + ")";
+            std::string y = std::string("(") + values[j] + ")";
+            EXPECT_INT_EQUAL(CPyTagged_Add(eval_int(x), eval_int(y)), eval_int(x + "+" + y));
+            EXPECT_INT_EQUAL(CPyTagged_Subtract(eval_int(x), eval_int(y)),
+                             eval_int(x + "-" + y));
+            EXPECT_EQ(CPyTagged_IsLt(eval_int(x), eval_int(y)),
+                      (bool)PyObject_IsTrue(eval(x + "<" + y)));
+            EXPECT_EQ(CPyTagged_IsEq(eval_int(x), eval_int(y)),
+                      (bool)PyObject_IsTrue(eval(x + "==" + y)));
+        }
+    }
+}
+
 #define ASSERT_MULTIPLY(x, y, result) \
     EXPECT_TRUE(is_int_equal(CPyTagged_Multiply(eval_int(x), eval_int(y)), eval_int(result)))
 
@@ -289,6 +377,52 @@ TEST_F(CAPITest, test_multiply_int) {
     ASSERT_MULTIPLY("-3", "-5", "15");
 }
 
+TEST_F(CAPITest, test_multiply_int_edge_cases) {
+    // Large operands with a product that still fits in a short int
+    ASSERT_MULTIPLY("2**31", "2**30", "2**61");
+    ASSERT_MULTIPLY("2**40", "2**21", "2**61");
+    ASSERT_MULTIPLY("-2**31", "2**30", "-2**61");
+    ASSERT_MULTIPLY("2**61", "-2", "-2**62");
+    ASSERT_MULTIPLY("2**62 - 1", "1", "2**62 - 1");
+    ASSERT_MULTIPLY("-2**62", "1", "-2**62");
+    // Overflow
+    ASSERT_MULTIPLY("2**31", "2**31", "2**62");
+    ASSERT_MULTIPLY("2**61", "2", "2**62");
+    ASSERT_MULTIPLY("-2**62", "-1", "2**62");
+    ASSERT_MULTIPLY("2**62 - 1", "2**62 - 1", "(2**62 - 1)**2");
+    ASSERT_MULTIPLY("-2**62", "-2**62", "2**124");
+}
+
+TEST_F(CAPITest, test_short_arithmetic_stays_unboxed) {
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_Multiply(eval_int("2**31"), eval_int("2**30"))));
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_Multiply(eval_int("3 * 2**40"),
+                                                        eval_int("-2**20"))));
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_Add(eval_int("2**61"), eval_int("2**61 - 1"))));
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_Subtract(eval_int("-2**61"), eval_int("2**61"))));
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_Lshift(eval_int("1"), eval_int("61"))));
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_FloorDivide(eval_int("-2**62"),
+                                                           eval_int("2"))));
+    EXPECT_TRUE(CPyTagged_CheckLong(CPyTagged_Multiply(eval_int("2**31"), eval_int("2**31"))));
+    EXPECT_TRUE(CPyTagged_CheckLong(CPyTagged_Lshift(eval_int("1"), eval_int("62"))));
+    EXPECT_TRUE(CPyTagged_CheckLong(CPyTagged_FloorDivide(eval_int("-2**62"),
+                                                          eval_int("-1"))));
+}
+
+#define ASSERT_LSHIFT(x, y, result) \
+    EXPECT_INT_EQUAL(CPyTagged_Lshift(eval_int(x), eval_int(y)), eval_int(result))
+
+TEST_F(CAPITest, test_lshift_int) {
+    ASSERT_LSHIFT("0", "100", "0");
+    ASSERT_LSHIFT("3", "4", "48");
+    ASSERT_LSHIFT("-3", "4", "-48");
+    ASSERT_LSHIFT("1", "61", "2**61");
+    ASSERT_LSHIFT("-1", "62", "-2**62");
+    ASSERT_LSHIFT("1", "62", "2**62");
+    ASSERT_LSHIFT("-1", "63", "-2**63");
+    ASSERT_LSHIFT("5", "70", "5 * 2**70");
+    ASSERT_LSHIFT("2**65", "1", "2**66");
+}
+
 #define ASSERT_FLOOR_DIV(x, y, result) \
     EXPECT_INT_EQUAL(CPyTagged_FloorDivide(eval_int(x), eval_int(y)), eval_int(result))
 
@@ -308,6 +442,9 @@ TEST_F(CAPITest, test_floor_divide_short_int) {
     ASSERT_FLOOR_DIV("-3", "-3", "1");
     ASSERT_FLOOR_DIV("-5", "-3", "1");
     ASSERT_FLOOR_DIV("-6", "-3", "2");
+    ASSERT_FLOOR_DIV("-1", "2", "-1");
+    ASSERT_FLOOR_DIV("2", "-3", "-1");
+    ASSERT_FLOOR_DIV("12345", "-7", "-1764");
 
     ASSERT_FLOOR_DIV("2**60", "3", "2**60 // 3");
     ASSERT_FLOOR_DIV("-2**62", "-1", "2**62");
@@ -319,6 +456,11 @@ TEST_F(CAPITest, test_floor_divide_short_int) {
     ASSERT_FLOOR_DIV("-2**30", "1", "-2**30");
     ASSERT_FLOOR_DIV("2**30 - 1", "1", "2**30 - 1");
     ASSERT_FLOOR_DIV("2**30 - 1", "-1", "-2**30 + 1");
+
+    ASSERT_FLOOR_DIV("-2**62", "2", "-2**61");
+    ASSERT_FLOOR_DIV("-2**62", "-2", "2**61");
+    ASSERT_FLOOR_DIV("-2**62", "3", "-2**62 // 3");
+    ASSERT_FLOOR_DIV("-2**62", "-3", "-2**62 // -3");
 }
 
 TEST_F(CAPITest, test_floor_divide_long_int) {
@@ -508,6 +650,124 @@ TEST_F(CAPITest, test_int_less_than_or_equal) {
     EXPECT_FALSE(INT_LE("-2**65", "-2**65 - 1"));
 }
 
+TEST_F(CAPITest, test_bitwise_ops_with_negative_operands) {
+    const char *values[] = {
+        "0", "1", "-1", "0x5a5a", "-0x5a5a", "2**62 - 1", "-2**62", "2**62", "-2**62 - 1",
+        "-2**63", "2**64 - 1", "-2**64", "-2**64 + 1", "0x123456789abcdef0123456789",
+        "-0x123456789abcdef0123456789", "-2**300", "-(2**1000 - 12345)", "2**1000 + 7",
+    };
+    int n = sizeof(values) / sizeof(values[0]);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            std::string x = std::string("(") + values[i] + ")";
+            std::string y = std::string("(") + values[j] + ")";
+            EXPECT_INT_EQUAL(CPyTagged_And(eval_int(x), eval_int(y)), eval_int(x + "&" + y));
+            EXPECT_INT_EQUAL(CPyTagged_Or(eval_int(x), eval_int(y)), eval_int(x + "|" + y));
+            EXPECT_INT_EQUAL(CPyTagged_Xor(eval_int(x), eval_int(y)), eval_int(x + "^" + y));
+        }
+    }
+    // Results that fit in a short int are unboxed
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_And(eval_int("-2**64 + 1"), eval_int("255"))));
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_Or(eval_int("-2**64"), eval_int("-1"))));
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_Xor(eval_int("-2**70"), eval_int("-2**70 + 3"))));
+}
+
+// Check the result of a nogil operation against the result of the boxed operation
+static void check_nogil_result(CPyTagged result, int error, PyObject *expected,
+                               std::string expr) {
+    if (expected == NULL) {
+        int code = PyErr_ExceptionMatches(PyExc_ZeroDivisionError) ? CPY_NOGIL_ZERO_DIVISION
+                                                                   : CPY_NOGIL_NEGATIVE_SHIFT;
+        PyErr_Clear();
+        EXPECT_EQ(result, CPY_INT_TAG) << expr;
+        EXPECT_EQ(error, code) << expr;
+    } else if (CPyTagged_CheckShort(CPyTagged_FromObject(expected))) {
+        EXPECT_EQ(error, 0) << expr;
+        EXPECT_INT_EQUAL(result, CPyTagged_FromObject(expected));
+    } else {
+        EXPECT_EQ(result, CPY_INT_TAG) << expr;
+        EXPECT_EQ(error, CPY_NOGIL_OVERFLOW) << expr;
+    }
+}
+
+TEST_F(CAPITest, test_nogil_int_ops) {
+    const char *values[] = {
+        "0", "1", "-1", "2", "-3", "7", "-7", "12345", "2**31", "-2**31", "61", "62", "63",
+        "64", "2**62 - 1", "-2**62",
+    };
+    CPyTagged (*ops[])(CPyTagged, CPyTagged, int *) = {
+        CPyTagged_NoGIL_Add, CPyTagged_NoGIL_Subtract, CPyTagged_NoGIL_Multiply,
+        CPyTagged_NoGIL_FloorDivide, CPyTagged_NoGIL_Remainder, CPyTagged_NoGIL_Rshift,
+        CPyTagged_NoGIL_Lshift,
+    };
+    PyObject *(*boxed_ops[])(PyObject *, PyObject *) = {
+        PyNumber_Add, PyNumber_Subtract, PyNumber_Multiply, PyNumber_FloorDivide,
+        PyNumber_Remainder, PyNumber_Rshift, PyNumber_Lshift,
+    };
+    int n = sizeof(values) / sizeof(values[0]);
+    int num_ops = sizeof(ops) / sizeof(ops[0]);
+    for (int i = 0; i < n; i++) {
+        CPyTagged x = eval_int(values[i]);
+        PyObject *x_obj = CPyTagged_AsObject(x);
+        for (int j = 0; j < n; j++) {
+            CPyTagged y = eval_int(values[j]);
+            PyObject *y_obj = CPyTagged_AsObject(y);
+            for (int k = 0; k < num_ops; k++) {
+                if (ops[k] == CPyTagged_NoGIL_Lshift && x != 0
+                        && CPyTagged_ShortAsSsize_t(y) > 100) {
+                    continue;  // The boxed result would be huge
+                }
+                int error = 0;
+                PyThreadState *tstate = CPy_NoGIL_Enter();
+                CPyTagged result = ops[k](x, y, &error);
+                CPy_NoGIL_Exit(tstate);
+                PyObject *expected = boxed_ops[k](x_obj, y_obj);
+                check_nogil_result(result, error, expected, std::string(values[i]) + " op"
+                                   + std::to_string(k) + " " + values[j]);
+                Py_XDECREF(expected);
+            }
+            Py_DECREF(y_obj);
+        }
+        int error = 0;
+        CPyTagged result = CPyTagged_NoGIL_Negate(x, &error);
+        PyObject *expected = PyNumber_Negative(x_obj);
+        check_nogil_result(result, error, expected, std::string("-") + values[i]);
+        Py_DECREF(expected);
+        EXPECT_INT_EQUAL(CPyTagged_NoGIL_Invert(x), CPyTagged_Invert(x));
+        Py_DECREF(x_obj);
+    }
+}
+
+TEST_F(CAPITest, test_nogil_checks_and_errors) {
+    int error = 0;
+    EXPECT_EQ(CPyTagged_NoGIL_CheckAttr(eval_int("-5"), &error), eval_int("-5"));
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(CPyTagged_NoGIL_CheckAttr(eval_int("2**100"), &error), CPY_INT_TAG);
+    EXPECT_EQ(error, CPY_NOGIL_OVERFLOW);
+    EXPECT_EQ(CPyTagged_NoGIL_CheckAttr(CPY_INT_TAG, &error), CPY_INT_TAG);
+    EXPECT_EQ(error, CPY_NOGIL_UNDEFINED_ATTR);
+    error = 0;
+    EXPECT_EQ(CPyBool_NoGIL_CheckAttr(1, &error), 1);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(CPyBool_NoGIL_CheckAttr(2, &error), 2);
+    EXPECT_EQ(error, CPY_NOGIL_UNDEFINED_ATTR);
+
+    EXPECT_EQ(CPy_NoGIL_CheckInt(eval_int("2**62 - 1")), 1);
+    EXPECT_FALSE(PyErr_Occurred());
+    EXPECT_EQ(CPy_NoGIL_CheckInt(eval_int("2**62")), 0);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_OverflowError));
+    PyErr_Clear();
+
+    PyObject *expected[] = {
+        PyExc_OverflowError, PyExc_ZeroDivisionError, PyExc_ValueError, PyExc_AttributeError,
+    };
+    for (int code = 1; code <= 4; code++) {
+        EXPECT_EQ(CPy_NoGIL_Raise(CPy_NoGIL_Enter(), code), 0);
+        EXPECT_TRUE(PyErr_ExceptionMatches(expected[code - 1]));
+        PyErr_Clear();
+    }
+}
+
 #define list_get_eq(list, index, value) \
     is_py_equal(CPyList_GetItem(list, eval_int(index)), eval(value))
 
@@ -524,6 +784,1464 @@ TEST_F(CAPITest, test_list_get) {
     EXPECT_TRUE(list_get_eq(l, "-3", "3"));
 }
 
+TEST_F(CAPITest, test_presized_list) {
+    PyObject *l = CPyList_NewPresized(2);
+    EXPECT_EQ(((PyListObject *)l)->allocated, 2);
+    EXPECT_EQ(PyList_GET_SIZE(l), 0);
+    EXPECT_TRUE(CPyList_AppendSteal(l, eval("'a'")));
+    EXPECT_TRUE(CPyList_AppendSteal(l, eval("'b'")));
+    // Exceeding the capacity hint reallocates
+    EXPECT_TRUE(CPyList_AppendSteal(l, eval("'c'")));
+    CPyList_ShrinkToFit(l);
+    EXPECT_EQ(((PyListObject *)l)->allocated, 3);
+    EXPECT_TRUE(is_py_equal(l, eval("['a', 'b', 'c']")));
+
+    PyObject *empty = CPyList_NewPresized(10);
+    CPyList_ShrinkToFit(empty);
+    EXPECT_EQ(((PyListObject *)empty)->allocated, 0);
+    EXPECT_TRUE(is_py_equal(empty, eval("[]")));
+    Py_DECREF(empty);
+
+    // Huge hints are capped, and they never fail
+    PyObject *huge = CPyList_NewPresized(PY_SSIZE_T_MAX);
+    ASSERT_TRUE(huge != NULL);
+    EXPECT_LE(((PyListObject *)huge)->allocated, 1 << 20);
+    EXPECT_TRUE(CPyList_AppendSteal(huge, eval("'a'")));
+    EXPECT_TRUE(is_py_equal(huge, eval("['a']")));
+    Py_DECREF(huge);
+
+    EXPECT_EQ(CPyTagged_RangeLengthHint(eval_int("-2"), eval_int("3")), 5);
+    EXPECT_EQ(CPyTagged_RangeLengthHint(eval_int("3"), eval_int("-2")), 0);
+    EXPECT_EQ(CPyTagged_RangeLengthHint(eval_int("0"), eval_int("2**70")), 0);
+}
+
+TEST_F(CAPITest, test_deque_ops) {
+    PyObject *d = eval("__import__('collections').deque()");
+    EXPECT_EQ(CPyDeque_Append(d, eval("1")), 0);
+    EXPECT_EQ(CPyDeque_AppendLeft(d, eval("2")), 0);
+    EXPECT_INT_EQUAL(CPyDeque_Len(d), eval_int("2"));
+    EXPECT_TRUE(is_py_equal(CPyDeque_Pop(d), eval("1")));
+    EXPECT_TRUE(is_py_equal(CPyDeque_PopLeft(d), eval("2")));
+    EXPECT_EQ(CPyDeque_Pop(d), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_IndexError));
+    PyErr_Clear();
+    // Objects other than exact deques use generic method calls
+    PyObject *l = eval("[]");
+    EXPECT_EQ(CPyDeque_Append(l, eval("3")), 0);
+    EXPECT_INT_EQUAL(CPyDeque_Len(l), eval_int("1"));
+    EXPECT_TRUE(is_py_equal(CPyDeque_Pop(l), eval("3")));
+    EXPECT_EQ(CPyDeque_PopLeft(l), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_AttributeError));
+    PyErr_Clear();
+}
+
+TEST_F(CAPITest, test_list_search) {
+    PyObject *l = eval("['a', 'b' * 2, 2**70, 5, 1.0, True, None, 'bb', 5]");
+    EXPECT_INT_EQUAL(CPyList_Index(l, eval("'b' * 2")), eval_int("1"));
+    EXPECT_INT_EQUAL(CPyList_Index(l, eval("2**70 + 0")), eval_int("2"));
+    EXPECT_INT_EQUAL(CPyList_Index(l, eval("5")), eval_int("3"));
+    // Ints compare equal to floats and bools
+    EXPECT_INT_EQUAL(CPyList_Index(l, eval("1")), eval_int("4"));
+    EXPECT_INT_EQUAL(CPyList_Count(l, eval("1")), eval_int("2"));
+    EXPECT_INT_EQUAL(CPyList_Count(l, eval("'bb'")), eval_int("2"));
+    EXPECT_INT_EQUAL(CPyList_Count(l, eval("5")), eval_int("2"));
+    EXPECT_INT_EQUAL(CPyList_Count(l, eval("-5")), eval_int("0"));
+    EXPECT_EQ(CPyList_Contains(l, eval("'\\u1234'")), 0);
+    EXPECT_EQ(CPyList_Contains(l, eval("None")), 1);
+    EXPECT_EQ(CPyList_Contains(l, eval("2**71")), 0);
+    EXPECT_EQ(CPyList_Index(l, eval("'c'")), CPY_INT_TAG);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_ValueError));
+    PyErr_Clear();
+    EXPECT_EQ(CPyList_Remove(l, eval("'bb'")), 0);
+    EXPECT_TRUE(is_py_equal(l, eval("['a', 2**70, 5, 1.0, True, None, 'bb', 5]")));
+
+    // A custom __eq__ is used for items that aren't str or int
+    PyObject *l2 = eval("[1, type('E', (), {'__eq__': lambda s, o: o == 'x'})(), 'x']");
+    EXPECT_INT_EQUAL(CPyList_Index(l2, eval("'x'")), eval_int("1"));
+    EXPECT_INT_EQUAL(CPyList_Count(l2, eval("'x'")), eval_int("2"));
+    PyObject *l3 = eval("[type('F', (), {'__eq__': lambda s, o: 1 / 0})()]");
+    EXPECT_EQ(CPyList_Contains(l3, eval("'x'")), -1);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_ZeroDivisionError));
+    PyErr_Clear();
+    EXPECT_EQ(CPyList_Count(l3, eval("1")), CPY_INT_TAG);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_ZeroDivisionError));
+    PyErr_Clear();
+
+    // "x in l" calls x.__eq__(item) first, but l.index(x) calls item.__eq__(x)
+    PyObject *e = eval("type('E', (), {'__eq__': lambda s, o: True})()");
+    PyObject *l4 = eval("[type('F', (), {'__eq__': lambda s, o: False})()]");
+    EXPECT_EQ(CPyList_Contains(l4, e), 1);
+    EXPECT_EQ(CPyList_Index(l4, e), CPY_INT_TAG);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_ValueError));
+    PyErr_Clear();
+    // List subclasses may override __contains__
+    PyObject *sub = eval("type('L', (list,), {'__contains__': lambda s, o: o == 'y'})(['x'])");
+    EXPECT_EQ(CPyList_Contains(sub, eval("'x'")), 0);
+    EXPECT_EQ(CPyList_Contains(sub, eval("'y'")), 1);
+}
+
+TEST_F(CAPITest, test_slice_with_step) {
+    CPyTagged big = eval_int("2**70");
+    CPyTagged neg_big = eval_int("-2**70");
+    // Bounds are clamped like PySlice_AdjustIndices()
+    EXPECT_EQ(CPySlice_AdjustIndex(CPyTagged_ShortFromSsize_t(-2), 5, 1), 3);
+    EXPECT_EQ(CPySlice_AdjustIndex(CPyTagged_ShortFromSsize_t(-9), 5, 1), 0);
+    EXPECT_EQ(CPySlice_AdjustIndex(CPyTagged_ShortFromSsize_t(-9), 5, -1), -1);
+    EXPECT_EQ(CPySlice_AdjustIndex(CPyTagged_ShortFromSsize_t(9), 5, -1), 4);
+    EXPECT_EQ(CPySlice_AdjustIndex(big, 5, 1), 5);
+    EXPECT_EQ(CPySlice_AdjustIndex(neg_big, 5, -2), -1);
+    EXPECT_EQ(CPySlice_Length(0, 5, 2), 3);
+    EXPECT_EQ(CPySlice_Length(4, -1, -3), 2);
+    EXPECT_EQ(CPySlice_Length(3, 3, -1), 0);
+
+    PyObject *l = eval("[0, 1, 2, 3, 4, 5]");
+    PyObject *r = CPyList_GetSliceStep(l, big, neg_big, CPyTagged_ShortFromSsize_t(-2));
+    EXPECT_TRUE(is_py_equal(r, eval("[5, 3, 1]")));
+    r = CPySequenceTuple_GetSliceStep(eval("(0, 1, 2, 3)"), CPyTagged_ShortFromSsize_t(1), big,
+                                      CPyTagged_ShortFromSsize_t(2));
+    EXPECT_TRUE(is_py_equal(r, eval("(1, 3)")));
+    r = CPyStr_GetSliceStep(eval("'a\\u20acb\\U0001f600c'"), CPyTagged_ShortFromSsize_t(0), big,
+                            CPyTagged_ShortFromSsize_t(2));
+    EXPECT_TRUE(is_py_equal(r, eval("'abc'")));
+    EXPECT_EQ(PyUnicode_KIND(r), PyUnicode_1BYTE_KIND);
+    // A zero step raises ValueError
+    EXPECT_TRUE(CPyList_GetSliceStep(l, 0, big, 0) == NULL);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_ValueError));
+    PyErr_Clear();
+    EXPECT_INT_EQUAL(CPySequence_SliceIndex(eval("'abc'"), neg_big, CPyTagged_ShortFromSsize_t(1)),
+                     eval_int("0"));
+}
+
+TEST_F(CAPITest, test_str_single_chars) {
+    PyObject *s = eval("'a\\xff\\u20ac\\U0001f600'");
+    CPyTagged zero = CPyTagged_ShortFromSsize_t(0);
+    // Latin-1 characters are shared
+    PyObject *a = CPyStr_GetItem(s, zero);
+    EXPECT_TRUE(is_py_equal(a, eval("'a'")));
+    EXPECT_EQ(a, CPyStr_GetItemUnsafe(s, zero));
+    EXPECT_EQ(a, CPyStr_FromChar('a'));
+    PyObject *ff = CPyStr_GetItem(s, CPyTagged_ShortFromSsize_t(1));
+    EXPECT_EQ(ff, CPyStr_GetItem(s, CPyTagged_ShortFromSsize_t(-3)));
+    EXPECT_EQ(PyUnicode_READ_CHAR(ff, 0), 0xff);
+    PyObject *euro = CPyStr_GetItemUnsafe(s, CPyTagged_ShortFromSsize_t(2));
+    EXPECT_TRUE(is_py_equal(euro, eval("'\\u20ac'")));
+    PyObject *emoji = CPyStr_GetItem(s, CPyTagged_ShortFromSsize_t(-1));
+    EXPECT_TRUE(is_py_equal(emoji, eval("'\\U0001f600'")));
+    EXPECT_EQ(PyUnicode_KIND(emoji), PyUnicode_4BYTE_KIND);
+
+    EXPECT_EQ(CPyStr_IndexEqualsChar(s, zero, 'a'), 1);
+    EXPECT_EQ(CPyStr_IndexEqualsChar(s, zero, 'b'), 0);
+    EXPECT_EQ(CPyStr_IndexEqualsChar(s, CPyTagged_ShortFromSsize_t(-2), 0x20ac), 1);
+    EXPECT_EQ(CPyStr_IndexEqualsChar(s, CPyTagged_ShortFromSsize_t(3), 0x1f600), 1);
+    EXPECT_EQ(CPyStr_IndexEqualsChar(s, CPyTagged_ShortFromSsize_t(4), 'a'), -1);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_IndexError));
+    PyErr_Clear();
+    EXPECT_EQ(CPyStr_IndexEqualsChar(s, CPyTagged_ShortFromSsize_t(-5), 'a'), -1);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_IndexError));
+    PyErr_Clear();
+    EXPECT_EQ(CPyStr_IndexEqualsChar(s, eval_int("2**70"), 'a'), -1);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_OverflowError));
+    PyErr_Clear();
+}
+
+TEST_F(CAPITest, test_str_build) {
+    PyObject *r = CPyStr_Build(5, 0x6, eval("'line '"), CPyTagged_ShortFromSsize_t(-12),
+                               eval_int("2**64"), eval("':'"), eval("'\\U0001f600'"));
+    EXPECT_TRUE(is_py_equal(r, eval("'line -12' + str(2**64) + ':\\U0001f600'")));
+    EXPECT_EQ(PyUnicode_KIND(r), PyUnicode_4BYTE_KIND);
+    r = CPyStr_Build(2, 0x0, eval("''"), eval("''"));
+    EXPECT_TRUE(is_py_equal(r, eval("''")));
+    CPyTagged max_short = CPyTagged_ShortFromSsize_t(CPY_TAGGED_MAX);
+    r = CPyStr_Build(1, 0x1, max_short);
+    EXPECT_TRUE(is_py_equal(r, PyObject_Str(CPyTagged_AsObject(max_short))));
+}
+
+TEST_F(CAPITest, test_int_from_str) {
+    const char *strs[] = {"'0'", "'-0'", "' 12 '", "'\\t+7\\n'", "'007'", "'1_000'", "'- 1'",
+                          "''", "' '", "'-'", "'12a'", "'ff'", "'FF'", "'0x1f'", "'z'",
+                          "'\\xa012'", "'\\u0661'", "'\\u20ac'", "'999999999999999999'",
+                          "'-999999999999999999'", "'4611686018427387903'",
+                          "'4611686018427387904'", "'-4611686018427387904'",
+                          "'-4611686018427387905'", "'1' * 40", "'-' + '9' * 40",
+                          "'3fffffffffffffff'", "'4000000000000000'", "'-4000000000000000'"};
+    const int bases[] = {10, 16, 2, 36};
+    size_t i, j;
+    for (i = 0; i < sizeof(strs) / sizeof(strs[0]); i++) {
+        for (j = 0; j < sizeof(bases) / sizeof(bases[0]); j++) {
+            PyObject *str = eval(strs[i]);
+            PyObject *expected = PyLong_FromUnicodeObject(str, bases[j]);
+            CPyTagged result = j == 0 ? CPyTagged_FromStr(str)
+                : CPyTagged_FromStrWithBase(str, CPyTagged_ShortFromSsize_t(bases[j]));
+            std::string expr = std::string(strs[i]) + ", " + std::to_string(bases[j]);
+            if (expected == NULL) {
+                EXPECT_EQ(result, CPY_INT_TAG) << expr;
+                EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_ValueError)) << expr;
+                PyErr_Clear();
+            } else {
+                EXPECT_TRUE(result != CPY_INT_TAG) << expr;
+                EXPECT_INT_EQUAL(result, CPyTagged_FromObject(expected));
+                // Values are normalized, so that only out of range values are long
+                EXPECT_EQ(CPyTagged_CheckShort(result),
+                          CPyTagged_CheckShort(CPyTagged_FromObject(expected))) << expr;
+            }
+        }
+    }
+    EXPECT_EQ(CPyTagged_FromStrWithBase(eval("'1'"), eval_int("2**70")), CPY_INT_TAG);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_ValueError));
+    PyErr_Clear();
+    EXPECT_INT_EQUAL(CPyTagged_FromStrWithBase(eval("'0x1f'"), eval_int("0")), eval_int("31"));
+}
+
+TEST_F(CAPITest, test_int_format) {
+    char buf[CPY_MAX_INT_CHARS];
+    Py_ssize_t values[] = {0, 1, -1, 9, 10, 99, 100, -100, 101, 12345, -987654321,
+                           CPY_TAGGED_MAX, CPY_TAGGED_MIN, PY_SSIZE_T_MAX, PY_SSIZE_T_MIN};
+    size_t i;
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        PyObject *obj = PyLong_FromSsize_t(values[i]);
+        int len = CPy_FormatSsize_t(buf, values[i]);
+        EXPECT_EQ(len, (int)strlen(buf));
+        EXPECT_TRUE(is_py_equal(PyUnicode_FromString(buf), PyObject_Str(obj))) << buf;
+        len = CPy_FormatSsize_tHex(buf, values[i]);
+        EXPECT_EQ(len, (int)strlen(buf));
+        EXPECT_TRUE(is_py_equal(PyUnicode_FromString(buf), PyNumber_ToBase(obj, 16))) << buf;
+        Py_DECREF(obj);
+    }
+    const char *ints[] = {"0", "-5", "2**62 - 1", "-2**62", "2**62", "-2**62 - 1", "7**100"};
+    for (i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+        CPyTagged n = eval_int(ints[i]);
+        EXPECT_TRUE(is_py_equal(CPyTagged_Str(n), eval("str(" + std::string(ints[i]) + ")")));
+        EXPECT_TRUE(is_py_equal(CPyTagged_Hex(n), eval("hex(" + std::string(ints[i]) + ")")));
+    }
+}
+
+TEST_F(CAPITest, test_str_split_fast_paths) {
+    const char *strs[] = {"''", "' '", "'a'", "' a  b\\tc '", "'a\\x1fb\\x85c'", "'a,,b,'",
+                          "'\\xe4,b'", "'\\u20ac,b'"};
+    const char *seps[] = {"None", "','", "',,'", "'\\xe4'", "'ab'"};
+    size_t i, j;
+    Py_ssize_t n;
+    for (i = 0; i < sizeof(strs) / sizeof(strs[0]); i++) {
+        for (j = 0; j < sizeof(seps) / sizeof(seps[0]); j++) {
+            for (n = -1; n < 3; n++) {
+                PyObject *str = eval(strs[i]);
+                PyObject *sep = eval(seps[j]);
+                PyObject *result = CPyStr_SplitMax(str, sep == Py_None ? NULL : sep, n);
+                ASSERT_TRUE(result != NULL);
+                PyObject *expected = PyUnicode_Split(str, sep == Py_None ? NULL : sep, n);
+                EXPECT_TRUE(is_py_equal(result, expected))
+                    << strs[i] << " " << seps[j] << " " << n;
+            }
+        }
+    }
+    PyObject *r = CPyStr_ReplaceMax(eval("'a.b.c'"), eval("'.'"), eval("'::'"), 1);
+    EXPECT_TRUE(is_py_equal(r, eval("'a::b.c'")));
+    EXPECT_EQ(CPyStr_Find(eval("'abcab'"), eval("'ca'")), CPyTagged_ShortFromSsize_t(2));
+    EXPECT_EQ(CPyStr_Find(eval("'\\u20acab'"), eval("'b'")), CPyTagged_ShortFromSsize_t(2));
+    EXPECT_EQ(CPyStr_Count(eval("'aaaaa'"), eval("'aa'")), CPyTagged_ShortFromSsize_t(2));
+    EXPECT_EQ(CPyStr_Contains(eval("'ab'"), eval("'\\u20ac'")), 0);
+    EXPECT_TRUE(CPyStr_Startswith(eval("'\\xe4bc'"), eval("'\\xe4b'")));
+    EXPECT_FALSE(CPyStr_Endswith(eval("'bc'"), eval("'abc'")));
+}
+
+TEST_F(CAPITest, test_set_contains_int) {
+    // Include values with colliding hashes, -1 (which hashes to -2), and
+    // enough items to need probing
+    PyObject *sets[] = {
+        eval("set()"), eval("{5}"), eval("{-1, -2, 0}"), eval("set(range(-100, 1000, 7))"),
+        eval("{2**61 + 4, 2**62 - 1, -2**62}"), eval("frozenset(range(0, 64 * 1024, 1024))"),
+        eval("{True, 2.0, 'x'}"),
+    };
+    long long values[] = {0, 1, 2, 5, -1, -2, -3, 6, 1024, 13, 2305843009213693956LL,
+                          4611686018427387903LL, -4611686018427387904LL, -100, 993};
+    size_t i, j;
+    for (i = 0; i < sizeof(sets) / sizeof(sets[0]); i++) {
+        for (j = 0; j < sizeof(values) / sizeof(values[0]); j++) {
+            PyObject *obj = PyLong_FromLongLong(values[j]);
+            CPyTagged key = CPyTagged_FromObject(obj);
+            EXPECT_EQ(CPySet_ContainsInt(sets[i], key), PySet_Contains(sets[i], obj))
+                << i << " " << values[j];
+            CPyTagged_DecRef(key);
+            Py_DECREF(obj);
+        }
+    }
+    EXPECT_EQ(CPySet_ContainsInt(eval("{2**70}"), eval_int("2**70")), 1);
+    EXPECT_EQ(CPySet_ContainsInt(eval("{2**70}"), eval_int("2**71")), 0);
+}
+
+TEST_F(CAPITest, test_set_ops) {
+    PyObject *s = eval("{1, 'a'}");
+    PyObject *r = CPySet_Union(s, eval("frozenset({2})"));
+    EXPECT_TRUE(is_py_equal(r, eval("{1, 2, 'a'}")));
+    EXPECT_EQ(Py_TYPE(r), &PySet_Type);
+    r = CPySet_InPlaceUnion(s, eval("{3}"));
+    EXPECT_EQ(r, s);
+    EXPECT_TRUE(is_py_equal(s, eval("{1, 3, 'a'}")));
+
+    PyObject *it = CPySet_GetIter(s);
+    EXPECT_EQ(it, s);
+    PyObject *seen = PySet_New(NULL);
+    CPyTagged offset = CPyTagged_ShortFromSsize_t(0);
+    while (1) {
+        tuple_T3CIO next = CPySet_Next(it, offset);
+        if (!next.f0) {
+            EXPECT_EQ(next.f2, Py_None);
+            break;
+        }
+        PySet_Add(seen, next.f2);
+        offset = next.f1;
+    }
+    EXPECT_TRUE(is_py_equal(seen, s));
+    EXPECT_TRUE(CPySet_CheckSize(s, CPyTagged_ShortFromSsize_t(3)));
+    EXPECT_FALSE(CPySet_CheckSize(s, CPyTagged_ShortFromSsize_t(2)));
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_RuntimeError));
+    PyErr_Clear();
+}
+
+TEST_F(CAPITest, test_add_traceback_cached) {
+    PyCodeObject *cache = NULL;
+    PyObject *codes[2];
+    int i;
+    for (i = 0; i < 2; i++) {
+        PyErr_SetString(PyExc_ValueError, "x");
+        CPy_AddTracebackCached(&cache, "file.py", "func", 12, moduleDict);
+        PyObject *type, *value, *tb;
+        PyErr_Fetch(&type, &value, &tb);
+        ASSERT_TRUE(tb != NULL);
+        PyTracebackObject *entry = (PyTracebackObject *)tb;
+        EXPECT_EQ(entry->tb_lineno, 12);
+        codes[i] = (PyObject *)entry->tb_frame->f_code;
+        EXPECT_TRUE(is_py_equal(((PyCodeObject *)codes[i])->co_name, eval("'func'")));
+        Py_DECREF(type);
+        Py_DECREF(value);
+        Py_DECREF(tb);
+    }
+    EXPECT_EQ(codes[0], (PyObject *)cache);
+    EXPECT_EQ(codes[1], (PyObject *)cache);
+}
+
+TEST_F(CAPITest, test_fetch_error) {
+    PyObject *exc_type = CPy_ExcState()->exc_type;
+    PyErr_SetString(PyExc_KeyError, "k");
+    tuple_T3OOO err = CPy_FetchError();
+    EXPECT_FALSE(PyErr_Occurred());
+    // The exception isn't normalized or made the handled exception
+    EXPECT_EQ(err.f0, PyExc_KeyError);
+    EXPECT_TRUE(PyUnicode_Check(err.f1));
+    EXPECT_EQ(err.f2, _CPy_ExcDummy);
+    EXPECT_EQ(CPy_ExcState()->exc_type, exc_type);
+    EXPECT_TRUE(CPy_ErrorMatches(err, PyExc_LookupError));
+    EXPECT_TRUE(CPy_ErrorMatches(err, eval("(ValueError, KeyError)")));
+    EXPECT_FALSE(CPy_ErrorMatches(err, PyExc_ValueError));
+    CPy_RestoreError(err);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_KeyError));
+    PyErr_Clear();
+    Py_DECREF(err.f0);
+    Py_DECREF(err.f1);
+    Py_DECREF(err.f2);
+
+    PyErr_SetNone(PyExc_StopIteration);
+    err = CPy_FetchError();
+    EXPECT_EQ(err.f1, _CPy_ExcDummy);
+    CPy_RestoreError(err);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_StopIteration));
+    PyErr_Clear();
+    Py_DECREF(err.f0);
+    Py_DECREF(err.f1);
+    Py_DECREF(err.f2);
+}
+
+TEST_F(CAPITest, test_iter_send_status) {
+    PyObject *res;
+    PyObject *it = eval("(x for x in [1])");
+    EXPECT_EQ(CPyIter_SendStatus(it, Py_None, &res), CPY_GEN_NEXT);
+    EXPECT_TRUE(is_py_equal(res, int_from_str("1")));
+    Py_DECREF(res);
+    EXPECT_EQ(CPyIter_SendStatus(it, Py_None, &res), CPY_GEN_RETURN);
+    EXPECT_EQ(res, Py_None);
+    EXPECT_FALSE(PyErr_Occurred());
+    Py_DECREF(res);
+    EXPECT_EQ(CPyIter_SendStatus(it, int_from_str("1"), &res), CPY_GEN_RETURN);
+    Py_DECREF(res);
+
+    PyObject *value = NULL;
+    CPyGen_SetReturnValue(int_from_str("5"), &value);
+    EXPECT_FALSE(PyErr_Occurred());
+    EXPECT_TRUE(is_py_equal(value, int_from_str("5")));
+    Py_DECREF(value);
+    CPyGen_SetReturnValue(int_from_str("5"), NULL);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_StopIteration));
+    PyErr_Clear();
+
+    PyObject *result = NULL;
+    EXPECT_EQ(CPyGen_SendResult(NULL, NULL, &result), CPY_GEN_ERROR);
+    EXPECT_EQ(CPyGen_SendResult(Py_None, NULL, &result), CPY_GEN_NEXT);
+    EXPECT_EQ(result, Py_None);
+    EXPECT_TRUE(CPyGen_NativeMethods(it) == NULL);
+}
+
+TEST_F(CAPITest, test_attribute_probes) {
+    PyObject *obj = eval("1");
+    PyObject *real = eval("'real'");
+    PyObject *missing = eval("'missing'");
+    PyObject *defl = eval("'default'");
+    EXPECT_EQ(CPyObject_HasAttr(obj, real), 1);
+    EXPECT_EQ(CPyObject_HasAttr(obj, missing), 0);
+    EXPECT_FALSE(PyErr_Occurred());
+    PyObject *result = CPyObject_GetAttr3(obj, missing, defl);
+    EXPECT_EQ(result, defl);
+    Py_DECREF(result);
+    result = CPyObject_GetAttr3(obj, real, defl);
+    EXPECT_TRUE(is_py_equal(result, obj));
+    Py_DECREF(result);
+    EXPECT_FALSE(PyErr_Occurred());
+
+    // Errors other than AttributeError propagate
+    EXPECT_EQ(CPyObject_HasAttr(obj, obj), -1);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+    PyErr_Clear();
+}
+
+TEST_F(CAPITest, test_parse_slots) {
+    // def f(a, b=None, *, c, **kw)
+    static const char * const kwlist[] = {"a", "b", "c", 0};
+    static CPyArg_Descriptor desc = {kwlist, "f", 3, 1, 2, 2, 0, 1};
+    PyObject *args[] = {eval("10"), eval("20"), eval("30"), eval("40")};
+    PyObject *kwnames = eval("('c', 'd')");
+    CPyArg_Slot slots[4];
+    ASSERT_TRUE(CPyArg_ParseStackAndKeywordsSlots(args, 2, kwnames, &desc, slots));
+    EXPECT_EQ(slots[0].obj, args[0]);
+    EXPECT_EQ(slots[1].obj, args[1]);
+    EXPECT_EQ(slots[2].obj, args[2]);
+    EXPECT_TRUE(is_py_equal(slots[3].obj, eval("{'d': 40}")));
+    Py_DECREF(slots[3].obj);
+
+    // Only a keyword-only argument given; optional slots are cleared
+    kwnames = eval("('c',)");
+    ASSERT_TRUE(CPyArg_ParseStackAndKeywordsSlots(args, 1, kwnames, &desc, slots));
+    EXPECT_EQ(slots[0].obj, args[0]);
+    EXPECT_EQ(slots[1].obj, nullptr);
+    EXPECT_EQ(slots[2].obj, args[1]);
+    EXPECT_EQ(PyDict_GET_SIZE(slots[3].obj), 0);
+    Py_DECREF(slots[3].obj);
+
+    EXPECT_FALSE(CPyArg_ParseStackAndKeywordsSlots(args, 2, NULL, &desc, slots));
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+    PyErr_Clear();
+    kwnames = eval("('a',)");
+    EXPECT_FALSE(CPyArg_ParseStackAndKeywordsSlots(args, 1, kwnames, &desc, slots));
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+    PyErr_Clear();
+}
+
+TEST_F(CAPITest, test_parse_slots_typed) {
+    // def f(a: int, b: bool = False, *, c: str = '', d: dict)
+    static const char * const kwlist[] = {"a", "b", "c", "d", 0};
+    static PyTypeObject *dict_type = &PyDict_Type;
+    static const CPyArg_Type types[] = {
+        {CPYARG_INT, NULL, "int"}, {CPYARG_BOOL, NULL, "bool"}, {CPYARG_STR, NULL, "str"},
+        {CPYARG_INSTANCE, &dict_type, "dict"}};
+    static CPyArg_Descriptor desc = {kwlist, "f", 4, 1, 2, 3, 0, 0, types};
+    PyObject *args[] = {eval("5"), eval("True"), eval("{}")};
+    PyObject *kwnames = eval("('d',)");
+    CPyArg_Slot slots[4];
+    ASSERT_EQ(CPyArg_ParseStackAndKeywordsSlots(args, 2, kwnames, &desc, slots), 1);
+    EXPECT_EQ(slots[0].tagged, 10);
+    EXPECT_EQ(slots[1].boolean, 1);
+    EXPECT_EQ(slots[2].obj, nullptr);
+    EXPECT_EQ(slots[3].obj, args[2]);
+
+    // A missing optional bool gets the error value
+    PyObject *args2[] = {args[0], args[2]};
+    ASSERT_EQ(CPyArg_ParseStackAndKeywordsSlots(args2, 1, kwnames, &desc, slots), 1);
+    EXPECT_EQ(slots[1].boolean, 2);
+
+    // Wrong argument types and wrong signatures are told apart
+    PyObject *bad_args[] = {eval("'x'"), args[2]};
+    EXPECT_EQ(CPyArg_ParseStackAndKeywordsSlots(bad_args, 1, kwnames, &desc, slots), -1);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+    PyErr_Clear();
+    EXPECT_EQ(CPyArg_ParseStackAndKeywordsSlots(args, 1, NULL, &desc, slots), 0);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+    PyErr_Clear();
+}
+
+TEST_F(CAPITest, test_parse_slots_many_keywords) {
+    // def f(*, k0=None, ..., k19=None)
+    static const char * const kwlist[] = {
+        "k0", "k1", "k2", "k3", "k4", "k5", "k6", "k7", "k8", "k9", "k10",
+        "k11", "k12", "k13", "k14", "k15", "k16", "k17", "k18", "k19", 0};
+    static CPyArg_Descriptor desc = {kwlist, "f", 20, 0, 0, INT_MAX, 0, 0};
+    PyObject *args[] = {eval("10"), eval("20"), eval("30")};
+    // The last name isn't interned, so it can only be matched by value
+    PyObject *kwnames = eval("('k19', 'k3', ''.join(['k', '1', '1']))");
+    CPyArg_Slot slots[20];
+    ASSERT_TRUE(CPyArg_ParseStackAndKeywordsSlots(args, 0, kwnames, &desc, slots));
+    for (int i = 0; i < 20; i++) {
+        PyObject *expected = i == 19 ? args[0] : i == 3 ? args[1] : i == 11 ? args[2] : nullptr;
+        EXPECT_EQ(slots[i].obj, expected);
+    }
+
+    kwnames = eval("('k2', 'k20')");
+    EXPECT_FALSE(CPyArg_ParseStackAndKeywordsSlots(args, 0, kwnames, &desc, slots));
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+    PyErr_Clear();
+}
+
+TEST_F(CAPITest, test_str_statics) {
+    // An ASCII value and a non-ASCII value, which has to be decoded
+    static const char * const strings[] = {"\x02\x07" "foo\x04" "\xc3\xa9", ""};
+    PyObject *statics[5];
+    ASSERT_EQ(CPyStatics_Initialize(statics, strings, NULL, NULL, NULL, NULL, NULL, NULL), 0);
+    EXPECT_TRUE(is_py_equal(statics[3], eval("'foo'")));
+    EXPECT_TRUE(PyUnicode_IS_ASCII(statics[3]));
+    EXPECT_TRUE(PyUnicode_CHECK_INTERNED(statics[3]));
+    EXPECT_TRUE(is_py_equal(statics[4], eval("'\\u00e9'")));
+#ifdef CPY_IMMORTAL_STATICS
+    EXPECT_GE(Py_REFCNT(statics[3]), CPY_IMMORTAL_REFCNT_BIAS);
+    EXPECT_GE(Py_REFCNT(statics[0]), CPY_IMMORTAL_REFCNT_BIAS);
+#endif
+}
+
+TEST_F(CAPITest, test_lazy_statics) {
+    static const char * const strings[] = {"\x02\x03" "a\x05" "bc", ""};
+    static const char * const ints[] = {"\x02" "12\0-123456789012345678901234567890", ""};
+    static const double floats[] = {1, 1.5};
+    static const int tuples[] = {1, 2, 4, 3};
+    PyObject *statics[9];
+    CPyStatics_Table table;
+    ASSERT_EQ(CPyStatics_InitializeLazy(&table, statics, 9, strings, NULL, ints, floats,
+                                        NULL, tuples, NULL), 0);
+    EXPECT_EQ(statics[0], Py_None);
+    EXPECT_EQ(statics[2], Py_True);
+    for (int i = 3; i < 9; i++) {
+        EXPECT_EQ(statics[i], nullptr);
+    }
+
+    // Loading the tuple also loads its items
+    EXPECT_TRUE(is_py_equal(CPyStatics_Get(&table, 8), eval("('bc', 'a')")));
+    EXPECT_TRUE(is_py_equal(statics[4], eval("'bc'")));
+    EXPECT_EQ(statics[5], nullptr);
+    EXPECT_TRUE(is_py_equal(CPyStatics_Get(&table, 6), eval("-123456789012345678901234567890")));
+    EXPECT_TRUE(is_py_equal(CPyStatics_Get(&table, 7), eval("1.5")));
+    EXPECT_TRUE(is_py_equal(CPyStatics_Get(&table, 5), eval("12")));
+    PyObject *a = CPyStatics_Get(&table, 3);
+    EXPECT_EQ(CPyStatics_Get(&table, 3), a);
+    EXPECT_TRUE(PyUnicode_CHECK_INTERNED(a));
+#ifdef CPY_IMMORTAL_STATICS
+    EXPECT_GE(Py_REFCNT(a), CPY_IMMORTAL_REFCNT_BIAS);
+#endif
+}
+
+TEST_F(CAPITest, test_immortal_refcounts) {
+#ifdef CPY_IMMORTAL_STATICS
+    // Generated code skips increfs of literals, but the decrefs that follow
+    // must not eat into the bias either
+    PyObject *obj = eval("'immortal' + str(1)");
+    CPyTagged num = eval_int("2**100");
+    PyObject *objs[] = {obj, CPyTagged_LongAsObject(num)};
+    for (PyObject *o : objs) {
+        o->ob_refcnt += CPY_IMMORTAL_REFCNT_BIAS;
+    }
+    Py_ssize_t refcnt = Py_REFCNT(obj);
+    Py_ssize_t num_refcnt = Py_REFCNT(objs[1]);
+    for (int i = 0; i < 1000; i++) {
+        CPy_DECREF(obj);
+        CPy_XDECREF(obj);
+        CPyTagged_DecRef(num);
+        CPyTagged_XDecRef(num);
+        CPy_INCREF(obj);
+        CPyTagged_IncRef(num);
+    }
+    EXPECT_EQ(Py_REFCNT(obj), refcnt);
+    EXPECT_EQ(Py_REFCNT(objs[1]), num_refcnt);
+    for (PyObject *o : objs) {
+        o->ob_refcnt -= CPY_IMMORTAL_REFCNT_BIAS;
+    }
+    // Other objects are counted as usual
+    refcnt = Py_REFCNT(obj);
+    CPy_INCREF(obj);
+    EXPECT_EQ(Py_REFCNT(obj), refcnt + 1);
+    CPy_DECREF(obj);
+    EXPECT_EQ(Py_REFCNT(obj), refcnt);
+    Py_DECREF(obj);
+    CPyTagged_DecRef(num);
+#endif
+}
+
+TEST_F(CAPITest, test_import_profile) {
+    // Recording is enabled by the environment variable at first use
+    PyObject *path = eval("__import__('os').path.join(__import__('tempfile').gettempdir(), "
+                          "'mypyc_test_import_profile.json')");
+    PyObject *key = eval("'MYPYC_IMPORT_PROFILE'");
+    PyObject *environ = eval("__import__('os').environ");
+    ASSERT_EQ(PyObject_SetItem(environ, key, path), 0);
+    CPyImportProfileMark mark;
+    CPyImportProfile_Start(&mark);
+    EXPECT_GE(mark.start, 0);
+    PyObject *obj = eval("[object() for i in range(100)]");
+    CPyImportProfile_End(&mark, "test", "\"quoted\"");
+    Py_DECREF(obj);
+    ASSERT_EQ(PyObject_DelItem(environ, key), 0);
+}
+
+TEST_F(CAPITest, test_type_from_templates) {
+    static PyTypeObject template_a, template_b;
+    template_a.tp_name = "A";
+    template_b.tp_name = "B";
+    for (PyTypeObject *t : {&template_a, &template_b}) {
+        t->tp_basicsize = sizeof(PyObject);
+        t->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HEAPTYPE | Py_TPFLAGS_BASETYPE;
+    }
+    static PyTypeObject *type_a, *type_b;
+    static const CPyType_Template templates[] = {{&type_a, &template_a}, {&type_b, &template_b}};
+    PyObject *modname = eval("'mod'");
+    ASSERT_EQ(CPyType_FromTemplates(templates, 2, modname), 0);
+    EXPECT_TRUE(is_py_equal(PyObject_GetAttrString((PyObject *)type_a, "__qualname__"),
+                            eval("'A'")));
+    EXPECT_TRUE(is_py_equal(PyObject_GetAttrString((PyObject *)type_b, "__module__"), modname));
+    EXPECT_EQ(type_b->tp_base, &PyBaseObject_Type);
+
+    // A custom __init_subclass__ of a base is still called
+    PyObject *bases = eval("(type('I', (), {'__init_subclass__': "
+                           "classmethod(lambda cls: setattr(cls, 'hit', 1))}),)");
+    PyObject *t = CPyType_FromTemplate((PyObject *)&template_a, bases, modname);
+    ASSERT_NE(t, nullptr);
+    EXPECT_TRUE(PyObject_HasAttrString(t, "hit"));
+
+    // A base with a nonempty __slots__ is rejected
+    bases = eval("(type('S', (), {'__slots__': ('x',)}),)");
+    EXPECT_EQ(CPyType_FromTemplate((PyObject *)&template_a, bases, modname), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+    PyErr_Clear();
+}
+
+TEST_F(CAPITest, test_trait_cache) {
+    // Lay out a vtable whose trait section describes 16 traits, the way
+    // emitclass.py does: (trait, subvtable, offset table) triples sitting
+    // before the start of the vtable proper.
+    const int num_traits = 16;
+    PyTypeObject traits[num_traits];
+    CPyVTableItem subvtables[num_traits][1];
+    size_t offsets[num_traits][1];
+    CPyVTableItem table[num_traits * 3 + 1];
+    for (int i = 0; i < num_traits; i++) {
+        int j = (num_traits - 1 - i) * 3;
+        table[j] = (CPyVTableItem)&traits[i];
+        table[j + 1] = (CPyVTableItem)subvtables[i];
+        table[j + 2] = (CPyVTableItem)offsets[i];
+        offsets[i][0] = 100 + i;
+    }
+    CPyVTableItem *vtable = &table[num_traits * 3];
+
+    CPyTraitCache cache = {NULL, NULL};
+    PyTypeObject *last = &traits[num_traits - 1];
+    EXPECT_EQ(CPy_FindTraitVtableCached(last, vtable, &cache), subvtables[num_traits - 1]);
+    EXPECT_EQ(cache.vtable, vtable);
+    EXPECT_EQ(cache.entry, &table[0]);
+    // A hit returns the cached entry without scanning
+    EXPECT_EQ(CPy_FindAttrOffsetCached(last, vtable, 0, &cache), (size_t)(100 + num_traits - 1));
+    EXPECT_EQ(CPy_FindAttrOffset(&traits[3], vtable, 0), (size_t)103);
+
+    // A different receiver class replaces the entry
+    CPyVTableItem other[4] = {(CPyVTableItem)last, (CPyVTableItem)subvtables[0],
+                              (CPyVTableItem)offsets[5], NULL};
+    EXPECT_EQ(CPy_FindAttrOffsetCached(last, &other[3], 0, &cache), (size_t)105);
+    EXPECT_EQ(cache.vtable, &other[3]);
+    EXPECT_EQ(CPy_FindTraitVtableCached(last, vtable, &cache), subvtables[num_traits - 1]);
+}
+
+TEST_F(CAPITest, test_free_list) {
+    CPyFreeListStats stats;
+    CPyFreeList_Clear();
+    PyTypeObject *type = (PyTypeObject *)eval("type('F', (), {'__slots__': ('a', 'b')})");
+    ASSERT_NE(type, nullptr);
+
+    PyObject *obj = CPyFreeList_Alloc(type);
+    ASSERT_NE(obj, nullptr);
+    // Release it the way the dealloc function of a native class does
+    PyObject_GC_UnTrack(obj);
+    CPyFreeList_Free(obj);
+    Py_DECREF(type);
+    CPyFreeList_GetStats(&stats);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.frees, 1u);
+    EXPECT_EQ(stats.bytes, (size_t)type->tp_basicsize);
+
+    // The next instance of the same size reuses the memory
+    PyObject *obj2 = CPyFreeList_Alloc(type);
+    EXPECT_EQ(obj2, obj);
+    EXPECT_EQ(Py_REFCNT(obj2), 1);
+    EXPECT_EQ(Py_TYPE(obj2), type);
+    EXPECT_TRUE(PyObject_IS_GC(obj2));
+    CPyFreeList_GetStats(&stats);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.bytes, 0u);
+    Py_DECREF(obj2);
+
+    // Instances of other sizes don't share the memory
+    obj = CPyFreeList_Alloc(type);
+    PyObject_GC_UnTrack(obj);
+    CPyFreeList_Free(obj);
+    Py_DECREF(type);
+    PyTypeObject *other = (PyTypeObject *)eval("type('G', (), {'__slots__': ('a', 'b', 'c')})");
+    ASSERT_NE(other, nullptr);
+    PyObject *obj3 = CPyFreeList_Alloc(other);
+    EXPECT_NE(obj3, obj);
+    CPyFreeList_GetStats(&stats);
+    EXPECT_EQ(stats.misses, 3u);
+    EXPECT_EQ(stats.bytes, (size_t)type->tp_basicsize);
+    Py_DECREF(obj3);
+    CPyFreeList_Clear();
+}
+
+TEST_F(CAPITest, test_dispatch_profile_record) {
+    CPyDispatchSite site = {{NULL}, {0}, 0};
+    PyObject *values[] = {
+        PyLong_FromLong(1), PyUnicode_FromString("x"), PyLong_FromLong(2),
+        PyFloat_FromDouble(1.0), PyTuple_New(0), PyList_New(0), PyDict_New(),
+    };
+    for (PyObject *value : values) {
+        ASSERT_NE(value, nullptr);
+        CPyDispatchProfile_Record(&site, value);
+    }
+    EXPECT_EQ(site.types[0], &PyLong_Type);
+    EXPECT_EQ(site.counts[0], 2u);
+    EXPECT_EQ(site.types[1], &PyUnicode_Type);
+    EXPECT_EQ(site.types[3], &PyTuple_Type);
+    EXPECT_EQ(site.counts[3], 1u);
+    // Types that don't fit in the table are only counted
+    EXPECT_EQ(site.other, 2u);
+    for (PyObject *value : values) {
+        Py_DECREF(value);
+    }
+    for (int i = 0; i < CPY_DISPATCH_PROFILE_TYPES; i++) {
+        Py_DECREF(site.types[i]);
+    }
+}
+
+TEST_F(CAPITest, test_stats) {
+    CPyStats_Reset();
+    CPyTagged big = eval_int("2**70");
+    PyObject *obj = CPyTagged_AsObject(CPyTagged_ShortFromInt(5000));
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_int_box_short], 1u);
+    EXPECT_EQ(CPyTagged_FromObject(obj), CPyTagged_ShortFromInt(5000));
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_int_unbox_short], 1u);
+    CPy_DECREF(obj);
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_decref], 1u);
+    CPy_XDECREF(NULL);
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_decref], 1u);
+    CPyTagged_IncRef(big);
+    CPyTagged_DecRef(big);
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_int_incref], 1u);
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_int_decref], 1u);
+    CPyTagged r = CPyTagged_And(big, CPyTagged_ShortFromInt(-1));
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_int_bitwise_long], 1u);
+    EXPECT_TRUE(is_int_equal(r, big));
+    CPyTagged_DecRef(r);
+
+    PyObject *d = eval("{'x': 1}");
+    PyObject *dd = eval("__import__('collections').UserDict({'x': 1})");
+    PyObject *x = PyUnicode_FromString("x");
+    Py_XDECREF(CPyDict_GetItem(d, x));
+    Py_XDECREF(CPyDict_GetItem(dd, x));
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_dict_get_item_fast], 1u);
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_dict_get_item_slow], 1u);
+
+    // def f(a, *, b)
+    static const char * const kwlist[] = {"a", "b", 0};
+    static CPyArg_Descriptor desc = {kwlist, "f", 2, 1, 1, 1, 0, 0};
+    PyObject *args[] = {eval("1"), eval("2")};
+    PyObject *kwnames = eval("('b',)");
+    CPyArg_Slot slots[2];
+    ASSERT_TRUE(CPyArg_ParseStackAndKeywordsSlots(args, 1, kwnames, &desc, slots));
+    ASSERT_TRUE(CPyArg_ParseStackAndKeywordsSlots(args, 1, kwnames, &desc, slots));
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_arg_parser_init], 1u);
+
+    PyObject *stats = CPyStats_Get();
+    ASSERT_NE(stats, nullptr);
+    EXPECT_TRUE(is_py_equal(PyDict_GetItemString(stats, "dict_get_item_slow"), eval("1")));
+    EXPECT_EQ(PyDict_Size(stats), (Py_ssize_t)CPY_NUM_STATS);
+    Py_DECREF(stats);
+    CPyStats_Reset();
+    EXPECT_EQ(CPyStats_Counters[CPY_STAT_int_box_short], 0u);
+    Py_DECREF(x);
+    CPyTagged_DecRef(big);
+}
+
+TEST_F(CAPITest, test_attr_profile) {
+    static CPyInlineCache caches[2];
+    static const char * const names[2] = {"mod:1", "mod:2"};
+    // Profiling is enabled by the first registration, and the dump at exit is discarded
+    setenv("MYPYC_ATTR_PROFILE", "/dev/null", 1);
+    ASSERT_EQ(CPyAttrProfile_Register(caches, names, 2), 0);
+    unsetenv("MYPYC_ATTR_PROFILE");
+    CPyAttrProfile_Reset();
+
+    PyObject *obj = eval("1");
+    PyObject *attr = PyUnicode_FromString("real");
+    for (int i = 0; i < 3; i++) {
+        CPyAttrProfile_Record(&caches[1], obj, attr);
+    }
+    Py_XDECREF(CPyObject_GetAttr(obj, attr));
+    PyObject *counts = CPyAttrProfile_Get();
+    ASSERT_NE(counts, nullptr);
+    PyObject *key = Py_BuildValue("(ssO)", "mod:2", "builtins.int", attr);
+    EXPECT_TRUE(is_py_equal(PyDict_GetItem(counts, key), eval("3")));
+    Py_DECREF(key);
+    key = Py_BuildValue("(ssO)", "*", "builtins.int", attr);
+    EXPECT_TRUE(is_py_equal(PyDict_GetItem(counts, key), eval("1")));
+    Py_DECREF(key);
+    Py_DECREF(counts);
+
+    CPyAttrProfile_Reset();
+    counts = CPyAttrProfile_Get();
+    EXPECT_EQ(PyDict_Size(counts), 0);
+    Py_DECREF(counts);
+    Py_DECREF(attr);
+    Py_DECREF(obj);
+}
+
+TEST_F(CAPITest, test_bytes_ops) {
+    PyObject *b = eval("b'ab\\xff'");
+    PyObject *ba = eval("bytearray(b'xyz')");
+    PyObject *mv = eval("memoryview(b'mv')");
+    EXPECT_TRUE(CPyBytes_Check(b) && CPyBytes_Check(ba) && CPyBytes_Check(mv));
+    EXPECT_FALSE(CPyBytes_Check(eval("'ab'")));
+    EXPECT_EQ(CPyBytes_Size(b), 3);
+    EXPECT_EQ(CPyBytes_Size(mv), 2);
+
+    EXPECT_EQ(CPyBytes_GetItem(b, CPyTagged_ShortFromSsize_t(-1)),
+              CPyTagged_ShortFromSsize_t(0xff));
+    EXPECT_EQ(CPyBytes_GetItem(ba, CPyTagged_ShortFromSsize_t(0)),
+              CPyTagged_ShortFromSsize_t('x'));
+    EXPECT_EQ(CPyBytes_GetItem(mv, CPyTagged_ShortFromSsize_t(1)),
+              CPyTagged_ShortFromSsize_t('v'));
+    EXPECT_EQ(CPyBytes_GetItem(b, CPyTagged_ShortFromSsize_t(3)), CPY_INT_TAG);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_IndexError));
+    PyErr_Clear();
+
+    CPyTagged one = CPyTagged_ShortFromSsize_t(1);
+    CPyTagged big = CPyTagged_ShortFromSsize_t(CPY_TAGGED_MAX);
+    EXPECT_TRUE(is_py_equal(CPyBytes_GetSlice(b, one, big), eval("b'b\\xff'")));
+    EXPECT_EQ(CPyBytes_GetSlice(b, CPyTagged_ShortFromSsize_t(0), big), b);
+    EXPECT_TRUE(is_py_equal(CPyBytes_GetSlice(ba, one, big), eval("bytearray(b'yz')")));
+
+    EXPECT_TRUE(is_py_equal(CPyBytes_Concat(b, ba), eval("b'ab\\xffxyz'")));
+    EXPECT_TRUE(is_py_equal(CPyBytes_Concat(b, mv), eval("b'ab\\xffmv'")));
+    EXPECT_TRUE(is_py_equal(CPyBytes_Concat(ba, b), eval("bytearray(b'xyzab\\xff')")));
+    EXPECT_TRUE(CPyBytes_Concat(b, eval("'s'")) == NULL);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+    PyErr_Clear();
+    EXPECT_TRUE(is_py_equal(CPyBytes_Join(eval("b','"), eval("[b'a', bytearray(b'b')]")),
+                            eval("b'a,b'")));
+    EXPECT_TRUE(is_py_equal(CPyBytes_Join(ba, eval("[b'a', b'b']")),
+                            eval("bytearray(b'axyzb')")));
+
+    EXPECT_EQ(CPyBytes_Startswith(b, eval("b'ab'")), 1);
+    EXPECT_EQ(CPyBytes_Startswith(ba, eval("b'xyzw'")), 0);
+    EXPECT_EQ(CPyBytes_Endswith(ba, mv), 0);
+    EXPECT_EQ(CPyBytes_Endswith(mv, eval("b'v'")), -1);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_AttributeError));
+    PyErr_Clear();
+
+    PyObject *s = CPyBytes_Decode(eval("b'ascii only text'"), NULL, NULL);
+    EXPECT_TRUE(is_py_equal(s, eval("'ascii only text'")));
+    EXPECT_EQ(CPyBytes_Decode(eval("b'a'"), eval("'latin-1'"), NULL), CPyStr_FromChar('a'));
+    s = CPyBytes_Decode(eval("b'\\xe2\\x82\\xac'"), NULL, NULL);
+    EXPECT_TRUE(is_py_equal(s, eval("'\\u20ac'")));
+    s = CPyBytes_Decode(b, eval("'ascii'"), eval("'replace'"));
+    EXPECT_TRUE(is_py_equal(s, eval("'ab\\ufffd'")));
+    EXPECT_TRUE(CPyBytes_Decode(b, NULL, NULL) == NULL);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_UnicodeDecodeError));
+    PyErr_Clear();
+    s = CPyBytes_Decode(eval("b'\\x00\\x41'"), eval("'utf-16-be'"), NULL);
+    EXPECT_TRUE(is_py_equal(s, eval("'A'")));
+}
+
+TEST_F(CAPITest, test_list_sort) {
+    // Enough items to need merging, including ints outside the long long range
+    PyObject *l = eval("[(i * 7919) % 1009 - 500 for i in range(1009)] + [2**70, -2**70]");
+    EXPECT_EQ(CPyList_Sort(l), 0);
+    EXPECT_TRUE(is_py_equal(l, eval("[-2**70] + list(range(-500, 509)) + [2**70]")));
+    l = eval("['b\\xe9', 'ba', 'b', '', 'a' * 40]");
+    EXPECT_EQ(CPyList_Sort(l), 0);
+    EXPECT_TRUE(is_py_equal(l, eval("['', 'a' * 40, 'b', 'ba', 'b\\xe9']")));
+    l = eval("[(1, 'b'), (0, 'x', 1), (1, 'a'), (0, 'x')]");
+    EXPECT_EQ(CPyList_Sort(l), 0);
+    EXPECT_TRUE(is_py_equal(l, eval("[(0, 'x'), (0, 'x', 1), (1, 'a'), (1, 'b')]")));
+    // Reverse sorts are stable
+    l = eval("[(i % 5, i) for i in range(100)]");
+    EXPECT_EQ(CPyList_SortKey(l, eval("lambda t: t[0]"), true), 0);
+    EXPECT_TRUE(is_py_equal(l, eval("sorted([(i % 5, i) for i in range(100)], "
+                                    "key=lambda t: t[0], reverse=True)")));
+    // Keys without a specialized comparison are sorted by list.sort()
+    l = eval("[(i * 7919) % 1009 / 2 for i in range(1009)]");
+    EXPECT_EQ(CPyList_Sort(l), 0);
+    EXPECT_TRUE(is_py_equal(l, eval("[i / 2 for i in range(1009)]")));
+    l = eval("[(i % 5, i) for i in range(100)]");
+    PyObject *calls = eval("[]");
+    PyObject *key = eval("lambda calls: lambda t: calls.append(t) or t[0] / 2");
+    EXPECT_EQ(CPyList_SortKey(l, PyObject_CallFunctionObjArgs(key, calls, NULL), true), 0);
+    EXPECT_TRUE(is_py_equal(l, eval("sorted([(i % 5, i) for i in range(100)], "
+                                    "key=lambda t: t[0], reverse=True)")));
+    EXPECT_EQ(PyList_GET_SIZE(calls), 100);
+    PyObject *r = CPyList_Sorted(eval("'cab'"), Py_None, false);
+    EXPECT_TRUE(is_py_equal(r, eval("['a', 'b', 'c']")));
+    l = eval("[1, None]");
+    EXPECT_EQ(CPyList_Sort(l), -1);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+    PyErr_Clear();
+    EXPECT_TRUE(is_py_equal(l, eval("[1, None]")));
+}
+
+TEST_F(CAPITest, test_dict_build) {
+    PyObject *items[] = {eval("'a'"), eval("1"), eval("(2, 3)"), eval("None"),
+                         eval("'a'"), eval("4")};
+    PyObject *d = CPyDict_BuildArray(3, items);
+    EXPECT_TRUE(is_py_equal(d, eval("{'a': 4, (2, 3): None}")));
+    items[2] = eval("[]");
+    EXPECT_TRUE(CPyDict_BuildArray(2, items) == NULL);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+    PyErr_Clear();
+
+    // Use enough different key tuples to grow the template table
+    PyObject *keys = eval("[('x', 'k%d' % i) for i in range(100)]");
+    PyObject *values[] = {eval("1"), eval("2")};
+    Py_ssize_t i;
+    int round;
+    for (round = 0; round < 2; round++) {
+        for (i = 0; i < 100; i++) {
+            d = CPyDict_FromTemplate(PyList_GET_ITEM(keys, i), values);
+            ASSERT_TRUE(d != NULL);
+            EXPECT_EQ(PyDict_Size(d), 2);
+            EXPECT_EQ(PyDict_GetItem(d, eval("'x'")), values[0]);
+            EXPECT_EQ(PyDict_GetItem(d, PyTuple_GET_ITEM(PyList_GET_ITEM(keys, i), 1)),
+                      values[1]);
+            Py_DECREF(d);
+        }
+    }
+    // Duplicate keys keep the last value
+    d = CPyDict_FromTemplate(eval("('a', 'a')"), values);
+    EXPECT_TRUE(is_py_equal(d, eval("{'a': 2}")));
+}
+
+TEST_F(CAPITest, test_dict_known_hash) {
+    PyObject *key = eval("'known'");
+    PyObject *other = eval("'other'");
+    PyObject *one = eval("1");
+    PyObject *d = eval("{'x': 0}");
+    PyObject *sub = eval("__import__('collections').OrderedDict()");
+    PyObject *dicts[] = {d, sub};
+    for (PyObject *dict : dicts) {
+        EXPECT_EQ(CPyDict_ContainsKnownHash(dict, key), 0);
+        EXPECT_TRUE(CPyDict_GetItemKnownHash(dict, key) == NULL);
+        EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_KeyError));
+        PyErr_Clear();
+        EXPECT_EQ(CPyDict_GetWithNoneKnownHash(dict, key), Py_None);
+        EXPECT_EQ(CPyDict_SetItemKnownHash(dict, key, one), 0);
+        EXPECT_EQ(CPyDict_ContainsKnownHash(dict, key), 1);
+        EXPECT_EQ(CPyDict_GetItemKnownHash(dict, key), one);
+        EXPECT_EQ(CPyDict_GetKnownHash(dict, key, Py_None), one);
+        EXPECT_EQ(CPyDict_SetDefaultKnownHash(dict, key, Py_None), one);
+        EXPECT_EQ(CPyDict_SetDefaultWithNoneKnownHash(dict, other), Py_None);
+        EXPECT_EQ(PyDict_GetItem(dict, other), Py_None);
+    }
+    EXPECT_TRUE(is_py_equal(d, eval("{'x': 0, 'known': 1, 'other': None}")));
+}
+
+TEST_F(CAPITest, test_dict_next_batch) {
+    PyObject *d = eval("{i: str(i) for i in range(10)}");
+    PyObject *sub = eval("__import__('collections').OrderedDict((i, str(i)) for i in range(10))");
+    PyObject *dicts[] = {d, sub};
+    int kinds[] = {CPY_DICT_BATCH_KEYS, CPY_DICT_BATCH_ITEMS | CPY_DICT_BATCH_BORROWED};
+    for (PyObject *dict : dicts) {
+        for (int kind : kinds) {
+            PyObject *iter = CPyDict_GetBatchIter(dict, kind);
+            ASSERT_TRUE(iter != NULL);
+            PyObject *buf[8];
+            PyObject *seen = PyList_New(0);
+            CPyTagged offset = 0;
+            tuple_T2II batch;
+            do {
+                batch = CPyDict_NextBatch(iter, offset, buf, 4, kind);
+                ASSERT_NE(batch.f0, CPY_INT_TAG);
+                offset = batch.f1;
+                Py_ssize_t count = CPyTagged_ShortAsSsize_t(batch.f0);
+                EXPECT_LE(count, kind & CPY_DICT_BATCH_VALUES ? 8 : 4);
+                for (Py_ssize_t i = 0; i < count; i++) {
+                    PyList_Append(seen, buf[i]);
+                    if (!(kind & CPY_DICT_BATCH_BORROWED)) {
+                        Py_DECREF(buf[i]);
+                    }
+                }
+            } while (batch.f0 != 0);
+            if (kind & CPY_DICT_BATCH_VALUES) {
+                EXPECT_TRUE(is_py_equal(seen, eval("sum(([i, str(i)] for i in range(10)), [])")));
+            } else {
+                EXPECT_TRUE(is_py_equal(seen, eval("list(range(10))")));
+            }
+            Py_DECREF(seen);
+            Py_DECREF(iter);
+        }
+    }
+    // Replacing a value asks for a refetch, only a size change is an error
+    uint64_t version = CPyDict_Version(d);
+    CPyTagged size = CPyTagged_FromSsize_t(PyDict_Size(d));
+    EXPECT_EQ(CPyDict_CheckBatch(d, size, version), 0);
+    PyDict_SetItem(d, eval("1"), Py_None);
+    EXPECT_EQ(CPyDict_CheckBatch(d, size, version), 1);
+    EXPECT_FALSE(PyErr_Occurred());
+    PyDict_SetItem(d, eval("10"), Py_None);
+    EXPECT_EQ(CPyDict_CheckBatch(d, size, version), -1);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_RuntimeError));
+    PyErr_Clear();
+    EXPECT_EQ(CPyDict_CheckBatch(sub, size, CPyDict_Version(sub)), 0);
+    // Resuming after the first three keys, or after two items (four objects)
+    PyObject *buf[1];
+    CPyTagged pos = CPyTagged_FromSsize_t(3);
+    CPyTagged offset = CPyDict_BatchOffset(d, 0, pos, CPY_DICT_BATCH_KEYS);
+    tuple_T2II batch = CPyDict_NextBatch(d, offset, buf, 1, CPY_DICT_BATCH_KEYS);
+    EXPECT_EQ(batch.f0, CPyTagged_FromSsize_t(1));
+    EXPECT_TRUE(is_py_equal(buf[0], eval("3")));
+    Py_DECREF(buf[0]);
+    pos = CPyTagged_FromSsize_t(4);
+    offset = CPyDict_BatchOffset(d, 0, pos, CPY_DICT_BATCH_ITEMS);
+    batch = CPyDict_NextBatch(d, offset, buf, 1, CPY_DICT_BATCH_KEYS);
+    EXPECT_EQ(batch.f0, CPyTagged_FromSsize_t(1));
+    EXPECT_TRUE(is_py_equal(buf[0], eval("2")));
+    Py_DECREF(buf[0]);
+    EXPECT_EQ(CPyDict_BatchOffset(sub, offset, pos, CPY_DICT_BATCH_ITEMS), offset);
+}
+
+TEST_F(CAPITest, test_dict_items_flat_and_view_contains) {
+    PyObject *d = eval("{1: 'a', 2: 'b', 3: [4]}");
+    PyObject *sub = eval("__import__('collections').OrderedDict([(1, 'a'), (2, 'b'), (3, [4])])");
+    PyObject *dicts[] = {d, sub};
+    for (PyObject *dict : dicts) {
+        PyObject *flat = CPyDict_ItemsFlat(dict);
+        ASSERT_TRUE(flat != NULL);
+        EXPECT_TRUE(is_py_equal(flat, eval("[1, 'a', 2, 'b', 3, [4]]")));
+        Py_DECREF(flat);
+
+        EXPECT_EQ(CPyDict_ViewContains(dict, eval("2"), CPY_DICT_BATCH_KEYS), 1);
+        EXPECT_EQ(CPyDict_ViewContains(dict, eval("'a'"), CPY_DICT_BATCH_KEYS), 0);
+        EXPECT_EQ(CPyDict_ViewContains(dict, eval("[4]"), CPY_DICT_BATCH_VALUES), 1);
+        EXPECT_EQ(CPyDict_ViewContains(dict, eval("'c'"), CPY_DICT_BATCH_VALUES), 0);
+        EXPECT_EQ(CPyDict_ViewContains(dict, eval("(2, 'b')"), CPY_DICT_BATCH_ITEMS), 1);
+        EXPECT_EQ(CPyDict_ViewContains(dict, eval("(2, 'a')"), CPY_DICT_BATCH_ITEMS), 0);
+        EXPECT_EQ(CPyDict_ViewContains(dict, eval("2"), CPY_DICT_BATCH_ITEMS), 0);
+        EXPECT_FALSE(PyErr_Occurred());
+        // Keys must be hashable
+        EXPECT_EQ(CPyDict_ViewContains(dict, eval("[]"), CPY_DICT_BATCH_KEYS), -1);
+        EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+        PyErr_Clear();
+
+        EXPECT_EQ(CPyDict_ViewLen(dict, CPY_DICT_BATCH_VALUES), 3);
+    }
+    // Overridden view methods are called
+    PyObject *custom = eval("type('D', (dict,), {'keys': lambda self: [5]})({1: 2, 3: 4})");
+    EXPECT_EQ(CPyDict_ViewLen(custom, CPY_DICT_BATCH_KEYS), 1);
+    EXPECT_EQ(CPyDict_ViewLen(custom, CPY_DICT_BATCH_ITEMS), 2);
+    EXPECT_EQ(CPyDict_ViewContains(custom, eval("5"), CPY_DICT_BATCH_KEYS), 1);
+}
+
+TEST_F(CAPITest, test_dict_stdlib_subclasses) {
+    PyObject *dd = eval("__import__('collections').defaultdict(list, {1: [2]})");
+    PyObject *key = eval("1");
+    PyObject *missing = eval("3");
+    PyObject *res = CPyDict_GetItem(dd, key);
+    EXPECT_TRUE(is_py_equal(res, eval("[2]")));
+    Py_DECREF(res);
+    res = CPyDict_GetItem(dd, missing);
+    EXPECT_TRUE(is_py_equal(res, eval("[]")));
+    // The default value is inserted
+    EXPECT_EQ(PyDict_GetItem(dd, missing), res);
+    Py_DECREF(res);
+    // Iteration uses the dict directly
+    PyObject *iter = CPyDict_GetKeysIter(dd);
+    EXPECT_EQ(iter, dd);
+    tuple_T3CIO next = CPyDict_NextKey(iter, 0);
+    EXPECT_TRUE(next.f0);
+    EXPECT_TRUE(is_py_equal(next.f2, key));
+    Py_DECREF(next.f2);
+    Py_DECREF(iter);
+
+    PyObject *no_factory = eval("__import__('collections').defaultdict()");
+    EXPECT_EQ(CPyDict_GetItem(no_factory, missing), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_KeyError));
+    PyErr_Clear();
+
+    PyObject *counter = eval("__import__('collections').Counter('aab')");
+    res = CPyDict_GetItemKnownHash(counter, eval("'a'"));
+    EXPECT_TRUE(is_py_equal(res, eval("2")));
+    Py_DECREF(res);
+    res = CPyDict_GetItem(counter, missing);
+    EXPECT_TRUE(is_py_equal(res, eval("0")));
+    Py_DECREF(res);
+    // The missing key is not inserted
+    EXPECT_EQ(PyDict_Size(counter), 2);
+    EXPECT_EQ(CPyDict_GetItemsIter(counter), counter);
+    Py_DECREF(counter);
+
+    PyObject *od = eval("__import__('collections').OrderedDict({1: 2})");
+    EXPECT_EQ(CPyDict_GetItem(od, missing), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_KeyError));
+    PyErr_Clear();
+    // OrderedDict has its own iteration order
+    iter = CPyDict_GetKeysIter(od);
+    EXPECT_NE(iter, od);
+    Py_DECREF(iter);
+
+    // Subclasses of the stdlib subclasses use the generic paths
+    PyObject *sub = eval("type('C', (__import__('collections').Counter,),"
+                         " {'__missing__': lambda self, k: 'custom'})()");
+    res = CPyDict_GetItem(sub, missing);
+    EXPECT_TRUE(is_py_equal(res, eval("'custom'")));
+    Py_DECREF(res);
+}
+
+TEST_F(CAPITest, test_inline_cache) {
+    PyObject *cls = eval("type('C', (), {'x': 1, 'f': lambda self, n=0: n + 5,"
+                         " 'p': property(lambda self: 7)})");
+    PyObject *obj = PyObject_CallObject(cls, NULL);
+    PyObject *x = eval("'x'");
+    PyObject *f = eval("'f'");
+    PyObject *p = eval("'p'");
+    CPyInlineCache cache = {};
+    for (int i = 0; i < 2; i++) {
+        PyObject *res = CPyObject_GetAttrCached(obj, x, &cache);
+        EXPECT_TRUE(is_py_equal(res, eval("1")));
+        Py_DECREF(res);
+        EXPECT_EQ(cache.owner, (void *)Py_TYPE(obj));
+    }
+    // Instance attributes take precedence
+    PyObject_SetAttr(obj, x, eval("2"));
+    PyObject *res = CPyObject_GetAttrCached(obj, x, &cache);
+    EXPECT_TRUE(is_py_equal(res, eval("2")));
+    Py_DECREF(res);
+    // Modifying the class invalidates the cache
+    PyObject_DelAttr(obj, x);
+    PyObject_SetAttr(cls, x, eval("3"));
+    res = CPyObject_GetAttrCached(obj, x, &cache);
+    EXPECT_TRUE(is_py_equal(res, eval("3")));
+    Py_DECREF(res);
+    // Data descriptors take precedence over instance attributes
+    PyObject_SetAttr(cls, x, eval("property(lambda self: 4)"));
+    PyObject *obj_dict = PyObject_GetAttrString(obj, "__dict__");
+    PyDict_SetItem(obj_dict, x, eval("5"));
+    Py_DECREF(obj_dict);
+    res = CPyObject_GetAttrCached(obj, x, &cache);
+    EXPECT_TRUE(is_py_equal(res, eval("4")));
+    Py_DECREF(res);
+
+    CPyInlineCache cache2 = {};
+    res = CPyObject_GetAttrCached(obj, p, &cache2);
+    EXPECT_TRUE(is_py_equal(res, eval("7")));
+    Py_DECREF(res);
+    // Each cache is only used with a single attribute name
+    CPyInlineCache missing_cache = {};
+    EXPECT_EQ(CPyObject_GetAttrCached(obj, eval("'missing'"), &missing_cache), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_AttributeError));
+    PyErr_Clear();
+
+    CPyInlineCache cache3 = {};
+    for (int i = 0; i < 2; i++) {
+        res = CPyObject_CallMethodCached(obj, f, &cache3, NULL);
+        EXPECT_TRUE(is_py_equal(res, eval("5")));
+        Py_DECREF(res);
+        res = CPyObject_CallMethodCached(obj, f, &cache3, eval("1"), NULL);
+        EXPECT_TRUE(is_py_equal(res, eval("6")));
+        Py_DECREF(res);
+    }
+    // Instance attributes also take precedence for methods
+    PyObject_SetAttr(obj, f, eval("lambda n: n + 10"));
+    res = CPyObject_CallMethodCached(obj, f, &cache3, eval("1"), NULL);
+    EXPECT_TRUE(is_py_equal(res, eval("11")));
+    Py_DECREF(res);
+    Py_DECREF(obj);
+
+    PyObject *mod = PyImport_ImportModule("string");
+    PyObject *name = eval("'digits'");
+    CPyInlineCache cache4 = {};
+    for (int i = 0; i < 2; i++) {
+        res = CPyObject_GetAttrCached(mod, name, &cache4);
+        EXPECT_TRUE(is_py_equal(res, eval("'0123456789'")));
+        Py_DECREF(res);
+    }
+    EXPECT_NE(cache4.owner, nullptr);
+    PyObject *old = PyObject_GetAttr(mod, name);
+    PyObject_SetAttr(mod, name, eval("'x'"));
+    res = CPyObject_GetAttrCached(mod, name, &cache4);
+    EXPECT_TRUE(is_py_equal(res, eval("'x'")));
+    Py_DECREF(res);
+    PyObject_SetAttr(mod, name, old);
+    Py_DECREF(old);
+    Py_DECREF(mod);
+
+    PyObject *d = eval("{'a': 1}");
+    PyObject *a = eval("'a'");
+    CPyInlineCache cache5 = {};
+    for (int i = 0; i < 2; i++) {
+        res = CPyDict_GetItemCached(d, a, &cache5);
+        EXPECT_TRUE(is_py_equal(res, eval("1")));
+        Py_DECREF(res);
+    }
+    PyDict_SetItem(d, a, eval("2"));
+    res = CPyDict_GetItemCached(d, a, &cache5);
+    EXPECT_TRUE(is_py_equal(res, eval("2")));
+    Py_DECREF(res);
+    PyDict_DelItem(d, a);
+    EXPECT_EQ(CPyDict_GetItemCached(d, a, &cache5), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_KeyError));
+    PyErr_Clear();
+}
+
+TEST_F(CAPITest, test_native_hash_and_id) {
+    PyObject *s = eval("'hash me'");
+    EXPECT_EQ(CPyObject_HashNative(s), PyObject_Hash(s));
+    // Now the hash is cached
+    EXPECT_EQ(CPyObject_HashNative(s), PyObject_Hash(s));
+    PyObject *big = eval("2**63 + 5");
+    EXPECT_EQ(CPyObject_HashNative(big), PyObject_Hash(big));
+    EXPECT_EQ(CPyObject_HashNative(eval("-1")), -2);
+
+    EXPECT_EQ(CPyObject_HashNative(eval("[]")), -1);
+    EXPECT_TRUE(PyErr_Occurred());
+    PyErr_Clear();
+
+    EXPECT_EQ(CPyObject_IdNative(s), (Py_ssize_t)s);
+    EXPECT_EQ(CPyTagged_AsSsize_t(CPyTagged_Id(s)), (Py_ssize_t)s);
+}
+
+#define EXPECT_NATIVE_INT_ERROR(expr, exc) do { \
+    EXPECT_EQ(expr, CPY_LL_INT_ERROR); \
+    EXPECT_TRUE(PyErr_ExceptionMatches(exc)); \
+    PyErr_Clear(); \
+} while (0)
+
+TEST_F(CAPITest, test_int64_arithmetic) {
+    EXPECT_EQ(CPyInt64_Add(INT64_MAX - 1, 1), INT64_MAX);
+    EXPECT_NATIVE_INT_ERROR(CPyInt64_Add(INT64_MAX, 1), PyExc_OverflowError);
+    EXPECT_EQ(CPyInt64_Subtract(INT64_MIN + 1, 1), INT64_MIN);
+    EXPECT_NATIVE_INT_ERROR(CPyInt64_Subtract(INT64_MIN, 1), PyExc_OverflowError);
+    EXPECT_EQ(CPyInt64_Multiply(-(1LL << 31), 1LL << 32), INT64_MIN);
+    EXPECT_NATIVE_INT_ERROR(CPyInt64_Multiply(1LL << 32, 1LL << 31), PyExc_OverflowError);
+    EXPECT_NATIVE_INT_ERROR(CPyInt64_Negate(INT64_MIN), PyExc_OverflowError);
+    EXPECT_EQ(CPyInt64_Negate(INT64_MAX), INT64_MIN + 1);
+    // An error value that is a valid result doesn't set an exception
+    EXPECT_EQ(CPyInt64_Add(-100, -13), CPY_LL_INT_ERROR);
+    EXPECT_FALSE(PyErr_Occurred());
+
+    EXPECT_EQ(CPyInt32_Add(INT32_MAX - 1, 1), INT32_MAX);
+    EXPECT_NATIVE_INT_ERROR(CPyInt32_Add(INT32_MAX, 1), PyExc_OverflowError);
+    EXPECT_NATIVE_INT_ERROR(CPyInt32_Subtract(INT32_MIN, 1), PyExc_OverflowError);
+    EXPECT_NATIVE_INT_ERROR(CPyInt32_Multiply(1 << 16, 1 << 15), PyExc_OverflowError);
+    EXPECT_NATIVE_INT_ERROR(CPyInt32_Negate(INT32_MIN), PyExc_OverflowError);
+}
+
+TEST_F(CAPITest, test_int64_divide_and_remainder) {
+    int64_t values[] = {0, 1, 2, 3, 7, -1, -2, -3, -7, INT64_MAX, INT64_MIN};
+    for (int64_t x : values) {
+        for (int64_t y : values) {
+            if (y == 0 || (x == INT64_MIN && y == -1)) {
+                continue;
+            }
+            std::string expr = "(" + std::to_string(x) + ", " + std::to_string(y) + ")";
+            EXPECT_TRUE(is_py_equal(CPyInt64_AsObject(CPyInt64_Divide(x, y)),
+                                    eval("int.__floordiv__" + expr))) << expr;
+            EXPECT_TRUE(is_py_equal(CPyInt64_AsObject(CPyInt64_Remainder(x, y)),
+                                    eval("int.__mod__" + expr))) << expr;
+        }
+    }
+    EXPECT_NATIVE_INT_ERROR(CPyInt64_Divide(1, 0), PyExc_ZeroDivisionError);
+    EXPECT_NATIVE_INT_ERROR(CPyInt64_Remainder(1, 0), PyExc_ZeroDivisionError);
+    EXPECT_NATIVE_INT_ERROR(CPyInt64_Divide(INT64_MIN, -1), PyExc_OverflowError);
+    EXPECT_EQ(CPyInt64_Remainder(INT64_MIN, -1), 0);
+
+    EXPECT_EQ(CPyInt32_Divide(-7, 2), -4);
+    EXPECT_EQ(CPyInt32_Remainder(-7, 2), 1);
+    EXPECT_EQ(CPyInt32_Remainder(7, -2), -1);
+    EXPECT_NATIVE_INT_ERROR(CPyInt32_Divide(INT32_MIN, -1), PyExc_OverflowError);
+    EXPECT_NATIVE_INT_ERROR(CPyInt32_Divide(1, 0), PyExc_ZeroDivisionError);
+}
+
+TEST_F(CAPITest, test_int64_conversions) {
+    EXPECT_EQ(CPyLong_AsInt64(eval("2**63 - 1")), INT64_MAX);
+    EXPECT_EQ(CPyLong_AsInt64(eval("-2**63")), INT64_MIN);
+    EXPECT_NATIVE_INT_ERROR(CPyLong_AsInt64(eval("2**63")), PyExc_OverflowError);
+    EXPECT_NATIVE_INT_ERROR(CPyLong_AsInt64(eval("1.5")), PyExc_TypeError);
+    EXPECT_EQ(CPyLong_AsInt32(eval("-2**31")), INT32_MIN);
+    EXPECT_NATIVE_INT_ERROR(CPyLong_AsInt32(eval("2**31")), PyExc_OverflowError);
+
+    EXPECT_EQ(CPyTagged_AsInt64(eval_int("-5")), -5);
+    EXPECT_EQ(CPyTagged_AsInt64(eval_int("2**62")), 1LL << 62);
+    EXPECT_NATIVE_INT_ERROR(CPyTagged_AsInt64(eval_int("2**64")), PyExc_OverflowError);
+    EXPECT_EQ(CPyTagged_AsInt32(eval_int("2**31 - 1")), INT32_MAX);
+    EXPECT_NATIVE_INT_ERROR(CPyTagged_AsInt32(eval_int("2**31")), PyExc_OverflowError);
+
+    EXPECT_INT_EQUAL(CPyTagged_FromInt64(INT64_MIN), eval_int("-2**63"));
+    EXPECT_INT_EQUAL(CPyTagged_FromInt64(INT64_MAX), eval_int("2**63 - 1"));
+    EXPECT_TRUE(CPyTagged_CheckShort(CPyTagged_FromInt64(-3)));
+    EXPECT_INT_EQUAL(CPyTagged_FromInt32(INT32_MIN), eval_int("-2**31"));
+    EXPECT_TRUE(is_py_equal(CPyInt64_AsObject(INT64_MIN), eval("-2**63")));
+    EXPECT_TRUE(is_py_equal(CPyInt32_AsObject(INT32_MAX), eval("2**31 - 1")));
+}
+
+TEST_F(CAPITest, test_int64_compare_tagged) {
+    EXPECT_EQ(CPyInt64_CompareTagged(3, eval_int("3")), 0);
+    EXPECT_EQ(CPyInt64_CompareTagged(2, eval_int("3")), -1);
+    EXPECT_EQ(CPyInt64_CompareTagged(INT64_MAX, eval_int("2**63 - 1")), 0);
+    EXPECT_EQ(CPyInt64_CompareTagged(INT64_MAX, eval_int("2**62")), 1);
+    EXPECT_EQ(CPyInt64_CompareTagged(INT64_MAX, eval_int("2**63")), -1);
+    EXPECT_EQ(CPyInt64_CompareTagged(INT64_MIN, eval_int("-2**63 - 1")), 1);
+    EXPECT_TRUE(CPyInt64_IsEqTagged(INT64_MIN, eval_int("-2**63")));
+    EXPECT_FALSE(CPyInt64_IsEqTagged(0, eval_int("2**64")));
+    EXPECT_TRUE(CPyInt64_IsLtTagged(-1, eval_int("0")));
+    EXPECT_TRUE(CPyInt64_IsLtTagged(INT64_MAX, eval_int("2**100")));
+    EXPECT_FALSE(CPyInt64_IsLtTagged(INT64_MIN, eval_int("-2**100")));
+}
+
+TEST_F(CAPITest, test_list_int64_index) {
+    auto l = empty_list();
+    list_append(l, "3");
+    list_append(l, "5");
+    EXPECT_TRUE(is_py_equal(CPyList_GetItemInt64(l, 1), eval("5")));
+    EXPECT_TRUE(is_py_equal(CPyList_GetItemInt64(l, -2), eval("3")));
+    EXPECT_EQ(CPyList_GetItemInt64(l, 2), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_IndexError));
+    PyErr_Clear();
+    EXPECT_EQ(CPyList_GetItemInt64(l, -3), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_IndexError));
+    PyErr_Clear();
+    EXPECT_EQ(CPyList_GetItemInt64(l, INT64_MIN), nullptr);
+    PyErr_Clear();
+
+    EXPECT_TRUE(CPyList_SetItemInt64(l, -1, eval("7")));
+    EXPECT_TRUE(is_py_equal(l, eval("[3, 7]")));
+    EXPECT_FALSE(CPyList_SetItemInt64(l, INT64_MAX, eval("7")));
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_IndexError));
+    PyErr_Clear();
+}
+
+TEST_F(CAPITest, test_borrowed_get_item) {
+    PyObject *l = eval("[object(), object()]");
+    PyObject *item = PyList_GET_ITEM(l, 1);
+    Py_ssize_t refcnt = Py_REFCNT(item);
+    EXPECT_EQ(CPyList_GetItemBorrow(l, CPyTagged_ShortFromSsize_t(1)), item);
+    EXPECT_EQ(CPyList_GetItemShortBorrow(l, CPyTagged_ShortFromSsize_t(-1)), item);
+    EXPECT_EQ(CPyList_GetItemUnsafeBorrow(l, CPyTagged_ShortFromSsize_t(1)), item);
+    EXPECT_EQ(Py_REFCNT(item), refcnt);
+    EXPECT_EQ(CPyList_GetItemShortBorrow(l, CPyTagged_ShortFromSsize_t(2)), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_IndexError));
+    PyErr_Clear();
+    EXPECT_EQ(CPyList_GetItemBorrow(l, CPyTagged_ShortFromSsize_t(-3)), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_IndexError));
+    PyErr_Clear();
+    // The owning variants still return new references
+    EXPECT_EQ(CPyList_GetItem(l, CPyTagged_ShortFromSsize_t(1)), item);
+    EXPECT_EQ(Py_REFCNT(item), refcnt + 1);
+    Py_DECREF(item);
+
+    PyObject *t = eval("(object(), object())");
+    item = PyTuple_GET_ITEM(t, 0);
+    refcnt = Py_REFCNT(item);
+    EXPECT_EQ(CPySequenceTuple_GetItemBorrow(t, CPyTagged_ShortFromSsize_t(-2)), item);
+    EXPECT_EQ(Py_REFCNT(item), refcnt);
+    EXPECT_EQ(CPySequenceTuple_GetItemBorrow(t, CPyTagged_ShortFromSsize_t(2)), nullptr);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_IndexError));
+    PyErr_Clear();
+    EXPECT_EQ(CPySequenceTuple_GetItem(t, CPyTagged_ShortFromSsize_t(0)), item);
+    EXPECT_EQ(Py_REFCNT(item), refcnt + 1);
+    Py_DECREF(item);
+}
+
+static bool is_float_result(double x, std::string expr) {
+    PyObject *obj = CPyFloat_AsObject(x);
+    std::string actual = str_from_object(obj);
+    std::string expected = str_from_object(eval(expr));
+    Py_DECREF(obj);
+    if (actual != expected) {
+        std::cout << "Expected " << expected << " for " << expr << " but got " << actual << "\n";
+    }
+    return actual == expected;
+}
+
+#define EXPECT_FLOAT_ERROR(expr, exc) do { \
+    EXPECT_EQ(expr, CPY_FLOAT_ERROR); \
+    EXPECT_TRUE(PyErr_ExceptionMatches(exc)); \
+    PyErr_Clear(); \
+} while (0)
+
+TEST_F(CAPITest, test_float_conversions) {
+    EXPECT_EQ(CPyFloat_FromObject(eval("1.5")), 1.5);
+    EXPECT_EQ(CPyFloat_FromObject(eval("-3")), -3.0);
+    EXPECT_EQ(CPyFloat_FromObject(eval("2**70")), 1180591620717411303424.0);
+    EXPECT_FLOAT_ERROR(CPyFloat_FromObject(eval("10**400")), PyExc_OverflowError);
+    EXPECT_FLOAT_ERROR(CPyFloat_FromObject(eval("'x'")), PyExc_TypeError);
+    EXPECT_EQ(CPyFloat_FromTagged(eval_int("-7")), -7.0);
+    EXPECT_EQ(CPyFloat_FromTagged(eval_int("2**64")), 18446744073709551616.0);
+    EXPECT_FLOAT_ERROR(CPyFloat_FromTagged(eval_int("10**400")), PyExc_OverflowError);
+
+    EXPECT_INT_EQUAL(CPyTagged_FromFloat(-2.5), eval_int("-2"));
+    EXPECT_INT_EQUAL(CPyTagged_FromFloat(1e20), eval_int("int(1e20)"));
+    EXPECT_INT_EQUAL(CPyTagged_FromFloat(-4611686018427387904.0), eval_int("-2**62"));
+    EXPECT_EQ(CPyTagged_FromFloat(Py_NAN), CPY_INT_TAG);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_ValueError));
+    PyErr_Clear();
+    EXPECT_EQ(CPyTagged_FromFloat(Py_HUGE_VAL), CPY_INT_TAG);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_OverflowError));
+    PyErr_Clear();
+
+    EXPECT_TRUE(CPyFloat_IsEqTagged(3.0, eval_int("3")));
+    EXPECT_FALSE(CPyFloat_IsEqTagged(3.5, eval_int("3")));
+    EXPECT_TRUE(CPyFloat_IsEqTagged(9007199254740992.0, eval_int("2**53 + 0")));
+    // The int isn't exactly representable as a float
+    EXPECT_FALSE(CPyFloat_IsEqTagged(9007199254740992.0, eval_int("2**53 + 1")));
+    EXPECT_TRUE(CPyFloat_IsEqTagged(1e30, eval_int("int(1e30)")));
+}
+
+TEST_F(CAPITest, test_float_division) {
+    const char *values[] = {"0.0", "-0.0", "1.0", "-1.0", "2.5", "-2.5", "7.0", "-7.0", "1e300",
+                            "0.1", "float('inf')", "float('-inf')"};
+    for (const char *xs : values) {
+        for (const char *ys : values) {
+            double x = CPyFloat_FromObject(eval(xs));
+            double y = CPyFloat_FromObject(eval(ys));
+            if (y == 0.0) {
+                continue;
+            }
+            std::string args = std::string("(") + xs + ", " + ys + ")";
+            EXPECT_TRUE(is_float_result(CPyFloat_TrueDivide(x, y), "float.__truediv__" + args));
+            EXPECT_TRUE(is_float_result(CPyFloat_FloorDivide(x, y), "float.__floordiv__" + args));
+            EXPECT_TRUE(is_float_result(CPyFloat_Remainder(x, y), "float.__mod__" + args));
+        }
+    }
+    EXPECT_FLOAT_ERROR(CPyFloat_TrueDivide(1.0, 0.0), PyExc_ZeroDivisionError);
+    EXPECT_FLOAT_ERROR(CPyFloat_FloorDivide(1.0, -0.0), PyExc_ZeroDivisionError);
+    EXPECT_FLOAT_ERROR(CPyFloat_Remainder(1.0, 0.0), PyExc_ZeroDivisionError);
+}
+
+TEST_F(CAPITest, test_float_math_functions) {
+    EXPECT_EQ(CPyFloat_Sqrt(2.25), 1.5);
+    EXPECT_FLOAT_ERROR(CPyFloat_Sqrt(-1.0), PyExc_ValueError);
+    EXPECT_EQ(CPyFloat_Exp(0.0), 1.0);
+    EXPECT_EQ(CPyFloat_Exp(-Py_HUGE_VAL), 0.0);
+    EXPECT_FLOAT_ERROR(CPyFloat_Exp(1000.0), PyExc_OverflowError);
+    EXPECT_EQ(CPyFloat_Log(1.0), 0.0);
+    EXPECT_FLOAT_ERROR(CPyFloat_Log(0.0), PyExc_ValueError);
+    EXPECT_EQ(CPyFloat_Sin(0.0), 0.0);
+    EXPECT_EQ(CPyFloat_Cos(0.0), 1.0);
+    EXPECT_FLOAT_ERROR(CPyFloat_Cos(Py_HUGE_VAL), PyExc_ValueError);
+    EXPECT_FLOAT_ERROR(CPyFloat_Tan(-Py_HUGE_VAL), PyExc_ValueError);
+    EXPECT_INT_EQUAL(CPyFloat_Floor(-1.5), eval_int("-2"));
+    EXPECT_INT_EQUAL(CPyFloat_Ceil(-1.5), eval_int("-1"));
+    EXPECT_INT_EQUAL(CPyFloat_Floor(1e30), eval_int("int(1e30)"));
+    EXPECT_EQ(CPyFloat_Ceil(Py_NAN), CPY_INT_TAG);
+    EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_ValueError));
+    PyErr_Clear();
+}
+
 TEST_F(CAPITest, test_tagged_as_long_long) {
     auto s = eval_int("3");
     auto neg = eval_int("-1");
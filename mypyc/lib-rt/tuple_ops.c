@@ -5,7 +5,9 @@
 #include <Python.h>
 #include "CPy.h"
 
-PyObject *CPySequenceTuple_GetItem(PyObject *tuple, CPyTagged index) {
+// Like CPySequenceTuple_GetItem, but return a borrowed reference. Tuples
+// are immutable, so the result is valid for as long as the tuple is alive.
+PyObject *CPySequenceTuple_GetItemBorrow(PyObject *tuple, CPyTagged index) {
     if (CPyTagged_CheckShort(index)) {
         Py_ssize_t n = CPyTagged_ShortAsSsize_t(index);
         Py_ssize_t size = PyTuple_GET_SIZE(tuple);
@@ -21,15 +23,19 @@ PyObject *CPySequenceTuple_GetItem(PyObject *tuple, CPyTagged index) {
                 return NULL;
             }
         }
-        PyObject *result = PyTuple_GET_ITEM(tuple, n);
-        Py_INCREF(result);
-        return result;
+        return PyTuple_GET_ITEM(tuple, n);
     } else {
         PyErr_SetString(PyExc_OverflowError, CPYTHON_LARGE_INT_ERRMSG);
         return NULL;
     }
 }
 
+PyObject *CPySequenceTuple_GetItem(PyObject *tuple, CPyTagged index) {
+    PyObject *result = CPySequenceTuple_GetItemBorrow(tuple, index);
+    Py_XINCREF(result);
+    return result;
+}
+
 PyObject *CPySequenceTuple_GetSlice(PyObject *obj, CPyTagged start, CPyTagged end) {
     if (likely(PyTuple_CheckExact(obj)
                && CPyTagged_CheckShort(start) && CPyTagged_CheckShort(end))) {
@@ -46,6 +52,32 @@ PyObject *CPySequenceTuple_GetSlice(PyObject *obj, CPyTagged start, CPyTagged en
     return CPyObject_GetSlice(obj, start, end);
 }
 
+PyObject *CPySequenceTuple_GetSliceStep(PyObject *obj, CPyTagged start, CPyTagged end,
+                                        CPyTagged step) {
+    if (likely(PyTuple_CheckExact(obj) && CPyTagged_CheckShort(step) && step != 0)) {
+        Py_ssize_t stepn = CPyTagged_ShortAsSsize_t(step);
+        Py_ssize_t length = PyTuple_GET_SIZE(obj);
+        Py_ssize_t startn = CPySlice_AdjustIndex(start, length, stepn);
+        Py_ssize_t endn = CPySlice_AdjustIndex(end, length, stepn);
+        if (stepn == 1) {
+            return PyTuple_GetSlice(obj, startn, endn);
+        }
+        Py_ssize_t n = CPySlice_Length(startn, endn, stepn);
+        PyObject *result = PyTuple_New(n);
+        if (unlikely(result == NULL)) {
+            return NULL;
+        }
+        Py_ssize_t i;
+        for (i = 0; i < n; i++) {
+            PyObject *item = PyTuple_GET_ITEM(obj, startn + i * stepn);
+            Py_INCREF(item);
+            PyTuple_SET_ITEM(result, i, item);
+        }
+        return result;
+    }
+    return CPyObject_GetSliceStep(obj, start, end, step);
+}
+
 // PyTuple_SET_ITEM does no error checking,
 // and should only be used to fill in brand new tuples.
 bool CPySequenceTuple_SetItemUnsafe(PyObject *tuple, CPyTagged index, PyObject *value)
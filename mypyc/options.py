@@ -10,7 +10,9 @@ class CompilerOptions:
                  separate: bool = False,
                  target_dir: Optional[str] = None,
                  include_runtime_files: Optional[bool] = None,
-                 capi_version: Optional[Tuple[int, int]] = None) -> None:
+                 capi_version: Optional[Tuple[int, int]] = None,
+                 profile_dispatch: bool = False,
+                 dispatch_profile: Optional[str] = None) -> None:
         self.strip_asserts = strip_asserts
         self.multi_file = multi_file
         self.verbose = verbose
@@ -25,3 +27,7 @@ class CompilerOptions:
         # binaries are backward compatible even if no recent API
         # features are used.
         self.capi_version = capi_version or sys.version_info[:2]
+        # Count the receiver types at vtable call sites (see mypyc.codegen.dispatchprofile)
+        self.profile_dispatch = profile_dispatch
+        # A profile written by such a build, used to emit guarded direct calls
+        self.dispatch_profile = dispatch_profile
@@ -0,0 +1,102 @@
+"""Primitive bytes ops.
+
+Since mypy promotes bytearray and memoryview to bytes, these must also accept
+bytearray and memoryview objects wherever a bytes value is expected.
+"""
+
+from mypyc.ir.ops import ERR_MAGIC
+from mypyc.ir.rtypes import (
+    object_rprimitive, bytes_rprimitive, str_rprimitive, int_rprimitive, c_int_rprimitive,
+    bool_rprimitive, c_pyssize_t_rprimitive, pointer_rprimitive
+)
+from mypyc.primitives.registry import (
+    method_op, binary_op, load_address_op, custom_op, ERR_NEG_INT
+)
+
+
+# Get the 'bytes' type object.
+load_address_op(
+    name='builtins.bytes',
+    type=object_rprimitive,
+    src='PyBytes_Type')
+
+# bytes1 + bytes2
+binary_op(name='+',
+          arg_types=[bytes_rprimitive, bytes_rprimitive],
+          return_type=bytes_rprimitive,
+          c_function_name='CPyBytes_Concat',
+          error_kind=ERR_MAGIC)
+
+# bytes.join(obj)
+method_op(
+    name='join',
+    arg_types=[bytes_rprimitive, object_rprimitive],
+    return_type=bytes_rprimitive,
+    c_function_name='CPyBytes_Join',
+    error_kind=ERR_MAGIC)
+
+# bytes[index] (for an int index)
+method_op(
+    name='__getitem__',
+    arg_types=[bytes_rprimitive, int_rprimitive],
+    return_type=int_rprimitive,
+    c_function_name='CPyBytes_GetItem',
+    error_kind=ERR_MAGIC)
+
+# bytes[begin:end]
+bytes_slice_op = custom_op(
+    arg_types=[bytes_rprimitive, int_rprimitive, int_rprimitive],
+    return_type=bytes_rprimitive,
+    c_function_name='CPyBytes_GetSlice',
+    error_kind=ERR_MAGIC)
+
+# bytes.startswith(bytes)
+method_op(
+    name='startswith',
+    arg_types=[bytes_rprimitive, bytes_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPyBytes_Startswith',
+    error_kind=ERR_NEG_INT,
+    truncated_type=bool_rprimitive)
+
+# bytes.endswith(bytes)
+method_op(
+    name='endswith',
+    arg_types=[bytes_rprimitive, bytes_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPyBytes_Endswith',
+    error_kind=ERR_NEG_INT,
+    truncated_type=bool_rprimitive)
+
+# bytes.decode()
+method_op(
+    name='decode',
+    arg_types=[bytes_rprimitive],
+    return_type=str_rprimitive,
+    c_function_name='CPyBytes_Decode',
+    error_kind=ERR_MAGIC,
+    extra_int_constants=[(0, pointer_rprimitive), (0, pointer_rprimitive)])
+
+# bytes.decode(encoding)
+method_op(
+    name='decode',
+    arg_types=[bytes_rprimitive, str_rprimitive],
+    return_type=str_rprimitive,
+    c_function_name='CPyBytes_Decode',
+    error_kind=ERR_MAGIC,
+    extra_int_constants=[(0, pointer_rprimitive)])
+
+# bytes.decode(encoding, errors)
+method_op(
+    name='decode',
+    arg_types=[bytes_rprimitive, str_rprimitive, str_rprimitive],
+    return_type=str_rprimitive,
+    c_function_name='CPyBytes_Decode',
+    error_kind=ERR_MAGIC)
+
+# len(bytes)
+bytes_len_op = custom_op(
+    arg_types=[bytes_rprimitive],
+    return_type=c_pyssize_t_rprimitive,
+    c_function_name='CPyBytes_Size',
+    error_kind=ERR_NEG_INT)
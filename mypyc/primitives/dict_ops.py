@@ -1,14 +1,19 @@
 """Primitive dict ops."""
 
+from typing import Dict
+from typing_extensions import Final
+
 from mypyc.ir.ops import ERR_FALSE, ERR_MAGIC, ERR_NEVER
 from mypyc.ir.rtypes import (
-    dict_rprimitive, object_rprimitive, bool_rprimitive, int_rprimitive,
-    list_rprimitive, dict_next_rtuple_single, dict_next_rtuple_pair, c_pyssize_t_rprimitive,
-    c_int_rprimitive, bit_rprimitive
+    dict_rprimitive, object_rprimitive, bool_rprimitive, int_rprimitive, short_int_rprimitive,
+    list_rprimitive, dict_next_rtuple_single, dict_next_rtuple_pair, dict_next_batch_rtuple,
+    c_pyssize_t_rprimitive, c_int_rprimitive, bit_rprimitive, object_pointer_rprimitive,
+    uint64_rprimitive, str_rprimitive, inline_cache_rprimitive
 )
 
 from mypyc.primitives.registry import (
-    custom_op, method_op, function_op, binary_op, load_address_op, ERR_NEG_INT
+    CFunctionDescription, custom_op, method_op, function_op, binary_op, load_address_op,
+    str_literal_variant, ERR_NEG_INT
 )
 
 # Get the 'dict' type object.
@@ -25,14 +30,22 @@ dict_new_op = custom_op(
     error_kind=ERR_MAGIC)
 
 # Construct a dictionary from keys and values.
-# Positional argument is the number of key-value pairs
-# Variable arguments are (key1, value1, ..., keyN, valueN).
+# The first argument is the number of key-value pairs, and the second
+# one is a C array (key1, value1, ..., keyN, valueN).
 dict_build_op = custom_op(
-    arg_types=[c_pyssize_t_rprimitive],
+    arg_types=[c_pyssize_t_rprimitive, object_pointer_rprimitive],
     return_type=dict_rprimitive,
-    c_function_name='CPyDict_Build',
-    error_kind=ERR_MAGIC,
-    var_arg_type=object_rprimitive)
+    c_function_name='CPyDict_BuildArray',
+    error_kind=ERR_MAGIC)
+
+# Construct a dictionary with str literal keys by copying a cached template.
+# The first argument is a tuple literal with the keys, and the second one is
+# a C array with the values.
+dict_from_template_op = custom_op(
+    arg_types=[object_rprimitive, object_pointer_rprimitive],
+    return_type=dict_rprimitive,
+    c_function_name='CPyDict_FromTemplate',
+    error_kind=ERR_MAGIC)
 
 # Construct a dictionary from another dictionary.
 function_op(
@@ -59,6 +72,13 @@ dict_get_item_op = method_op(
     c_function_name='CPyDict_GetItem',
     error_kind=ERR_MAGIC)
 
+# dict[key] with a str literal key, using an inline cache
+dict_get_item_cached_op = custom_op(
+    arg_types=[dict_rprimitive, str_rprimitive, inline_cache_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyDict_GetItemCached',
+    error_kind=ERR_MAGIC)
+
 # dict[key] = value
 dict_set_item_op = method_op(
     name='__setitem__',
@@ -68,7 +88,7 @@ dict_set_item_op = method_op(
     error_kind=ERR_NEG_INT)
 
 # key in dict
-binary_op(
+dict_contains_op = binary_op(
     name='in',
     arg_types=[object_rprimitive, dict_rprimitive],
     return_type=c_int_rprimitive,
@@ -103,7 +123,7 @@ method_op(
     error_kind=ERR_NEG_INT)
 
 # dict.get(key, default)
-method_op(
+dict_get_op = method_op(
     name='get',
     arg_types=[dict_rprimitive, object_rprimitive, object_rprimitive],
     return_type=object_rprimitive,
@@ -111,7 +131,7 @@ method_op(
     error_kind=ERR_MAGIC)
 
 # dict.get(key)
-method_op(
+dict_get_with_none_op = method_op(
     name='get',
     arg_types=[dict_rprimitive, object_rprimitive],
     return_type=object_rprimitive,
@@ -119,7 +139,7 @@ method_op(
     error_kind=ERR_MAGIC)
 
 # dict.setdefault(key, default)
-method_op(
+dict_setdefault_op = method_op(
     name='setdefault',
     arg_types=[dict_rprimitive, object_rprimitive, object_rprimitive],
     return_type=object_rprimitive,
@@ -127,7 +147,7 @@ method_op(
     error_kind=ERR_MAGIC)
 
 # dict.setdefault(key)
-method_op(
+dict_setdefault_with_none_op = method_op(
     name='setdefault',
     arg_types=[dict_rprimitive, object_rprimitive],
     return_type=object_rprimitive,
@@ -135,6 +155,16 @@ method_op(
     is_borrowed=True,
     error_kind=ERR_MAGIC)
 
+# Variants of the above for str literal keys, which use the hash cached by
+# CPyStatics_Initialize instead of hashing the key.
+str_literal_variant(dict_get_item_op, 1, 'CPyDict_GetItemKnownHash')
+str_literal_variant(dict_set_item_op, 1, 'CPyDict_SetItemKnownHash')
+str_literal_variant(dict_contains_op, 0, 'CPyDict_ContainsKnownHash')
+str_literal_variant(dict_get_op, 1, 'CPyDict_GetKnownHash')
+str_literal_variant(dict_get_with_none_op, 1, 'CPyDict_GetWithNoneKnownHash')
+str_literal_variant(dict_setdefault_op, 1, 'CPyDict_SetDefaultKnownHash')
+str_literal_variant(dict_setdefault_with_none_op, 1, 'CPyDict_SetDefaultWithNoneKnownHash')
+
 # dict.keys()
 method_op(
     name='keys',
@@ -196,6 +226,13 @@ dict_items_op = custom_op(
     c_function_name='CPyDict_Items',
     error_kind=ERR_MAGIC)
 
+# list(dict.items()) as a flat list of keys and values (key1, value1, key2, ...)
+dict_items_flat_op = custom_op(
+    arg_types=[dict_rprimitive],
+    return_type=list_rprimitive,
+    c_function_name='CPyDict_ItemsFlat',
+    error_kind=ERR_MAGIC)
+
 # PyDict_Next() fast iteration
 dict_key_iter_op = custom_op(
     arg_types=[dict_rprimitive],
@@ -240,6 +277,87 @@ dict_check_size_op = custom_op(
     c_function_name='CPyDict_CheckSize',
     error_kind=ERR_FALSE)
 
+# Batched dict iteration. These must match CPY_DICT_BATCH_* in CPy.h.
+DICT_BATCH_KEYS = 1  # type: Final
+DICT_BATCH_VALUES = 2  # type: Final
+DICT_BATCH_ITEMS = 3  # type: Final
+DICT_BATCH_BORROWED = 4  # type: Final
+
+# len(dict.keys()), len(dict.values()) and len(dict.items())
+dict_view_len_ops = {
+    name: custom_op(
+        arg_types=[dict_rprimitive],
+        return_type=c_pyssize_t_rprimitive,
+        c_function_name='CPyDict_ViewLen',
+        error_kind=ERR_NEG_INT,
+        extra_int_constants=[(kind, c_int_rprimitive)])
+    for name, kind in [('keys', DICT_BATCH_KEYS),
+                       ('values', DICT_BATCH_VALUES),
+                       ('items', DICT_BATCH_ITEMS)]
+}  # type: Dict[str, CFunctionDescription]
+
+# item in dict.keys(), item in dict.values() and item in dict.items()
+dict_view_contains_ops = {
+    name: custom_op(
+        arg_types=[dict_rprimitive, object_rprimitive],
+        return_type=c_int_rprimitive,
+        c_function_name='CPyDict_ViewContains',
+        error_kind=ERR_NEG_INT,
+        truncated_type=bool_rprimitive,
+        extra_int_constants=[(kind, c_int_rprimitive)])
+    for name, kind in [('keys', DICT_BATCH_KEYS),
+                       ('values', DICT_BATCH_VALUES),
+                       ('items', DICT_BATCH_ITEMS)]
+}  # type: Dict[str, CFunctionDescription]
+
+# Maximum number of keys, values or items fetched per call
+DICT_BATCH_SIZE = 16  # type: Final
+
+# dict_batch_iter_op(dict, kind) returns the dict itself or an iterator for subclasses
+dict_batch_iter_op = custom_op(
+    arg_types=[dict_rprimitive, c_int_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyDict_GetBatchIter',
+    error_kind=ERR_MAGIC)
+
+# dict_next_batch_op(iter, offset, buf, n, kind) fills buf with the next batch
+dict_next_batch_op = custom_op(
+    arg_types=[object_rprimitive, int_rprimitive, object_pointer_rprimitive,
+               c_pyssize_t_rprimitive, c_int_rprimitive],
+    return_type=dict_next_batch_rtuple,
+    c_function_name='CPyDict_NextBatch',
+    error_kind=ERR_MAGIC)
+
+# Read a borrowed object from a batch buffer
+dict_batch_item_op = custom_op(
+    arg_types=[object_pointer_rprimitive, short_int_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyDict_BatchItem',
+    error_kind=ERR_NEVER,
+    is_borrowed=True)
+
+dict_version_op = custom_op(
+    arg_types=[dict_rprimitive],
+    return_type=uint64_rprimitive,
+    c_function_name='CPyDict_Version',
+    error_kind=ERR_NEVER)
+
+# check that the dict didn't change size during borrowed iteration; returns 1 if the
+# remaining items in the batch may be stale and must be fetched again
+dict_check_batch_op = custom_op(
+    arg_types=[dict_rprimitive, int_rprimitive, uint64_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPyDict_CheckBatch',
+    error_kind=ERR_NEG_INT)
+
+# dict_batch_offset_op(iter, offset, pos, kind) is the offset after the first pos objects
+# of a batch fetched from offset
+dict_batch_offset_op = custom_op(
+    arg_types=[object_rprimitive, int_rprimitive, short_int_rprimitive, c_int_rprimitive],
+    return_type=int_rprimitive,
+    c_function_name='CPyDict_BatchOffset',
+    error_kind=ERR_NEVER)
+
 dict_size_op = custom_op(
     arg_types=[dict_rprimitive],
     return_type=c_pyssize_t_rprimitive,
@@ -1,7 +1,9 @@
 """Exception-related primitive ops."""
 
 from mypyc.ir.ops import ERR_NEVER, ERR_FALSE, ERR_ALWAYS
-from mypyc.ir.rtypes import object_rprimitive, void_rtype, exc_rtuple, bit_rprimitive
+from mypyc.ir.rtypes import (
+    object_rprimitive, void_rtype, exc_rtuple, bit_rprimitive, object_pointer_rprimitive
+)
 from mypyc.primitives.registry import custom_op
 
 # If the argument is a class, raise an instance of the class. Otherwise, assume
@@ -12,11 +14,13 @@ raise_exception_op = custom_op(
     c_function_name='CPy_Raise',
     error_kind=ERR_ALWAYS)
 
-# Raise StopIteration exception with the specified value (which can be NULL).
-set_stop_iteration_value = custom_op(
-    arg_types=[object_rprimitive],
+# Return a value from a generator. If the second argument (a pointer to the
+# return value) is NULL, raise StopIteration with the value. Otherwise store
+# the value in it, and signal an error without setting an exception.
+set_generator_return_value = custom_op(
+    arg_types=[object_rprimitive, object_pointer_rprimitive],
     return_type=void_rtype,
-    c_function_name='CPyGen_SetStopIterationValue',
+    c_function_name='CPyGen_SetReturnValue',
     error_kind=ERR_ALWAYS)
 
 # Raise exception with traceback.
@@ -81,6 +85,37 @@ exc_matches_op = custom_op(
     c_function_name='CPy_ExceptionMatches',
     error_kind=ERR_NEVER)
 
+# Fetches a propagating exception without normalizing it or updating
+# sys.exc_info(), and clears the error indicator. This is only used for
+# except blocks that can't observe the exception.
+error_fetch_op = custom_op(
+    arg_types=[],
+    return_type=exc_rtuple,
+    c_function_name='CPy_FetchError',
+    error_kind=ERR_NEVER)
+
+# Checks whether an exception returned from error_fetch matches a particular type.
+fetched_exc_matches_op = custom_op(
+    arg_types=[exc_rtuple, object_rprimitive],
+    return_type=bit_rprimitive,
+    c_function_name='CPy_ErrorMatches',
+    error_kind=ERR_NEVER)
+
+# Restores an exception returned from error_fetch as the propagating exception.
+restore_error_op = custom_op(
+    arg_types=[exc_rtuple],
+    return_type=void_rtype,
+    c_function_name='CPy_RestoreError',
+    error_kind=ERR_NEVER)
+
+# Sets an exception returned from error_fetch as the context of the
+# propagating exception.
+chain_error_op = custom_op(
+    arg_types=[exc_rtuple],
+    return_type=void_rtype,
+    c_function_name='CPy_ChainError',
+    error_kind=ERR_NEVER)
+
 # Get the value of the exception currently being handled.
 get_exc_value_op = custom_op(
     arg_types=[],
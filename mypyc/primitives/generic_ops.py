@@ -12,10 +12,11 @@ check that the priorities are configured properly.
 from mypyc.ir.ops import ERR_NEVER, ERR_MAGIC
 from mypyc.ir.rtypes import (
     object_rprimitive, int_rprimitive, bool_rprimitive, c_int_rprimitive, pointer_rprimitive,
-    object_pointer_rprimitive, c_size_t_rprimitive, c_pyssize_t_rprimitive
+    object_pointer_rprimitive, c_size_t_rprimitive, c_pyssize_t_rprimitive, short_int_rprimitive,
+    inline_cache_rprimitive
 )
 from mypyc.primitives.registry import (
-    binary_op, c_unary_op, method_op, function_op, custom_op, ERR_NEG_INT
+    binary_op, c_unary_op, method_op, function_op, custom_op, ERR_NEG_INT, ERR_NEG_ONE
 )
 
 
@@ -139,13 +140,20 @@ method_op(
     priority=0)
 
 # hash(obj)
-function_op(
+generic_hash_op = function_op(
     name='builtins.hash',
     arg_types=[object_rprimitive],
     return_type=int_rprimitive,
     c_function_name='CPyObject_Hash',
     error_kind=ERR_MAGIC)
 
+# hash(obj), but return Py_hash_t so that large hash values aren't boxed
+generic_ssize_t_hash_op = custom_op(
+    arg_types=[object_rprimitive],
+    return_type=c_pyssize_t_rprimitive,
+    c_function_name='CPyObject_HashNative',
+    error_kind=ERR_NEG_ONE)
+
 # getattr(obj, attr)
 py_getattr_op = function_op(
     name='builtins.getattr',
@@ -154,6 +162,14 @@ py_getattr_op = function_op(
     c_function_name='CPyObject_GetAttr',
     error_kind=ERR_MAGIC)
 
+# obj.attr with a constant attribute name, using an inline cache
+# Arguments are (object, attribute name, inline cache).
+py_getattr_cached_op = custom_op(
+    arg_types=[object_rprimitive, object_rprimitive, inline_cache_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyObject_GetAttrCached',
+    error_kind=ERR_MAGIC)
+
 # getattr(obj, attr, default)
 function_op(
     name='builtins.getattr',
@@ -174,9 +190,10 @@ py_setattr_op = function_op(
 py_hasattr_op = function_op(
     name='builtins.hasattr',
     arg_types=[object_rprimitive, object_rprimitive],
-    return_type=bool_rprimitive,
-    c_function_name='PyObject_HasAttr',
-    error_kind=ERR_NEVER)
+    return_type=c_int_rprimitive,
+    c_function_name='CPyObject_HasAttr',
+    error_kind=ERR_NEG_INT,
+    truncated_type=bool_rprimitive)
 
 # del obj.attr
 py_delattr_op = function_op(
@@ -216,6 +233,17 @@ py_vectorcall_method_op = custom_op(
     c_function_name='PyObject_VectorcallMethod',
     error_kind=ERR_MAGIC)
 
+# Same as py_vectorcall_method_op, but use an inline cache for the method lookup
+py_vectorcall_method_cached_op = custom_op(
+    arg_types=[object_rprimitive,  # Method name
+               object_pointer_rprimitive,  # Args, including self (PyObject **)
+               c_size_t_rprimitive,  # Number of positional args, including self
+               object_rprimitive,  # Keyword arg names tuple (or NULL)
+               inline_cache_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyObject_VectorcallMethodCached',
+    error_kind=ERR_MAGIC)
+
 # Call callable object with positional + keyword args: func(*args, **kwargs)
 # Arguments are (func, *args tuple, **kwargs dict).
 py_call_with_kwargs_op = custom_op(
@@ -234,6 +262,16 @@ py_method_call_op = custom_op(
     var_arg_type=object_rprimitive,
     extra_int_constants=[(0, pointer_rprimitive)])
 
+# Same as py_method_call_op, but use an inline cache for the method lookup
+# Arguments are (object, attribute name, inline cache, arg1, ...).
+py_method_call_cached_op = custom_op(
+    arg_types=[object_rprimitive, object_rprimitive, inline_cache_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyObject_CallMethodCached',
+    error_kind=ERR_MAGIC,
+    var_arg_type=object_rprimitive,
+    extra_int_constants=[(0, pointer_rprimitive)])
+
 # len(obj)
 generic_len_op = custom_op(
     arg_types=[object_rprimitive],
@@ -274,3 +312,11 @@ next_raw_op = custom_op(arg_types=[object_rprimitive],
                         return_type=object_rprimitive,
                         c_function_name='CPyIter_Next',
                         error_kind=ERR_NEVER)
+
+# Clamp a slice bound of a tuple or str for iterating over the slice
+# without creating it. The last argument is the (short int) step.
+sequence_slice_index_op = custom_op(
+    arg_types=[object_rprimitive, int_rprimitive, short_int_rprimitive],
+    return_type=short_int_rprimitive,
+    c_function_name='CPySequence_SliceIndex',
+    error_kind=ERR_NEVER)
@@ -9,13 +9,15 @@ Use mypyc.ir.ops.IntOp for operations on fixed-width/C integers.
 """
 
 from typing import Dict, NamedTuple
-from mypyc.ir.ops import ERR_NEVER, ERR_MAGIC, ComparisonOp
+from mypyc.ir.ops import ERR_NEVER, ERR_MAGIC, ERR_FALSE, ComparisonOp
 from mypyc.ir.rtypes import (
     int_rprimitive, bool_rprimitive, float_rprimitive, object_rprimitive,
-    str_rprimitive, bit_rprimitive, RType
+    str_rprimitive, bit_rprimitive, void_rtype, c_int_rprimitive, thread_state_rprimitive,
+    nogil_error_rprimitive, c_pyssize_t_rprimitive, RType
 )
 from mypyc.primitives.registry import (
-    load_address_op, c_unary_op, CFunctionDescription, function_op, binary_op, custom_op
+    load_address_op, c_unary_op, CFunctionDescription, function_op, binary_op, custom_op,
+    ERR_NEG_INT, ERR_NEG_ONE
 )
 
 # These int constructors produce object_rprimitives that then need to be unboxed
@@ -40,16 +42,16 @@ function_op(
 function_op(
     name='builtins.int',
     arg_types=[str_rprimitive],
-    return_type=object_rprimitive,
-    c_function_name='CPyLong_FromStr',
+    return_type=int_rprimitive,
+    c_function_name='CPyTagged_FromStr',
     error_kind=ERR_MAGIC)
 
 # int(string, base)
 function_op(
     name='builtins.int',
     arg_types=[str_rprimitive, int_rprimitive],
-    return_type=object_rprimitive,
-    c_function_name='CPyLong_FromStrWithBase',
+    return_type=int_rprimitive,
+    c_function_name='CPyTagged_FromStrWithBase',
     error_kind=ERR_MAGIC)
 
 # str(n) on ints
@@ -61,6 +63,14 @@ function_op(
     error_kind=ERR_MAGIC,
     priority=2)
 
+# hex(n)
+function_op(
+    name='builtins.hex',
+    arg_types=[int_rprimitive],
+    return_type=str_rprimitive,
+    c_function_name='CPyTagged_Hex',
+    error_kind=ERR_MAGIC)
+
 # We need a specialization for str on bools also since the int one is wrong...
 function_op(
     name='builtins.str',
@@ -124,6 +134,29 @@ def int_unary_op(name: str, c_function_name: str) -> CFunctionDescription:
 int_neg_op = int_unary_op('-', 'CPyTagged_Negate')
 int_invert_op = int_unary_op('~', 'CPyTagged_Invert')
 
+# Convert a Py_ssize_t to an int (boxing it if it doesn't fit in a short int)
+ssize_t_to_int_op = custom_op(
+    arg_types=[c_pyssize_t_rprimitive],
+    return_type=int_rprimitive,
+    c_function_name='CPyTagged_FromSsize_t',
+    error_kind=ERR_NEVER)
+
+# Convert the int returned by a native __hash__ method to a tp_hash result
+# (never -1), like CPython does for Python __hash__ methods
+int_to_hash_value_op = custom_op(
+    arg_types=[int_rprimitive],
+    return_type=c_pyssize_t_rprimitive,
+    c_function_name='CPyTagged_AsHashValue',
+    error_kind=ERR_NEG_ONE)
+
+# Convert the int returned by a native __len__ method to an mp_length result
+# (ValueError if negative)
+int_to_len_value_op = custom_op(
+    arg_types=[int_rprimitive],
+    return_type=c_pyssize_t_rprimitive,
+    c_function_name='CPyTagged_AsLenValue',
+    error_kind=ERR_NEG_INT)
+
 # Primitives related to integer comparison operations:
 
 # Description for building int comparison ops
@@ -163,3 +196,82 @@ int_comparison_op_mapping = {
     '>': IntComparisonOpDescription(ComparisonOp.SGT, int_less_than_, False, True),
     '>=': IntComparisonOpDescription(ComparisonOp.SGE, int_less_than_, True, False),
 }  # type: Dict[str, IntComparisonOpDescription]
+
+# Primitives for nogil functions, which run without the GIL (see
+# mypyc.irbuild.nogil). All int values in these functions are short.
+# Operations that can fail store an error code through the nogil_error
+# pointer given as the last argument instead of raising an exception.
+
+# Check that an int argument is short (before releasing the GIL)
+nogil_check_int_op = custom_op(
+    arg_types=[int_rprimitive],
+    return_type=bit_rprimitive,
+    c_function_name='CPy_NoGIL_CheckInt',
+    error_kind=ERR_FALSE)
+
+# Release the GIL
+nogil_enter_op = custom_op(
+    arg_types=[],
+    return_type=thread_state_rprimitive,
+    c_function_name='CPy_NoGIL_Enter',
+    error_kind=ERR_NEVER)
+
+# Reacquire the GIL
+nogil_exit_op = custom_op(
+    arg_types=[thread_state_rprimitive],
+    return_type=void_rtype,
+    c_function_name='CPy_NoGIL_Exit',
+    error_kind=ERR_NEVER)
+
+# Reacquire the GIL and raise the exception for an error code (always fails)
+nogil_raise_op = custom_op(
+    arg_types=[thread_state_rprimitive, c_int_rprimitive],
+    return_type=bit_rprimitive,
+    c_function_name='CPy_NoGIL_Raise',
+    error_kind=ERR_FALSE)
+
+
+def int_nogil_binary_op(c_function_name: str) -> CFunctionDescription:
+    return custom_op(
+        arg_types=[int_rprimitive, int_rprimitive, nogil_error_rprimitive],
+        return_type=int_rprimitive,
+        c_function_name=c_function_name,
+        error_kind=ERR_MAGIC)
+
+
+# Short int binary ops by operator ('&', '|' and '^' are plain IntOps on short ints)
+int_nogil_binary_ops = {
+    '+': int_nogil_binary_op('CPyTagged_NoGIL_Add'),
+    '-': int_nogil_binary_op('CPyTagged_NoGIL_Subtract'),
+    '*': int_nogil_binary_op('CPyTagged_NoGIL_Multiply'),
+    '//': int_nogil_binary_op('CPyTagged_NoGIL_FloorDivide'),
+    '%': int_nogil_binary_op('CPyTagged_NoGIL_Remainder'),
+    '>>': int_nogil_binary_op('CPyTagged_NoGIL_Rshift'),
+    '<<': int_nogil_binary_op('CPyTagged_NoGIL_Lshift'),
+}  # type: Dict[str, CFunctionDescription]
+
+int_nogil_neg_op = custom_op(
+    arg_types=[int_rprimitive, nogil_error_rprimitive],
+    return_type=int_rprimitive,
+    c_function_name='CPyTagged_NoGIL_Negate',
+    error_kind=ERR_MAGIC)
+
+int_nogil_invert_op = custom_op(
+    arg_types=[int_rprimitive],
+    return_type=int_rprimitive,
+    c_function_name='CPyTagged_NoGIL_Invert',
+    error_kind=ERR_NEVER)
+
+# Check a borrowed native int attribute value (it may be undefined or a long int)
+int_nogil_check_attr_op = custom_op(
+    arg_types=[int_rprimitive, nogil_error_rprimitive],
+    return_type=int_rprimitive,
+    c_function_name='CPyTagged_NoGIL_CheckAttr',
+    error_kind=ERR_MAGIC)
+
+# Check a native bool attribute value (it may be undefined)
+bool_nogil_check_attr_op = custom_op(
+    arg_types=[bool_rprimitive, nogil_error_rprimitive],
+    return_type=bool_rprimitive,
+    c_function_name='CPyBool_NoGIL_CheckAttr',
+    error_kind=ERR_MAGIC)
@@ -3,7 +3,7 @@
 from mypyc.ir.ops import ERR_MAGIC, ERR_NEVER, ERR_FALSE
 from mypyc.ir.rtypes import (
     int_rprimitive, short_int_rprimitive, list_rprimitive, object_rprimitive,  c_int_rprimitive,
-    c_pyssize_t_rprimitive, bit_rprimitive
+    c_pyssize_t_rprimitive, bit_rprimitive, bool_rprimitive, void_rtype
 )
 from mypyc.primitives.registry import (
     load_address_op, function_op, binary_op, method_op, custom_op, ERR_NEG_INT
@@ -56,6 +56,31 @@ list_get_item_unsafe_op = custom_op(
     c_function_name='CPyList_GetItemUnsafe',
     error_kind=ERR_NEVER)
 
+# Variants of the above that return a borrowed reference. The result is
+# only valid while the list is alive and the item isn't replaced or
+# removed, so these must only be used if no arbitrary code can run
+# before the last use of the result.
+list_get_item_borrow_op = custom_op(
+    arg_types=[list_rprimitive, int_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyList_GetItemBorrow',
+    error_kind=ERR_MAGIC,
+    is_borrowed=True)
+
+list_get_item_short_borrow_op = custom_op(
+    arg_types=[list_rprimitive, short_int_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyList_GetItemShortBorrow',
+    error_kind=ERR_MAGIC,
+    is_borrowed=True)
+
+list_get_item_unsafe_borrow_op = custom_op(
+    arg_types=[list_rprimitive, short_int_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyList_GetItemUnsafeBorrow',
+    error_kind=ERR_NEVER,
+    is_borrowed=True)
+
 # list[index] = obj
 list_set_item_op = method_op(
     name='__setitem__',
@@ -74,6 +99,35 @@ new_list_set_item_op = custom_op(
     error_kind=ERR_FALSE,
     steals=[False, False, True])
 
+# Create an empty list with room for the given number of items. Items are
+# added with list_append_steal_op, and list_shrink_to_fit_op is called once
+# the list is complete.
+new_presized_list_op = custom_op(
+    arg_types=[c_pyssize_t_rprimitive],
+    return_type=list_rprimitive,
+    c_function_name='CPyList_NewPresized',
+    error_kind=ERR_MAGIC)
+
+list_append_steal_op = custom_op(
+    arg_types=[list_rprimitive, object_rprimitive],
+    return_type=bit_rprimitive,
+    c_function_name='CPyList_AppendSteal',
+    error_kind=ERR_FALSE,
+    steals=[False, True])
+
+list_shrink_to_fit_op = custom_op(
+    arg_types=[list_rprimitive],
+    return_type=void_rtype,
+    c_function_name='CPyList_ShrinkToFit',
+    error_kind=ERR_NEVER)
+
+# Length of range(start, end) as a list capacity hint (0 if not a short int range)
+range_length_hint_op = custom_op(
+    arg_types=[int_rprimitive, int_rprimitive],
+    return_type=c_pyssize_t_rprimitive,
+    c_function_name='CPyTagged_RangeLengthHint',
+    error_kind=ERR_NEVER)
+
 # list.append(obj)
 list_append_op = method_op(
     name='append',
@@ -127,9 +181,23 @@ method_op(
     name='sort',
     arg_types=[list_rprimitive],
     return_type=c_int_rprimitive,
-    c_function_name='PyList_Sort',
+    c_function_name='CPyList_Sort',
+    error_kind=ERR_NEG_INT)
+
+# list.sort(key=key, reverse=reverse), where key may be None
+list_sort_key_op = custom_op(
+    arg_types=[list_rprimitive, object_rprimitive, bool_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPyList_SortKey',
     error_kind=ERR_NEG_INT)
 
+# sorted(obj, key=key, reverse=reverse), where key may be None
+sorted_op = custom_op(
+    arg_types=[object_rprimitive, object_rprimitive, bool_rprimitive],
+    return_type=list_rprimitive,
+    c_function_name='CPyList_Sorted',
+    error_kind=ERR_MAGIC)
+
 # list.reverse()
 method_op(
     name='reverse',
@@ -154,6 +222,16 @@ method_op(
     c_function_name='CPyList_Index',
     error_kind=ERR_MAGIC)
 
+# obj in list
+binary_op(
+    name='in',
+    arg_types=[object_rprimitive, list_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPyList_Contains',
+    error_kind=ERR_NEG_INT,
+    truncated_type=bool_rprimitive,
+    ordering=[1, 0])
+
 # list * int
 binary_op(
     name='*',
@@ -175,3 +253,10 @@ list_slice_op = custom_op(
     return_type=object_rprimitive,
     c_function_name='CPyList_GetSlice',
     error_kind=ERR_MAGIC,)
+
+# list[begin:end:step]
+list_slice_step_op = custom_op(
+    arg_types=[list_rprimitive, int_rprimitive, int_rprimitive, int_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyList_GetSliceStep',
+    error_kind=ERR_MAGIC)
@@ -41,6 +41,13 @@ function_op(
     c_function_name='CPyTagged_Id',
     error_kind=ERR_NEVER)
 
+# id(obj), but return Py_ssize_t
+id_ssize_t_op = custom_op(
+    arg_types=[object_rprimitive],
+    return_type=c_pyssize_t_rprimitive,
+    c_function_name='CPyObject_IdNative',
+    error_kind=ERR_NEVER)
+
 # Return the result of obj.__await()__ or obj.__iter__() (if no __await__ exists)
 coro_op = custom_op(
     arg_types=[object_rprimitive],
@@ -50,14 +57,15 @@ coro_op = custom_op(
 
 # Do obj.send(value), or a next(obj) if second arg is None.
 # (This behavior is to match the PEP 380 spec for yield from.)
-# Like next_raw_op, don't swallow StopIteration,
-# but also don't propagate an error.
-# Can return NULL: see next_op.
-send_op = custom_op(
-    arg_types=[object_rprimitive, object_rprimitive],
-    return_type=object_rprimitive,
-    c_function_name='CPyIter_Send',
-    error_kind=ERR_NEVER)
+# The yielded or returned value is stored in the pointer argument.
+# Return 1 if a value was yielded, 0 if the iterator returned (or raised
+# StopIteration), and -1 on other errors.
+send_status_op = custom_op(
+    arg_types=[object_rprimitive, object_rprimitive, object_pointer_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPyIter_SendStatus',
+    error_kind=ERR_NEG_INT,
+    truncated_type=bool_rprimitive)
 
 # This is sort of unfortunate but oh well: yield_from_except performs most of the
 # error handling logic in `yield from` operations. It returns a bool and passes
@@ -81,15 +89,6 @@ method_new_op = custom_op(
     c_function_name='PyMethod_New',
     error_kind=ERR_MAGIC)
 
-# Check if the current exception is a StopIteration and return its value if so.
-# Treats "no exception" as StopIteration with a None value.
-# If it is a different exception, re-reraise it.
-check_stop_op = custom_op(
-    arg_types=[],
-    return_type=object_rprimitive,
-    c_function_name='CPy_FetchStopIterationValue',
-    error_kind=ERR_MAGIC)
-
 # Determine the most derived metaclass and check for metaclass conflicts.
 # Arguments are (metaclass, bases).
 py_calc_meta_op = custom_op(
@@ -189,3 +188,35 @@ check_unpack_count_op = custom_op(
     return_type=c_int_rprimitive,
     c_function_name='CPySequence_CheckUnpackCount',
     error_kind=ERR_NEG_INT)
+
+# collections.deque operations (see the comment in misc_ops.c)
+
+deque_append_op = custom_op(
+    arg_types=[object_rprimitive, object_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPyDeque_Append',
+    error_kind=ERR_NEG_INT)
+
+deque_append_left_op = custom_op(
+    arg_types=[object_rprimitive, object_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPyDeque_AppendLeft',
+    error_kind=ERR_NEG_INT)
+
+deque_pop_op = custom_op(
+    arg_types=[object_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyDeque_Pop',
+    error_kind=ERR_MAGIC)
+
+deque_pop_left_op = custom_op(
+    arg_types=[object_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyDeque_PopLeft',
+    error_kind=ERR_MAGIC)
+
+deque_len_op = custom_op(
+    arg_types=[object_rprimitive],
+    return_type=int_rprimitive,
+    c_function_name='CPyDeque_Len',
+    error_kind=ERR_MAGIC)
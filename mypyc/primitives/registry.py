@@ -45,6 +45,11 @@ from mypyc.ir.rtypes import RType
 # is only used for primitives. We translate it away during IR building.
 ERR_NEG_INT = 10  # type: Final
 
+# Error kind for functions that return -1 on exception and never return -1
+# otherwise, but may return other negative values (such as Py_hash_t results).
+# This is also translated away during IR building.
+ERR_NEG_ONE = 11  # type: Final
+
 
 CFunctionDescription = NamedTuple(
     'CFunctionDescription',  [('name', str),
@@ -81,6 +86,10 @@ unary_ops = {}  # type: Dict[str, List[CFunctionDescription]]
 
 builtin_names = {}  # type: Dict[str, Tuple[RType, str]]
 
+# Variants of CallC ops that are used when an argument is a str literal, keyed
+# by the C function name of the generic op. The int is the index of the argument.
+str_literal_ops = {}  # type: Dict[str, Tuple[CFunctionDescription, int]]
+
 
 def method_op(name: str,
               arg_types: List[RType],
@@ -228,6 +237,20 @@ def c_unary_op(name: str,
     return desc
 
 
+def str_literal_variant(desc: CFunctionDescription,
+                        arg_index: int,
+                        c_function_name: str) -> CFunctionDescription:
+    """Define a variant of an op for calls where an argument is a str literal.
+
+    The variant must take the same arguments as the original op.
+    """
+    assert desc.c_function_name not in str_literal_ops, (
+        'already defined: %s' % desc.c_function_name)
+    variant = desc._replace(c_function_name=c_function_name)
+    str_literal_ops[desc.c_function_name] = (variant, arg_index)
+    return variant
+
+
 def load_address_op(name: str,
                     type: RType,
                     src: str) -> LoadAddressDescription:
@@ -239,6 +262,7 @@ def load_address_op(name: str,
 # Import various modules that set up global state.
 import mypyc.primitives.int_ops  # noqa
 import mypyc.primitives.str_ops  # noqa
+import mypyc.primitives.bytes_ops  # noqa
 import mypyc.primitives.list_ops  # noqa
 import mypyc.primitives.dict_ops  # noqa
 import mypyc.primitives.tuple_ops  # noqa
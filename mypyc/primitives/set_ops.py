@@ -1,10 +1,12 @@
 """Primitive set (and frozenset) ops."""
 
-from mypyc.primitives.registry import function_op, method_op, binary_op, ERR_NEG_INT
-from mypyc.ir.ops import ERR_MAGIC, ERR_FALSE
+from mypyc.primitives.registry import (
+    function_op, method_op, binary_op, custom_op, ERR_NEG_INT
+)
+from mypyc.ir.ops import ERR_MAGIC, ERR_FALSE, ERR_NEVER
 from mypyc.ir.rtypes import (
     object_rprimitive, bool_rprimitive, set_rprimitive, c_int_rprimitive, pointer_rprimitive,
-    bit_rprimitive
+    bit_rprimitive, int_rprimitive, dict_next_rtuple_single
 )
 
 
@@ -18,7 +20,11 @@ new_set_op = function_op(
     extra_int_constants=[(0, pointer_rprimitive)])
 
 # set(obj)
-function_op(
+#
+# This is also used to copy precomputed frozenset literals for set displays
+# with only literal items. Copying a set reuses the stored hashes and
+# allocates the table only once.
+set_from_iterable_op = function_op(
     name='builtins.set',
     arg_types=[object_rprimitive],
     return_type=set_rprimitive,
@@ -43,6 +49,49 @@ binary_op(
     truncated_type=bool_rprimitive,
     ordering=[1, 0])
 
+# int in set (a short int is looked up without boxing)
+binary_op(
+    name='in',
+    arg_types=[int_rprimitive, set_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPySet_ContainsInt',
+    error_kind=ERR_NEG_INT,
+    truncated_type=bool_rprimitive,
+    ordering=[1, 0],
+    priority=2)
+
+# item in <frozenset literal>
+frozenset_contains_op = custom_op(
+    arg_types=[object_rprimitive, object_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='PySet_Contains',
+    error_kind=ERR_NEG_INT,
+    truncated_type=bool_rprimitive)
+
+# int in <frozenset literal>
+frozenset_contains_int_op = custom_op(
+    arg_types=[object_rprimitive, int_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPySet_ContainsInt',
+    error_kind=ERR_NEG_INT,
+    truncated_type=bool_rprimitive)
+
+# set1 | set2
+binary_op(
+    name='|',
+    arg_types=[set_rprimitive, set_rprimitive],
+    return_type=set_rprimitive,
+    c_function_name='CPySet_Union',
+    error_kind=ERR_MAGIC)
+
+# set1 |= set2
+binary_op(
+    name='|=',
+    arg_types=[set_rprimitive, set_rprimitive],
+    return_type=set_rprimitive,
+    c_function_name='CPySet_InPlaceUnion',
+    error_kind=ERR_MAGIC)
+
 # set.remove(obj)
 method_op(
     name='remove',
@@ -92,3 +141,23 @@ method_op(
     return_type=object_rprimitive,
     c_function_name='PySet_Pop',
     error_kind=ERR_MAGIC)
+
+# _PySet_NextEntry() fast iteration
+set_iter_op = custom_op(
+    arg_types=[set_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPySet_GetIter',
+    error_kind=ERR_MAGIC)
+
+set_next_op = custom_op(
+    arg_types=[object_rprimitive, int_rprimitive],
+    return_type=dict_next_rtuple_single,
+    c_function_name='CPySet_Next',
+    error_kind=ERR_NEVER)
+
+# check that len(set) == const during iteration
+set_check_size_op = custom_op(
+    arg_types=[set_rprimitive, int_rprimitive],
+    return_type=bit_rprimitive,
+    c_function_name='CPySet_CheckSize',
+    error_kind=ERR_FALSE)
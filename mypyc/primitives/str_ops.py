@@ -1,15 +1,17 @@
 """Primitive str ops."""
 
 from typing import List, Tuple
+from typing_extensions import Final
 
 from mypyc.ir.ops import ERR_MAGIC, ERR_NEVER
 from mypyc.ir.rtypes import (
-    RType, object_rprimitive, str_rprimitive, int_rprimitive, list_rprimitive,
-    c_int_rprimitive, pointer_rprimitive, bool_rprimitive, bit_rprimitive
+    RType, object_rprimitive, str_rprimitive, int_rprimitive, short_int_rprimitive,
+    list_rprimitive, c_int_rprimitive, pointer_rprimitive, bool_rprimitive, bit_rprimitive,
+    c_pyssize_t_rprimitive, uint32_rprimitive
 )
 from mypyc.primitives.registry import (
     method_op, binary_op, function_op,
-    load_address_op, custom_op
+    load_address_op, custom_op, ERR_NEG_INT
 )
 
 
@@ -70,9 +72,50 @@ method_op(
     error_kind=ERR_MAGIC
 )
 
+# str[index] for an index known to be in range (used in for loops)
+str_get_item_unsafe_op = custom_op(
+    arg_types=[str_rprimitive, short_int_rprimitive],
+    return_type=str_rprimitive,
+    c_function_name='CPyStr_GetItemUnsafe',
+    error_kind=ERR_MAGIC)
+
+# str[index] == <single character>, without creating a str object for str[index]
+str_index_equals_char_op = custom_op(
+    arg_types=[str_rprimitive, int_rprimitive, c_int_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPyStr_IndexEqualsChar',
+    error_kind=ERR_NEG_INT,
+    truncated_type=bool_rprimitive)
+
+# str.find(sub)
+method_op(
+    name='find',
+    arg_types=[str_rprimitive, str_rprimitive],
+    return_type=int_rprimitive,
+    c_function_name='CPyStr_Find',
+    error_kind=ERR_MAGIC)
+
+# str.count(sub)
+method_op(
+    name='count',
+    arg_types=[str_rprimitive, str_rprimitive],
+    return_type=int_rprimitive,
+    c_function_name='CPyStr_Count',
+    error_kind=ERR_MAGIC)
+
+# sub in str
+binary_op(
+    name='in',
+    arg_types=[str_rprimitive, str_rprimitive],
+    return_type=c_int_rprimitive,
+    c_function_name='CPyStr_Contains',
+    error_kind=ERR_NEG_INT,
+    truncated_type=bool_rprimitive,
+    ordering=[1, 0])
+
 # str.split(...)
 str_split_types = [str_rprimitive, str_rprimitive, int_rprimitive]  # type: List[RType]
-str_split_functions = ['PyUnicode_Split', 'PyUnicode_Split', 'CPyStr_Split']
+str_split_functions = ['CPyStr_SplitMax', 'CPyStr_SplitMax', 'CPyStr_Split']
 str_split_constants = [[(0, pointer_rprimitive), (-1, c_int_rprimitive)],
                        [(-1, c_int_rprimitive)],
                        []] \
@@ -97,6 +140,27 @@ binary_op(name='+=',
           error_kind=ERR_MAGIC,
           steals=[True, False])
 
+# Concatenate strs into a new str with a single allocation, used for f-strings
+# and joins of str displays. Pieces can also be tagged ints, which are formatted
+# without boxing: the second argument is a bit mask of the int pieces. Since the
+# var args have mixed types, this is called through LowLevelIRBuilder.str_build.
+str_build_op = custom_op(
+    arg_types=[c_pyssize_t_rprimitive, uint32_rprimitive],
+    return_type=str_rprimitive,
+    c_function_name='CPyStr_Build',
+    error_kind=ERR_MAGIC,
+    var_arg_type=str_rprimitive)
+
+# Must match CPY_STR_BUILD_MAX_PIECES in CPy.h
+STR_BUILD_MAX_PIECES = 32  # type: Final
+
+# Format a str with an empty format spec, as in f"{s}"
+str_format_simple_op = custom_op(
+    arg_types=[str_rprimitive],
+    return_type=str_rprimitive,
+    c_function_name='CPyStr_FormatSimple',
+    error_kind=ERR_MAGIC)
+
 unicode_compare = custom_op(
     arg_types=[str_rprimitive, str_rprimitive],
     return_type=c_int_rprimitive,
@@ -110,12 +174,19 @@ str_slice_op = custom_op(
     c_function_name='CPyStr_GetSlice',
     error_kind=ERR_MAGIC)
 
+# str[begin:end:step]
+str_slice_step_op = custom_op(
+    arg_types=[str_rprimitive, int_rprimitive, int_rprimitive, int_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPyStr_GetSliceStep',
+    error_kind=ERR_MAGIC)
+
 # str.replace(old, new)
 method_op(
     name='replace',
     arg_types=[str_rprimitive, str_rprimitive, str_rprimitive],
     return_type=str_rprimitive,
-    c_function_name="PyUnicode_Replace",
+    c_function_name="CPyStr_ReplaceMax",
     error_kind=ERR_MAGIC,
     extra_int_constants=[(-1, c_int_rprimitive)])
 
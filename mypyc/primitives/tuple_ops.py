@@ -4,10 +4,10 @@ Note: Varying-length tuples are represented as boxed Python tuple
 objects, i.e. tuple_rprimitive (RPrimitive), not RTuple.
 """
 
-from mypyc.ir.ops import ERR_MAGIC, ERR_FALSE
+from mypyc.ir.ops import ERR_MAGIC, ERR_FALSE, ERR_NEVER
 from mypyc.ir.rtypes import (
     tuple_rprimitive, int_rprimitive, list_rprimitive, object_rprimitive,
-    c_pyssize_t_rprimitive, bit_rprimitive
+    c_pyssize_t_rprimitive, bit_rprimitive, short_int_rprimitive
 )
 from mypyc.primitives.registry import method_op, function_op, custom_op
 
@@ -20,6 +20,24 @@ tuple_get_item_op = method_op(
     c_function_name='CPySequenceTuple_GetItem',
     error_kind=ERR_MAGIC)
 
+# tuple[index], returning a borrowed reference that is valid while the
+# tuple is alive
+tuple_get_item_borrow_op = custom_op(
+    arg_types=[tuple_rprimitive, int_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPySequenceTuple_GetItemBorrow',
+    error_kind=ERR_MAGIC,
+    is_borrowed=True)
+
+# tuple[index] for an index that is known to be in range, returning a
+# borrowed reference (used for unpacking tuples)
+tuple_get_item_unsafe_borrow_op = custom_op(
+    arg_types=[tuple_rprimitive, short_int_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPySequenceTuple_GetItemUnsafeBorrow',
+    error_kind=ERR_NEVER,
+    is_borrowed=True)
+
 # Construct a boxed tuple from items: (item1, item2, ...)
 new_tuple_op = custom_op(
     arg_types=[c_pyssize_t_rprimitive],
@@ -66,3 +84,10 @@ tuple_slice_op = custom_op(
     return_type=object_rprimitive,
     c_function_name='CPySequenceTuple_GetSlice',
     error_kind=ERR_MAGIC)
+
+# tuple[begin:end:step]
+tuple_slice_step_op = custom_op(
+    arg_types=[tuple_rprimitive, int_rprimitive, int_rprimitive, int_rprimitive],
+    return_type=object_rprimitive,
+    c_function_name='CPySequenceTuple_GetSliceStep',
+    error_kind=ERR_MAGIC)
@@ -0,0 +1,131 @@
+"""Driver for differential benchmarks (bench-*.test).
+
+Each function starting with bench_ takes an iteration count, runs its
+workload that many times and returns a result. Every function is run
+both compiled (from the 'native' module) and interpreted (from the
+'interpreted' module) with a count of 1, and the results must be equal.
+
+If MYPYC_RUN_BENCH is 1, each function is also measured compiled and
+interpreted, each in a fresh process so that peak RSS values are
+comparable. One line is printed per function:
+
+    bench_name: speedup X.XX, time A/B us, peak RSS C/D KiB, traced peak E/F KiB
+
+where the first value of each pair is for interpreted and the second one
+is for compiled code. Traced peak is the peak size of the memory
+allocated by the workload (measured with tracemalloc), which unlike RSS
+doesn't include the interpreter itself. Test cases can set gates with
+comments in the program:
+
+    # min_speedup: 2.0
+    # max_traced_ratio: 1.0
+
+The benchmark fails if compiled code is less than min_speedup times
+faster, or if its traced peak is more than max_traced_ratio times that
+of interpreted code. If MYPYC_BENCH_REPORT is set, a tab-separated line
+with the test case name, function name and the values above is also
+appended to the file it names, so that runs can be compared.
+"""
+
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+import tracemalloc
+
+MIN_TIME = float(os.environ.get('MYPYC_BENCH_MIN_TIME', '0.2'))
+REPEAT = 5
+
+
+def bench_functions(module):
+    return sorted(name for name in dir(module) if name.startswith('bench_'))
+
+
+def time_once(func, n):
+    t0 = time.perf_counter()
+    func(n)
+    return time.perf_counter() - t0
+
+
+def measure(module_name, name):
+    """Measure a single function in this process and print the results as JSON."""
+    module = __import__(module_name)
+    func = getattr(module, name)
+    # Find an iteration count that takes long enough, which also warms up
+    n = 1
+    while time_once(func, n) < MIN_TIME / REPEAT:
+        n *= 2
+    best = min(time_once(func, n) for _ in range(REPEAT))
+    # Only the peak memory of a single iteration is interesting
+    tracemalloc.start()
+    func(1)
+    traced_peak = tracemalloc.get_traced_memory()[1]
+    tracemalloc.stop()
+    import resource
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    if sys.platform == 'darwin':
+        rss //= 1024  # Bytes instead of KiB
+    print(json.dumps({'time': best / n, 'rss': rss, 'traced': traced_peak}))
+
+
+def measure_in_subprocess(module_name, name):
+    output = subprocess.check_output([sys.executable, __file__, '--measure', module_name, name])
+    return json.loads(output.decode('utf8'))
+
+
+def read_gate(text, name):
+    m = re.search(r'# {}: ([0-9.]+)$'.format(name), text, flags=re.MULTILINE)
+    return float(m.group(1)) if m else None
+
+
+def main():
+    import native
+    import interpreted
+
+    names = bench_functions(native)
+    assert names, 'no bench_ functions found'
+    for name in names:
+        expected = getattr(interpreted, name)(1)
+        actual = getattr(native, name)(1)
+        assert actual == expected, '{}: {!r} != {!r}'.format(name, actual, expected)
+
+    if os.environ.get('MYPYC_RUN_BENCH') != '1':
+        return
+
+    with open('native.py') as f:
+        text = f.read()
+    min_speedup = read_gate(text, 'min_speedup')
+    max_traced_ratio = read_gate(text, 'max_traced_ratio')
+    report = os.environ.get('MYPYC_BENCH_REPORT')
+    case = os.environ.get('MYPYC_BENCH_CASE', '')
+    failures = []
+    for name in names:
+        interp = measure_in_subprocess('interpreted', name)
+        comp = measure_in_subprocess('native', name)
+        speedup = interp['time'] / comp['time']
+        print('{}: speedup {:.2f}, time {:.3f}/{:.3f} us, peak RSS {}/{} KiB, '
+              'traced peak {:.1f}/{:.1f} KiB'.format(
+                  name, speedup, interp['time'] * 1e6, comp['time'] * 1e6,
+                  interp['rss'], comp['rss'], interp['traced'] / 1024, comp['traced'] / 1024))
+        if report:
+            with open(report, 'a') as f:
+                f.write('\t'.join(str(x) for x in [
+                    case, name, speedup, interp['time'], comp['time'], interp['rss'],
+                    comp['rss'], interp['traced'], comp['traced']]) + '\n')
+        if min_speedup is not None and speedup < min_speedup:
+            failures.append('{}: speedup {:.2f} is below {}'.format(name, speedup, min_speedup))
+        if (max_traced_ratio is not None
+                and comp['traced'] > max_traced_ratio * max(interp['traced'], 1)):
+            failures.append('{}: traced peak {} is more than {} times {}'.format(
+                name, comp['traced'], max_traced_ratio, interp['traced']))
+    if failures:
+        raise AssertionError('\n'.join(failures))
+
+
+if __name__ == '__main__':
+    if sys.argv[1:2] == ['--measure']:
+        measure(sys.argv[2], sys.argv[3])
+    else:
+        main()
@@ -34,6 +34,7 @@ class int:
     def __add__(self, n: int) -> int: pass
     def __sub__(self, n: int) -> int: pass
     def __mul__(self, n: int) -> int: pass
+    def __pow__(self, n: int, modulo: Optional[int] = None) -> int: pass
     def __floordiv__(self, x: int) -> int: pass
     def __mod__(self, x: int) -> int: pass
     def __neg__(self) -> int: pass
@@ -77,6 +78,8 @@ class str:
     def startswith(self, x: str, start: int=..., end: int=...) -> bool: pass
     def endswith(self, x: str, start: int=..., end: int=...) -> bool: pass
     def replace(self, old: str, new: str, maxcount: Optional[int] = None) -> str: pass
+    def find(self, sub: str, start: Optional[int] = None, end: Optional[int] = None) -> int: ...
+    def count(self, sub: str, start: Optional[int] = None, end: Optional[int] = None) -> int: ...
 
 class float:
     def __init__(self, x: object) -> None: pass
@@ -96,10 +99,18 @@ class complex:
 
 class bytes:
     def __init__(self, x: object) -> None: pass
-    def __add__(self, x: object) -> bytes: pass
+    def __add__(self, x: bytes) -> bytes: pass
     def __eq__(self, x:object) -> bool:pass
     def __ne__(self, x: object) -> bool: pass
+    def __len__(self) -> int: pass
+    @overload
+    def __getitem__(self, i: int) -> int: pass
+    @overload
+    def __getitem__(self, i: slice) -> bytes: pass
     def join(self, x: Iterable[object]) -> bytes: pass
+    def startswith(self, x: bytes) -> bool: pass
+    def endswith(self, x: bytes) -> bool: pass
+    def decode(self, encoding: str = ..., errors: str = ...) -> str: pass
 
 class bool(int):
     def __init__(self, o: object = ...) -> None: ...
@@ -135,7 +146,10 @@ class list(Generic[T], Sequence[T], Iterable[T]):
     @overload
     def __getitem__(self, s: slice) -> List[T]: ...
     def __setitem__(self, i: int, o: T) -> None: pass
+    @overload
     def __delitem__(self, i: int) -> None: pass
+    @overload
+    def __delitem__(self, i: slice) -> None: pass
     def __mul__(self, i: int) -> List[T]: pass
     def __rmul__(self, i: int) -> List[T]: pass
     def __iter__(self) -> Iterator[T]: pass
@@ -146,7 +160,7 @@ class list(Generic[T], Sequence[T], Iterable[T]):
     def count(self, T) -> int: pass
     def extend(self, l: Iterable[T]) -> None: pass
     def insert(self, i: int, x: T) -> None: pass
-    def sort(self) -> None: pass
+    def sort(self, *, key: Optional[Callable[[T], Any]] = ..., reverse: bool = ...) -> None: pass
     def reverse(self) -> None: pass
     def remove(self, o: T) -> None: pass
     def index(self, o: T) -> int: pass
@@ -230,6 +244,10 @@ class KeyError(LookupError): pass
 
 class IndexError(LookupError): pass
 
+class ArithmeticError(Exception): pass
+
+class OverflowError(ArithmeticError): pass
+
 class RuntimeError(Exception): pass
 
 class NotImplementedError(RuntimeError): pass
@@ -240,6 +258,8 @@ class StopIteration(Exception):
 def any(i: Iterable[T]) -> bool: pass
 def all(i: Iterable[T]) -> bool: pass
 def reversed(object: Sequence[T]) -> Iterator[T]: ...
+def sorted(i: Iterable[T], *, key: Optional[Callable[[T], Any]] = ...,
+           reverse: bool = ...) -> List[T]: ...
 def id(o: object) -> int: pass
 # This type is obviously wrong but the test stubs don't have Sized anymore
 def len(o: object) -> int: pass
@@ -252,8 +272,11 @@ def next(i: Iterator[T]) -> T: pass
 @overload
 def next(i: Iterator[T], default: T) -> T: pass
 def hash(o: object) -> int: ...
+def hex(x: int) -> str: ...
 def globals() -> Dict[str, Any]: ...
 def setattr(object: Any, name: str, value: Any) -> None: ...
+def getattr(object: Any, name: str, default: Any = ...) -> Any: ...
+def hasattr(object: Any, name: str) -> bool: ...
 def enumerate(x: Iterable[T]) -> Iterator[Tuple[int, T]]: ...
 @overload
 def zip(x: Iterable[T], y: Iterable[S]) -> Iterator[Tuple[T, S]]: ...
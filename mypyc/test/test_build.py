@@ -0,0 +1,117 @@
+"""Test cases for compiling C files in parallel with the object file cache."""
+
+import os
+import shutil
+import sys
+import tempfile
+import unittest
+from typing import Any, List
+
+from distutils import ccompiler, sysconfig
+from distutils.core import Extension
+from distutils.dist import Distribution
+from distutils.errors import CompileError
+
+from mypyc.build import (
+    cacheable_sources, register_cacheable_sources, setup_parallel_compile,
+    teardown_parallel_compile, object_cache_key, get_build_ext
+)
+
+
+@unittest.skipIf(sys.platform.startswith('win'), 'only unix compilers are supported')
+class TestObjectCache(unittest.TestCase):
+    def setUp(self) -> None:
+        self.tmp = tempfile.mkdtemp()
+        self.header = self.write('header.h', '#define VALUE 1\n')
+        self.sources = [self.write('a.c', '#include "header.h"\nint a(void) { return VALUE; }\n'),
+                        self.write('b.c', 'int b(void) { return 2; }\n')]
+        self.cache_dir = os.path.join(self.tmp, 'objcache')
+        register_cacheable_sources(self.sources, [self.header])
+
+    def tearDown(self) -> None:
+        for src in self.sources:
+            del cacheable_sources[os.path.abspath(src)]
+        shutil.rmtree(self.tmp)
+
+    def write(self, name: str, text: str) -> str:
+        path = os.path.join(self.tmp, name)
+        with open(path, 'w') as f:
+            f.write(text)
+        return path
+
+    def build(self, sources: List[str]) -> List[str]:
+        """Compile sources and return the names of the ones that weren't cached."""
+        compiler = ccompiler.new_compiler()  # type: Any
+        sysconfig.customize_compiler(compiler)
+        compiled = []  # type: List[str]
+        original = compiler._compile
+
+        def _compile(obj: str, src: str, *args: Any) -> None:
+            compiled.append(os.path.basename(src))
+            original(obj, src, *args)
+
+        compiler._compile = _compile
+        setup_parallel_compile(compiler, 2, self.cache_dir)
+        objects = compiler.compile(sources, output_dir=os.path.join(self.tmp, 'build'),
+                                   include_dirs=[self.tmp])
+        assert all(os.path.isfile(obj) for obj in objects)
+        return sorted(compiled)
+
+    def test_build_twice(self) -> None:
+        assert self.build(self.sources) == ['a.c', 'b.c']
+        assert len(os.listdir(self.cache_dir)) == 2
+        # Nothing changed, so both object files come from the cache
+        assert self.build(self.sources) == []
+        # Only a.c includes the header, but the key covers every header that
+        # any registered source can include
+        self.write('header.h', '#define VALUE 2\n')
+        assert self.build(self.sources) == ['a.c', 'b.c']
+        assert self.build(self.sources) == []
+        self.write('b.c', 'int b(void) { return 3; }\n')
+        assert self.build(self.sources) == ['b.c']
+        # Reverting a change finds the old object file again
+        self.write('header.h', '#define VALUE 1\n')
+        self.write('b.c', 'int b(void) { return 2; }\n')
+        assert self.build(self.sources) == []
+
+    def test_cache_key(self) -> None:
+        compiler = ccompiler.new_compiler()  # type: Any
+        sysconfig.customize_compiler(compiler)
+        key = object_cache_key(compiler, self.sources[0], ['-O2'], {})
+        assert key is not None
+        assert object_cache_key(compiler, self.sources[0], ['-O2'], {}) == key
+        assert object_cache_key(compiler, self.sources[0], ['-O3'], {}) != key
+        self.write('header.h', '#define VALUE 2\n')
+        assert object_cache_key(compiler, self.sources[0], ['-O2'], {}) != key
+
+    def test_other_sources_not_affected(self) -> None:
+        other = self.write('other.c', 'int other(void) { return 0; }\n')
+        assert object_cache_key(None, other, [], {}) is None
+        # Sources not registered by mypycify go through the original compile
+        assert self.build([other]) == ['other.c']
+        assert not os.path.exists(self.cache_dir)
+
+    def test_only_one_compiler_patched(self) -> None:
+        compiler = ccompiler.new_compiler()
+        other = ccompiler.new_compiler()
+        setup_parallel_compile(compiler, 2, self.cache_dir)
+        assert 'compile' in vars(compiler)
+        assert 'compile' not in vars(other)
+        teardown_parallel_compile(compiler)
+        assert 'compile' not in vars(compiler)
+
+    def test_build_ext_restores_compiler(self) -> None:
+        bad = self.write('bad.c', 'this is not C\n')
+        self.sources.append(bad)
+        register_cacheable_sources([bad], [])
+        ext = Extension('bad', [bad])
+        setattr(ext, 'mypyc_parallel_compile', (2, self.cache_dir))
+        cmd = get_build_ext()(Distribution({'ext_modules': [ext]}))
+        cmd.build_temp = os.path.join(self.tmp, 'build')
+        cmd.build_lib = self.tmp
+        cmd.ensure_finalized()
+        cmd.compiler = ccompiler.new_compiler()
+        sysconfig.customize_compiler(cmd.compiler)
+        with self.assertRaises(CompileError):
+            cmd.build_extension(ext)
+        assert 'compile' not in vars(cmd.compiler)
@@ -0,0 +1,30 @@
+"""Test reading receiver type profiles of method call sites."""
+
+import unittest
+
+from mypyc.codegen.dispatchprofile import dispatch_site_name, read_dispatch_profile
+
+
+class TestDispatchProfile(unittest.TestCase):
+    def test_site_name(self) -> None:
+        assert dispatch_site_name('pkg.mod', 12, 'accept') == 'pkg.mod:12:accept'
+
+    def test_read_profile(self) -> None:
+        lines = [
+            # Monomorphic
+            'm:1:f\tm.A\t1000\n',
+            # Mostly one class, counts from two runs
+            'm:2:f\tm.A\t600\n',
+            'm:2:f\tm.B\t10\n',
+            'm:2:f\tm.A\t400\n',
+            # Polymorphic
+            'm:3:f\tm.A\t500\n',
+            'm:3:f\tm.B\t500\n',
+            # Too many classes to tell
+            'm:4:f\tm.A\t10\n',
+            'm:4:f\t*\t1000\n',
+            # Too few calls to matter
+            'm:5:f\tm.A\t5\n',
+            '\n',
+        ]
+        assert read_dispatch_profile(lines) == {'m:1:f': 'm.A', 'm:2:f': 'm.A'}
@@ -9,12 +9,13 @@ from mypy.test.helpers import assert_string_arrays_equal
 from mypyc.ir.ops import (
     BasicBlock, Goto, Return, Integer, Assign, AssignMulti, IncRef, DecRef, Branch,
     Call, Unbox, Box, TupleGet, GetAttr, SetAttr, Op, Value, CallC, IntOp, LoadMem,
-    GetElementPtr, LoadAddress, ComparisonOp, SetMem, Register
+    GetElementPtr, LoadAddress, ComparisonOp, SetMem, Register, LoadInlineCache, MethodCall,
+    LoadLiteral
 )
 from mypyc.ir.rtypes import (
     RTuple, RInstance, RType, RArray, int_rprimitive, bool_rprimitive, list_rprimitive,
     dict_rprimitive, object_rprimitive, c_int_rprimitive, short_int_rprimitive, int32_rprimitive,
-    int64_rprimitive, RStruct, pointer_rprimitive
+    int64_rprimitive, RStruct, pointer_rprimitive, str_rprimitive
 )
 from mypyc.ir.func_ir import FuncIR, FuncDecl, RuntimeArg, FuncSignature
 from mypyc.ir.class_ir import ClassIR
@@ -68,6 +69,11 @@ class TestFunctionEmitterVisitor(unittest.TestCase):
         compute_vtable(ir)
         ir.mro = [ir]
         self.r = add_local('r', RInstance(ir))
+        trait = ClassIR('T', 'mod', is_trait=True)
+        trait.attributes = OrderedDict([('x', bool_rprimitive), ('y', int_rprimitive)])
+        compute_vtable(trait)
+        trait.mro = [trait]
+        self.tr = add_local('tr', RInstance(trait))
 
         self.context = EmitterContext(NameGenerator([['mod']]))
 
@@ -205,6 +211,14 @@ class TestFunctionEmitterVisitor(unittest.TestCase):
         self.assert_emit(IncRef(self.m),
                          "CPyTagged_IncRef(cpy_r_m);")
 
+    def test_inc_ref_literal(self) -> None:
+        lit = LoadLiteral('foo', str_rprimitive)
+        self.assert_emit(IncRef(lit),
+                         """#ifndef CPY_IMMORTAL_STATICS
+                            CPy_INCREF(cpy_r_r0);
+                            #endif""",
+                         prior_ops=[lit])
+
     def test_dec_ref(self) -> None:
         self.assert_emit(DecRef(self.m),
                          "CPyTagged_DecRef(cpy_r_m);")
@@ -258,6 +272,11 @@ class TestFunctionEmitterVisitor(unittest.TestCase):
                }
             """)
 
+    def test_get_attr_borrowed(self) -> None:
+        self.assert_emit(
+            GetAttr(self.r, 'y', 1, borrow=True),
+            """cpy_r_r0 = ((mod___AObject *)cpy_r_r)->_y;""")
+
     def test_set_attr(self) -> None:
         self.assert_emit(
             SetAttr(self.r, 'y', self.m, 1),
@@ -268,6 +287,43 @@ class TestFunctionEmitterVisitor(unittest.TestCase):
                cpy_r_r0 = 1;
             """)
 
+    def test_get_attr_trait(self) -> None:
+        self.assert_emit(
+            GetAttr(self.tr, 'x', 1),
+            """size_t __tmp1;
+               __tmp1 = CPy_FindAttrOffsetCached(CPyType_T, """
+            """((mod___TObject *)cpy_r_tr)->vtable, 0, &CPyTraitCaches[0]);
+               cpy_r_r0 = *(char *)((char *)cpy_r_tr + __tmp1);
+            """)
+
+    def test_method_call_dispatch_profile(self) -> None:
+        base = ClassIR('B', 'mod')
+        sub = ClassIR('S', 'mod')
+        for cl in base, sub:
+            sig = FuncSignature([RuntimeArg('self', RInstance(cl))], int_rprimitive)
+            cl.method_decls['f'] = FuncDecl('f', cl.name, 'mod', sig)
+            cl.methods['f'] = FuncIR(cl.method_decls['f'], [], [])
+        base.mro = [base]
+        sub.base = base
+        sub.mro = [sub, base]
+        base.children = [sub]
+        compute_vtable(sub)
+        b = Register(RInstance(base), 'b')
+        self.registers.append(b)
+        self.context.dispatch_sites = []
+        self.context.dispatch_targets = {'prog:1:f': sub}
+        self.assert_emit(
+            MethodCall(b, 'f', [], 1),
+            """CPyDispatchProfile_Record(&CPyDispatchSites[0], cpy_r_b);
+               if (Py_TYPE(cpy_r_b) == CPyType_S) {
+                   cpy_r_r0 = ((CPyTagged (*)(PyObject *))CPyDef_S___f)(cpy_r_b);
+               } else {
+                   cpy_r_r0 = CPY_GET_METHOD(cpy_r_b, CPyType_B, 0, mod___BObject, """
+            """CPyTagged (*)(PyObject *))(cpy_r_b); /* f */
+               }
+            """)
+        self.assertEqual(self.context.dispatch_sites, ['prog:1:f'])
+
     def test_dict_get_item(self) -> None:
         self.assert_emit(CallC(dict_get_item_op.c_function_name, [self.d, self.o2],
                                dict_get_item_op.return_type, dict_get_item_op.steals,
@@ -363,6 +419,12 @@ class TestFunctionEmitterVisitor(unittest.TestCase):
         self.assert_emit(LoadAddress(object_rprimitive, "PyDict_Type"),
                          """cpy_r_r0 = (PyObject *)&PyDict_Type;""")
 
+    def test_load_inline_cache(self) -> None:
+        self.context.tables.inline_caches[LoadInlineCache()] = 0
+        op = LoadInlineCache()
+        self.context.tables.inline_caches[op] = 1
+        self.assert_emit(op, """cpy_r_r0 = &CPyInlineCaches[1];""")
+
     def test_assign_multi(self) -> None:
         t = RArray(object_rprimitive, 2)
         a = Register(t, 'a')
@@ -377,8 +439,11 @@ class TestFunctionEmitterVisitor(unittest.TestCase):
         self.assert_emit(Assign(a, Integer((1 << 31) - 1, int64_rprimitive)),
                          """cpy_r_a = 2147483647;""")
 
-    def assert_emit(self, op: Op, expected: str, next_block: Optional[BasicBlock] = None) -> None:
+    def assert_emit(self, op: Op, expected: str, next_block: Optional[BasicBlock] = None,
+                    prior_ops: Optional[List[Op]] = None) -> None:
+        """Check the code for op, which may use values of prior_ops (that aren't emitted)."""
         block = BasicBlock(0)
+        block.ops.extend(prior_ops or [])
         block.ops.append(op)
         value_names = generate_names_for_ir(self.registers, [block])
         emitter = Emitter(self.context, value_names)
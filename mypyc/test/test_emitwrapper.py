@@ -4,8 +4,9 @@ from typing import List
 from mypy.test.helpers import assert_string_arrays_equal
 
 from mypyc.codegen.emit import Emitter, EmitterContext
-from mypyc.codegen.emitwrapper import generate_arg_check
-from mypyc.ir.rtypes import list_rprimitive, int_rprimitive
+from mypyc.codegen.emitwrapper import generate_arg_check, make_arg_types
+from mypyc.ir.func_ir import RuntimeArg
+from mypyc.ir.rtypes import list_rprimitive, int_rprimitive, object_rprimitive
 from mypyc.namegen import NameGenerator
 
 
@@ -52,6 +53,15 @@ class TestArgCheck(unittest.TestCase):
             '}',
         ], lines)
 
+    def test_arg_types(self) -> None:
+        emitter = Emitter(self.context)
+        args = [RuntimeArg('x', int_rprimitive), RuntimeArg('y', object_rprimitive),
+                RuntimeArg('z', list_rprimitive)]
+        assert make_arg_types(args, emitter) == (
+            'static const CPyArg_Type argtypes[] = {{CPYARG_INT, NULL, "int"}, '
+            '{CPYARG_OBJECT, NULL, "object"}, {CPYARG_LIST, NULL, "list"}};')
+        assert make_arg_types(args[1:2], emitter) is None
+
     def assert_lines(self, expected: List[str], actual: List[str]) -> None:
         actual = [line.rstrip('\n') for line in actual]
         assert_string_arrays_equal(expected, actual, 'Invalid output')
@@ -14,6 +14,7 @@ from mypyc.ir.pprint import format_func
 from mypyc.transform.uninit import insert_uninit_checks
 from mypyc.transform.exceptions import insert_exception_handling
 from mypyc.transform.refcount import insert_ref_count_opcodes
+from mypyc.transform.nogil import check_nogil_regions
 from mypyc.test.testutil import (
     ICODE_GEN_BUILTINS, use_custom_builtins, MypycDataSuite, build_ir_for_single_file,
     assert_test_output, remove_comment_lines, replace_native_int
@@ -46,7 +47,11 @@ class TestExceptionTransform(MypycDataSuite):
                     insert_uninit_checks(fn)
                     insert_exception_handling(fn)
                     insert_ref_count_opcodes(fn)
-                    actual.extend(format_func(fn))
+                    errors = check_nogil_regions(fn)
+                    if errors:
+                        actual.extend('main:%d: error: %s' % error for error in errors)
+                    else:
+                        actual.extend(format_func(fn))
 
             assert_test_output(testcase, actual, 'Invalid source code output',
                                expected_output)
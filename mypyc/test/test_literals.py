@@ -9,23 +9,25 @@ from mypyc.codegen.literals import (
 
 class TestLiterals(unittest.TestCase):
     def test_format_str_literal(self) -> None:
-        assert format_str_literal('') == b'\x00'
-        assert format_str_literal('xyz') == b'\x03xyz'
-        assert format_str_literal('x' * 127) == b'\x7f' + b'x' * 127
-        assert format_str_literal('x' * 128) == b'\x81\x00' + b'x' * 128
-        assert format_str_literal('x' * 131) == b'\x81\x03' + b'x' * 131
+        assert format_str_literal('') == b'\x01'
+        assert format_str_literal('xyz') == b'\x07xyz'
+        assert format_str_literal('x' * 63) == b'\x7f' + b'x' * 63
+        assert format_str_literal('x' * 64) == b'\x81\x01' + b'x' * 64
+        assert format_str_literal('x' * 131) == b'\x82\x07' + b'x' * 131
+        # Non-ASCII values don't have the low bit set
+        assert format_str_literal('\u00e9') == b'\x04\xc3\xa9'
 
     def test_encode_str_values(self) -> None:
         assert _encode_str_values({}) == [b'']
-        assert _encode_str_values({'foo': 0}) == [b'\x01\x03foo', b'']
-        assert _encode_str_values({'foo': 0, 'b': 1}) == [b'\x02\x03foo\x01b', b'']
+        assert _encode_str_values({'foo': 0}) == [b'\x01\x07foo', b'']
+        assert _encode_str_values({'foo': 0, 'b': 1}) == [b'\x02\x07foo\x03b', b'']
         assert _encode_str_values({'foo': 0, 'x' * 70: 1}) == [
-            b'\x01\x03foo',
-            bytes([1, 70]) + b'x' * 70,
+            b'\x01\x07foo',
+            bytes([1, 0x81, 13]) + b'x' * 70,
             b''
         ]
         assert _encode_str_values({'y' * 100: 0}) == [
-            bytes([1, 100]) + b'y' * 100,
+            bytes([1, 0x81, 73]) + b'y' * 100,
             b''
         ]
 
@@ -85,3 +87,22 @@ class TestLiterals(unittest.TestCase):
             '4', '6', '3', '0', '7',  # Second tuple (length=4)
             '0',  # Third tuple (length=0)
         ]
+
+    def test_frozenset_literal(self) -> None:
+        lit = Literals()
+        lit.record_literal(frozenset({'b', 'a', 1}))
+        lit.record_literal(frozenset())
+        lit.record_literal((1, 'a'))
+        # Items are recorded in a deterministic order
+        assert lit.literal_index('a') == 3
+        assert lit.literal_index('b') == 4
+        assert lit.literal_index(1) == 5
+        assert lit.literal_index((1, 'a')) == 6
+        assert lit.literal_index(frozenset({'a', 'b', 1})) == 7
+        assert lit.literal_index(frozenset()) == 8
+        assert lit.num_literals() == 9
+        assert lit.encoded_frozenset_values() == [
+            '2',  # Number of frozensets
+            '3', '3', '4', '5',  # First frozenset (length=3)
+            '0',  # Second frozenset (length=0)
+        ]
@@ -58,11 +58,12 @@ if sys.version_info >= (3, 8):
 
 setup_format = """\
 from setuptools import setup
-from mypyc.build import mypycify
+from mypyc.build import mypycify, get_build_ext
 
 setup(name='test_run_output',
       ext_modules=mypycify({}, separate={}, skip_cgen_input={!r}, strip_asserts=False,
                            multi_file={}, opt_level='{}'),
+      cmdclass={{'build_ext': get_build_ext()}},
 )
 """
 
@@ -123,6 +124,10 @@ class TestRun(MypycDataSuite):
     optional_out = True
     multi_file = False
     separate = False
+    # Driver used by test cases that don't provide a driver.py
+    default_driver = 'driver.py'
+    # Used if MYPYC_OPT_LEVEL isn't set
+    default_opt_level = 0
 
     def run_case(self, testcase: DataDrivenTestCase) -> None:
         # setup.py wants to be run from the root directory of the package, which we accommodate
@@ -171,7 +176,7 @@ class TestRun(MypycDataSuite):
             self.run_case_step(testcase, step)
 
     def run_case_step(self, testcase: DataDrivenTestCase, incremental_step: int) -> None:
-        bench = testcase.config.getoption('--bench', False) and 'Benchmark' in testcase.name
+        bench = self.is_bench(testcase)
 
         options = Options()
         options.use_builtins_fixtures = True
@@ -246,7 +251,7 @@ class TestRun(MypycDataSuite):
         if incremental_step == 1:
             check_serialization_roundtrip(ir)
 
-        opt_level = int(os.environ.get('MYPYC_OPT_LEVEL', 0))
+        opt_level = int(os.environ.get('MYPYC_OPT_LEVEL', self.default_opt_level))
 
         setup_file = os.path.abspath(os.path.join(WORKDIR, 'setup.py'))
         # We pass the C file information to the build script via setup.py unfortunately
@@ -272,10 +277,11 @@ class TestRun(MypycDataSuite):
             # (mypyc/test-data/driver/driver.py) that calls each
             # function named test_*.
             default_driver = os.path.join(
-                os.path.dirname(__file__), '..', 'test-data', 'driver', 'driver.py')
+                os.path.dirname(__file__), '..', 'test-data', 'driver', self.default_driver)
             shutil.copy(default_driver, driver_path)
         env = os.environ.copy()
         env['MYPYC_RUN_BENCH'] = '1' if bench else '0'
+        env['MYPYC_BENCH_CASE'] = testcase.name
 
         # XXX: This is an ugly hack.
         if 'MYPYC_RUN_GDB' in os.environ:
@@ -335,6 +341,10 @@ class TestRun(MypycDataSuite):
 
         assert proc.returncode == 0
 
+    def is_bench(self, testcase: DataDrivenTestCase) -> bool:
+        """Should we measure performance in this test case?"""
+        return testcase.config.getoption('--bench', False) and 'Benchmark' in testcase.name
+
     def get_separate(self, program_text: str,
                      incremental_step: int) -> Any:
         template = r'# separate{}: (\[.*\])$'
@@ -369,6 +379,26 @@ class TestRunSeparate(TestRun):
     ]
 
 
+class TestBench(TestRun):
+    """Differential benchmarks that compare compiled and interpreted code.
+
+    Without --bench, these check that compiled and interpreted code produce
+    the same results. With --bench, they also report speedups and memory use,
+    and fail if the gates in a test case aren't met. See
+    mypyc/test-data/driver/bench_driver.py for the details.
+    """
+
+    files = [
+        'bench-basics.test',
+    ]
+    default_driver = 'bench_driver.py'
+    # Measure optimized code, like users would run
+    default_opt_level = 3
+
+    def is_bench(self, testcase: DataDrivenTestCase) -> bool:
+        return testcase.config.getoption('--bench', False)
+
+
 def fix_native_line_number(message: str, fnam: str, delta: int) -> str:
     """Update code locations in test case output to point to the .test file.
 
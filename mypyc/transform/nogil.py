@@ -0,0 +1,112 @@
+"""Check the parts of nogil functions that run without the GIL.
+
+A nogil function (see mypyc.irbuild.nogil) releases the GIL by calling
+CPy_NoGIL_Enter and reacquires it by calling CPy_NoGIL_Exit or
+CPy_NoGIL_Raise. This finds the ops that run in between, after the
+exception and refcount transforms have added their ops. Only ops that
+don't touch Python objects are allowed there.
+
+This also drops the traceback entries of error branches that run without
+the GIL, since adding a traceback entry needs the GIL. The traceback entry
+of CPy_NoGIL_Raise is used instead.
+"""
+
+from typing import List, Tuple, Dict, Set
+from typing_extensions import Final
+
+from mypyc.analysis.dataflow import get_cfg
+from mypyc.ir.ops import (
+    Op, BasicBlock, Goto, Branch, Unreachable, KeepAlive, Assign, IntOp, ComparisonOp, Truncate,
+    LoadErrorValue, IncRef, DecRef, GetAttr, CallC
+)
+from mypyc.ir.func_ir import FuncIR
+from mypyc.ir.rtypes import RType, is_tagged
+from mypyc.primitives.int_ops import (
+    nogil_enter_op, nogil_exit_op, nogil_raise_op, int_nogil_binary_ops, int_nogil_neg_op,
+    int_nogil_invert_op, int_nogil_check_attr_op, bool_nogil_check_attr_op, int_equal_,
+    int_less_than_
+)
+
+# C functions that can be called without the GIL
+NOGIL_C_FUNCTIONS = {
+    desc.c_function_name
+    for desc in list(int_nogil_binary_ops.values()) + [
+        int_nogil_neg_op, int_nogil_invert_op, int_nogil_check_attr_op, bool_nogil_check_attr_op,
+        # Int comparisons only call these for long ints, and all ints are short
+        int_equal_, int_less_than_,
+    ]
+}  # type: Final
+
+NOGIL_ERROR = ('Only int and bool operations and reads of native int and bool attributes '
+               'are allowed in nogil functions')  # type: Final
+
+
+def check_nogil_regions(fn: FuncIR) -> List[Tuple[int, str]]:
+    """Check the ops that run without the GIL in fn.
+
+    Return errors as (line, message) tuples.
+    """
+    if not any(is_call_to(op, nogil_enter_op.c_function_name)
+               for block in fn.blocks for op in block.ops):
+        return []
+
+    # Propagate whether the GIL is released at the start of each block
+    succ = get_cfg(fn.blocks).succ
+    released = {fn.blocks[0]: False}  # type: Dict[BasicBlock, bool]
+    worklist = [fn.blocks[0]]
+    error_lines = set()  # type: Set[int]
+    while worklist:
+        block = worklist.pop()
+        state = released[block]
+        for op in block.ops:
+            if is_call_to(op, nogil_enter_op.c_function_name):
+                state = True
+            elif (is_call_to(op, nogil_exit_op.c_function_name)
+                    or is_call_to(op, nogil_raise_op.c_function_name)):
+                state = False
+            elif state:
+                if isinstance(op, Branch) and op.traceback_entry is not None:
+                    op.traceback_entry = None
+                    op.rare = True
+                elif not is_nogil_op(op):
+                    error_lines.add(op.line)
+        for target in succ[block]:
+            if target not in released:
+                released[target] = state
+                worklist.append(target)
+            else:
+                assert released[target] == state, 'Inconsistent GIL state in %s' % fn.name
+    if -1 in error_lines:
+        # Ops added by the transforms (such as decrefs of the results of other
+        # rejected ops) have no line number
+        error_lines.remove(-1)
+        if not error_lines:
+            error_lines.add(fn.line)
+    return [(line, NOGIL_ERROR) for line in sorted(error_lines)]
+
+
+def is_call_to(op: Op, c_function_name: str) -> bool:
+    return isinstance(op, CallC) and op.function_name == c_function_name
+
+
+def is_nogil_type(typ: RType) -> bool:
+    return not typ.is_refcounted or is_tagged(typ)
+
+
+def is_nogil_op(op: Op) -> bool:
+    """Can op run without the GIL (assuming that all ints are short)?"""
+    if isinstance(op, (Goto, Branch, Unreachable, KeepAlive, IntOp, ComparisonOp, Truncate)):
+        return True
+    elif isinstance(op, Assign):
+        return is_nogil_type(op.dest.type)
+    elif isinstance(op, LoadErrorValue):
+        return is_nogil_type(op.type)
+    elif isinstance(op, (IncRef, DecRef)):
+        # Short ints aren't reference counted
+        return is_tagged(op.src.type)
+    elif isinstance(op, GetAttr):
+        # Borrowed reads are checked by the caller, and they aren't properties
+        return op.is_borrowed
+    elif isinstance(op, CallC):
+        return op.function_name in NOGIL_C_FUNCTIONS
+    return False
@@ -142,7 +142,7 @@ if USE_MYPYC:
         del sys.modules['mypy.git']
         sys.path.insert(0, use_other_mypyc)
 
-    from mypyc.build import mypycify
+    from mypyc.build import mypycify, get_build_ext
     opt_level = os.getenv('MYPYC_OPT_LEVEL', '3')
     force_multifile = os.getenv('MYPYC_MULTI_FILE', '') == '1'
     ext_modules = mypycify(
@@ -152,6 +152,7 @@ if USE_MYPYC:
         # our Appveyor builds run out of memory sometimes.
         multi_file=sys.platform == 'win32' or force_multifile,
     )
+    cmdclass['build_ext'] = get_build_ext()
 else:
     ext_modules = []
 